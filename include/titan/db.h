@@ -17,6 +17,27 @@ struct TitanCFDescriptor {
       : name(_name), options(_options) {}
 };
 
+// GC work estimated by TitanDB::EstimateGC().
+struct GCEstimate {
+  struct Batch {
+    std::vector<uint64_t> file_numbers;
+    // Bytes read by GC, i.e. size of the blob files.
+    uint64_t bytes_read = 0;
+    // Bytes rewritten by GC, i.e. live data size of the blob files.
+    uint64_t bytes_written = 0;
+  };
+
+  // Batches of blob files in the order GC would pick them.
+  std::vector<Batch> batches;
+  uint64_t bytes_read = 0;
+  uint64_t bytes_written = 0;
+  // Space freed once all the batches are done.
+  uint64_t reclaimable_size = 0;
+  // Number and size of all blob files of the column family.
+  uint64_t num_blob_files = 0;
+  uint64_t blob_file_size = 0;
+};
+
 class TitanDB : public StackableDB {
  public:
   static Status Open(const TitanOptions& options, const std::string& dbname,
@@ -151,6 +172,25 @@ class TitanDB : public StackableDB {
                                          const RangePtr* ranges, size_t n,
                                          bool include_end = true) = 0;
 
+  // GCs the blob files of the column family whose keys are all in
+  // [begin, end], regardless of background GC, and blocks until it is done.
+  // nullptr means the range is unbounded on that side. Files being GCed or
+  // whose discardable ratio is below `options.min_discardable_ratio` are
+  // skipped.
+  virtual Status CompactBlobFiles(ColumnFamilyHandle* column_family,
+                                  const Slice* begin, const Slice* end,
+                                  const CompactBlobFilesOptions& options) = 0;
+
+  // Estimates GC of the column family by running the GC picker over blob
+  // files as they are now, one batch after another, without running or
+  // scheduling any GC. If `options` is given, its GC options, such as
+  // `blob_file_discardable_ratio`, `min_gc_batch_size` and
+  // `max_gc_batch_size`, are used instead of those of the column family, to
+  // see the effect of changing them.
+  virtual Status EstimateGC(ColumnFamilyHandle* column_family,
+                            const TitanCFOptions* options,
+                            GCEstimate* estimate) = 0;
+
   using rocksdb::StackableDB::GetOptions;
   Options GetOptions(ColumnFamilyHandle* column_family) const override = 0;
 
@@ -200,6 +240,18 @@ class TitanDB : public StackableDB {
     //  "rocksdb.titandb.discardable_ratio_le100_file_num" - returns count of
     //      file whose discardable ratio is less or equal to 100%.
     static const std::string kNumDiscardableRatioLE100File;
+    //  "rocksdb.titandb.num-pending-gc" - returns number of GC runs queued
+    //      but not started yet, of all column families.
+    static const std::string kNumPendingGC;
+    //  "rocksdb.titandb.num-running-gc" - returns number of GC jobs running,
+    //      of all column families.
+    static const std::string kNumRunningGC;
+    //  "rocksdb.titandb.gc-reclaimable-size" - returns size GC can reclaim
+    //      from blob files reaching the discardable ratio and not being GC.
+    static const std::string kGCReclaimableSize;
+    //  "rocksdb.titandb.gc-bytes-per-sec" - returns current rate of
+    //      `gc_rate_limiter`, 0 if there is none.
+    static const std::string kGCBytesPerSec;
   };
 
   bool GetProperty(ColumnFamilyHandle* column_family, const Slice& property,
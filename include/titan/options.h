@@ -1,7 +1,10 @@
 #pragma once
 
+#include <functional>
+#include <limits>
 #include <map>
 #include <unordered_map>
+#include <vector>
 
 #include "logging/logging.h"
 #include "rocksdb/options.h"
@@ -9,6 +12,10 @@
 namespace rocksdb {
 namespace titandb {
 
+// A compression level meaning the same as
+// `TitanCFOptions::blob_file_compression_options.level`.
+const int kInheritBlobCompressionLevel = std::numeric_limits<int>::min();
+
 struct TitanDBOptions : public DBOptions {
   // The directory to store data specific to TitanDB alongside with
   // the base DB.
@@ -26,6 +33,70 @@ struct TitanDBOptions : public DBOptions {
   // Default: 1
   int32_t max_background_gc{1};
 
+  // Max number of threads a single GC job uses. The input blob files of a
+  // GC job are split into this many partitions by key range and size, each
+  // of which is read, checked and rewritten into its own output files by a
+  // separate sub job. One sub job runs in the GC thread, the others are
+  // submitted to the GC thread pool, so they share `max_background_gc`
+  // threads with other GC jobs; the GC thread runs the ones not started by
+  // the pool itself. Outputs of all partitions are installed together at
+  // the end of the job, unless `gc_rewrite_buffer_size` is set, in which
+  // case each sub job installs its outputs chunk by chunk.
+  //
+  // Default: 1
+  uint32_t max_gc_subjobs{1};
+
+  // If set, bytes read from and written to blob files by GC are charged to
+  // this rate limiter, so that all GC jobs of the DB share one I/O budget.
+  // It can be shared among DBs as well. Reads are only charged if the rate
+  // limiter is created with `RateLimiter::Mode::kAllIo`.
+  //
+  // Default: nullptr
+  std::shared_ptr<RateLimiter> gc_rate_limiter;
+
+  // If non-zero, GC reads each input blob file sequentially in chunks of
+  // this size, and the chunk after the one being processed is read by the
+  // low priority thread pool of `env`, so that reads of all inputs overlap
+  // with each other and with processing. A GC job holds at most 16 such
+  // chunks at a time, inputs beyond that are read on demand. Sizes of a few
+  // MBs bring GC reads close to the sequential bandwidth of the disk.
+  // Otherwise GC reads ahead up to 256KB at a time, on demand.
+  //
+  // Default: 0
+  uint64_t gc_readahead_size{0};
+
+  // If true, GC reads input blob files with direct I/O, so that they don't
+  // push hot data out of page cache. Better used with `gc_readahead_size`.
+  //
+  // Default: false
+  bool use_direct_reads_for_gc{false};
+
+  // If true and `gc_rate_limiter` is set, the rate of `gc_rate_limiter` is
+  // adjusted every second by foreground load. The rate is halved while the
+  // P99 latency of blob file reads by Gets is above
+  // `adaptive_gc_rate_target_latency_micros` or the base DB is stalling
+  // writes. GC stops starting new jobs if that still happens at 1/64 of
+  // the rate. Otherwise the rate is raised back step by step to the rate
+  // `gc_rate_limiter` is created with. Note that other users of a shared
+  // `gc_rate_limiter` are affected as well.
+  //
+  // Default: false
+  bool adaptive_gc_rate{false};
+
+  // Target P99 latency of blob file reads by Gets for `adaptive_gc_rate`.
+  // If zero, only write stalls are considered.
+  //
+  // Default: 0
+  uint64_t adaptive_gc_rate_target_latency_micros{0};
+
+  // If non-zero, `adaptive_gc_rate` stops holding GC back by foreground load
+  // when space amplification of blob files (size of live blob files over
+  // size of live blob data, of all column families) approaches this limit,
+  // and lets GC run at full rate once it is reached. Requires statistics.
+  //
+  // Default: 0
+  double adaptive_gc_rate_max_space_amp{0};
+
   // How often to schedule delete obsolete blob files periods.
   // If set zero, obsolete blob files won't be deleted.
   //
@@ -59,6 +130,22 @@ enum class TitanBlobRunMode {
                   // and store the value in SST file.
 };
 
+enum class TitanGCValidityCheckMode {
+  kPointLookup = 0,  // GC checks each blob record with a point lookup (in
+                     // batches, see `gc_lookup_batch_size`) to the LSM.
+  kMergeJoin = 1,    // GC walks an LSM iterator in lockstep with the sorted
+                     // blob records of its input files.
+  kAuto = 2,         // Pick one of the above for each GC job, based on the
+                     // density of GC input keys in the LSM key range.
+};
+
+enum class TitanBlobGCPickerType {
+  kBasic = 0,        // Pick blob files with the highest discardable ratio.
+  kCostBenefit = 1,  // Pick blob files by benefit (free space times age of
+                     // data) over cost (bytes GC has to read and rewrite),
+                     // and defer files that are still decaying quickly.
+};
+
 struct TitanOptionsHelper {
   static std::map<TitanBlobRunMode, std::string> blob_run_mode_to_string;
   static std::unordered_map<std::string, TitanBlobRunMode>
@@ -75,22 +162,103 @@ struct MutableTitanCFOptions;
 
 struct TitanCFOptions : public ColumnFamilyOptions {
   // The smallest value to store in blob files. Value smaller than
-  // this threshold will be inlined in base DB.
+  // this threshold will be inlined in base DB. It can be changed through
+  // SetOptions, and is adjusted by Titan if `min_blob_size_auto_tune` is set.
   //
   // Default: 4096
   uint64_t min_blob_size{4096};
 
+  // Per-level override of `min_blob_size`, indexed by the target level of the
+  // flush or compaction output. Levels beyond the end of the vector use the
+  // last entry. It lets values stay inline in upper levels, where they are
+  // likely to be overwritten soon, and only be separated once they are
+  // compacted into lower levels. Use UINT64_MAX to keep all values of a
+  // level inline. If empty, `min_blob_size` applies to all levels.
+  //
+  // Default: empty
+  std::vector<uint64_t> level_min_blob_size;
+
+  // If set true, Titan adjusts `min_blob_size` on every stats dump, based on
+  // the size distribution of values written by flush and the ratio of
+  // separated values found overwritten by GC. The more values die before GC,
+  // the more of the smaller values are kept inline, so that they are dropped
+  // by compaction instead of being written to blob files and collected by GC.
+  // It takes no effect if `level_min_blob_size` is set.
+  //
+  // Requirement: statistics != nullptr, titan_stats_dump_period_sec > 0
+  // Default: false
+  bool min_blob_size_auto_tune{false};
+
+  // The bounds `min_blob_size` is kept within by auto tune.
+  //
+  // Default: 512 and 64KB
+  uint64_t min_blob_size_lower_bound{512};
+  uint64_t min_blob_size_upper_bound{64 << 10};
+
   // The compression algorithm used to compress data in blob files.
   //
   // Default: kNoCompression
   CompressionType blob_file_compression{kNoCompression};
 
+  // Per-level override of `blob_file_compression`, indexed by the target
+  // level of the flush or compaction output. Levels beyond the end of the
+  // vector use the last entry. It allows a cheap compression for the blob
+  // files written by flush, and a stronger one for values which survive to
+  // lower levels. If empty, `blob_file_compression` applies to all levels.
+  //
+  // Default: empty
+  std::vector<CompressionType> level_blob_file_compression;
+
+  // The compression algorithm used to recompress values rewritten by GC,
+  // which have survived at least one round of GC and are likely cold.
+  // `kDisableCompressionOption` means the same as `blob_file_compression`.
+  //
+  // Default: kDisableCompressionOption
+  CompressionType gc_blob_file_compression{kDisableCompressionOption};
+
+  // Per-level override of `blob_file_compression_options.level`, indexed in
+  // the same way as `level_blob_file_compression`, e.g. a high zstd level
+  // for values which survive to the bottom levels. Blob files compressed
+  // with a shared dictionary use the level the dictionary is digested with.
+  // If empty, `blob_file_compression_options.level` applies to all levels.
+  //
+  // Default: empty
+  std::vector<int> level_blob_file_compression_level;
+
+  // The compression level used to recompress values rewritten by GC.
+  // `kInheritBlobCompressionLevel` means the same as
+  // `blob_file_compression_options.level`.
+  //
+  // Default: kInheritBlobCompressionLevel
+  int gc_blob_file_compression_level{kInheritBlobCompressionLevel};
+
   // The compression options. The `blob_file_compression.enabled` option is
   // ignored, we only use `blob_file_compression` above to determine wether the
   // blob file is compressed. We use this options mainly to configure the
   // compression dictionary.
   CompressionOptions blob_file_compression_options;
 
+  // If true and `blob_file_compression_options.max_dict_bytes` is non-zero,
+  // blob files of the column family share a compression dictionary trained
+  // in background from sampled values and persisted in the Titan manifest,
+  // instead of training one per blob file. Blob file builders then don't need
+  // to buffer records to train the dictionary, and readers share one digested
+  // dictionary. Blob files written before the first dictionary is trained are
+  // compressed without dictionary.
+  //
+  // Default: false
+  bool blob_file_shared_compression_dict{false};
+
+  // If non-zero, consecutive blob records are packed into blocks of about this
+  // size before compression, in blob file format version 3. It improves
+  // compression ratio of small values, and lets scans and GC read a block of
+  // records at once, at the cost of reading the whole block for a point
+  // lookup. The blob cache caches decoded blocks instead of records. Suggested
+  // value is 16KB to 64KB.
+  //
+  // Default: 0
+  uint64_t blob_file_block_size{0};
+
   // The desirable blob file size. This is not a hard limit but a wish.
   //
   // Default: 256MB
@@ -126,6 +294,118 @@ struct TitanCFOptions : public ColumnFamilyOptions {
   // Default: 8MB
   uint64_t merge_small_file_threshold{8 << 20};
 
+  // How GC picks blob files among the ones with enough discardable data.
+  // The cost-benefit picker prefers files whose live data is old and no
+  // longer being overwritten, since young files with fast decaying data are
+  // likely to free more space by themselves if GC waits a bit.
+  //
+  // Default: kBasic
+  TitanBlobGCPickerType gc_picker{TitanBlobGCPickerType::kBasic};
+
+  // If set true, GC batches blob files with overlapping key ranges together,
+  // and splits its outputs where the input files leave a gap in the key
+  // space, so that GC outputs cover tight key ranges as level merge outputs
+  // do. It helps scan locality and `DeleteFilesInRanges()`. Only applies to
+  // blob files with known key ranges.
+  //
+  // Default: false
+  bool gc_key_range_clustering{false};
+
+  // If non-zero, the target space amplification of blob files of this column
+  // family, i.e. size of live blob files over size of live data in them.
+  // Once it reaches 80% of the target, GC of this column family is scheduled
+  // ahead of others, ignores `min_gc_batch_size`, and may use up to twice of
+  // `max_background_gc` threads. If it still exceeds the target, meaning GC
+  // cannot keep up, puts and merges to this column family are delayed at
+  // `delayed_write_rate`, halved for every 10% the target is exceeded by,
+  // until it drops back. Deletions are not delayed. The rate is shared by
+  // all column families exceeding their targets, and set by the furthest
+  // behind.
+  // Must be at least 1 / (1 - `blob_file_discardable_ratio`), the space
+  // amplification files below the discardable ratio are left at by GC.
+  //
+  // Default: 0
+  double max_blob_space_amplification{0};
+
+  // Number of blob records GC reads ahead from its input files and checks
+  // against the LSM with one batched MultiGet, instead of one point lookup
+  // per record. The base DB sorts the keys and shares the index and filter
+  // block lookups among them. Set to 1 to check records one by one.
+  // Records are always checked one by one with `gc_merge_rewrite`, since the
+  // batched lookup doesn't tell which values are blob indexes.
+  //
+  // Default: 64
+  uint64_t gc_lookup_batch_size{64};
+
+  // How GC checks whether blob records of its input files are still
+  // referenced by the LSM. Merge-join is cheaper when GC inputs cover most
+  // of the keys in their key range, and point lookups are cheaper when the
+  // keys are sparse.
+  //
+  // Default: kPointLookup
+  TitanGCValidityCheckMode gc_validity_check_mode{
+      TitanGCValidityCheckMode::kPointLookup};
+
+  // If set true, SST files record which blob records they reference, and
+  // compactions keep track of the exact blob records they drop. GC then
+  // discards those records without checking them against the LSM, and for
+  // blob files created while the option is set, it rewrites the remaining
+  // records right away, leaving it to the rewrite to skip the ones which
+  // were overwritten in the meanwhile. Costs a few bytes of SST properties
+  // per blob index, and a few bytes of memory and Titan manifest per
+  // dropped blob record until its file is GCed. With `gc_merge_rewrite`,
+  // which has no check on rewrite, the remaining records are still checked
+  // against the LSM.
+  //
+  // Default: false
+  bool track_blob_record_deletions{false};
+
+  // If non-zero and `track_blob_record_deletions` is set, after each GC
+  // job, runs of adjacent dead records of at least this size are reclaimed
+  // in place by punching holes in blob files whose garbage is still below
+  // `blob_file_discardable_ratio`, which frees the space without rewriting
+  // the live records around them. Runs are found from the dead records kept
+  // in memory, and a file is checked again only once this much more of it
+  // is dropped. A few files are checked per GC job. It is a no-op on
+  // platforms or file systems which don't support punching holes.
+  //
+  // Default: 0
+  uint64_t punch_hole_min_size{0};
+
+  // If non-zero, once compaction leaves a blob file with a discardable ratio
+  // of at least this, but still below `blob_file_discardable_ratio`, SST
+  // files referencing the blob file are marked for compaction. Stale versions
+  // and tombstones in these SSTs often keep much of the blob file alive
+  // without compaction ever picking them, and compacting them lets GC reclaim
+  // the file sooner. SSTs in the last non-empty level are not marked, as the
+  // base DB only marks files it can compact down. Each blob file is hinted
+  // once some SST referencing it is marked, until then it is tried again
+  // after later compactions.
+  //
+  // Default: 0
+  double compaction_hint_discardable_ratio{0};
+
+  // If non-zero, GC installs its output blob files and rewrites their blob
+  // indexes to the LSM whenever the pending rewrites exceed this size,
+  // instead of holding them all until the end of the GC job. It bounds the
+  // memory used by GC, at the cost of smaller output files. Input files are
+  // still deleted only after the whole GC job finishes, but how far each of
+  // them got is logged with every chunk, so that if the job is interrupted
+  // by shutdown or an error, the next GC of the files resumes from there.
+  //
+  // Default: 0
+  uint64_t gc_rewrite_buffer_size{0};
+
+  // Max number of keys GC rewrites back to the LSM in one write. In normal
+  // rewrite mode, each key of the write is still checked against the LSM by
+  // the write callback, and keys updated in the meanwhile are dropped from
+  // the write before it is retried. Larger value reduces the write group and
+  // WAL overhead of GC, but holds the write leader longer while checking.
+  // Set to 1 to rewrite keys one by one.
+  //
+  // Default: 64
+  uint64_t gc_rewrite_batch_keys{64};
+
   // The mode used to process blob file.
   //
   // Default: kNormal
@@ -168,6 +448,14 @@ struct TitanCFOptions : public ColumnFamilyOptions {
   // trade-off being read performance slightly reduced compared to normal
   // rewrite mode.
   //
+  // GC rewrites of deleted keys leave deletion markers, which a compaction
+  // filter installed by Titan drops. It is installed if this is set when the
+  // column family is opened, or if the user gives a compaction filter. Note
+  // that with a compaction filter, CompactRange() compacts the bottommost
+  // level too under the default `bottommost_level_compaction`. If this is
+  // only enabled later by SetOptions(), the markers, which read as
+  // deletions, are kept until the DB is reopened with it.
+  //
   // Default: false
   bool gc_merge_rewrite{false};
 
@@ -188,6 +476,29 @@ struct TitanCFOptions : public ColumnFamilyOptions {
     return *this;
   }
 
+  // Returns the min blob size threshold for outputs targeting `level`.
+  uint64_t MinBlobSizeForLevel(int level) const;
+
+  // Returns the blob file compression for outputs targeting `level`.
+  CompressionType BlobFileCompressionForLevel(int level) const;
+
+  // Returns the blob file compression for GC outputs.
+  CompressionType GCBlobFileCompression() const {
+    return gc_blob_file_compression == kDisableCompressionOption
+               ? blob_file_compression
+               : gc_blob_file_compression;
+  }
+
+  // Returns the blob file compression level for outputs targeting `level`.
+  int BlobFileCompressionLevelForLevel(int level) const;
+
+  // Returns the blob file compression level for GC outputs.
+  int GCBlobFileCompressionLevel() const {
+    return gc_blob_file_compression_level == kInheritBlobCompressionLevel
+               ? blob_file_compression_options.level
+               : gc_blob_file_compression_level;
+  }
+
   void Dump(Logger* logger) const;
 };
 
@@ -195,8 +506,19 @@ struct ImmutableTitanCFOptions {
   ImmutableTitanCFOptions() : ImmutableTitanCFOptions(TitanCFOptions()) {}
 
   explicit ImmutableTitanCFOptions(const TitanCFOptions& opts)
-      : min_blob_size(opts.min_blob_size),
+      : level_min_blob_size(opts.level_min_blob_size),
+        min_blob_size_auto_tune(opts.min_blob_size_auto_tune),
+        min_blob_size_lower_bound(opts.min_blob_size_lower_bound),
+        min_blob_size_upper_bound(opts.min_blob_size_upper_bound),
         blob_file_compression(opts.blob_file_compression),
+        level_blob_file_compression(opts.level_blob_file_compression),
+        gc_blob_file_compression(opts.gc_blob_file_compression),
+        level_blob_file_compression_level(
+            opts.level_blob_file_compression_level),
+        gc_blob_file_compression_level(opts.gc_blob_file_compression_level),
+        blob_file_shared_compression_dict(
+            opts.blob_file_shared_compression_dict),
+        blob_file_block_size(opts.blob_file_block_size),
         blob_file_target_size(opts.blob_file_target_size),
         blob_cache(opts.blob_cache),
         max_gc_batch_size(opts.max_gc_batch_size),
@@ -204,13 +526,42 @@ struct ImmutableTitanCFOptions {
         blob_file_discardable_ratio(opts.blob_file_discardable_ratio),
         sample_file_size_ratio(opts.sample_file_size_ratio),
         merge_small_file_threshold(opts.merge_small_file_threshold),
+        gc_picker(opts.gc_picker),
+        gc_key_range_clustering(opts.gc_key_range_clustering),
+        max_blob_space_amplification(opts.max_blob_space_amplification),
+        gc_lookup_batch_size(opts.gc_lookup_batch_size),
+        gc_validity_check_mode(opts.gc_validity_check_mode),
+        track_blob_record_deletions(opts.track_blob_record_deletions),
+        punch_hole_min_size(opts.punch_hole_min_size),
+        compaction_hint_discardable_ratio(
+            opts.compaction_hint_discardable_ratio),
+        gc_rewrite_buffer_size(opts.gc_rewrite_buffer_size),
+        gc_rewrite_batch_keys(opts.gc_rewrite_batch_keys),
         level_merge(opts.level_merge),
         skip_value_in_compaction_filter(opts.skip_value_in_compaction_filter) {}
 
-  uint64_t min_blob_size;
+  std::vector<uint64_t> level_min_blob_size;
+
+  bool min_blob_size_auto_tune;
+
+  uint64_t min_blob_size_lower_bound;
+
+  uint64_t min_blob_size_upper_bound;
 
   CompressionType blob_file_compression;
 
+  std::vector<CompressionType> level_blob_file_compression;
+
+  CompressionType gc_blob_file_compression;
+
+  std::vector<int> level_blob_file_compression_level;
+
+  int gc_blob_file_compression_level;
+
+  bool blob_file_shared_compression_dict;
+
+  uint64_t blob_file_block_size;
+
   uint64_t blob_file_target_size;
 
   std::shared_ptr<Cache> blob_cache;
@@ -225,6 +576,26 @@ struct ImmutableTitanCFOptions {
 
   uint64_t merge_small_file_threshold;
 
+  TitanBlobGCPickerType gc_picker;
+
+  bool gc_key_range_clustering;
+
+  double max_blob_space_amplification;
+
+  uint64_t gc_lookup_batch_size;
+
+  TitanGCValidityCheckMode gc_validity_check_mode;
+
+  bool track_blob_record_deletions;
+
+  uint64_t punch_hole_min_size;
+
+  double compaction_hint_discardable_ratio;
+
+  uint64_t gc_rewrite_buffer_size;
+
+  uint64_t gc_rewrite_batch_keys;
+
   bool level_merge;
 
   bool skip_value_in_compaction_filter;
@@ -234,9 +605,11 @@ struct MutableTitanCFOptions {
   MutableTitanCFOptions() : MutableTitanCFOptions(TitanCFOptions()) {}
 
   explicit MutableTitanCFOptions(const TitanCFOptions& opts)
-      : blob_run_mode(opts.blob_run_mode),
+      : min_blob_size(opts.min_blob_size),
+        blob_run_mode(opts.blob_run_mode),
         gc_merge_rewrite(opts.gc_merge_rewrite) {}
 
+  uint64_t min_blob_size;
   TitanBlobRunMode blob_run_mode;
   bool gc_merge_rewrite;
 };
@@ -280,5 +653,30 @@ struct TitanReadOptions : public ReadOptions {
   }
 };
 
+struct CompactBlobFilesOptions {
+  // Only blob files with at least this discardable ratio are GCed. If
+  // negative, `blob_file_discardable_ratio` of the column family is used.
+  //
+  // Default: -1
+  double min_discardable_ratio{-1};
+
+  // Max number of GC jobs run at the same time, by the calling thread and
+  // the GC thread pool, which is shared with background GC and has
+  // `max_background_gc` threads. Jobs all run in the calling thread if
+  // background GC is disabled. Files are split into jobs the same way as
+  // background GC does, by `max_gc_batch_size` and `blob_file_target_size`.
+  //
+  // Default: 1
+  uint32_t max_parallelism{1};
+
+  // If set, it is called after each GC job with the number of blob files
+  // GCed so far and the number of blob files picked. Calls may come from
+  // different threads, but never at the same time.
+  //
+  // Default: nullptr
+  std::function<void(uint64_t /*files_done*/, uint64_t /*files_total*/)>
+      progress_callback;
+};
+
 }  // namespace titandb
 }  // namespace rocksdb
@@ -42,6 +42,15 @@ enum TickerType : uint32_t {
   TITAN_GC_SUCCESS,
   TITAN_GC_TRIGGER_NEXT,
 
+  TITAN_GC_RATE_SLOWDOWN,
+  TITAN_GC_RATE_SPEEDUP,
+  TITAN_GC_RATE_PAUSE,
+
+  TITAN_BLOB_SPACE_WRITE_DELAY_MICROS,
+
+  TITAN_GC_NUM_HOLES_PUNCHED,
+  TITAN_GC_BYTES_PUNCHED,
+
   TITAN_TICKER_ENUM_MAX,
 };
 
@@ -75,6 +84,13 @@ const std::vector<std::pair<TickerType, std::string>> TitanTickersNameMap = {
     {TITAN_GC_FAILURE, "titandb.gc.failure"},
     {TITAN_GC_SUCCESS, "titandb.gc.success"},
     {TITAN_GC_TRIGGER_NEXT, "titandb.gc.trigger.next"},
+    {TITAN_GC_RATE_SLOWDOWN, "titandb.gc.rate.slowdown"},
+    {TITAN_GC_RATE_SPEEDUP, "titandb.gc.rate.speedup"},
+    {TITAN_GC_RATE_PAUSE, "titandb.gc.rate.pause"},
+    {TITAN_BLOB_SPACE_WRITE_DELAY_MICROS,
+     "titandb.blob.space.write.delay.micros"},
+    {TITAN_GC_NUM_HOLES_PUNCHED, "titandb.gc.num.holes.punched"},
+    {TITAN_GC_BYTES_PUNCHED, "titandb.gc.bytes.punched"},
 };
 
 enum HistogramType : uint32_t {
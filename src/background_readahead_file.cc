@@ -0,0 +1,201 @@
+#include "background_readahead_file.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "util/mutexlock.h"
+
+namespace rocksdb {
+namespace titandb {
+
+bool ReadaheadBudget::TryAcquire(uint64_t bytes) {
+  uint64_t used = used_.load(std::memory_order_relaxed);
+  do {
+    if (used + bytes > limit_) {
+      return false;
+    }
+  } while (!used_.compare_exchange_weak(used, used + bytes,
+                                        std::memory_order_relaxed));
+  return true;
+}
+
+void ReadaheadBudget::Release(uint64_t bytes) {
+  uint64_t used = used_.fetch_sub(bytes, std::memory_order_relaxed);
+  assert(used >= bytes);
+  (void)used;
+}
+
+BackgroundReadaheadFile::BackgroundReadaheadFile(
+    std::unique_ptr<RandomAccessFile>&& file, Env* env,
+    std::shared_ptr<ReadaheadBudget> budget)
+    : file_(std::move(file)),
+      env_(env),
+      budget_(std::move(budget)),
+      use_direct_io_(file_->use_direct_io()),
+      alignment_(use_direct_io_
+                     ? std::max<size_t>(file_->GetRequiredBufferAlignment(), 1)
+                     : 1) {}
+
+BackgroundReadaheadFile::~BackgroundReadaheadFile() {
+  for (auto& range : ranges_) {
+    DropRange(range.get());
+  }
+}
+
+Status BackgroundReadaheadFile::Read(uint64_t offset, size_t n, Slice* result,
+                                     char* scratch) const {
+  size_t copied = 0;
+  while (copied < n) {
+    uint64_t pos = offset + copied;
+    PrefetchedRange* range = FindRange(pos);
+    if (range == nullptr) {
+      // Not prefetched, read the rest from the file.
+      std::unique_ptr<char[]> buffer;
+      Slice rest;
+      Status s = ReadToBuffer(pos, n - copied, &buffer, &rest);
+      if (!s.ok()) {
+        return s;
+      }
+      memcpy(scratch + copied, rest.data(), rest.size());
+      copied += rest.size();
+      break;
+    }
+    if (!range->status.ok()) {
+      return range->status;
+    }
+    if (pos >= range->offset + range->data.size()) {
+      // End of the file.
+      break;
+    }
+    uint64_t available = range->offset + range->data.size() - pos;
+    size_t len = static_cast<size_t>(std::min<uint64_t>(n - copied, available));
+    memcpy(scratch + copied, range->data.data() + (pos - range->offset), len);
+    copied += len;
+  }
+  *result = Slice(scratch, copied);
+  return Status::OK();
+}
+
+Status BackgroundReadaheadFile::Prefetch(uint64_t offset, size_t n) {
+  if (n == 0) {
+    return Status::OK();
+  }
+  for (auto& range : ranges_) {
+    if (range->offset <= offset &&
+        offset + n <= range->offset + range->size) {
+      return Status::OK();
+    }
+  }
+  while (ranges_.size() >= kMaxPrefetchedRanges) {
+    DropRange(ranges_.front().get());
+    ranges_.pop_front();
+  }
+  if (budget_ != nullptr && !budget_->TryAcquire(n)) {
+    // Read on demand instead.
+    return Status::OK();
+  }
+  std::shared_ptr<PrefetchedRange> range(new PrefetchedRange(this));
+  range->offset = offset;
+  range->size = n;
+  ranges_.push_back(range);
+  env_->Schedule(&BackgroundReadaheadFile::BGWorkRead,
+                 new std::shared_ptr<PrefetchedRange>(std::move(range)),
+                 Env::Priority::LOW);
+  return Status::OK();
+}
+
+void BackgroundReadaheadFile::BGWorkRead(void* arg) {
+  std::unique_ptr<std::shared_ptr<PrefetchedRange>> range(
+      reinterpret_cast<std::shared_ptr<PrefetchedRange>*>(arg));
+  PrefetchedRange* r = range->get();
+  {
+    MutexLock l(&r->mutex);
+    if (r->state != PrefetchedRange::State::kPending) {
+      // Read in place or dropped already.
+      return;
+    }
+    r->state = PrefetchedRange::State::kReading;
+  }
+  r->file->ReadRange(r);
+}
+
+void BackgroundReadaheadFile::ReadRange(PrefetchedRange* range) const {
+  Status s =
+      ReadToBuffer(range->offset, range->size, &range->buffer, &range->data);
+  MutexLock l(&range->mutex);
+  range->status = s;
+  range->state = PrefetchedRange::State::kDone;
+  range->cv.SignalAll();
+}
+
+void BackgroundReadaheadFile::WaitForRange(PrefetchedRange* range) const {
+  {
+    MutexLock l(&range->mutex);
+    if (range->state != PrefetchedRange::State::kPending) {
+      while (range->state != PrefetchedRange::State::kDone) {
+        range->cv.Wait();
+      }
+      return;
+    }
+    range->state = PrefetchedRange::State::kReading;
+  }
+  ReadRange(range);
+}
+
+void BackgroundReadaheadFile::DropRange(PrefetchedRange* range) const {
+  {
+    MutexLock l(&range->mutex);
+    if (range->state == PrefetchedRange::State::kPending) {
+      range->state = PrefetchedRange::State::kDone;
+    }
+    while (range->state != PrefetchedRange::State::kDone) {
+      range->cv.Wait();
+    }
+  }
+  if (budget_ != nullptr) {
+    budget_->Release(range->size);
+  }
+}
+
+Status BackgroundReadaheadFile::ReadToBuffer(uint64_t offset, size_t n,
+                                             std::unique_ptr<char[]>* buffer,
+                                             Slice* result) const {
+  // Direct I/O requires the offset, size and buffer address to be aligned.
+  uint64_t aligned_offset = offset - offset % alignment_;
+  size_t prefix = static_cast<size_t>(offset - aligned_offset);
+  size_t aligned_size = prefix + n;
+  aligned_size = (aligned_size + alignment_ - 1) / alignment_ * alignment_;
+  buffer->reset(new char[aligned_size + alignment_ - 1]);
+  uintptr_t address = reinterpret_cast<uintptr_t>(buffer->get());
+  char* scratch = buffer->get() + (alignment_ - address % alignment_) %
+                                      alignment_;
+
+  Slice slice;
+  Status s = file_->Read(aligned_offset, aligned_size, &slice, scratch);
+  if (!s.ok()) {
+    *result = Slice();
+    return s;
+  }
+  if (slice.size() <= prefix) {
+    *result = Slice();
+  } else {
+    *result = Slice(slice.data() + prefix, std::min(n, slice.size() - prefix));
+  }
+  return s;
+}
+
+BackgroundReadaheadFile::PrefetchedRange* BackgroundReadaheadFile::FindRange(
+    uint64_t offset) const {
+  // Newer ranges first, in case of overlaps.
+  for (auto it = ranges_.rbegin(); it != ranges_.rend(); it++) {
+    PrefetchedRange* range = it->get();
+    if (range->offset <= offset && offset < range->offset + range->size) {
+      WaitForRange(range);
+      return range;
+    }
+  }
+  return nullptr;
+}
+
+}  // namespace titandb
+}  // namespace rocksdb
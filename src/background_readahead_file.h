@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <memory>
+
+#include "port/port.h"
+#include "rocksdb/env.h"
+
+namespace rocksdb {
+namespace titandb {
+
+// Limits the bytes of prefetched ranges held at the same time by a group of
+// files, e.g. the inputs of a GC job. Thread-safe.
+class ReadaheadBudget {
+ public:
+  explicit ReadaheadBudget(uint64_t limit) : limit_(limit) {}
+
+  // Takes `bytes` from the budget, returns false if it is not enough.
+  bool TryAcquire(uint64_t bytes);
+  void Release(uint64_t bytes);
+
+ private:
+  const uint64_t limit_;
+  std::atomic<uint64_t> used_{0};
+};
+
+// Wraps a blob file read through sequentially, e.g. by GC. Ranges passed to
+// Prefetch() are read into buffers by the low priority thread pool of env,
+// and reads are served from these buffers. A read of a range not picked up
+// by the pool yet reads it in place, so a busy pool only costs the overlap.
+// Reads out of the prefetched ranges go to the file. The file may be opened
+// with direct I/O, reads are aligned here then.
+//
+// Not thread-safe, it is meant to be used by a single iterator.
+class BackgroundReadaheadFile : public RandomAccessFile {
+ public:
+  // Number of prefetched ranges kept, older ones are dropped by new
+  // prefetches. It is enough for the iterator to read a range while the
+  // next one is being prefetched.
+  static const size_t kMaxPrefetchedRanges = 2;
+
+  // Prefetches are skipped if `budget` is given and runs out.
+  BackgroundReadaheadFile(std::unique_ptr<RandomAccessFile>&& file, Env* env,
+                          std::shared_ptr<ReadaheadBudget> budget);
+  ~BackgroundReadaheadFile() override;
+
+  Status Read(uint64_t offset, size_t n, Slice* result,
+              char* scratch) const override;
+
+  // Starts reading [offset, offset + n) in the background, unless it is
+  // prefetched already or the budget runs out.
+  Status Prefetch(uint64_t offset, size_t n) override;
+
+  size_t GetUniqueId(char* id, size_t max_size) const override {
+    return file_->GetUniqueId(id, max_size);
+  }
+
+  Status InvalidateCache(size_t offset, size_t length) override {
+    return file_->InvalidateCache(offset, length);
+  }
+
+ private:
+  // Shared with the read scheduled to the thread pool, which may run after
+  // the range is dropped.
+  struct PrefetchedRange {
+    enum class State { kPending, kReading, kDone };
+
+    explicit PrefetchedRange(const BackgroundReadaheadFile* _file)
+        : file(_file), cv(&mutex) {}
+
+    const BackgroundReadaheadFile* file;
+    uint64_t offset = 0;
+    size_t size = 0;
+    // Bytes read, shorter than `size` at the end of the file. Only valid
+    // once `state` is kDone.
+    Slice data;
+    Status status;
+    std::unique_ptr<char[]> buffer;
+    port::Mutex mutex;
+    port::CondVar cv;
+    // Protected by `mutex`.
+    State state = State::kPending;
+  };
+
+  static void BGWorkRead(void* arg);
+
+  // Reads the range claimed by the caller and wakes up waiters.
+  void ReadRange(PrefetchedRange* range) const;
+
+  // Reads the range in place if it is not picked up by the pool yet, or
+  // waits for it otherwise.
+  void WaitForRange(PrefetchedRange* range) const;
+
+  // Drops the range, waiting for the read in progress, if any, since it
+  // uses the file.
+  void DropRange(PrefetchedRange* range) const;
+
+  // Reads up to `n` bytes at `offset` into a newly allocated `*buffer`,
+  // which `*result` points into.
+  Status ReadToBuffer(uint64_t offset, size_t n,
+                      std::unique_ptr<char[]>* buffer, Slice* result) const;
+
+  // Returns the prefetched range containing `offset`, waiting for it to be
+  // read, or nullptr if there is none.
+  PrefetchedRange* FindRange(uint64_t offset) const;
+
+  std::unique_ptr<RandomAccessFile> file_;
+  Env* env_;
+  std::shared_ptr<ReadaheadBudget> budget_;
+  const bool use_direct_io_;
+  const size_t alignment_;
+  // In the order of being prefetched.
+  mutable std::deque<std::shared_ptr<PrefetchedRange>> ranges_;
+};
+
+}  // namespace titandb
+}  // namespace rocksdb
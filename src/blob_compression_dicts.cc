@@ -0,0 +1,120 @@
+#include "blob_compression_dicts.h"
+
+#include "util/mutexlock.h"
+
+namespace rocksdb {
+namespace titandb {
+
+namespace {
+
+uint64_t MaxSampleBytes(const CompressionOptions& opts) {
+  // Follow the sample size used by rocksdb when it is not specified.
+  return opts.zstd_max_train_bytes > 0 ? opts.zstd_max_train_bytes
+                                       : 100 * uint64_t{opts.max_dict_bytes};
+}
+
+bool IsZSTD(CompressionType type) {
+  return type == kZSTD || type == kZSTDNotFinalCompression;
+}
+
+// Whether blob files of the column family may be compressed with zstd, for
+// which dictionaries are digested to uncompress with. Files written with
+// the per level or GC compression share the dictionaries too.
+bool MayUseZSTD(const TitanCFOptions& cf_options) {
+  if (IsZSTD(cf_options.blob_file_compression) ||
+      IsZSTD(cf_options.GCBlobFileCompression())) {
+    return true;
+  }
+  for (CompressionType type : cf_options.level_blob_file_compression) {
+    if (IsZSTD(type)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+BlobCompressionDicts::BlobCompressionDicts(const TitanCFOptions& cf_options)
+    : enabled_(cf_options.blob_file_shared_compression_dict &&
+               cf_options.blob_file_compression_options.max_dict_bytes > 0),
+      compression_(cf_options.blob_file_compression),
+      using_zstd_(MayUseZSTD(cf_options)),
+      compression_opts_(cf_options.blob_file_compression_options),
+      max_sample_bytes_(MaxSampleBytes(compression_opts_)) {
+  need_samples_.store(enabled_);
+}
+
+void BlobCompressionDicts::Add(uint64_t id, const Slice& raw_dict) {
+  Dict dict;
+  dict.raw = raw_dict.ToString();
+  dict.compression = std::make_shared<CompressionDict>(
+      dict.raw, compression_, compression_opts_.level);
+  dict.uncompression =
+      std::make_shared<UncompressionDict>(dict.raw, using_zstd_);
+  MutexLock l(&mutex_);
+  dicts_[id] = std::move(dict);
+  need_samples_.store(false);
+  samples_.clear();
+  sample_lens_.clear();
+}
+
+std::shared_ptr<const CompressionDict> BlobCompressionDicts::GetLatest(
+    uint64_t* id) const {
+  MutexLock l(&mutex_);
+  if (dicts_.empty()) {
+    return nullptr;
+  }
+  auto it = dicts_.rbegin();
+  *id = it->first;
+  return it->second.compression;
+}
+
+std::shared_ptr<const UncompressionDict>
+BlobCompressionDicts::GetUncompressionDict(uint64_t id) const {
+  MutexLock l(&mutex_);
+  auto it = dicts_.find(id);
+  if (it == dicts_.end()) {
+    return nullptr;
+  }
+  return it->second.uncompression;
+}
+
+void BlobCompressionDicts::GetAll(
+    std::map<uint64_t, std::string>* dicts) const {
+  MutexLock l(&mutex_);
+  for (auto& dict : dicts_) {
+    dicts->emplace(dict.first, dict.second.raw);
+  }
+}
+
+void BlobCompressionDicts::AddSamples(const std::string& samples,
+                                      const std::vector<size_t>& sample_lens) {
+  MutexLock l(&mutex_);
+  if (!need_samples_.load() || samples_.size() >= max_sample_bytes_) {
+    return;
+  }
+  samples_.append(samples);
+  sample_lens_.insert(sample_lens_.end(), sample_lens.begin(),
+                      sample_lens.end());
+}
+
+bool BlobCompressionDicts::MaybeTrain(std::string* raw_dict) {
+  std::string samples;
+  std::vector<size_t> sample_lens;
+  {
+    MutexLock l(&mutex_);
+    if (!need_samples_.load() || samples_.size() < max_sample_bytes_) {
+      return false;
+    }
+    // Take the samples so that concurrent callers don't train again.
+    samples.swap(samples_);
+    sample_lens.swap(sample_lens_);
+  }
+  *raw_dict = ZSTD_TrainDictionary(samples, sample_lens,
+                                   compression_opts_.max_dict_bytes);
+  return !raw_dict->empty();
+}
+
+}  // namespace titandb
+}  // namespace rocksdb
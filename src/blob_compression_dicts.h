@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "port/port.h"
+#include "rocksdb/slice.h"
+#include "titan/options.h"
+#include "util/compression.h"
+
+namespace rocksdb {
+namespace titandb {
+
+// Compression dictionaries shared by blob files of a column family, when
+// blob_file_shared_compression_dict is enabled.
+//
+// A dictionary is trained in background from values sampled by flush and
+// compaction, persisted in the manifest with an id, and referenced by the id
+// from the header of blob files compressed with it. So blob file builders
+// compress with the latest dictionary from the first record instead of
+// buffering records to train one per file, and readers of all the files
+// share one digested dictionary.
+class BlobCompressionDicts {
+ public:
+  explicit BlobCompressionDicts(const TitanCFOptions& cf_options);
+
+  bool enabled() const { return enabled_; }
+
+  // Returns the CF-wide compression options dictionaries are digested with,
+  // regardless of the per-level or GC compression level of blob files.
+  const CompressionOptions& compression_opts() const {
+    return compression_opts_;
+  }
+
+  // Adds a dictionary logged in manifest.
+  void Add(uint64_t id, const Slice& raw_dict);
+
+  // Returns the latest dictionary to compress new blob files with, and sets
+  // "*id" to its id. Returns nullptr if there is none yet.
+  std::shared_ptr<const CompressionDict> GetLatest(uint64_t* id) const;
+
+  // Returns the dictionary to uncompress blob files referencing the id, or
+  // nullptr if not found.
+  std::shared_ptr<const UncompressionDict> GetUncompressionDict(
+      uint64_t id) const;
+
+  // Gets raw contents of all the dictionaries to write manifest snapshot.
+  void GetAll(std::map<uint64_t, std::string>* dicts) const;
+
+  // Returns the number of sample bytes wanted to train a dictionary, 0 if
+  // not needed.
+  uint64_t SampleBytesWanted() const {
+    return need_samples_.load(std::memory_order_relaxed) ? max_sample_bytes_
+                                                          : 0;
+  }
+
+  // Adds values sampled by a table builder.
+  void AddSamples(const std::string& samples,
+                  const std::vector<size_t>& sample_lens);
+
+  // Trains a dictionary if enough samples are collected, and sets
+  // "*raw_dict" to it. The dictionary takes effect after it is logged and
+  // added back with `Add()`.
+  bool MaybeTrain(std::string* raw_dict);
+
+ private:
+  struct Dict {
+    std::string raw;
+    std::shared_ptr<CompressionDict> compression;
+    std::shared_ptr<UncompressionDict> uncompression;
+  };
+
+  const bool enabled_;
+  const CompressionType compression_;
+  // Whether to digest dictionaries for zstd to uncompress with.
+  const bool using_zstd_;
+  const CompressionOptions compression_opts_;
+  const uint64_t max_sample_bytes_;
+
+  mutable port::Mutex mutex_;
+  std::map<uint64_t, Dict> dicts_;
+  std::string samples_;
+  std::vector<size_t> sample_lens_;
+  std::atomic<bool> need_samples_{false};
+};
+
+}  // namespace titandb
+}  // namespace rocksdb
@@ -1,31 +1,49 @@
 #include "blob_file_builder.h"
 
+#include "test_util/sync_point.h"
+
 namespace rocksdb {
 namespace titandb {
 
 BlobFileBuilder::BlobFileBuilder(const TitanDBOptions& db_options,
                                  const TitanCFOptions& cf_options,
-                                 WritableFileWriter* file)
-    : builder_state_(cf_options.blob_file_compression_options.max_dict_bytes > 0
-                         ? BuilderState::kBuffered
-                         : BuilderState::kUnbuffered),
+                                 WritableFileWriter* file,
+                                 const BlobCompressionDicts* compression_dicts)
+    : builder_state_(BuilderState::kUnbuffered),
       cf_options_(cf_options),
       file_(file),
       encoder_(cf_options.blob_file_compression,
-               cf_options.blob_file_compression_options) {
+               cf_options.blob_file_compression_options),
+      use_shared_dict_(compression_dicts != nullptr &&
+                       compression_dicts->enabled()) {
 #if ZSTD_VERSION_NUMBER < 10103
   if (cf_options_.blob_file_compression_options.max_dict_bytes > 0) {
     status_ = Status::NotSupported("ZSTD version too old.");
     return;
   }
 #endif
+  if (train_dict()) {
+    builder_state_ = BuilderState::kBuffered;
+  } else if (use_shared_dict_) {
+    shared_dict_ = compression_dicts->GetLatest(&shared_dict_id_);
+    if (shared_dict_ != nullptr) {
+      encoder_.SetCompressionDict(shared_dict_.get());
+    }
+  }
+  TEST_SYNC_POINT_CALLBACK("BlobFileBuilder::BlobFileBuilder", &cf_options_);
   WriteHeader();
 }
 
 void BlobFileBuilder::WriteHeader() {
   BlobFileHeader header;
-  if (cf_options_.blob_file_compression_options.max_dict_bytes > 0) {
+  if (packed()) {
+    header.version = BlobFileHeader::kVersion3;
+  }
+  if (train_dict()) {
     header.flags |= BlobFileHeader::kHasUncompressionDictionary;
+  } else if (shared_dict_ != nullptr) {
+    header.flags |= BlobFileHeader::kHasSharedDictionary;
+    header.dict_id = shared_dict_id_;
   }
   std::string buffer;
   header.EncodeTo(&buffer);
@@ -49,9 +67,16 @@ void BlobFileBuilder::Add(const BlobRecord& record,
             cf_options_.blob_file_compression_options.zstd_max_train_bytes) {
       EnterUnbuffered(out_ctx);
     }
+  } else if (packed()) {
+    std::string record_str;
+    record.EncodeTo(&record_str);
+    AddToBlock(record_str, std::move(ctx), out_ctx);
   } else {
     encoder_.EncodeRecord(record);
     WriteEncoderData(&ctx->new_blob_index.blob_handle);
+    if (ok()) {
+      num_entries_++;
+    }
     out_ctx->emplace_back(std::move(ctx));
   }
 
@@ -99,6 +124,28 @@ void BlobFileBuilder::EnterUnbuffered(OutContexts* out_ctx) {
 
 void BlobFileBuilder::FlushSampleRecords(OutContexts* out_ctx) {
   assert(cached_contexts_.size() >= sample_records_.size());
+  if (packed()) {
+    OutContexts contexts;
+    for (auto& ctx : cached_contexts_) {
+      contexts.emplace_back(std::move(ctx));
+    }
+    cached_contexts_.clear();
+    size_t sample_idx = 0;
+    for (auto& ctx : contexts) {
+      if (!ctx->has_value) {
+        assert(sample_idx < sample_records_.size());
+        AddToBlock(sample_records_[sample_idx++], std::move(ctx), out_ctx);
+      } else if (cached_contexts_.empty()) {
+        out_ctx->emplace_back(std::move(ctx));
+      } else {
+        cached_contexts_.emplace_back(std::move(ctx));
+      }
+    }
+    assert(sample_idx == sample_records_.size());
+    sample_records_.clear();
+    sample_str_len_ = 0;
+    return;
+  }
   size_t sample_idx = 0, ctx_idx = 0;
   for (; sample_idx < sample_records_.size(); sample_idx++, ctx_idx++) {
     const std::string& record_str = sample_records_[sample_idx];
@@ -110,6 +157,9 @@ void BlobFileBuilder::FlushSampleRecords(OutContexts* out_ctx) {
     const std::unique_ptr<BlobRecordContext>& ctx = cached_contexts_[ctx_idx];
     encoder_.EncodeSlice(record_str);
     WriteEncoderData(&ctx->new_blob_index.blob_handle);
+    if (ok()) {
+      num_entries_++;
+    }
     out_ctx->emplace_back(std::move(cached_contexts_[ctx_idx]));
   }
   for (; ctx_idx < cached_contexts_.size(); ctx_idx++) {
@@ -131,10 +181,52 @@ void BlobFileBuilder::WriteEncoderData(BlobHandle* handle) {
   status_ = file_->Append(encoder_.GetHeader());
   if (ok()) {
     status_ = file_->Append(encoder_.GetRecord());
-    num_entries_++;
   }
 }
 
+void BlobFileBuilder::AddToBlock(const Slice& record,
+                                 std::unique_ptr<BlobRecordContext> ctx,
+                                 OutContexts* out_ctx) {
+  block_builder_.Add(record);
+  cached_contexts_.emplace_back(std::move(ctx));
+  if (block_builder_.RawSize() >= cf_options_.blob_file_block_size) {
+    FlushBlock(out_ctx);
+  }
+}
+
+void BlobFileBuilder::FlushBlock(OutContexts* out_ctx) {
+  if (!block_builder_.empty()) {
+    std::vector<uint64_t> sizes;
+    BlobHandle block_handle;
+    uint32_t num_records = block_builder_.NumRecords();
+    encoder_.EncodeSlice(block_builder_.Finish());
+    // Account the whole block to live data size here, and split it to the
+    // records by their raw sizes.
+    WriteEncoderData(&block_handle);
+    BlobBlock::SplitBlockSize(block_builder_, block_handle.size, &sizes);
+    uint32_t slot = 0;
+    for (auto& ctx : cached_contexts_) {
+      if (ctx->has_value) {
+        continue;
+      }
+      BlobHandle& handle = ctx->new_blob_index.blob_handle;
+      handle.offset = block_handle.offset;
+      handle.size = sizes[slot];
+      handle.block_size = block_handle.size;
+      handle.slot = slot++;
+    }
+    assert(slot == num_records);
+    if (ok()) {
+      num_entries_ += num_records;
+    }
+    block_builder_.Reset();
+  }
+  for (auto& ctx : cached_contexts_) {
+    out_ctx->emplace_back(std::move(ctx));
+  }
+  cached_contexts_.clear();
+}
+
 void BlobFileBuilder::WriteRawBlock(const Slice& block, BlockHandle* handle) {
   handle->set_offset(file_->GetFileSize());
   handle->set_size(block.size());
@@ -170,10 +262,13 @@ Status BlobFileBuilder::Finish(OutContexts* out_ctx) {
   if (builder_state_ == BuilderState::kBuffered) {
     EnterUnbuffered(out_ctx);
   }
+  if (packed()) {
+    FlushBlock(out_ctx);
+  }
 
   BlobFileFooter footer;
   // if has compression dictionary, encode it into meta blocks
-  if (cf_options_.blob_file_compression_options.max_dict_bytes > 0) {
+  if (train_dict()) {
     BlockHandle meta_index_handle;
     MetaIndexBuilder meta_index_builder;
     WriteCompressionDictBlock(&meta_index_builder);
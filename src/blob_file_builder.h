@@ -1,5 +1,6 @@
 #pragma once
 
+#include "blob_compression_dicts.h"
 #include "blob_format.h"
 #include "table/meta_blocks.h"
 #include "titan/options.h"
@@ -33,6 +34,10 @@ namespace titandb {
 // meta index block with block handles pointed to the meta blocks. The
 // meta block and the meta index block are formatted the same as the
 // BlockBasedTable.
+//
+// 3. If `blob_file_block_size` is set, consecutive blob records are packed
+// into blocks, which take the place of records in the file. Output contexts
+// of the records in a block are held until the block is written.
 class BlobFileBuilder {
  public:
   // States of the builder.
@@ -66,8 +71,12 @@ class BlobFileBuilder {
   // Constructs a builder that will store the contents of the file it
   // is building in "*file". Does not close the file. It is up to the
   // caller to sync and close the file after calling Finish().
+  // If shared compression dictionary is enabled in "compression_dicts", the
+  // builder compresses with the latest shared dictionary instead of training
+  // one, and starts in `kUnbuffered` state.
   BlobFileBuilder(const TitanDBOptions& db_options,
-                  const TitanCFOptions& cf_options, WritableFileWriter* file);
+                  const TitanCFOptions& cf_options, WritableFileWriter* file,
+                  const BlobCompressionDicts* compression_dicts = nullptr);
 
   // Tries to add the record to the file
   // Notice:
@@ -84,6 +93,17 @@ class BlobFileBuilder {
   // Returns builder state
   BuilderState GetBuilderState() { return builder_state_; }
 
+  // Returns true if the builder holds contexts to be output later, in which
+  // case small KV pairs have to be passed in through `AddSmall()` to keep
+  // them in order.
+  bool HasPendingContexts() const {
+    return builder_state_ == BuilderState::kBuffered ||
+           !cached_contexts_.empty();
+  }
+
+  // Number of contexts held by the builder.
+  uint64_t NumPendingContexts() const { return cached_contexts_.size(); }
+
   // Returns non-ok iff some error has been detected.
   Status status() const { return status_; }
 
@@ -121,6 +141,18 @@ class BlobFileBuilder {
   void WriteCompressionDictBlock(MetaIndexBuilder* meta_index_builder);
   void FlushSampleRecords(OutContexts* out_ctx);
   void WriteEncoderData(BlobHandle* handle);
+  bool packed() const { return cf_options_.blob_file_block_size > 0; }
+  // Whether to train a compression dictionary for this file.
+  bool train_dict() const {
+    return !use_shared_dict_ &&
+           cf_options_.blob_file_compression_options.max_dict_bytes > 0;
+  }
+  // Packs the encoded record into current block, and writes out the block if
+  // it is full.
+  void AddToBlock(const Slice& record, std::unique_ptr<BlobRecordContext> ctx,
+                  OutContexts* out_ctx);
+  // Writes out current block and outputs contexts held.
+  void FlushBlock(OutContexts* out_ctx);
 
   TitanCFOptions cf_options_;
   WritableFileWriter* file_;
@@ -133,8 +165,15 @@ class BlobFileBuilder {
   uint64_t sample_str_len_ = 0;
   std::unique_ptr<CompressionDict> compression_dict_;
 
+  const bool use_shared_dict_;
+  // The shared dictionary compressed with, if any.
+  std::shared_ptr<const CompressionDict> shared_dict_;
+  uint64_t shared_dict_id_ = 0;
+
   OutContexts cached_contexts_;
 
+  BlobBlockBuilder block_builder_;
+
   uint64_t num_entries_ = 0;
   std::string smallest_key_;
   std::string largest_key_;
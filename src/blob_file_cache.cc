@@ -22,7 +22,8 @@ BlobFileCache::BlobFileCache(const TitanDBOptions& db_options,
       db_options_(db_options),
       cf_options_(cf_options),
       cache_(cache),
-      stats_(stats) {}
+      stats_(stats),
+      compression_dicts_(std::make_shared<BlobCompressionDicts>(cf_options)) {}
 
 Status BlobFileCache::Get(const ReadOptions& options, uint64_t file_number,
                           uint64_t file_size, const BlobHandle& handle,
@@ -78,7 +79,7 @@ Status BlobFileCache::FindFile(uint64_t file_number, uint64_t file_size,
 
   std::unique_ptr<BlobFileReader> reader;
   s = BlobFileReader::Open(cf_options_, std::move(file), file_size, &reader,
-                           stats_);
+                           stats_, compression_dicts_.get());
   if (!s.ok()) return s;
 
   cache_->Insert(cache_key, reader.release(), 1,
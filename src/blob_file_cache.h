@@ -1,5 +1,6 @@
 #pragma once
 
+#include "blob_compression_dicts.h"
 #include "blob_file_reader.h"
 #include "blob_format.h"
 #include "rocksdb/options.h"
@@ -31,6 +32,11 @@ class BlobFileCache {
   // Evicts the file cache for the specified file number.
   void Evict(uint64_t file_number);
 
+  // Shared compression dictionaries of the column family.
+  const std::shared_ptr<BlobCompressionDicts>& compression_dicts() const {
+    return compression_dicts_;
+  }
+
  private:
   // Finds the file for the specified file number. Opens the file if
   // the file is not found in the cache and caches it.
@@ -44,6 +50,7 @@ class BlobFileCache {
   TitanCFOptions cf_options_;
   std::shared_ptr<Cache> cache_;
   TitanStats* stats_;
+  std::shared_ptr<BlobCompressionDicts> compression_dicts_;
 };
 
 }  // namespace titandb
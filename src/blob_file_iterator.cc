@@ -1,5 +1,9 @@
 #include "blob_file_iterator.h"
 
+#include <algorithm>
+
+#include "rocksdb/comparator.h"
+
 #include "blob_file_reader.h"
 #include "util.h"
 #include "util/crc32c.h"
@@ -9,11 +13,13 @@ namespace titandb {
 
 BlobFileIterator::BlobFileIterator(
     std::unique_ptr<RandomAccessFileReader>&& file, uint64_t file_name,
-    uint64_t file_size, const TitanCFOptions& titan_cf_options)
+    uint64_t file_size, const TitanCFOptions& titan_cf_options,
+    const BlobCompressionDicts* compression_dicts)
     : file_(std::move(file)),
       file_number_(file_name),
       file_size_(file_size),
-      titan_cf_options_(titan_cf_options) {}
+      titan_cf_options_(titan_cf_options),
+      compression_dicts_(compression_dicts) {}
 
 BlobFileIterator::~BlobFileIterator() {}
 
@@ -34,6 +40,7 @@ bool BlobFileIterator::Init() {
   }
 
   header_size_ = blob_file_header.size();
+  packed_ = blob_file_header.version == BlobFileHeader::kVersion3;
 
   char footer_buf[BlobFileFooter::kEncodedLength];
   // With for_compaction=true, rate_limiter is enabled. Since BlobFileIterator
@@ -65,6 +72,13 @@ bool BlobFileIterator::Init() {
     // | footer(kEncodedLength: 32) |
     end_of_blob_record_ -=
         (uncompression_dict_->GetRawDict().size() + kBlockTrailerSize);
+  } else if (blob_file_header.flags & BlobFileHeader::kHasSharedDictionary) {
+    status_ = GetSharedUncompressionDict(blob_file_header, compression_dicts_,
+                                         &shared_uncompression_dict_);
+    if (!status_.ok()) {
+      return false;
+    }
+    decoder_.SetUncompressionDict(shared_uncompression_dict_.get());
   }
 
   assert(end_of_blob_record_ > BlobFileHeader::kMinEncodedLength);
@@ -75,14 +89,25 @@ bool BlobFileIterator::Init() {
 void BlobFileIterator::SeekToFirst() {
   if (!init_ && !Init()) return;
   status_ = Status::OK();
-  iterate_offset_ = header_size_;
+  iterate_offset_ = std::max(header_size_, start_offset_);
+  next_hole_ = 0;
+  block_ = BlobBlock();
+  block_slot_ = 0;
   PrefetchAndGet();
+  while (Valid() && packed_ && cur_record_offset_ == start_offset_ &&
+         cur_slot_ < start_slot_) {
+    Next();
+  }
 }
 
 bool BlobFileIterator::Valid() const { return valid_ && status().ok(); }
 
 void BlobFileIterator::Next() {
   assert(init_);
+  if (packed_ && block_slot_ < block_.NumRecords()) {
+    GetBlockRecord();
+    return;
+  }
   PrefetchAndGet();
 }
 
@@ -104,7 +129,16 @@ void BlobFileIterator::IterateForPrev(uint64_t offset) {
   uint64_t total_length = 0;
   FixedSlice<kRecordHeaderSize> header_buffer;
   iterate_offset_ = header_size_;
+  next_hole_ = 0;
   for (; iterate_offset_ < offset; iterate_offset_ += total_length) {
+    uint64_t hole_begin = iterate_offset_;
+    SkipHoles();
+    if (iterate_offset_ != hole_begin) {
+      // Step over the hole as if it were a record.
+      total_length = iterate_offset_ - hole_begin;
+      iterate_offset_ = hole_begin;
+      continue;
+    }
     // With for_compaction=true, rate_limiter is enabled. Since
     // BlobFileIterator is only used for GC, we always set for_compaction to
     // true.
@@ -117,6 +151,9 @@ void BlobFileIterator::IterateForPrev(uint64_t offset) {
   }
 
   if (iterate_offset_ > offset) iterate_offset_ -= total_length;
+  next_hole_ = 0;
+  block_ = BlobBlock();
+  block_slot_ = 0;
   valid_ = false;
 }
 
@@ -138,18 +175,53 @@ void BlobFileIterator::GetBlobRecord() {
   status_ = file_->Read(iterate_offset_ + kRecordHeaderSize, record_size,
                         &record_slice, buffer_.data(), true /*for_compaction*/);
   if (status_.ok()) {
-    status_ =
-        decoder_.DecodeRecord(&record_slice, &cur_blob_record_, &uncompressed_);
+    if (packed_) {
+      Slice contents;
+      status_ = decoder_.DecodeSlice(&record_slice, &contents, &uncompressed_);
+      if (status_.ok()) {
+        status_ = block_.DecodeFrom(contents);
+      }
+    } else {
+      status_ = decoder_.DecodeRecord(&record_slice, &cur_blob_record_,
+                                      &uncompressed_);
+    }
   }
   if (!status_.ok()) return;
 
   cur_record_offset_ = iterate_offset_;
   cur_record_size_ = kRecordHeaderSize + record_size;
   iterate_offset_ += cur_record_size_;
+  if (packed_) {
+    BlobBlock::SplitBlockSize(block_, cur_record_size_, &block_record_sizes_);
+    block_slot_ = 0;
+    GetBlockRecord();
+    return;
+  }
   valid_ = true;
 }
 
+void BlobFileIterator::GetBlockRecord() {
+  assert(block_slot_ < block_.NumRecords());
+  cur_slot_ = block_slot_++;
+  status_ = block_.GetRecord(cur_slot_, &cur_blob_record_);
+  valid_ = status_.ok();
+}
+
+void BlobFileIterator::SkipHoles() {
+  while (next_hole_ < holes_.size()) {
+    const auto& hole = holes_[next_hole_];
+    if (hole.first > iterate_offset_) {
+      break;
+    }
+    if (hole.first + hole.second > iterate_offset_) {
+      iterate_offset_ = hole.first + hole.second;
+    }
+    next_hole_++;
+  }
+}
+
 void BlobFileIterator::PrefetchAndGet() {
+  SkipHoles();
   if (iterate_offset_ >= end_of_blob_record_) {
     valid_ = false;
     return;
@@ -163,15 +235,27 @@ void BlobFileIterator::PrefetchAndGet() {
     readahead_end_offset_ = readahead_begin_offset_;
     readahead_size_ = kMinReadaheadSize;
   }
-  auto min_blob_size =
-      iterate_offset_ + kRecordHeaderSize + titan_cf_options_.min_blob_size;
-  if (readahead_end_offset_ <= min_blob_size) {
-    while (readahead_end_offset_ + readahead_size_ <= min_blob_size &&
-           readahead_size_ < kMaxReadaheadSize)
-      readahead_size_ <<= 1;
-    file_->Prefetch(readahead_end_offset_, readahead_size_);
-    readahead_end_offset_ += readahead_size_;
-    readahead_size_ = std::min(kMaxReadaheadSize, readahead_size_ << 1);
+  if (sequential_readahead_size_ > 0) {
+    // Keep the chunk after the one being read prefetched.
+    while (readahead_end_offset_ < end_of_blob_record_ &&
+           readahead_end_offset_ <
+               iterate_offset_ + sequential_readahead_size_) {
+      uint64_t size = std::min(sequential_readahead_size_,
+                               end_of_blob_record_ - readahead_end_offset_);
+      file_->Prefetch(readahead_end_offset_, size);
+      readahead_end_offset_ += size;
+    }
+  } else {
+    auto min_blob_size =
+        iterate_offset_ + kRecordHeaderSize + titan_cf_options_.min_blob_size;
+    if (readahead_end_offset_ <= min_blob_size) {
+      while (readahead_end_offset_ + readahead_size_ <= min_blob_size &&
+             readahead_size_ < kMaxReadaheadSize)
+        readahead_size_ <<= 1;
+      file_->Prefetch(readahead_end_offset_, readahead_size_);
+      readahead_end_offset_ += readahead_size_;
+      readahead_size_ = std::min(kMaxReadaheadSize, readahead_size_ << 1);
+    }
   }
 
   GetBlobRecord();
@@ -181,11 +265,30 @@ void BlobFileIterator::PrefetchAndGet() {
   }
 }
 
+namespace {
+
+uint64_t KeyPrefix(const Slice& key) {
+  uint64_t prefix = 0;
+  for (size_t i = 0; i < sizeof(prefix); i++) {
+    prefix <<= 8;
+    if (i < key.size()) {
+      prefix |= static_cast<unsigned char>(key[i]);
+    }
+  }
+  return prefix;
+}
+
+}  // namespace
+
 BlobFileMergeIterator::BlobFileMergeIterator(
     std::vector<std::unique_ptr<BlobFileIterator>>&& blob_file_iterators,
     const Comparator* comparator)
-    : blob_file_iterators_(std::move(blob_file_iterators)),
-      min_heap_(BlobFileIterComparator(comparator)) {}
+    : comparator_(comparator),
+      bytewise_(comparator == BytewiseComparator()),
+      blob_file_iterators_(std::move(blob_file_iterators)),
+      losers_(std::max<size_t>(blob_file_iterators_.size(), 1), 0),
+      exhausted_(blob_file_iterators_.size(), true),
+      key_prefixes_(bytewise_ ? blob_file_iterators_.size() : 0, 0) {}
 
 bool BlobFileMergeIterator::Valid() const {
   if (current_ == nullptr) return false;
@@ -194,28 +297,76 @@ bool BlobFileMergeIterator::Valid() const {
 }
 
 void BlobFileMergeIterator::SeekToFirst() {
-  for (auto& iter : blob_file_iterators_) {
-    iter->SeekToFirst();
-    if (iter->status().ok() && iter->Valid()) min_heap_.push(iter.get());
+  const size_t n = blob_file_iterators_.size();
+  for (size_t i = 0; i < n; i++) {
+    blob_file_iterators_[i]->SeekToFirst();
+    UpdateLeaf(i);
   }
-  if (!min_heap_.empty()) {
-    current_ = min_heap_.top();
-    min_heap_.pop();
-  } else {
+  if (!status_.ok() || n == 0) {
+    current_ = nullptr;
+    if (status_.ok()) {
+      status_ = Status::Aborted("No iterator is valid");
+    }
+    return;
+  }
+
+  // Play the whole tournament bottom up, with winners of nodes kept aside.
+  std::vector<size_t> winners(2 * n);
+  for (size_t i = 0; i < n; i++) {
+    winners[n + i] = i;
+  }
+  for (size_t j = n - 1; j >= 1; j--) {
+    size_t left = winners[2 * j];
+    size_t right = winners[2 * j + 1];
+    bool left_wins = Before(left, right);
+    winners[j] = left_wins ? left : right;
+    losers_[j] = left_wins ? right : left;
+  }
+  losers_[0] = n == 1 ? 0 : winners[1];
+  if (exhausted_[losers_[0]]) {
+    current_ = nullptr;
     status_ = Status::Aborted("No iterator is valid");
+  } else {
+    current_ = blob_file_iterators_[losers_[0]].get();
   }
 }
 
 void BlobFileMergeIterator::Next() {
   assert(Valid());
+  size_t i = losers_[0];
   current_->Next();
-  if (current_->status().ok() && current_->Valid()) min_heap_.push(current_);
-  if (!min_heap_.empty()) {
-    current_ = min_heap_.top();
-    min_heap_.pop();
-  } else {
+  UpdateLeaf(i);
+  if (!status_.ok()) {
     current_ = nullptr;
+    return;
+  }
+  Replay(i);
+  size_t winner = losers_[0];
+  current_ =
+      exhausted_[winner] ? nullptr : blob_file_iterators_[winner].get();
+}
+
+void BlobFileMergeIterator::UpdateLeaf(size_t i) {
+  BlobFileIterator* iter = blob_file_iterators_[i].get();
+  if (!iter->status().ok()) {
+    // Records of the file can't be skipped silently.
+    status_ = iter->status();
+  }
+  exhausted_[i] = !iter->Valid();
+  if (bytewise_ && !exhausted_[i]) {
+    key_prefixes_[i] = KeyPrefix(iter->key());
+  }
+}
+
+void BlobFileMergeIterator::Replay(size_t i) {
+  const size_t n = blob_file_iterators_.size();
+  size_t winner = i;
+  for (size_t j = (n + i) / 2; j >= 1; j /= 2) {
+    if (Before(losers_[j], winner)) {
+      std::swap(losers_[j], winner);
+    }
   }
+  losers_[0] = winner;
 }
 
 Slice BlobFileMergeIterator::key() const {
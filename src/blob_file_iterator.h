@@ -1,8 +1,9 @@
 #pragma once
 
 #include <cstdint>
-#include <queue>
+#include <vector>
 
+#include "blob_compression_dicts.h"
 #include "blob_format.h"
 #include "rocksdb/slice.h"
 #include "rocksdb/status.h"
@@ -20,9 +21,12 @@ class BlobFileIterator {
   const uint64_t kMinReadaheadSize = 4 << 10;
   const uint64_t kMaxReadaheadSize = 256 << 10;
 
+  // "compression_dicts" is required to iterate blob files compressed with a
+  // shared dictionary.
   BlobFileIterator(std::unique_ptr<RandomAccessFileReader>&& file,
                    uint64_t file_name, uint64_t file_size,
-                   const TitanCFOptions& titan_cf_options);
+                   const TitanCFOptions& titan_cf_options,
+                   const BlobCompressionDicts* compression_dicts = nullptr);
   ~BlobFileIterator();
 
   bool Init();
@@ -34,13 +38,38 @@ class BlobFileIterator {
   Status status() const { return status_; }
   uint64_t header_size() const { return header_size_; }
 
+  // Sets the ranges punched out of the file, sorted by offset, which are
+  // skipped by the iterator.
+  void SetPunchedHoles(const BlobFileRanges& holes) { holes_ = holes; }
+
+  // Makes SeekToFirst() start from the record at `offset`, or the record at
+  // `slot` of the block at `offset`, instead of the first record.
+  void SetStartPosition(uint64_t offset, uint32_t slot) {
+    start_offset_ = offset;
+    start_slot_ = slot;
+  }
+
+  // Makes the iterator prefetch the file in chunks of `size`, always a chunk
+  // ahead of the record being read, instead of reading ahead on demand. Meant
+  // for files opened by NewGCBlobFileReader(), which read prefetched chunks
+  // in the background.
+  void SetSequentialReadahead(uint64_t size) {
+    sequential_readahead_size_ = size;
+  }
+
   void IterateForPrev(uint64_t);
 
   BlobIndex GetBlobIndex() {
     BlobIndex blob_index;
     blob_index.file_number = file_number_;
     blob_index.blob_handle.offset = cur_record_offset_;
-    blob_index.blob_handle.size = cur_record_size_;
+    if (packed_) {
+      blob_index.blob_handle.size = block_record_sizes_[cur_slot_];
+      blob_index.blob_handle.block_size = cur_record_size_;
+      blob_index.blob_handle.slot = cur_slot_;
+    } else {
+      blob_index.blob_handle.size = cur_record_size_;
+    }
     return blob_index;
   }
 
@@ -50,15 +79,22 @@ class BlobFileIterator {
   const uint64_t file_number_;
   const uint64_t file_size_;
   TitanCFOptions titan_cf_options_;
+  const BlobCompressionDicts* compression_dicts_;
 
   bool init_{false};
   uint64_t end_of_blob_record_{0};
 
+  BlobFileRanges holes_;
+  size_t next_hole_{0};
+  uint64_t start_offset_{0};
+  uint32_t start_slot_{0};
+
   // Iterator status
   Status status_;
   bool valid_{false};
 
   std::unique_ptr<UncompressionDict> uncompression_dict_;
+  std::shared_ptr<const UncompressionDict> shared_uncompression_dict_;
   BlobDecoder decoder_;
 
   uint64_t iterate_offset_{0};
@@ -69,14 +105,31 @@ class BlobFileIterator {
   uint64_t cur_record_size_;
   uint64_t header_size_;
 
+  // For blob files with records packed into blocks, current record and offset
+  // are of the block, and records are iterated by slots in the block.
+  bool packed_{false};
+  BlobBlock block_;
+  std::vector<uint64_t> block_record_sizes_;
+  uint32_t block_slot_{0};
+  uint32_t cur_slot_{0};
+
   uint64_t readahead_begin_offset_{0};
   uint64_t readahead_end_offset_{0};
   uint64_t readahead_size_{kMinReadaheadSize};
+  uint64_t sequential_readahead_size_{0};
 
+  void SkipHoles();
   void PrefetchAndGet();
   void GetBlobRecord();
+  void GetBlockRecord();
 };
 
+// Merges blob file iterators by key with a loser tree, i.e. a tournament tree
+// whose internal nodes keep the loser of the match played there, while the
+// winner goes up. When the winner moves on, only the matches on its path to
+// the root are replayed, one comparison per level, where a binary heap takes
+// about two. With the bytewise comparator, matches are mostly decided by the
+// first 8 bytes of keys, cached as integers.
 class BlobFileMergeIterator {
  public:
   explicit BlobFileMergeIterator(
@@ -98,29 +151,44 @@ class BlobFileMergeIterator {
   BlobIndex GetBlobIndex() { return current_->GetBlobIndex(); }
 
  private:
-  class BlobFileIterComparator {
-   public:
-    // The default constructor is not supposed to be used.
-    // It is only to make std::priority_queue can compile.
-    BlobFileIterComparator() : comparator_(nullptr){};
-    explicit BlobFileIterComparator(const Comparator* comparator)
-        : comparator_(comparator){};
-    // Smaller value get Higher priority
-    bool operator()(const BlobFileIterator* iter1,
-                    const BlobFileIterator* iter2) {
-      assert(comparator_ != nullptr);
-      return comparator_->Compare(iter1->key(), iter2->key()) > 0;
-    }
+  // Refreshes the state of iterator `i` after it moved.
+  void UpdateLeaf(size_t i);
+
+  // Replays the matches from the leaf of iterator `i` up to the root.
+  void Replay(size_t i);
 
-   private:
-    const Comparator* comparator_;
-  };
+  // Returns true if iterator `a` goes before iterator `b`. Exhausted
+  // iterators go last, and ties go to the lower index.
+  bool Before(size_t a, size_t b) const {
+    if (exhausted_[a] || exhausted_[b]) {
+      return !exhausted_[a];
+    }
+    int cmp;
+    if (bytewise_) {
+      if (key_prefixes_[a] != key_prefixes_[b]) {
+        return key_prefixes_[a] < key_prefixes_[b];
+      }
+      cmp = blob_file_iterators_[a]->key().compare(
+          blob_file_iterators_[b]->key());
+    } else {
+      cmp = comparator_->Compare(blob_file_iterators_[a]->key(),
+                                 blob_file_iterators_[b]->key());
+    }
+    return cmp != 0 ? cmp < 0 : a < b;
+  }
 
   Status status_;
+  const Comparator* comparator_;
+  const bool bytewise_;
   std::vector<std::unique_ptr<BlobFileIterator>> blob_file_iterators_;
-  std::priority_queue<BlobFileIterator*, std::vector<BlobFileIterator*>,
-                      BlobFileIterComparator>
-      min_heap_;
+  // For iterator i, leaf i of the tree is node i + n, and the parent of node
+  // j is node j / 2. losers_[j] is the iterator lost the match at internal
+  // node j, and losers_[0] the overall winner.
+  std::vector<size_t> losers_;
+  std::vector<bool> exhausted_;
+  // Big-endian first 8 bytes of current keys, zero padded. Only maintained
+  // with the bytewise comparator.
+  std::vector<uint64_t> key_prefixes_;
   BlobFileIterator* current_ = nullptr;
 };
 
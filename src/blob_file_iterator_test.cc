@@ -1,5 +1,6 @@
 #include "blob_file_iterator.h"
 
+#include <algorithm>
 #include <cinttypes>
 
 #include "blob_file_builder.h"
@@ -98,10 +99,17 @@ class BlobFileIteratorTest : public testing::Test {
   void NewBlobFileIterator() {
     uint64_t file_size = 0;
     ASSERT_OK(env_->GetFileSize(file_name_, &file_size));
-    NewBlobFileReader(file_number_, 0, titan_options_, env_options_, env_,
-                      &readable_file_);
+    if (titan_options_.gc_readahead_size > 0) {
+      NewGCBlobFileReader(file_number_, titan_options_, env_options_, env_,
+                          &readable_file_);
+    } else {
+      NewBlobFileReader(file_number_, 0, titan_options_, env_options_, env_,
+                        &readable_file_);
+    }
     blob_file_iterator_.reset(new BlobFileIterator{
         std::move(readable_file_), file_number_, file_size, TitanCFOptions()});
+    blob_file_iterator_->SetSequentialReadahead(
+        titan_options_.gc_readahead_size);
   }
 
   void TestBlobFileIterator() {
@@ -148,6 +156,30 @@ TEST_F(BlobFileIteratorTest, DictCompress) {
 #endif
 }
 
+TEST_F(BlobFileIteratorTest, PackedBlocks) {
+  titan_options_.blob_file_block_size = 4 << 10;
+  TestBlobFileIterator();
+}
+
+TEST_F(BlobFileIteratorTest, PackedBlocksDictCompress) {
+#if ZSTD_VERSION_NUMBER >= 10103
+  CompressionOptions compression_opts;
+  compression_opts.enabled = true;
+  compression_opts.max_dict_bytes = 4000;
+  titan_options_.blob_file_compression = kZSTD;
+  titan_options_.blob_file_compression_options = compression_opts;
+  titan_options_.blob_file_block_size = 4 << 10;
+
+  TestBlobFileIterator();
+#endif
+}
+
+TEST_F(BlobFileIteratorTest, BackgroundReadahead) {
+  // Records of about min_blob_size straddle chunks of this size.
+  titan_options_.gc_readahead_size = 10000;
+  TestBlobFileIterator();
+}
+
 TEST_F(BlobFileIteratorTest, IterateForPrev) {
   NewBuilder();
   const int n = 1000;
@@ -212,6 +244,54 @@ TEST_F(BlobFileIteratorTest, IterateForPrev) {
   ASSERT_EQ(blob_handle, blob_index.blob_handle);
 }
 
+TEST_F(BlobFileIteratorTest, PunchedHoles) {
+  NewBuilder();
+  const int n = 1000;
+  BlobFileBuilder::OutContexts contexts;
+  for (int i = 0; i < n; i++) {
+    AddKeyValue(GenKey(i), GenValue(i), contexts);
+  }
+  FinishBuilder(contexts);
+  ASSERT_EQ(contexts.size(), n);
+
+  // Punch out records [100, 200) and 500.
+  auto range = [&](int begin, int end) {
+    const auto& first = contexts[begin]->new_blob_index.blob_handle;
+    const auto& last = contexts[end - 1]->new_blob_index.blob_handle;
+    return std::make_pair(first.offset, last.offset + last.size - first.offset);
+  };
+  BlobFileRanges holes{range(100, 200), range(500, 501)};
+  for (const auto& hole : holes) {
+    Status s = PunchHole(file_name_, hole.first, hole.second);
+    ASSERT_TRUE(s.ok() || s.IsNotSupported());
+  }
+
+  NewBlobFileIterator();
+  blob_file_iterator_->SetPunchedHoles(holes);
+  blob_file_iterator_->SeekToFirst();
+  for (int i = 0; i < n; i++) {
+    if ((i >= 100 && i < 200) || i == 500) {
+      continue;
+    }
+    ASSERT_OK(blob_file_iterator_->status());
+    ASSERT_TRUE(blob_file_iterator_->Valid());
+    ASSERT_EQ(GenKey(i), blob_file_iterator_->key());
+    ASSERT_EQ(GenValue(i), blob_file_iterator_->value());
+    blob_file_iterator_->Next();
+  }
+  ASSERT_OK(blob_file_iterator_->status());
+  ASSERT_FALSE(blob_file_iterator_->Valid());
+
+  // Iterating from inside a hole starts at the hole.
+  blob_file_iterator_->IterateForPrev(
+      contexts[150]->new_blob_index.blob_handle.offset);
+  ASSERT_OK(blob_file_iterator_->status());
+  blob_file_iterator_->Next();
+  ASSERT_OK(blob_file_iterator_->status());
+  ASSERT_TRUE(blob_file_iterator_->Valid());
+  ASSERT_EQ(GenKey(200), blob_file_iterator_->key());
+}
+
 TEST_F(BlobFileIteratorTest, MergeIterator) {
   const int kMaxKeyNum = 1000;
   BlobFileBuilder::OutContexts contexts;
@@ -257,6 +337,58 @@ TEST_F(BlobFileIteratorTest, MergeIterator) {
   ASSERT_EQ(i, kMaxKeyNum);
 }
 
+TEST_F(BlobFileIteratorTest, MergeIteratorInterleaved) {
+  // Keys of each file are interleaved with the others, and the number of
+  // files is not a power of two.
+  const size_t kNumFiles = 7;
+  const size_t kMaxKeyNum = 1000;
+  for (const Comparator* cmp :
+       {BytewiseComparator(), ReverseBytewiseComparator()}) {
+    titan_options_.comparator = cmp;
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < kMaxKeyNum; i++) {
+      keys.push_back(GenKey(i));
+    }
+    std::sort(keys.begin(), keys.end(),
+              [cmp](const std::string& a, const std::string& b) {
+                return cmp->Compare(a, b) < 0;
+              });
+
+    std::vector<std::string> file_names;
+    std::vector<std::unique_ptr<BlobFileIterator>> iters;
+    for (size_t f = 0; f < kNumFiles; f++) {
+      file_number_ = Random::GetTLSInstance()->Next();
+      file_name_ = BlobFileName(dirname_, file_number_);
+      file_names.push_back(file_name_);
+      NewBuilder();
+      BlobFileBuilder::OutContexts contexts;
+      for (size_t i = f; i < keys.size(); i += kNumFiles) {
+        AddKeyValue(keys[i], keys[i], contexts);
+      }
+      FinishBuilder(contexts);
+      uint64_t file_size = 0;
+      ASSERT_OK(env_->GetFileSize(file_name_, &file_size));
+      NewBlobFileReader(file_number_, 0, titan_options_, env_options_, env_,
+                        &readable_file_);
+      iters.emplace_back(new BlobFileIterator{std::move(readable_file_),
+                                              file_number_, file_size,
+                                              TitanCFOptions(titan_options_)});
+    }
+
+    BlobFileMergeIterator iter(std::move(iters), cmp);
+    size_t i = 0;
+    for (iter.SeekToFirst(); iter.Valid(); iter.Next(), i++) {
+      ASSERT_EQ(keys[i], iter.key());
+      ASSERT_EQ(keys[i], iter.value());
+    }
+    ASSERT_OK(iter.status());
+    ASSERT_EQ(keys.size(), i);
+    for (const auto& file_name : file_names) {
+      env_->DeleteFile(file_name);
+    }
+  }
+}
+
 }  // namespace titandb
 }  // namespace rocksdb
 
@@ -35,6 +35,30 @@ Status NewBlobFileReader(uint64_t file_number, uint64_t readahead_size,
   return s;
 }
 
+Status NewGCBlobFileReader(uint64_t file_number,
+                           const TitanDBOptions& db_options,
+                           const EnvOptions& env_options, Env* env,
+                           std::unique_ptr<RandomAccessFileReader>* result,
+                           std::shared_ptr<ReadaheadBudget> readahead_budget) {
+  EnvOptions gc_env_options = env_options;
+  if (db_options.use_direct_reads_for_gc) {
+    gc_env_options.use_direct_reads = true;
+  }
+  std::unique_ptr<RandomAccessFile> file;
+  auto file_name = BlobFileName(db_options.dirname, file_number);
+  Status s = env->NewRandomAccessFile(file_name, &file, gc_env_options);
+  if (!s.ok()) return s;
+
+  if (db_options.gc_readahead_size > 0) {
+    file.reset(new BackgroundReadaheadFile(std::move(file), env,
+                                           std::move(readahead_budget)));
+  }
+  result->reset(new RandomAccessFileReader(
+      std::move(file), file_name, nullptr /*env*/, nullptr /*stats*/,
+      0 /*hist_type*/, nullptr /*file_read_hist*/, env_options.rate_limiter));
+  return s;
+}
+
 const uint64_t kMaxReadaheadSize = 256 << 10;
 
 namespace {
@@ -54,6 +78,20 @@ void EncodeBlobCache(std::string* dst, const Slice& prefix, uint64_t offset) {
   PutVarint64(dst, offset);
 }
 
+Status DecodeBlockRecord(const Slice& contents, uint32_t slot,
+                         BlobRecord* record) {
+  BlobBlock block;
+  Status s = block.DecodeFrom(contents);
+  if (s.ok()) {
+    s = block.GetRecord(slot, record);
+  }
+  return s;
+}
+
+void ReleaseBlock(void* arg1, void* /*arg2*/) {
+  delete reinterpret_cast<std::shared_ptr<std::string>*>(arg1);
+}
+
 // Seek to the specified meta block.
 // Return true if it successfully seeks to that block.
 Status SeekToMetaBlock(InternalIterator* meta_iter,
@@ -81,7 +119,8 @@ Status BlobFileReader::Open(const TitanCFOptions& options,
                             std::unique_ptr<RandomAccessFileReader> file,
                             uint64_t file_size,
                             std::unique_ptr<BlobFileReader>* result,
-                            TitanStats* stats) {
+                            TitanStats* stats,
+                            const BlobCompressionDicts* compression_dicts) {
   if (file_size < BlobFileFooter::kEncodedLength) {
     return Status::Corruption("file is too short to be a blob file");
   }
@@ -105,16 +144,25 @@ Status BlobFileReader::Open(const TitanCFOptions& options,
     return s;
   }
 
-  auto reader = new BlobFileReader(options, std::move(file), stats);
+  std::unique_ptr<BlobFileReader> reader(
+      new BlobFileReader(options, std::move(file), stats));
   reader->footer_ = footer;
   if (header.flags & BlobFileHeader::kHasUncompressionDictionary) {
+    std::unique_ptr<UncompressionDict> uncompression_dict;
     s = InitUncompressionDict(footer, reader->file_.get(),
-                              &reader->uncompression_dict_);
+                              &uncompression_dict);
+    if (!s.ok()) {
+      return s;
+    }
+    reader->uncompression_dict_ = std::move(uncompression_dict);
+  } else if (header.flags & BlobFileHeader::kHasSharedDictionary) {
+    s = GetSharedUncompressionDict(header, compression_dicts,
+                                   &reader->uncompression_dict_);
     if (!s.ok()) {
       return s;
     }
   }
-  result->reset(reader);
+  *result = std::move(reader);
   return Status::OK();
 }
 
@@ -125,7 +173,8 @@ Status BlobFileReader::ReadHeader(std::unique_ptr<RandomAccessFileReader>& file,
       file->Read(0, BlobFileHeader::kMaxEncodedLength, &buffer, buffer.get());
   if (!s.ok()) return s;
 
-  s = DecodeInto(buffer, header);
+  // The header may be shorter than the buffer read.
+  s = header->DecodeFrom(&buffer);
 
   return s;
 }
@@ -147,6 +196,8 @@ Status BlobFileReader::Get(const ReadOptions& /*options*/,
                            PinnableSlice* buffer) {
   TEST_SYNC_POINT("BlobFileReader::Get");
 
+  // For packed records, the whole block is cached with the offset of the block
+  // and shared by all records in it.
   std::string cache_key;
   Cache::Handle* cache_handle = nullptr;
   if (cache_) {
@@ -156,6 +207,9 @@ Status BlobFileReader::Get(const ReadOptions& /*options*/,
       RecordTick(statistics(stats_), TITAN_BLOB_CACHE_HIT);
       auto blob = reinterpret_cast<OwnedSlice*>(cache_->Value(cache_handle));
       buffer->PinSlice(*blob, UnrefCacheHandle, cache_.get(), cache_handle);
+      if (handle.packed()) {
+        return DecodeBlockRecord(*blob, handle.slot, record);
+      }
       return DecodeInto(*blob, record);
     }
   }
@@ -184,15 +238,16 @@ Status BlobFileReader::Get(const ReadOptions& /*options*/,
 Status BlobFileReader::ReadRecord(const BlobHandle& handle, BlobRecord* record,
                                   OwnedSlice* buffer) {
   Slice blob;
-  CacheAllocationPtr ubuf(new char[handle.size]);
-  Status s = file_->Read(handle.offset, handle.size, &blob, ubuf.get());
+  uint64_t read_size = handle.read_size();
+  CacheAllocationPtr ubuf(new char[read_size]);
+  Status s = file_->Read(handle.offset, read_size, &blob, ubuf.get());
   if (!s.ok()) {
     return s;
   }
-  if (handle.size != static_cast<uint64_t>(blob.size())) {
+  if (read_size != static_cast<uint64_t>(blob.size())) {
     return Status::Corruption(
         "ReadRecord actual size: " + ToString(blob.size()) +
-        " not equal to blob size " + ToString(handle.size));
+        " not equal to blob size " + ToString(read_size));
   }
 
   BlobDecoder decoder(uncompression_dict_ == nullptr
@@ -203,28 +258,53 @@ Status BlobFileReader::ReadRecord(const BlobHandle& handle, BlobRecord* record,
     return s;
   }
   buffer->reset(std::move(ubuf), blob);
-  s = decoder.DecodeRecord(&blob, record, buffer);
+  if (handle.packed()) {
+    // `buffer` is left holding the block contents.
+    Slice contents;
+    s = decoder.DecodeSlice(&blob, &contents, buffer);
+    if (s.ok()) {
+      s = DecodeBlockRecord(contents, handle.slot, record);
+    }
+  } else {
+    s = decoder.DecodeRecord(&blob, record, buffer);
+  }
   return s;
 }
 
 Status BlobFilePrefetcher::Get(const ReadOptions& options,
                                const BlobHandle& handle, BlobRecord* record,
                                PinnableSlice* buffer) {
+  if (handle.packed() && block_ != nullptr && handle.offset == block_offset_) {
+    // Another record in the same block as last read.
+    Status s = DecodeBlockRecord(*block_, handle.slot, record);
+    if (s.ok()) {
+      buffer->PinSlice(*block_, ReleaseBlock,
+                       new std::shared_ptr<std::string>(block_), nullptr);
+    }
+    return s;
+  }
+  uint64_t read_size = handle.read_size();
   if (handle.offset == last_offset_) {
-    last_offset_ = handle.offset + handle.size;
-    if (handle.offset + handle.size > readahead_limit_) {
-      readahead_size_ = std::max(handle.size, readahead_size_);
+    last_offset_ = handle.offset + read_size;
+    if (handle.offset + read_size > readahead_limit_) {
+      readahead_size_ = std::max(read_size, readahead_size_);
       reader_->file_->Prefetch(handle.offset, readahead_size_);
       readahead_limit_ = handle.offset + readahead_size_;
       readahead_size_ = std::min(kMaxReadaheadSize, readahead_size_ * 2);
     }
   } else {
-    last_offset_ = handle.offset + handle.size;
+    last_offset_ = handle.offset + read_size;
     readahead_size_ = 0;
     readahead_limit_ = 0;
   }
 
-  return reader_->Get(options, handle, record, buffer);
+  Status s = reader_->Get(options, handle, record, buffer);
+  if (s.ok() && handle.packed()) {
+    // `buffer` holds the block contents.
+    block_offset_ = handle.offset;
+    block_ = std::make_shared<std::string>(buffer->data(), buffer->size());
+  }
+  return s;
 }
 
 Status InitUncompressionDict(
@@ -280,5 +360,20 @@ Status InitUncompressionDict(
   return s;
 }
 
+Status GetSharedUncompressionDict(
+    const BlobFileHeader& header, const BlobCompressionDicts* compression_dicts,
+    std::shared_ptr<const UncompressionDict>* uncompression_dict) {
+  assert(header.flags & BlobFileHeader::kHasSharedDictionary);
+  if (compression_dicts != nullptr) {
+    *uncompression_dict =
+        compression_dicts->GetUncompressionDict(header.dict_id);
+  }
+  if (*uncompression_dict == nullptr) {
+    return Status::Corruption("Shared compression dictionary " +
+                              ToString(header.dict_id) + " not found");
+  }
+  return Status::OK();
+}
+
 }  // namespace titandb
 }  // namespace rocksdb
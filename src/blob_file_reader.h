@@ -1,5 +1,7 @@
 #pragma once
 
+#include "background_readahead_file.h"
+#include "blob_compression_dicts.h"
 #include "blob_format.h"
 #include "titan/options.h"
 #include "titan_stats.h"
@@ -13,15 +15,28 @@ Status NewBlobFileReader(uint64_t file_number, uint64_t readahead_size,
                          const EnvOptions& env_options, Env* env,
                          std::unique_ptr<RandomAccessFileReader>* result);
 
+// Opens a blob file to be read through by GC, with direct I/O if
+// `use_direct_reads_for_gc` is set. If `gc_readahead_size` is set,
+// prefetches on the file are read in the background, as long as
+// `readahead_budget`, if given, allows.
+Status NewGCBlobFileReader(
+    uint64_t file_number, const TitanDBOptions& db_options,
+    const EnvOptions& env_options, Env* env,
+    std::unique_ptr<RandomAccessFileReader>* result,
+    std::shared_ptr<ReadaheadBudget> readahead_budget = nullptr);
+
 class BlobFileReader {
  public:
   // Opens a blob file and read the necessary metadata from it.
   // If successful, sets "*result" to the newly opened file reader.
+  // "compression_dicts" is required to open blob files compressed with a
+  // shared dictionary.
   static Status Open(const TitanCFOptions& options,
                      std::unique_ptr<RandomAccessFileReader> file,
                      uint64_t file_size,
                      std::unique_ptr<BlobFileReader>* result,
-                     TitanStats* stats);
+                     TitanStats* stats,
+                     const BlobCompressionDicts* compression_dicts = nullptr);
 
   // Gets the blob record pointed by the handle in this file. The data
   // of the record is stored in the provided buffer, so the buffer
@@ -50,7 +65,7 @@ class BlobFileReader {
   // Information read from the file.
   BlobFileFooter footer_;
 
-  std::unique_ptr<UncompressionDict> uncompression_dict_ = nullptr;
+  std::shared_ptr<const UncompressionDict> uncompression_dict_ = nullptr;
 
   TitanStats* stats_;
 };
@@ -67,6 +82,9 @@ class BlobFilePrefetcher : public Cleanable {
 
  private:
   BlobFileReader* reader_;
+  // The last packed block read, whose other records are served from it.
+  uint64_t block_offset_{0};
+  std::shared_ptr<std::string> block_;
   uint64_t last_offset_{0};
   uint64_t readahead_size_{0};
   uint64_t readahead_limit_{0};
@@ -79,5 +97,10 @@ Status InitUncompressionDict(
     const BlobFileFooter& footer, RandomAccessFileReader* file,
     std::unique_ptr<UncompressionDict>* uncompression_dict);
 
+// Gets the shared uncompression dictionary referenced by the blob file header.
+Status GetSharedUncompressionDict(
+    const BlobFileHeader& header, const BlobCompressionDicts* compression_dicts,
+    std::shared_ptr<const UncompressionDict>* uncompression_dict);
+
 }  // namespace titandb
 }  // namespace rocksdb
@@ -91,6 +91,13 @@ Status BlobFileSet::Recover() {
   s = OpenManifest(new_manifest_file_number);
   if (!s.ok()) return s;
 
+  // Creation time of blob files is not persisted, take files found at
+  // recovery as created now.
+  int64_t now = 0;
+  if (!env_->GetCurrentTime(&now).ok()) {
+    now = 0;
+  }
+
   // Purge inactive files at start
   std::set<uint64_t> alive_files;
   alive_files.insert(new_manifest_file_number);
@@ -113,6 +120,11 @@ Status BlobFileSet::Recover() {
     bs.second->GetObsoleteFiles(nullptr, kMaxSequenceNumber);
     for (const auto& f : bs.second->files_) {
       alive_files.insert(f.second->file_number());
+      // Files added before creation times were logged are taken as created
+      // at DB open.
+      if (f.second->creation_time() == 0) {
+        f.second->set_creation_time(static_cast<uint64_t>(now));
+      }
     }
   }
   std::vector<std::string> files;
@@ -189,6 +201,34 @@ Status BlobFileSet::WriteSnapshot(log::Writer* log) {
         continue;
       }
       edit.AddBlobFile(file.second);
+      if (!file.second->punched_holes().empty()) {
+        edit.AddPunchedHoles(file.first, file.second->punched_holes());
+      }
+      if (file.second->gc_resume_offset() > 0) {
+        edit.SetGCResumePosition(file.first, file.second->gc_resume_offset(),
+                                 file.second->gc_resume_slot());
+      }
+      if (file.second->creation_time() > 0) {
+        edit.SetBlobFileCreationTime(file.first,
+                                     file.second->creation_time());
+      }
+      if (file.second->deletion_tracked()) {
+        edit.SetBlobDeletionTracked(file.first, true);
+      }
+      if (!file.second->dead_records().empty()) {
+        edit.AddDeadBlobRecords(file.first, file.second->dead_records());
+      }
+    }
+    std::map<uint64_t, std::string> dicts;
+    it.second->compression_dicts()->GetAll(&dicts);
+    for (auto& dict : dicts) {
+      edit.AddCompressionDict(dict.first, dict.second);
+    }
+    {
+      MutexLock l(&it.second->mutex_);
+      if (it.second->live_size_checkpoint_ != nullptr) {
+        edit.SetLiveSizeCheckpoint(*it.second->live_size_checkpoint_);
+      }
     }
     std::string record;
     edit.EncodeTo(&record);
@@ -353,6 +393,28 @@ void BlobFileSet::GetAllFiles(std::vector<std::string>* files,
     blob_storage->GetAllFiles(&all_blob_files);
     for (auto& file : blob_storage->files_) {
       edit.AddBlobFile(file.second);
+      if (!file.second->punched_holes().empty()) {
+        edit.AddPunchedHoles(file.first, file.second->punched_holes());
+      }
+      if (file.second->gc_resume_offset() > 0) {
+        edit.SetGCResumePosition(file.first, file.second->gc_resume_offset(),
+                                 file.second->gc_resume_slot());
+      }
+      if (file.second->creation_time() > 0) {
+        edit.SetBlobFileCreationTime(file.first,
+                                     file.second->creation_time());
+      }
+      if (file.second->deletion_tracked()) {
+        edit.SetBlobDeletionTracked(file.first, true);
+      }
+      if (!file.second->dead_records().empty()) {
+        edit.AddDeadBlobRecords(file.first, file.second->dead_records());
+      }
+    }
+    std::map<uint64_t, std::string> dicts;
+    blob_storage->compression_dicts()->GetAll(&dicts);
+    for (auto& dict : dicts) {
+      edit.AddCompressionDict(dict.first, dict.second);
     }
     edits->emplace_back(edit);
   }
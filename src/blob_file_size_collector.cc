@@ -1,4 +1,7 @@
 #include "blob_file_size_collector.h"
+
+#include <algorithm>
+
 #include "base_db_listener.h"
 
 namespace rocksdb {
@@ -88,5 +91,81 @@ Status BlobFileSizeCollector::Finish(UserCollectedProperties* properties) {
   return Status::OK();
 }
 
+TablePropertiesCollector*
+BlobRecordCollectorFactory::CreateTablePropertiesCollector(
+    rocksdb::TablePropertiesCollectorFactory::Context /* context */) {
+  return new BlobRecordCollector();
+}
+
+const std::string BlobRecordCollector::kPropertiesName =
+    "TitanDB.blob_records";
+
+bool BlobRecordCollector::Encode(
+    std::map<uint64_t, std::vector<BlobHandle>>* blob_records,
+    std::string* result) {
+  PutVarint32(result, static_cast<uint32_t>(blob_records->size()));
+  for (auto& file : *blob_records) {
+    PutVarint64(result, file.first);
+    BlobRecordSet::EncodeRecords(&file.second, result);
+  }
+  return true;
+}
+
+bool BlobRecordCollector::Decode(
+    Slice* slice, std::map<uint64_t, std::vector<BlobHandle>>* blob_records) {
+  uint32_t num = 0;
+  if (!GetVarint32(slice, &num)) {
+    return false;
+  }
+  for (uint32_t i = 0; i < num; ++i) {
+    uint64_t file_number;
+    if (!GetVarint64(slice, &file_number) ||
+        !BlobRecordSet::DecodeRecords(slice, &(*blob_records)[file_number])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+Status BlobRecordCollector::AddUserKey(const Slice& /* key */,
+                                       const Slice& value, EntryType type,
+                                       SequenceNumber /* seq */,
+                                       uint64_t /* file_size */) {
+  if (type != kEntryBlobIndex && type != kEntryMerge) {
+    return Status::OK();
+  }
+
+  Status s;
+  MergeBlobIndex index;
+
+  if (type == kEntryMerge) {
+    s = index.DecodeFrom(const_cast<Slice*>(&value));
+  } else {
+    s = index.DecodeFromBase(const_cast<Slice*>(&value));
+  }
+  if (!s.ok()) {
+    return s;
+  }
+  if (BlobIndex::IsDeletionMarker(index)) {
+    return Status::OK();
+  }
+
+  blob_records_[index.file_number].push_back(index.blob_handle);
+  return Status::OK();
+}
+
+Status BlobRecordCollector::Finish(UserCollectedProperties* properties) {
+  if (blob_records_.empty()) {
+    return Status::OK();
+  }
+
+  std::string res;
+  bool ok __attribute__((__unused__)) = Encode(&blob_records_, &res);
+  assert(ok);
+  assert(!res.empty());
+  properties->emplace(std::make_pair(kPropertiesName, res));
+  return Status::OK();
+}
+
 }  // namespace titandb
 }  // namespace rocksdb
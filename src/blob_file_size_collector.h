@@ -1,5 +1,8 @@
 #pragma once
 
+#include <map>
+#include <vector>
+
 #include "blob_file_set.h"
 #include "db_impl.h"
 #include "rocksdb/listener.h"
@@ -39,5 +42,39 @@ class BlobFileSizeCollector final : public TablePropertiesCollector {
   std::map<uint64_t, uint64_t> blob_files_size_;
 };
 
+// Collects handles of the blob records referenced by an SST, so that blob
+// records dropped by a compaction can be told by comparing its inputs and
+// outputs. Only used with `track_blob_record_deletions`.
+class BlobRecordCollectorFactory final
+    : public TablePropertiesCollectorFactory {
+ public:
+  TablePropertiesCollector* CreateTablePropertiesCollector(
+      TablePropertiesCollectorFactory::Context context) override;
+
+  const char* Name() const override { return "BlobRecordCollector"; }
+};
+
+class BlobRecordCollector final : public TablePropertiesCollector {
+ public:
+  const static std::string kPropertiesName;
+
+  // Records of each blob file are encoded as a `BlobRecordSet`.
+  static bool Encode(std::map<uint64_t, std::vector<BlobHandle>>* blob_records,
+                     std::string* result);
+  static bool Decode(Slice* slice,
+                     std::map<uint64_t, std::vector<BlobHandle>>* blob_records);
+
+  Status AddUserKey(const Slice& key, const Slice& value, EntryType type,
+                    SequenceNumber seq, uint64_t file_size) override;
+  Status Finish(UserCollectedProperties* properties) override;
+  UserCollectedProperties GetReadableProperties() const override {
+    return UserCollectedProperties();
+  }
+  const char* Name() const override { return "BlobRecordCollector"; }
+
+ private:
+  std::map<uint64_t, std::vector<BlobHandle>> blob_records_;
+};
+
 }  // namespace titandb
 }  // namespace rocksdb
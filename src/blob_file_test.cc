@@ -1,9 +1,11 @@
 #include <cinttypes>
+#include <set>
 
 #include "blob_file_builder.h"
 #include "blob_file_cache.h"
 #include "blob_file_reader.h"
 #include "file/filename.h"
+#include "test_util/sync_point.h"
 #include "test_util/testharness.h"
 
 namespace rocksdb {
@@ -113,6 +115,30 @@ class BlobFileTest : public testing::Test {
       ASSERT_OK(prefetcher->Get(ro, blob_handle, &record, &buffer));
       ASSERT_EQ(record, expect);
     }
+
+    // Reading through the file, each block of packed records is read once.
+    ASSERT_OK(cache.NewPrefetcher(file_number_, file_size, &prefetcher));
+    std::set<uint64_t> blocks;
+    size_t reads = 0;
+    SyncPoint::GetInstance()->SetCallBack("BlobFileReader::Get",
+                                          [&](void*) { reads++; });
+    SyncPoint::GetInstance()->EnableProcessing();
+    for (int i = 0; i < n; i++) {
+      BlobRecord expect;
+      auto key = GenKey(i);
+      auto value = GenValue(i);
+      expect.key = key;
+      expect.value = value;
+      BlobRecord record;
+      PinnableSlice buffer;
+      BlobHandle blob_handle = contexts[i]->new_blob_index.blob_handle;
+      ASSERT_OK(prefetcher->Get(ro, blob_handle, &record, &buffer));
+      ASSERT_EQ(record, expect);
+      blocks.insert(blob_handle.offset);
+    }
+    SyncPoint::GetInstance()->DisableProcessing();
+    SyncPoint::GetInstance()->ClearAllCallBacks();
+    ASSERT_EQ(blocks.size(), reads);
   }
 
   void TestBlobFileReader(TitanOptions options) {
@@ -210,6 +236,17 @@ TEST_F(BlobFileTest, BlobFilePrefetcher) {
   TestBlobFilePrefetcher(options);
 }
 
+TEST_F(BlobFileTest, PackedBlobFile) {
+  TitanOptions options;
+  options.blob_file_block_size = 4 << 10;
+  TestBlobFileReader(options);
+  TestBlobFilePrefetcher(options);
+  options.blob_cache = NewLRUCache(1 << 20);
+  options.blob_file_compression = kLZ4Compression;
+  TestBlobFileReader(options);
+  TestBlobFilePrefetcher(options);
+}
+
 }  // namespace titandb
 }  // namespace rocksdb
 
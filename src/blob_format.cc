@@ -1,5 +1,7 @@
 #include "blob_format.h"
 
+#include <cmath>
+
 #include "test_util/sync_point.h"
 #include "util/crc32c.h"
 
@@ -8,6 +10,9 @@ namespace titandb {
 
 namespace {
 
+// Time constant of the exponential decay of blob file discard rates.
+const double kBlobFileDiscardRateWindowSecs = 3600;
+
 bool GetChar(Slice* src, unsigned char* value) {
   if (src->size() < 1) return false;
   *value = *src->data();
@@ -15,6 +20,15 @@ bool GetChar(Slice* src, unsigned char* value) {
   return true;
 }
 
+// Mixes an SST number, so that the digest summed from them doesn't depend on
+// the order SSTs are added or deleted in.
+uint64_t MixSSTNumber(uint64_t sst_number) {
+  uint64_t x = sst_number + 0x9e3779b97f4a7c15ull;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
 }  // namespace
 
 void BlobRecord::EncodeTo(std::string* dst) const {
@@ -74,6 +88,18 @@ Status BlobDecoder::DecodeRecord(Slice* src, BlobRecord* record,
                                  OwnedSlice* buffer) {
   TEST_SYNC_POINT_CALLBACK("BlobDecoder::DecodeRecord", &crc_);
 
+  Slice output;
+  Status s = DecodeSlice(src, &output, buffer);
+  if (!s.ok()) {
+    return s;
+  }
+  return DecodeInto(output, record);
+}
+
+Status BlobDecoder::DecodeSlice(Slice* src, Slice* output, OwnedSlice* buffer) {
+  if (src->size() < record_size_) {
+    return Status::Corruption("BlobRecord", "truncated");
+  }
   Slice input(src->data(), record_size_);
   src->remove_prefix(record_size_);
   uint32_t crc = crc32c::Extend(header_crc_, input.data(), input.size());
@@ -82,7 +108,8 @@ Status BlobDecoder::DecodeRecord(Slice* src, BlobRecord* record,
   }
 
   if (compression_ == kNoCompression) {
-    return DecodeInto(input, record);
+    *output = input;
+    return Status::OK();
   }
   UncompressionContext ctx(compression_);
   UncompressionInfo info(ctx, *uncompression_dict_, compression_);
@@ -90,7 +117,78 @@ Status BlobDecoder::DecodeRecord(Slice* src, BlobRecord* record,
   if (!s.ok()) {
     return s;
   }
-  return DecodeInto(*buffer, record);
+  *output = *buffer;
+  return s;
+}
+
+void BlobBlockBuilder::Add(const Slice& record) {
+  assert(!finished_);
+  assert(buffer_.size() < std::numeric_limits<uint32_t>::max());
+  offsets_.push_back(static_cast<uint32_t>(buffer_.size()));
+  buffer_.append(record.data(), record.size());
+  raw_size_ = buffer_.size();
+}
+
+Slice BlobBlockBuilder::Finish() {
+  assert(!finished_);
+  for (uint32_t offset : offsets_) {
+    PutFixed32(&buffer_, offset);
+  }
+  PutFixed32(&buffer_, static_cast<uint32_t>(offsets_.size()));
+  finished_ = true;
+  return buffer_;
+}
+
+void BlobBlockBuilder::Reset() {
+  buffer_.clear();
+  offsets_.clear();
+  raw_size_ = 0;
+  finished_ = false;
+}
+
+uint64_t BlobBlockBuilder::RecordRawSize(uint32_t slot) const {
+  assert(slot < offsets_.size());
+  uint64_t end = slot + 1 < offsets_.size() ? offsets_[slot + 1] : raw_size_;
+  return end - offsets_[slot];
+}
+
+Status BlobBlock::DecodeFrom(const Slice& contents) {
+  if (contents.size() < 4) {
+    return Status::Corruption("BlobBlock", "too short");
+  }
+  num_records_ = DecodeFixed32(contents.data() + contents.size() - 4);
+  uint64_t trailer_size = static_cast<uint64_t>(num_records_) * 4 + 4;
+  if (num_records_ == 0 || contents.size() < trailer_size) {
+    return Status::Corruption("BlobBlock", "bad number of records");
+  }
+  contents_ = Slice(contents.data(), contents.size() - trailer_size);
+  offsets_ = contents_.data() + contents_.size();
+  for (uint32_t i = 0; i < num_records_; i++) {
+    uint32_t offset = DecodeFixed32(offsets_ + i * 4);
+    uint32_t prev = i == 0 ? 0 : DecodeFixed32(offsets_ + (i - 1) * 4);
+    if (offset > contents_.size() || offset < prev) {
+      return Status::Corruption("BlobBlock", "bad record offset");
+    }
+  }
+  return Status::OK();
+}
+
+uint64_t BlobBlock::RecordRawSize(uint32_t slot) const {
+  assert(slot < num_records_);
+  uint64_t begin = DecodeFixed32(offsets_ + slot * 4);
+  uint64_t end = slot + 1 < num_records_
+                     ? DecodeFixed32(offsets_ + (slot + 1) * 4)
+                     : contents_.size();
+  return end - begin;
+}
+
+Status BlobBlock::GetRecord(uint32_t slot, BlobRecord* record) const {
+  if (slot >= num_records_) {
+    return Status::Corruption("BlobBlock", "slot out of range");
+  }
+  uint64_t begin = DecodeFixed32(offsets_ + slot * 4);
+  return DecodeInto(Slice(contents_.data() + begin, RecordRawSize(slot)),
+                    record);
 }
 
 void BlobHandle::EncodeTo(std::string* dst) const {
@@ -106,18 +204,144 @@ Status BlobHandle::DecodeFrom(Slice* src) {
 }
 
 bool operator==(const BlobHandle& lhs, const BlobHandle& rhs) {
-  return lhs.offset == rhs.offset && lhs.size == rhs.size;
+  return lhs.offset == rhs.offset && lhs.size == rhs.size &&
+         lhs.block_size == rhs.block_size && lhs.slot == rhs.slot;
+}
+
+void BlobRecordSet::Add(const std::vector<BlobHandle>& records) {
+  for (const auto& handle : records) {
+    pending_.push_back(handle);
+    pending_size_ += handle.size;
+  }
+  if (pending_.size() < std::max<uint64_t>(num_encoded_ / 8, 64)) {
+    return;
+  }
+  std::vector<BlobHandle> merged = Records();
+  encoded_.clear();
+  EncodeRecords(&merged, &encoded_);
+  Slice src(encoded_);
+  GetVarint64(&src, &num_encoded_);
+  encoded_.erase(0, encoded_.size() - src.size());
+  encoded_size_ = 0;
+  for (const auto& handle : merged) {
+    encoded_size_ += handle.size;
+  }
+  pending_.clear();
+  pending_size_ = 0;
+}
+
+std::vector<BlobHandle> BlobRecordSet::Records() const {
+  std::vector<BlobHandle> records;
+  records.reserve(size());
+  Slice src(encoded_);
+  uint64_t offset = 0;
+  for (uint64_t i = 0; i < num_encoded_; i++) {
+    BlobHandle handle;
+    uint64_t delta = 0;
+    bool ok __attribute__((__unused__)) =
+        GetVarint64(&src, &delta) && GetVarint64(&src, &handle.size) &&
+        GetVarint64(&src, &handle.block_size) &&
+        (handle.block_size == 0 || GetVarint32(&src, &handle.slot));
+    assert(ok);
+    offset += delta;
+    handle.offset = offset;
+    records.push_back(handle);
+  }
+  if (!pending_.empty()) {
+    records.insert(records.end(), pending_.begin(), pending_.end());
+    auto by_id = [](const BlobHandle& a, const BlobHandle& b) {
+      return a.record_id() < b.record_id();
+    };
+    std::stable_sort(records.begin(), records.end(), by_id);
+    records.erase(std::unique(records.begin(), records.end(),
+                              [](const BlobHandle& a, const BlobHandle& b) {
+                                return a.record_id() == b.record_id();
+                              }),
+                  records.end());
+  }
+  return records;
+}
+
+void BlobRecordSet::EncodeTo(std::string* dst) const {
+  std::vector<BlobHandle> records = Records();
+  EncodeRecords(&records, dst);
+}
+
+Status BlobRecordSet::DecodeFrom(Slice* src) {
+  std::vector<BlobHandle> records;
+  if (!DecodeRecords(src, &records)) {
+    return Status::Corruption("BlobRecordSet decode failed");
+  }
+  *this = BlobRecordSet();
+  Add(records);
+  return Status::OK();
+}
+
+void BlobRecordSet::EncodeRecords(std::vector<BlobHandle>* records,
+                                  std::string* dst) {
+  std::sort(records->begin(), records->end(),
+            [](const BlobHandle& a, const BlobHandle& b) {
+              return a.record_id() < b.record_id();
+            });
+  records->erase(std::unique(records->begin(), records->end(),
+                             [](const BlobHandle& a, const BlobHandle& b) {
+                               return a.record_id() == b.record_id();
+                             }),
+                 records->end());
+  PutVarint64(dst, records->size());
+  uint64_t last_offset = 0;
+  for (const auto& handle : *records) {
+    // Sorting by record id sorts by offset, see `BlobHandle::record_id()`.
+    PutVarint64(dst, handle.offset - last_offset);
+    PutVarint64(dst, handle.size);
+    PutVarint64(dst, handle.block_size);
+    if (handle.packed()) {
+      PutVarint32(dst, handle.slot);
+    }
+    last_offset = handle.offset;
+  }
+}
+
+bool BlobRecordSet::DecodeRecords(Slice* src,
+                                  std::vector<BlobHandle>* records) {
+  uint64_t num_records = 0;
+  if (!GetVarint64(src, &num_records)) {
+    return false;
+  }
+  uint64_t offset = 0;
+  for (uint64_t i = 0; i < num_records; i++) {
+    BlobHandle handle;
+    uint64_t delta = 0;
+    if (!GetVarint64(src, &delta) || !GetVarint64(src, &handle.size) ||
+        !GetVarint64(src, &handle.block_size) ||
+        (handle.packed() && !GetVarint32(src, &handle.slot))) {
+      return false;
+    }
+    offset += delta;
+    handle.offset = offset;
+    records->push_back(handle);
+  }
+  return true;
+}
+
+bool operator==(const BlobRecordSet& lhs, const BlobRecordSet& rhs) {
+  return lhs.Records() == rhs.Records();
 }
 
 void BlobIndex::EncodeTo(std::string* dst) const {
-  dst->push_back(kBlobRecord);
+  dst->push_back(blob_handle.packed() ? kPackedBlobRecord : kBlobRecord);
   PutVarint64(dst, file_number);
   blob_handle.EncodeTo(dst);
+  if (blob_handle.packed()) {
+    PutVarint64(dst, blob_handle.block_size);
+    PutVarint32(dst, blob_handle.slot);
+  }
 }
 
 Status BlobIndex::DecodeFrom(Slice* src) {
   unsigned char type;
-  if (!GetChar(src, &type) || type != kBlobRecord ||
+  if (!GetChar(src, &type) ||
+      (type != kBlobRecord && type != kPackedBlobRecord) ||
       !GetVarint64(src, &file_number)) {
     return Status::Corruption("BlobIndex");
   }
@@ -125,6 +349,13 @@ Status BlobIndex::DecodeFrom(Slice* src) {
   if (!s.ok()) {
     return Status::Corruption("BlobIndex", s.ToString());
   }
+  blob_handle.block_size = 0;
+  blob_handle.slot = 0;
+  if (type == kPackedBlobRecord &&
+      (!GetVarint64(src, &blob_handle.block_size) ||
+       !GetVarint32(src, &blob_handle.slot) || blob_handle.block_size == 0)) {
+    return Status::Corruption("BlobIndex", "bad packed blob handle");
+  }
   return s;
 }
 
@@ -147,6 +378,9 @@ void MergeBlobIndex::EncodeTo(std::string* dst) const {
   BlobIndex::EncodeTo(dst);
   PutVarint64(dst, source_file_number);
   PutVarint64(dst, source_file_offset);
+  if (source_slot != 0) {
+    PutVarint32(dst, source_slot);
+  }
 }
 
 void MergeBlobIndex::EncodeToBase(std::string* dst) const {
@@ -162,6 +396,10 @@ Status MergeBlobIndex::DecodeFrom(Slice* src) {
       !GetVarint64(src, &source_file_offset)) {
     return Status::Corruption("MergeBlobIndex");
   }
+  source_slot = 0;
+  if (!src->empty() && !GetVarint32(src, &source_slot)) {
+    return Status::Corruption("MergeBlobIndex");
+  }
   return s;
 }
 
@@ -172,6 +410,7 @@ Status MergeBlobIndex::DecodeFromBase(Slice* src) {
 bool MergeBlobIndex::operator==(const MergeBlobIndex& rhs) const {
   return (source_file_number == rhs.source_file_number &&
           source_file_offset == rhs.source_file_offset &&
+          source_slot == rhs.source_slot &&
           BlobIndex::operator==(rhs));
 }
 
@@ -278,6 +517,42 @@ void BlobFileMeta::FileStateTransit(const FileEvent& event) {
   }
 }
 
+void BlobFileMeta::AddPunchedHoles(const BlobFileRanges& holes) {
+  punched_holes_.insert(punched_holes_.end(), holes.begin(), holes.end());
+  std::sort(punched_holes_.begin(), punched_holes_.end());
+  // Merge adjacent and overlapping holes.
+  BlobFileRanges merged;
+  for (const auto& hole : punched_holes_) {
+    if (!merged.empty() &&
+        merged.back().first + merged.back().second >= hole.first) {
+      uint64_t end = std::max(merged.back().first + merged.back().second,
+                              hole.first + hole.second);
+      merged.back().second = end - merged.back().first;
+    } else {
+      merged.push_back(hole);
+    }
+  }
+  punched_holes_ = std::move(merged);
+  punched_size_ = 0;
+  for (const auto& hole : punched_holes_) {
+    punched_size_ += hole.second;
+  }
+}
+
+void BlobFileMeta::RecordDiscard(uint64_t bytes, uint64_t now) {
+  discard_rate_ = DiscardRate(now) + static_cast<double>(bytes) /
+                                         kBlobFileDiscardRateWindowSecs;
+  discard_rate_time_ = std::max(now, discard_rate_time_);
+}
+
+double BlobFileMeta::DiscardRate(uint64_t now) const {
+  if (now <= discard_rate_time_) {
+    return discard_rate_;
+  }
+  double elapsed = static_cast<double>(now - discard_rate_time_);
+  return discard_rate_ * std::exp(-elapsed / kBlobFileDiscardRateWindowSecs);
+}
+
 TitanInternalStats::StatsType BlobFileMeta::GetDiscardableRatioLevel() const {
   auto ratio = GetDiscardableRatio();
   TitanInternalStats::StatsType type;
@@ -303,6 +578,9 @@ TitanInternalStats::StatsType BlobFileMeta::GetDiscardableRatioLevel() const {
 void BlobFileMeta::Dump(bool with_keys) const {
   fprintf(stdout, "file %" PRIu64 ", size %" PRIu64 ", level %" PRIu32,
           file_number_, file_size_, file_level_);
+  if (punched_size_ > 0) {
+    fprintf(stdout, ", punched %" PRIu64, punched_size_);
+  }
   if (with_keys) {
     fprintf(stdout, ", smallest key: %s, largest key: %s",
             Slice(smallest_key_).ToString(true /*hex*/).c_str(),
@@ -311,12 +589,131 @@ void BlobFileMeta::Dump(bool with_keys) const {
   fprintf(stdout, "\n");
 }
 
+void LiveSizeDelta::EncodeTo(std::string* dst) const {
+  PutVarint32(dst, static_cast<uint32_t>(added_ssts.size()));
+  for (uint64_t sst_number : added_ssts) {
+    PutVarint64(dst, sst_number);
+  }
+  PutVarint32(dst, static_cast<uint32_t>(deleted_ssts.size()));
+  for (uint64_t sst_number : deleted_ssts) {
+    PutVarint64(dst, sst_number);
+  }
+  PutVarint32(dst, static_cast<uint32_t>(live_sizes.size()));
+  for (auto& file : live_sizes) {
+    PutVarint64Varint64(dst, file.first, static_cast<uint64_t>(file.second));
+  }
+}
+
+Status LiveSizeDelta::DecodeFrom(Slice* src) {
+  auto decode_ssts = [src](std::vector<uint64_t>* ssts) {
+    uint32_t num_ssts = 0;
+    if (!GetVarint32(src, &num_ssts)) {
+      return false;
+    }
+    ssts->clear();
+    for (uint32_t i = 0; i < num_ssts; i++) {
+      uint64_t sst_number;
+      if (!GetVarint64(src, &sst_number)) {
+        return false;
+      }
+      ssts->push_back(sst_number);
+    }
+    return true;
+  };
+  uint32_t num_files = 0;
+  if (!decode_ssts(&added_ssts) || !decode_ssts(&deleted_ssts) ||
+      !GetVarint32(src, &num_files)) {
+    return Status::Corruption("LiveSizeDelta decode failed");
+  }
+  live_sizes.clear();
+  for (uint32_t i = 0; i < num_files; i++) {
+    uint64_t file_number, live_size;
+    if (!GetVarint64(src, &file_number) || !GetVarint64(src, &live_size)) {
+      return Status::Corruption("LiveSizeDelta decode failed");
+    }
+    live_sizes[file_number] = static_cast<int64_t>(live_size);
+  }
+  return Status::OK();
+}
+
+bool operator==(const LiveSizeDelta& lhs, const LiveSizeDelta& rhs) {
+  return lhs.added_ssts == rhs.added_ssts &&
+         lhs.deleted_ssts == rhs.deleted_ssts &&
+         lhs.live_sizes == rhs.live_sizes;
+}
+
+void LiveSizeCheckpoint::AddSST(uint64_t sst_number) {
+  num_ssts++;
+  max_sst_number = std::max(max_sst_number, sst_number);
+  sst_digest += MixSSTNumber(sst_number);
+}
+
+void LiveSizeCheckpoint::DeleteSST(uint64_t sst_number) {
+  num_ssts--;
+  sst_digest -= MixSSTNumber(sst_number);
+}
+
+void LiveSizeCheckpoint::Apply(const LiveSizeDelta& delta) {
+  for (uint64_t sst_number : delta.added_ssts) {
+    AddSST(sst_number);
+  }
+  for (uint64_t sst_number : delta.deleted_ssts) {
+    DeleteSST(sst_number);
+  }
+  for (auto& file : delta.live_sizes) {
+    // Deltas of SSTs can be applied out of order, e.g. a compaction deleting
+    // an SST before the flush adding it, so sizes may wrap below zero in
+    // between. They're summed modulo 2^64 and are right once all SSTs of the
+    // set are applied.
+    uint64_t& live_size = live_sizes[file.first];
+    live_size += static_cast<uint64_t>(file.second);
+    if (live_size == 0) {
+      live_sizes.erase(file.first);
+    }
+  }
+}
+
+void LiveSizeCheckpoint::EncodeTo(std::string* dst) const {
+  PutVarint64Varint64(dst, num_ssts, max_sst_number);
+  PutFixed64(dst, sst_digest);
+  PutVarint32(dst, static_cast<uint32_t>(live_sizes.size()));
+  for (auto& file : live_sizes) {
+    PutVarint64Varint64(dst, file.first, file.second);
+  }
+}
+
+Status LiveSizeCheckpoint::DecodeFrom(Slice* src) {
+  uint32_t num_files = 0;
+  if (!GetVarint64(src, &num_ssts) || !GetVarint64(src, &max_sst_number) ||
+      !GetFixed64(src, &sst_digest) || !GetVarint32(src, &num_files)) {
+    return Status::Corruption("LiveSizeCheckpoint decode failed");
+  }
+  live_sizes.clear();
+  for (uint32_t i = 0; i < num_files; i++) {
+    uint64_t file_number, live_size;
+    if (!GetVarint64(src, &file_number) || !GetVarint64(src, &live_size)) {
+      return Status::Corruption("LiveSizeCheckpoint decode failed");
+    }
+    live_sizes[file_number] = live_size;
+  }
+  return Status::OK();
+}
+
+bool operator==(const LiveSizeCheckpoint& lhs, const LiveSizeCheckpoint& rhs) {
+  return lhs.num_ssts == rhs.num_ssts &&
+         lhs.max_sst_number == rhs.max_sst_number &&
+         lhs.sst_digest == rhs.sst_digest && lhs.live_sizes == rhs.live_sizes;
+}
+
 void BlobFileHeader::EncodeTo(std::string* dst) const {
   PutFixed32(dst, kHeaderMagicNumber);
   PutFixed32(dst, version);
 
-  if (version == BlobFileHeader::kVersion2) {
+  if (version != BlobFileHeader::kVersion1) {
     PutFixed32(dst, flags);
+    if (flags & kHasSharedDictionary) {
+      PutFixed64(dst, dict_id);
+    }
   }
 }
 
@@ -327,14 +724,21 @@ Status BlobFileHeader::DecodeFrom(Slice* src) {
         "Blob file header magic number missing or mismatched.");
   }
   if (!GetFixed32(src, &version) ||
-      (version != kVersion1 && version != kVersion2)) {
+      (version != kVersion1 && version != kVersion2 &&
+       version != kVersion3)) {
     return Status::Corruption("Blob file header version missing or invalid.");
   }
-  if (version == BlobFileHeader::kVersion2) {
+  if (version != BlobFileHeader::kVersion1) {
     // Check that no other flags are set
-    if (!GetFixed32(src, &flags) || flags & ~kHasUncompressionDictionary) {
+    if (!GetFixed32(src, &flags) ||
+        flags & ~(kHasUncompressionDictionary | kHasSharedDictionary) ||
+        ((flags & kHasUncompressionDictionary) &&
+         (flags & kHasSharedDictionary))) {
       return Status::Corruption("Blob file header flags missing or invalid.");
     }
+    if ((flags & kHasSharedDictionary) && !GetFixed64(src, &dict_id)) {
+      return Status::Corruption("Blob file header dict id missing.");
+    }
   }
   return Status::OK();
 }
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <algorithm>
+#include <map>
+#include <vector>
+
 #include "rocksdb/options.h"
 #include "rocksdb/slice.h"
 #include "rocksdb/status.h"
@@ -26,6 +30,14 @@ namespace titandb {
 //
 // For now, the only kind of meta block is an optional uncompression dictionary
 // indicated by a flag in the file header.
+//
+// Since version 3, records are packed into blocks instead, see `BlobBlock`.
+// Blocks share the same head as records:
+//
+// [blob file header]
+// [record head + block 1]
+// [record head + block 2]
+// ...
 
 // Format of blob head (9 bytes):
 //
@@ -115,6 +127,9 @@ class BlobDecoder {
 
   Status DecodeHeader(Slice* src);
   Status DecodeRecord(Slice* src, BlobRecord* record, OwnedSlice* buffer);
+  // Decodes the payload following the header, uncompressing it into `buffer`
+  // if needed. `*output` points to either `src` or `buffer`.
+  Status DecodeSlice(Slice* src, Slice* output, OwnedSlice* buffer);
 
   void SetUncompressionDict(const UncompressionDict* uncompression_dict) {
     uncompression_dict_ = uncompression_dict;
@@ -130,6 +145,81 @@ class BlobDecoder {
   const UncompressionDict* uncompression_dict_;
 };
 
+// Format of blob block (not fixed size), before compression:
+//
+//    +----------+-----+----------+----------+-----+----------+-------------+
+//    | record 1 | ... | record N | offset 1 | ... | offset N | num records |
+//    +----------+-----+----------+----------+-----+----------+-------------+
+//    |          |     |          | Fixed32  |     | Fixed32  |   Fixed32   |
+//    +----------+-----+----------+----------+-----+----------+-------------+
+//
+// Consecutive records are packed into blocks in blob files of version 3, so
+// that small records are compressed together and read with one I/O. A record
+// in the block is addressed by its slot, i.e. its index in the block.
+class BlobBlockBuilder {
+ public:
+  // Appends an encoded blob record.
+  void Add(const Slice& record);
+
+  // Appends the trailer and returns the block contents, which is valid until
+  // `Reset()` is called.
+  Slice Finish();
+
+  void Reset();
+
+  bool empty() const { return offsets_.empty(); }
+  uint32_t NumRecords() const { return static_cast<uint32_t>(offsets_.size()); }
+  // Size of the records added so far, excluding the trailer.
+  uint64_t RawSize() const { return raw_size_; }
+  uint64_t RecordRawSize(uint32_t slot) const;
+
+ private:
+  std::string buffer_;
+  std::vector<uint32_t> offsets_;
+  uint64_t raw_size_{0};
+  bool finished_{false};
+};
+
+class BlobBlock {
+ public:
+  // Parses block contents, which must outlive the block.
+  Status DecodeFrom(const Slice& contents);
+
+  uint32_t NumRecords() const { return num_records_; }
+  uint64_t RecordRawSize(uint32_t slot) const;
+  Status GetRecord(uint32_t slot, BlobRecord* record) const;
+
+  // Splits the on-disk size of a block to its records proportionally to their
+  // raw sizes, so that live data accounting of blob files keeps working on
+  // records. The last record takes the remainder.
+  template <typename T>
+  static void SplitBlockSize(const T& block, uint64_t block_size,
+                             std::vector<uint64_t>* sizes) {
+    uint32_t n = block.NumRecords();
+    uint64_t raw_size = 0;
+    for (uint32_t i = 0; i < n; i++) {
+      raw_size += block.RecordRawSize(i);
+    }
+    sizes->resize(n);
+    uint64_t allocated = 0;
+    for (uint32_t i = 0; i + 1 < n; i++) {
+      (*sizes)[i] = raw_size == 0 ? 0
+                                  : static_cast<uint64_t>(
+                                        static_cast<double>(block_size) *
+                                        block.RecordRawSize(i) / raw_size);
+      allocated += (*sizes)[i];
+    }
+    if (n > 0) {
+      (*sizes)[n - 1] = block_size - std::min(block_size, allocated);
+    }
+  }
+
+ private:
+  Slice contents_;
+  const char* offsets_{nullptr};
+  uint32_t num_records_{0};
+};
+
 // Format of blob handle (not fixed size):
 //
 //    +----------+----------+
@@ -138,9 +228,22 @@ class BlobDecoder {
 //    | Varint64 | Varint64 |
 //    +----------+----------+
 //
+// For a record packed in a block, `offset` is the offset of the block, `size`
+// is the share of the block taken by the record, and `block_size` and `slot`
+// locate the record in the block.
 struct BlobHandle {
   uint64_t offset{0};
   uint64_t size{0};
+  uint64_t block_size{0};
+  uint32_t slot{0};
+
+  bool packed() const { return block_size > 0; }
+  // Size to read from the blob file.
+  uint64_t read_size() const { return packed() ? block_size : size; }
+  // Identifies the record within its blob file. Records packed in a block
+  // share the offset of the block, but a block holds fewer records than
+  // bytes, so offset plus slot never collides with the next block.
+  uint64_t record_id() const { return offset + slot; }
 
   void EncodeTo(std::string* dst) const;
   Status DecodeFrom(Slice* src);
@@ -148,6 +251,54 @@ struct BlobHandle {
   friend bool operator==(const BlobHandle& lhs, const BlobHandle& rhs);
 };
 
+// Format of blob record set (not fixed size):
+//
+//    +-------------+--------------+----------+------------+----------+
+//    | num records | offset delta |   size   | block size |   slot   |
+//    +-------------+--------------+----------+------------+----------+
+//    |  Varint64   |   Varint64   | Varint64 |  Varint64  | Varint32 |
+//    +-------------+--------------+----------+------------+----------+
+//                  |<------------- repeated num records ------------>|
+//
+// Records of a blob file identified by their handles, sorted by record id.
+// Offsets are delta encoded, and the slot is only present for packed records,
+// so a record takes a few bytes. Records are added in batches, which are
+// merged into the encoded ones once they make up a fair share of the set.
+class BlobRecordSet {
+ public:
+  // Adds records in any order. Records in the set already are ignored.
+  void Add(const std::vector<BlobHandle>& records);
+
+  // Number of records, which may count records added twice until merged.
+  uint64_t size() const { return num_encoded_ + pending_.size(); }
+  bool empty() const { return size() == 0; }
+  // Total size of the records, see `BlobHandle::size`. Records added twice
+  // are counted twice until merged, like in `size()`.
+  uint64_t total_size() const { return encoded_size_ + pending_size_; }
+
+  // Returns the records sorted by record id.
+  std::vector<BlobHandle> Records() const;
+
+  void EncodeTo(std::string* dst) const;
+  Status DecodeFrom(Slice* src);
+
+  // Encodes records in the format above, sorting them by record id and
+  // dropping duplicates first.
+  static void EncodeRecords(std::vector<BlobHandle>* records,
+                            std::string* dst);
+  // Appends the decoded records to `records`.
+  static bool DecodeRecords(Slice* src, std::vector<BlobHandle>* records);
+
+  friend bool operator==(const BlobRecordSet& lhs, const BlobRecordSet& rhs);
+
+ private:
+  std::string encoded_;
+  uint64_t num_encoded_{0};
+  uint64_t encoded_size_{0};
+  std::vector<BlobHandle> pending_;
+  uint64_t pending_size_{0};
+};
+
 // Format of blob index (not fixed size):
 //
 //    +------+-------------+------------------------------------+
@@ -156,11 +307,15 @@ struct BlobHandle {
 //    | char |  Varint64   | Varint64(offsest) + Varint64(size) |
 //    +------+-------------+------------------------------------+
 //
+// For records packed in blocks, the type is `kPackedBlobRecord` and the blob
+// handle is followed by Varint64(block size) + Varint32(slot).
+//
 // It is stored in LSM-Tree as the value of key, then Titan can use this blob
 // index to locate actual value from blob file.
 struct BlobIndex {
   enum Type : unsigned char {
     kBlobRecord = 1,
+    kPackedBlobRecord = 2,
   };
   uint64_t file_number{0};
   BlobHandle blob_handle;
@@ -175,9 +330,19 @@ struct BlobIndex {
   bool operator==(const BlobIndex& rhs) const;
 };
 
+// Format of merge blob index (not fixed size):
+//
+//    +------------+--------------------+--------------------+-------------+
+//    | blob index | source file number | source file offset | source slot |
+//    +------------+--------------------+--------------------+-------------+
+//    |            |      Varint64      |      Varint64      |  Varint32   |
+//    +------------+--------------------+--------------------+-------------+
+//
+// The source slot is only present if it is non-zero.
 struct MergeBlobIndex : public BlobIndex {
   uint64_t source_file_number{0};
   uint64_t source_file_offset{0};
+  uint32_t source_slot{0};
 
   void EncodeTo(std::string* dst) const;
   void EncodeToBase(std::string* dst) const;
@@ -187,6 +352,9 @@ struct MergeBlobIndex : public BlobIndex {
   bool operator==(const MergeBlobIndex& rhs) const;
 };
 
+// Byte ranges of a blob file, as pairs of offset and size.
+using BlobFileRanges = std::vector<std::pair<uint64_t, uint64_t>>;
+
 // Format of blob file meta (not fixed size):
 //
 //    +-------------+-----------+--------------+------------+
@@ -284,12 +452,62 @@ class BlobFileMeta {
       return 0;
     }
     // TODO: Exclude meta blocks from file size
-    return 1 - (static_cast<double>(live_data_size_) /
-                (file_size_ - kBlobMaxHeaderSize - kBlobFooterSize));
+    uint64_t data_size = file_size_ - kBlobMaxHeaderSize - kBlobFooterSize;
+    data_size -= std::min(data_size, punched_size_);
+    if (data_size == 0) {
+      return 1;
+    }
+    return 1 - (static_cast<double>(live_data_size_) / data_size);
   }
   TitanInternalStats::StatsType GetDiscardableRatioLevel() const;
   void Dump(bool with_keys) const;
 
+  // Creation time of the file in seconds since epoch, 0 if unknown.
+  uint64_t creation_time() const { return creation_time_; }
+  void set_creation_time(uint64_t time) { creation_time_ = time; }
+  // Records that `bytes` of live data were discarded at `now` (in seconds).
+  void RecordDiscard(uint64_t bytes, uint64_t now);
+  // Returns the recent rate of live data being discarded at `now`, in bytes
+  // per second. Older discards weigh exponentially less.
+  double DiscardRate(uint64_t now) const;
+
+  // Whether all records dropped from the LSM since the file was created are
+  // in `dead_records()`, see `track_blob_record_deletions`.
+  bool deletion_tracked() const { return deletion_tracked_; }
+  void set_deletion_tracked(bool tracked) { deletion_tracked_ = tracked; }
+  // Records dropped from the LSM.
+  const BlobRecordSet& dead_records() const { return dead_records_; }
+  void AddDeadRecords(const std::vector<BlobHandle>& records) {
+    dead_records_.Add(records);
+  }
+  // Total size of dead records when holes were last searched for.
+  uint64_t punch_checked_size() const { return punch_checked_size_; }
+  void set_punch_checked_size(uint64_t size) { punch_checked_size_ = size; }
+
+  // Ranges of dead records punched out of the file, sorted by offset. They
+  // read as zeros and must be skipped when iterating the file.
+  const BlobFileRanges& punched_holes() const { return punched_holes_; }
+  uint64_t punched_size() const { return punched_size_; }
+  // Size of the file excluding punched holes.
+  uint64_t allocated_size() const {
+    return file_size_ - std::min(file_size_, punched_size_);
+  }
+  void AddPunchedHoles(const BlobFileRanges& holes);
+
+  // Whether SSTs referencing the file were marked for compaction already.
+  bool compaction_hinted() const { return compaction_hinted_; }
+  void set_compaction_hinted(bool hinted) { compaction_hinted_ = hinted; }
+
+  // Position of the first record not yet moved or dropped by an interrupted
+  // GC job, which the next GC job of the file resumes from. For records
+  // packed in blocks, it is the offset of the block and the slot in it.
+  uint64_t gc_resume_offset() const { return gc_resume_offset_; }
+  uint32_t gc_resume_slot() const { return gc_resume_slot_; }
+  void SetGCResumePosition(uint64_t offset, uint32_t slot) {
+    gc_resume_offset_ = offset;
+    gc_resume_slot_ = slot;
+  }
+
  private:
   // Persistent field
 
@@ -317,6 +535,97 @@ class BlobFileMeta {
   // `OnCompactionCompleted()` is called.
   std::atomic<uint64_t> live_data_size_{0};
   std::atomic<FileState> state_{FileState::kInit};
+
+  // Below are only used by the cost-benefit GC picker, and are protected by
+  // the DB mutex. The creation time is persisted by separate version edits,
+  // the discard rate is rebuilt from scratch after restart.
+  uint64_t creation_time_{0};
+  double discard_rate_{0};
+  uint64_t discard_rate_time_{0};
+
+  // Dead records of files created with `track_blob_record_deletions`, also
+  // protected by the DB mutex. Persisted by separate version edits, like the
+  // fields below.
+  bool deletion_tracked_{false};
+  BlobRecordSet dead_records_;
+  uint64_t punch_checked_size_{0};
+
+  // Whether SSTs referencing the file were marked for compaction, see
+  // `compaction_hint_discardable_ratio`. Protected by the DB mutex.
+  bool compaction_hinted_{false};
+
+  // Persisted by separate version edits rather than the meta itself.
+  BlobFileRanges punched_holes_;
+  uint64_t punched_size_{0};
+  uint64_t gc_resume_offset_{0};
+  uint32_t gc_resume_slot_{0};
+};
+
+// Format of live size delta (not fixed size):
+//
+//    +-----------+--------------+-------------+--------------+-----------+
+//    | num added |  added SSTs  | num deleted | deleted SSTs | num files |
+//    +-----------+--------------+-------------+--------------+-----------+
+//    | Varint32  | Varint64 * N |  Varint32   | Varint64 * N | Varint32  |
+//    +-----------+--------------+-------------+--------------+-----------+
+//    +--------------------+
+//    | files, size deltas |
+//    +--------------------+
+//    |  Varint64 * 2 * N  |
+//    +--------------------+
+//
+// SSTs added and deleted by a flush or compaction, and the changes of live
+// data sizes of blob files summed from their table properties. Negative
+// changes are encoded in two's complement.
+struct LiveSizeDelta {
+  std::vector<uint64_t> added_ssts;
+  std::vector<uint64_t> deleted_ssts;
+  // blob file number -> live data size change
+  std::map<uint64_t, int64_t> live_sizes;
+
+  void EncodeTo(std::string* dst) const;
+  Status DecodeFrom(Slice* src);
+
+  friend bool operator==(const LiveSizeDelta& lhs, const LiveSizeDelta& rhs);
+};
+
+// Format of live size checkpoint (not fixed size):
+//
+//    +----------+------------+------------+-----------+------------------+
+//    | num SSTs | max number | SST digest | num files | files, live sizes |
+//    +----------+------------+------------+-----------+------------------+
+//    | Varint64 |  Varint64  |  Fixed64   | Varint32  | Varint64 * 2 * N |
+//    +----------+------------+------------+-----------+------------------+
+//
+// Live data sizes of the blob files of a column family, summed from the table
+// properties of a set of SSTs, so that they needn't be read again when the DB
+// is opened. The SSTs are identified by their count, largest file number and
+// a digest of their file numbers. Since SST file numbers are never reused,
+// the checkpoint is valid for the SSTs of a later version as long as those
+// numbered up to `max_sst_number` are exactly the ones identified here.
+//
+// The checkpoint follows flushes and compactions by `LiveSizeDelta`s.
+// `max_sst_number` is the largest number ever added, which still bounds the
+// SSTs to check since deleted numbers don't come back.
+struct LiveSizeCheckpoint {
+  uint64_t num_ssts{0};
+  uint64_t max_sst_number{0};
+  uint64_t sst_digest{0};
+  // blob file number -> live data size
+  std::map<uint64_t, uint64_t> live_sizes;
+
+  // Adds an SST to the identified set.
+  void AddSST(uint64_t sst_number);
+  // Deletes an SST from the identified set.
+  void DeleteSST(uint64_t sst_number);
+  // Applies the SSTs and live data sizes changed by a flush or compaction.
+  void Apply(const LiveSizeDelta& delta);
+
+  void EncodeTo(std::string* dst) const;
+  Status DecodeFrom(Slice* src);
+
+  friend bool operator==(const LiveSizeCheckpoint& lhs,
+                         const LiveSizeCheckpoint& rhs);
 };
 
 // Format of blob file header for version 1 (8 bytes):
@@ -327,7 +636,7 @@ class BlobFileMeta {
 //    |   Fixed32    | Fixed32 |
 //    +--------------+---------+
 //
-// For version 2, there are another 4 bytes for flags:
+// For version 2 and 3, there are another 4 bytes for flags:
 //
 //    +--------------+---------+---------+
 //    | magic number | version |  flags  |
@@ -335,6 +644,15 @@ class BlobFileMeta {
 //    |   Fixed32    | Fixed32 | Fixed32 |
 //    +--------------+---------+---------+
 //
+// If `kHasSharedDictionary` is set in flags, it is followed by the id of the
+// column family level compression dictionary the file is compressed with:
+//
+//    +--------------+---------+---------+---------+
+//    | magic number | version |  flags  | dict id |
+//    +--------------+---------+---------+---------+
+//    |   Fixed32    | Fixed32 | Fixed32 | Fixed64 |
+//    +--------------+---------+---------+---------+
+//
 // The header is mean to be compatible with header of BlobDB blob files, except
 // we use a different magic number.
 struct BlobFileHeader {
@@ -342,20 +660,26 @@ struct BlobFileHeader {
   static const uint32_t kHeaderMagicNumber = 0x2be0a614ul;
   static const uint32_t kVersion1 = 1;
   static const uint32_t kVersion2 = 2;
+  // Records are packed into blocks.
+  static const uint32_t kVersion3 = 3;
 
   static const uint64_t kMinEncodedLength = 4 + 4;
-  static const uint64_t kMaxEncodedLength = 4 + 4 + 4;
+  static const uint64_t kMaxEncodedLength = 4 + 4 + 4 + 8;
 
   // Flags:
   static const uint32_t kHasUncompressionDictionary = 1 << 0;
+  static const uint32_t kHasSharedDictionary = 1 << 1;
 
   uint32_t version = kVersion2;
   uint32_t flags = 0;
+  uint64_t dict_id = 0;
 
   uint64_t size() const {
-    return version == BlobFileHeader::kVersion1
-               ? BlobFileHeader::kMinEncodedLength
-               : BlobFileHeader::kMaxEncodedLength;
+    if (version == BlobFileHeader::kVersion1) {
+      return BlobFileHeader::kMinEncodedLength;
+    }
+    return BlobFileHeader::kMinEncodedLength + 4 +
+           ((flags & kHasSharedDictionary) ? 8 : 0);
   }
 
   void EncodeTo(std::string* dst) const;
@@ -3,6 +3,7 @@
 #include "test_util/testharness.h"
 #include "testutil.h"
 #include "util.h"
+#include "util/string_util.h"
 
 namespace rocksdb {
 namespace titandb {
@@ -34,6 +35,107 @@ TEST(BlobFormatTest, BlobIndex) {
   CheckCodec(input);
 }
 
+TEST(BlobFormatTest, PackedBlobIndex) {
+  BlobIndex input;
+  input.file_number = 1;
+  input.blob_handle.offset = 2;
+  input.blob_handle.size = 3;
+  input.blob_handle.block_size = 4;
+  input.blob_handle.slot = 5;
+  CheckCodec(input);
+
+  MergeBlobIndex merge_input;
+  merge_input.file_number = 1;
+  merge_input.blob_handle = input.blob_handle;
+  merge_input.source_file_number = 6;
+  merge_input.source_file_offset = 7;
+  CheckCodec(merge_input);
+  merge_input.source_slot = 8;
+  CheckCodec(merge_input);
+}
+
+TEST(BlobFormatTest, BlobRecordSet) {
+  BlobRecordSet input;
+  CheckCodec(input);
+  // Plain records at 0, 100, ..., and blocks of 4 packed records in between.
+  std::vector<BlobHandle> expected;
+  for (uint64_t i = 0; i < 100; i++) {
+    BlobHandle handle;
+    handle.offset = i * 100;
+    handle.size = 10 + i;
+    expected.push_back(handle);
+    for (uint32_t slot = 0; slot < 4; slot++) {
+      handle.offset = i * 100 + 50;
+      handle.size = 5;
+      handle.block_size = 20;
+      handle.slot = slot;
+      expected.push_back(handle);
+    }
+  }
+  // Added backwards in small batches, with every batch added twice.
+  for (size_t end = expected.size(); end > 0; end -= 5) {
+    std::vector<BlobHandle> batch(expected.begin() + end - 5,
+                                  expected.begin() + end);
+    input.Add(batch);
+    input.Add(batch);
+    CheckCodec(input);
+  }
+  ASSERT_EQ(input.Records(), expected);
+  std::string encoded;
+  input.EncodeTo(&encoded);
+  // A few bytes per record.
+  ASSERT_LT(encoded.size(), expected.size() * 6);
+  BlobRecordSet output;
+  ASSERT_OK(DecodeInto(encoded, &output));
+  // 100 plain records of 10 to 109 bytes, and 100 blocks of 20 bytes.
+  ASSERT_EQ(output.total_size(), 5950 + 2000);
+}
+
+TEST(BlobFormatTest, BlobBlock) {
+  const int n = 10;
+  BlobBlockBuilder builder;
+  ASSERT_TRUE(builder.empty());
+  for (int i = 0; i < n; i++) {
+    BlobRecord record;
+    std::string key = "k" + ToString(i);
+    std::string value(i * 10, 'v');
+    record.key = key;
+    record.value = value;
+    std::string encoded;
+    record.EncodeTo(&encoded);
+    builder.Add(encoded);
+  }
+  ASSERT_EQ(builder.NumRecords(), n);
+  Slice contents = builder.Finish();
+
+  BlobBlock block;
+  ASSERT_OK(block.DecodeFrom(contents));
+  ASSERT_EQ(block.NumRecords(), n);
+  for (int i = 0; i < n; i++) {
+    BlobRecord record;
+    ASSERT_OK(block.GetRecord(i, &record));
+    ASSERT_EQ(record.key, "k" + ToString(i));
+    ASSERT_EQ(record.value, std::string(i * 10, 'v'));
+    ASSERT_EQ(block.RecordRawSize(i), builder.RecordRawSize(i));
+  }
+  BlobRecord record;
+  ASSERT_TRUE(block.GetRecord(n, &record).IsCorruption());
+
+  std::vector<uint64_t> sizes;
+  BlobBlock::SplitBlockSize(block, 1000, &sizes);
+  ASSERT_EQ(sizes.size(), n);
+  uint64_t total = 0;
+  for (int i = 0; i < n; i++) {
+    total += sizes[i];
+    if (i > 0) {
+      ASSERT_GE(sizes[i], sizes[i - 1]);
+    }
+  }
+  ASSERT_EQ(total, 1000);
+
+  ASSERT_TRUE(block.DecodeFrom(Slice("abc")).IsCorruption());
+}
+
 TEST(BlobFormatTest, BlobFileMeta) {
   BlobFileMeta input(2, 3, 0, 0, "0", "9");
   CheckCodec(input);
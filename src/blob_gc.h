@@ -2,6 +2,7 @@
 
 #include <memory>
 
+#include "blob_compression_dicts.h"
 #include "blob_format.h"
 #include "db/column_family.h"
 #include "titan/options.h"
@@ -29,6 +30,14 @@ class BlobGC {
 
   ColumnFamilyHandle* column_family_handle() { return cfh_; }
 
+  void SetCompressionDicts(std::shared_ptr<BlobCompressionDicts> dicts) {
+    compression_dicts_ = std::move(dicts);
+  }
+
+  const BlobCompressionDicts* compression_dicts() const {
+    return compression_dicts_.get();
+  }
+
   ColumnFamilyData* GetColumnFamilyData();
 
   void MarkFilesBeingGC();
@@ -44,6 +53,7 @@ class BlobGC {
   std::vector<BlobFileMeta*> outputs_;
   TitanCFOptions titan_cf_options_;
   ColumnFamilyHandle* cfh_{nullptr};
+  std::shared_ptr<BlobCompressionDicts> compression_dicts_;
   // Whether need to trigger gc after this gc or not
   const bool trigger_next_;
 };
@@ -53,5 +63,14 @@ struct GCScore {
   double score;
 };
 
+// Sizes of a blob file which may be picked by GC, as they were when the
+// candidates were taken.
+struct GCCandidate {
+  uint64_t file_number = 0;
+  uint64_t file_size = 0;
+  uint64_t live_data_size = 0;
+  double discardable_ratio = 0;
+};
+
 }  // namespace titandb
 }  // namespace rocksdb
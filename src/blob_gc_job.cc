@@ -5,13 +5,41 @@
 
 #include <inttypes.h>
 
+#include <algorithm>
+#include <functional>
 #include <memory>
 
 #include "blob_file_size_collector.h"
+#include "table/multiget_context.h"
+#include "util/autovector.h"
 
 namespace rocksdb {
 namespace titandb {
 
+namespace {
+
+// Roughly how many LSM keys a merge-join can step over for the cost of one
+// point lookup. The same value bounds the number of Next() calls before the
+// LSM iterator seeks to the next GC key directly.
+const uint64_t kMergeJoinStepsPerLookup = 8;
+
+// Max number of `gc_readahead_size` chunks a GC job prefetches at the same
+// time over all its input files.
+const uint64_t kMaxReadaheadChunksPerJob = 16;
+
+// Sub jobs of a GC job submitted to the GC thread pool. Shared with the
+// submitted closures, which may run after the job is done.
+struct SubJobsState {
+  port::Mutex mutex;
+  port::CondVar cv{&mutex};
+  // Whether each sub job is taken by a thread.
+  std::vector<bool> claimed;
+  // Number of sub jobs running in the pool.
+  size_t num_running = 0;
+};
+
+}  // namespace
+
 // Write callback for garbage collection to check if key has been updated
 // since last read. Similar to how OptimisticTransaction works.
 class BlobGCJob::GarbageCollectionWriteCallback : public WriteCallback {
@@ -34,7 +62,7 @@ class BlobGCJob::GarbageCollectionWriteCallback : public WriteCallback {
     if (!s.ok() && !s.IsNotFound()) {
       return s;
     }
-    read_bytes_ = key_.size() + index_entry.size();
+    read_bytes_ += key_.size() + index_entry.size();
     if (s.IsNotFound()) {
       // Either the key is deleted or updated with a newer version which is
       // inlined in LSM.
@@ -71,7 +99,44 @@ class BlobGCJob::GarbageCollectionWriteCallback : public WriteCallback {
   // Key to check
   std::string key_;
   BlobIndex blob_index_;
-  uint64_t read_bytes_;
+  uint64_t read_bytes_{0};
+};
+
+// Write callback for rewriting multiple keys in one write batch. Each key is
+// checked by its own GarbageCollectionWriteCallback. If any of them have been
+// updated, the callback fails the write and records them in `conflicts`, so
+// that the write can be retried without them.
+class BlobGCJob::GarbageCollectionBatchWriteCallback : public WriteCallback {
+ public:
+  GarbageCollectionBatchWriteCallback(
+      std::vector<GarbageCollectionWriteCallback*>&& callbacks,
+      std::vector<bool>* conflicts)
+      : callbacks_(std::move(callbacks)), conflicts_(conflicts) {
+    assert(conflicts_->size() == callbacks_.size());
+  }
+
+  virtual Status Callback(DB* db) override {
+    bool has_conflict = false;
+    for (size_t i = 0; i < callbacks_.size(); i++) {
+      if ((*conflicts_)[i]) {
+        continue;
+      }
+      Status s = callbacks_[i]->Callback(db);
+      if (s.IsBusy()) {
+        (*conflicts_)[i] = true;
+        has_conflict = true;
+      } else if (!s.ok()) {
+        return s;
+      }
+    }
+    return has_conflict ? Status::Busy("keys overwritten") : Status::OK();
+  }
+
+  virtual bool AllowWriteBatching() override { return false; }
+
+ private:
+  std::vector<GarbageCollectionWriteCallback*> callbacks_;
+  std::vector<bool>* conflicts_;
 };
 
 BlobGCJob::BlobGCJob(BlobGC* blob_gc, DB* db, port::Mutex* mutex,
@@ -80,8 +145,10 @@ BlobGCJob::BlobGCJob(BlobGC* blob_gc, DB* db, port::Mutex* mutex,
                      const EnvOptions& env_options,
                      BlobFileManager* blob_file_manager,
                      BlobFileSet* blob_file_set, LogBuffer* log_buffer,
-                     std::atomic_bool* shuting_down, TitanStats* stats)
+                     std::atomic_bool* shuting_down, TitanStats* stats,
+                     ThreadPool* thread_pool)
     : blob_gc_(blob_gc),
+      inputs_(blob_gc->inputs()),
       base_db_(db),
       base_db_impl_(reinterpret_cast<DBImpl*>(base_db_)),
       mutex_(mutex),
@@ -93,7 +160,8 @@ BlobGCJob::BlobGCJob(BlobGC* blob_gc, DB* db, port::Mutex* mutex,
       blob_file_set_(blob_file_set),
       log_buffer_(log_buffer),
       shuting_down_(shuting_down),
-      stats_(stats) {}
+      stats_(stats),
+      thread_pool_(thread_pool) {}
 
 BlobGCJob::~BlobGCJob() {
   if (log_buffer_) {
@@ -122,6 +190,24 @@ BlobGCJob::~BlobGCJob() {
 
 Status BlobGCJob::Prepare() {
   SavePrevIOBytes(&prev_bytes_read_, &prev_bytes_written_);
+  for (const auto& file : inputs_) {
+    inputs_creation_time_ =
+        std::max(inputs_creation_time_, file->creation_time());
+  }
+  if (blob_gc_->titan_cf_options().track_blob_record_deletions) {
+    std::shared_ptr<DeadRecordsMap> dead_records(new DeadRecordsMap);
+    for (const auto& file : inputs_) {
+      if (!file->deletion_tracked() && file->dead_records().empty()) {
+        continue;
+      }
+      InputDeadRecords& input = (*dead_records)[file->file_number()];
+      for (const auto& handle : file->dead_records().Records()) {
+        input.records.push_back(handle.record_id());
+      }
+      input.complete = file->deletion_tracked();
+    }
+    dead_records_ = std::move(dead_records);
+  }
   return Status::OK();
 }
 
@@ -136,9 +222,167 @@ Status BlobGCJob::Run() {
   ROCKS_LOG_BUFFER(log_buffer_, "[%s] Titan GC candidates[%s]",
                    blob_gc_->column_family_handle()->GetName().c_str(),
                    tmp.c_str());
+  if (db_options_.gc_readahead_size > 0) {
+    readahead_budget_ = std::make_shared<ReadaheadBudget>(
+        kMaxReadaheadChunksPerJob * db_options_.gc_readahead_size);
+  }
+  size_t num_subjobs =
+      std::min(static_cast<size_t>(db_options_.max_gc_subjobs), inputs_.size());
+  if (num_subjobs > 1) {
+    return RunSubJobs(num_subjobs);
+  }
   return DoRunGC();
 }
 
+// Splits input files into partitions of about the same size, each of which
+// covers a contiguous key range, and runs them as sub jobs in parallel.
+// Blob files can't be seeked by key, so partitions are made of whole files
+// and the key ranges of adjacent partitions may overlap. It is fine since
+// validity of each blob record is checked on its own, a key with versions
+// in different partitions is rewritten by at most one of them.
+Status BlobGCJob::RunSubJobs(size_t num_subjobs) {
+  const Comparator* ucmp = blob_gc_->titan_cf_options().comparator;
+  std::vector<std::shared_ptr<BlobFileMeta>> inputs = inputs_;
+  std::sort(inputs.begin(), inputs.end(),
+            [ucmp](const std::shared_ptr<BlobFileMeta>& a,
+                   const std::shared_ptr<BlobFileMeta>& b) {
+              return ucmp->Compare(a->smallest_key(), b->smallest_key()) < 0;
+            });
+  uint64_t total_size = 0;
+  for (const auto& file : inputs) {
+    total_size += file->file_size();
+  }
+
+  // Sub jobs log to their own buffers, which are flushed when the sub jobs
+  // are destroyed, so they must outlive the sub jobs.
+  std::vector<std::unique_ptr<LogBuffer>> log_buffers;
+  std::vector<std::unique_ptr<BlobGCJob>> sub_jobs;
+  uint64_t partition_size = 0;
+  for (size_t i = 0; i < inputs.size(); i++) {
+    if (sub_jobs.empty() ||
+        (sub_jobs.size() < num_subjobs &&
+         partition_size >= total_size / num_subjobs)) {
+      log_buffers.emplace_back(
+          new LogBuffer(InfoLogLevel::INFO_LEVEL, db_options_.info_log.get()));
+      sub_jobs.emplace_back(new BlobGCJob(
+          blob_gc_, base_db_, mutex_, db_options_, gc_merge_rewrite_, env_,
+          env_options_, blob_file_manager_, blob_file_set_,
+          log_buffers.back().get(), shuting_down_, stats_));
+      sub_jobs.back()->inputs_.clear();
+      sub_jobs.back()->dead_records_ = dead_records_;
+      sub_jobs.back()->inputs_creation_time_ = inputs_creation_time_;
+      sub_jobs.back()->readahead_budget_ = readahead_budget_;
+      partition_size = 0;
+    }
+    sub_jobs.back()->inputs_.push_back(inputs[i]);
+    partition_size += inputs[i]->file_size();
+  }
+  ROCKS_LOG_BUFFER(log_buffer_, "[%s] Titan GC runs in %" PRIu64 " sub jobs",
+                   blob_gc_->column_family_handle()->GetName().c_str(),
+                   static_cast<uint64_t>(sub_jobs.size()));
+
+  std::vector<Status> statuses(sub_jobs.size());
+  auto run_sub_job = [&sub_jobs, &statuses](size_t i) {
+    BlobGCJob* sub_job = sub_jobs[i].get();
+    SavePrevIOBytes(&sub_job->prev_bytes_read_, &sub_job->prev_bytes_written_);
+    statuses[i] = sub_job->DoRunGC();
+    UpdateIOBytes(sub_job->prev_bytes_read_, sub_job->prev_bytes_written_,
+                  &sub_job->io_bytes_read_, &sub_job->io_bytes_written_);
+  };
+  // All sub jobs but the first one are submitted to the GC thread pool, not
+  // the low priority pool of env, where the blocking rewrites could hold the
+  // compaction threads needed to lift a write stall. The first one runs in
+  // the current thread, which then runs the sub jobs not yet started by the
+  // pool rather than waiting for them, as it is a GC thread itself.
+  auto state = std::make_shared<SubJobsState>();
+  state->claimed.resize(sub_jobs.size(), false);
+  state->claimed[0] = true;
+  if (thread_pool_ != nullptr) {
+    for (size_t i = 1; i < sub_jobs.size(); i++) {
+      // `run_sub_job` refers to the stack of this function, it is called only
+      // if the sub job is claimed before this function returns.
+      thread_pool_->SubmitJob([state, run_sub_job, i]() {
+        {
+          MutexLock l(&state->mutex);
+          if (state->claimed[i]) {
+            return;
+          }
+          state->claimed[i] = true;
+          state->num_running++;
+        }
+        run_sub_job(i);
+        MutexLock l(&state->mutex);
+        if (--state->num_running == 0) {
+          state->cv.SignalAll();
+        }
+      });
+    }
+  }
+  run_sub_job(0);
+  for (size_t i = 1; i < sub_jobs.size(); i++) {
+    {
+      MutexLock l(&state->mutex);
+      if (state->claimed[i]) {
+        continue;
+      }
+      state->claimed[i] = true;
+    }
+    run_sub_job(i);
+  }
+  {
+    MutexLock l(&state->mutex);
+    while (state->num_running > 0) {
+      state->cv.Wait();
+    }
+  }
+
+  Status s;
+  for (size_t i = 0; i < sub_jobs.size(); i++) {
+    MergeSubJob(sub_jobs[i].get());
+    if (s.ok() && !statuses[i].ok()) {
+      s = statuses[i];
+    }
+  }
+  return s;
+}
+
+// Takes over outputs and pending rewrites of the sub job, so that they are
+// installed by Finish() of this job, as if they were produced by itself.
+void BlobGCJob::MergeSubJob(BlobGCJob* sub_job) {
+  std::move(sub_job->blob_file_builders_.begin(),
+            sub_job->blob_file_builders_.end(),
+            std::back_inserter(blob_file_builders_));
+  sub_job->blob_file_builders_.clear();
+  std::move(sub_job->rewrite_batches_.begin(),
+            sub_job->rewrite_batches_.end(),
+            std::back_inserter(rewrite_batches_));
+  sub_job->rewrite_batches_.clear();
+  std::move(sub_job->rewrite_batches_without_callback_.begin(),
+            sub_job->rewrite_batches_without_callback_.end(),
+            std::back_inserter(rewrite_batches_without_callback_));
+  sub_job->rewrite_batches_without_callback_.clear();
+
+  const auto& m = sub_job->metrics_;
+  metrics_.gc_bytes_read += m.gc_bytes_read;
+  metrics_.gc_bytes_written += m.gc_bytes_written;
+  metrics_.gc_num_keys_overwritten += m.gc_num_keys_overwritten;
+  metrics_.gc_bytes_overwritten += m.gc_bytes_overwritten;
+  metrics_.gc_num_keys_relocated += m.gc_num_keys_relocated;
+  metrics_.gc_bytes_relocated += m.gc_bytes_relocated;
+  metrics_.gc_num_new_files += m.gc_num_new_files;
+  metrics_.gc_num_files += m.gc_num_files;
+  metrics_.gc_small_file += m.gc_small_file;
+  metrics_.gc_discardable += m.gc_discardable;
+  metrics_.gc_sample += m.gc_sample;
+  metrics_.gc_sampling_micros += m.gc_sampling_micros;
+  metrics_.gc_read_lsm_micros += m.gc_read_lsm_micros;
+  metrics_.gc_update_lsm_micros += m.gc_update_lsm_micros;
+  // Metrics are recorded by this job from now on.
+  sub_job->metrics_ = {};
+  io_bytes_read_ += sub_job->io_bytes_read_;
+  io_bytes_written_ += sub_job->io_bytes_written_;
+}
+
 Status BlobGCJob::DoRunGC() {
   Status s;
 
@@ -158,6 +402,13 @@ Status BlobGCJob::DoRunGC() {
   std::unique_ptr<BlobFileHandle> blob_file_handle;
   std::unique_ptr<BlobFileBuilder> blob_file_builder;
 
+  // Values rewritten by GC have survived at least one GC round, recompress
+  // them with the GC compression.
+  TitanCFOptions gc_cf_options = blob_gc_->titan_cf_options();
+  gc_cf_options.blob_file_compression = gc_cf_options.GCBlobFileCompression();
+  gc_cf_options.blob_file_compression_options.level =
+      gc_cf_options.GCBlobFileCompressionLevel();
+
   //  uint64_t drop_entry_num = 0;
   //  uint64_t drop_entry_size = 0;
   //  uint64_t total_entry_num = 0;
@@ -167,38 +418,95 @@ Status BlobGCJob::DoRunGC() {
 
   std::string last_key;
   bool last_key_valid = false;
+  // Records are read ahead from input files in batches, so that their
+  // validity can be checked against the LSM with one MultiGet.
+  const size_t batch_size = static_cast<size_t>(
+      std::max<uint64_t>(blob_gc_->titan_cf_options().gc_lookup_batch_size, 1));
+  std::vector<GCEntry> entries;
+  size_t next_entry = 0;
+  // Outputs are split when GC moves on to the next disjoint key range of its
+  // inputs.
+  std::vector<std::string> range_limits;
+  if (blob_gc_->titan_cf_options().gc_key_range_clustering) {
+    GetInputKeyRangeLimits(&range_limits);
+  }
+  size_t next_range = 0;
+  const Comparator* ucmp = blob_gc_->titan_cf_options().comparator;
+  merge_join_ = UseMergeJoin();
+  ROCKS_LOG_BUFFER(log_buffer_, "[%s] Titan GC checks validity by %s",
+                   blob_gc_->column_family_handle()->GetName().c_str(),
+                   merge_join_ ? "merge-join" : "point lookups");
+  // Bytes written since GC last waited for its I/O budget.
+  uint64_t unpaid_bytes_written = 0;
   gc_iter->SeekToFirst();
   assert(gc_iter->Valid());
-  for (; gc_iter->Valid(); gc_iter->Next()) {
+  while (true) {
     if (IsShutingDown()) {
       s = Status::ShutdownInProgress();
       break;
     }
-    BlobIndex blob_index = gc_iter->GetBlobIndex();
-    // count read bytes for blob record of gc candidate files
-    metrics_.gc_bytes_read += blob_index.blob_handle.size;
+    if (next_entry == entries.size()) {
+      entries.clear();
+      next_entry = 0;
+      uint64_t bytes_read = 0;
+      for (; gc_iter->Valid() && entries.size() < batch_size;
+           gc_iter->Next()) {
+        GCEntry entry;
+        entry.key = gc_iter->key().ToString();
+        entry.blob_index = gc_iter->GetBlobIndex();
+        entry.value = gc_iter->value().ToString();
+        // count read bytes for blob record of gc candidate files
+        metrics_.gc_bytes_read += entry.blob_index.blob_handle.size;
+        bytes_read += entry.blob_index.blob_handle.size;
+        entries.emplace_back(std::move(entry));
+      }
+      RequestGCBudget(unpaid_bytes_written, RateLimiter::OpType::kWrite);
+      unpaid_bytes_written = 0;
+      if (entries.empty()) {
+        break;
+      }
+      RequestGCBudget(bytes_read, RateLimiter::OpType::kRead);
+      s = CheckEntries(&entries);
+      if (!s.ok()) {
+        break;
+      }
+    }
+    const GCEntry& entry = entries[next_entry++];
+    const BlobIndex& blob_index = entry.blob_index;
+    // Whatever happens to the entry is committed with the next chunk.
+    AdvanceResumePosition(blob_index);
 
-    if (!last_key.empty() && !gc_iter->key().compare(last_key)) {
+    if (!last_key.empty() && !Slice(entry.key).compare(last_key)) {
       if (last_key_valid) {
         continue;
       }
     } else {
-      last_key = gc_iter->key().ToString();
+      last_key = entry.key;
       last_key_valid = false;
     }
 
-    bool discardable = false;
-    s = DiscardEntry(gc_iter->key(), blob_index, &discardable);
-    if (!s.ok()) {
-      break;
-    }
-    if (discardable) {
+    if (entry.discardable) {
       metrics_.gc_num_keys_overwritten++;
       metrics_.gc_bytes_overwritten += blob_index.blob_handle.size;
       continue;
     }
 
-    last_key_valid = true;
+    // Versions of the key not checked against the LSM are all rewritten,
+    // the write callback keeps only the current one.
+    last_key_valid = entry.validated;
+
+    bool range_changed = false;
+    while (next_range < range_limits.size() &&
+           ucmp->Compare(entry.key, range_limits[next_range]) > 0) {
+      next_range++;
+      range_changed = true;
+    }
+    if (range_changed && blob_file_builder) {
+      assert(blob_file_handle);
+      assert(blob_file_builder->status().ok());
+      blob_file_builders_.emplace_back(std::make_pair(
+          std::move(blob_file_handle), std::move(blob_file_builder)));
+    }
 
     // Rewrite entry to new blob file
     if ((!blob_file_handle && !blob_file_builder) ||
@@ -219,19 +527,21 @@ Status BlobGCJob::DoRunGC() {
                      "Titan new GC output file %" PRIu64 ".",
                      blob_file_handle->GetNumber());
       blob_file_builder = std::unique_ptr<BlobFileBuilder>(
-          new BlobFileBuilder(db_options_, blob_gc_->titan_cf_options(),
-                              blob_file_handle->GetFile()));
+          new BlobFileBuilder(db_options_, gc_cf_options,
+                              blob_file_handle->GetFile(),
+                              blob_gc_->compression_dicts()));
       file_size = 0;
     }
     assert(blob_file_handle);
     assert(blob_file_builder);
 
     BlobRecord blob_record;
-    blob_record.key = gc_iter->key();
-    blob_record.value = gc_iter->value();
+    blob_record.key = entry.key;
+    blob_record.value = entry.value;
     // count written bytes for new blob record,
     // blob index's size is counted in `RewriteValidKeyToLSM`
     metrics_.gc_bytes_written += blob_record.size();
+    unpaid_bytes_written += blob_record.size();
 
     // BlobRecordContext require key to be an internal key. We encode key to
     // internal key in spite we only need the user key.
@@ -250,8 +560,27 @@ Status BlobGCJob::DoRunGC() {
     if (!s.ok()) {
       break;
     }
+
+    const uint64_t rewrite_buffer_limit =
+        blob_gc_->titan_cf_options().gc_rewrite_buffer_size;
+    if (rewrite_buffer_limit > 0 &&
+        rewrite_buffer_size_ >= rewrite_buffer_limit) {
+      assert(blob_file_builder->status().ok());
+      blob_file_builders_.emplace_back(std::make_pair(
+          std::move(blob_file_handle), std::move(blob_file_builder)));
+      s = InstallAndRewriteChunk();
+      if (s.ok()) {
+        s = LogResumePositions();
+      }
+      TEST_SYNC_POINT_CALLBACK("BlobGCJob::DoRunGC:AfterChunk", &s);
+      if (!s.ok()) {
+        break;
+      }
+    }
   }
 
+  lsm_iter_.reset();
+
   if (gc_iter->status().ok() && s.ok()) {
     if (blob_file_builder && blob_file_handle) {
       assert(blob_file_builder->status().ok());
@@ -278,6 +607,7 @@ void BlobGCJob::BatchWriteNewIndices(BlobFileBuilder::OutContexts& contexts,
     merge_blob_index.source_file_number = ctx->original_blob_index.file_number;
     merge_blob_index.source_file_offset =
         ctx->original_blob_index.blob_handle.offset;
+    merge_blob_index.source_slot = ctx->original_blob_index.blob_handle.slot;
     merge_blob_index.blob_handle = ctx->new_blob_index.blob_handle;
 
     std::string index_entry;
@@ -298,6 +628,9 @@ void BlobGCJob::BatchWriteNewIndices(BlobFileBuilder::OutContexts& contexts,
       auto& wb = rewrite_batches_.back().first;
       *s = WriteBatchInternal::PutBlobIndex(&wb, cfh->GetID(), ikey.user_key,
                                             index_entry);
+      // The callback keeps another copy of the key and the index.
+      rewrite_buffer_size_ +=
+          wb.GetDataSize() + ikey.user_key.size() + index_entry.size();
     } else {
       merge_blob_index.EncodeTo(&index_entry);
       rewrite_batches_without_callback_.emplace_back(
@@ -305,28 +638,87 @@ void BlobGCJob::BatchWriteNewIndices(BlobFileBuilder::OutContexts& contexts,
       auto& wb = rewrite_batches_without_callback_.back().first;
       *s = WriteBatchInternal::Merge(&wb, cfh->GetID(), ikey.user_key,
                                      index_entry);
+      rewrite_buffer_size_ += wb.GetDataSize();
     }
     if (!s->ok()) break;
   }
 }
 
+void BlobGCJob::GetInputKeyRangeLimits(
+    std::vector<std::string>* limits) const {
+  const Comparator* ucmp = blob_gc_->titan_cf_options().comparator;
+  std::vector<BlobFileMeta*> files;
+  for (const auto& file : inputs_) {
+    if (file->smallest_key().empty() || file->largest_key().empty()) {
+      // Key ranges of legacy files are unknown, so are the gaps.
+      return;
+    }
+    files.push_back(file.get());
+  }
+  std::sort(files.begin(), files.end(),
+            [ucmp](const BlobFileMeta* a, const BlobFileMeta* b) {
+              return ucmp->Compare(a->smallest_key(), b->smallest_key()) < 0;
+            });
+  // Merge overlapping key ranges and take the largest key of each merged
+  // range, except the last one.
+  const std::string* largest = nullptr;
+  for (auto* file : files) {
+    if (largest != nullptr &&
+        ucmp->Compare(file->smallest_key(), *largest) > 0) {
+      limits->push_back(*largest);
+      largest = nullptr;
+    }
+    if (largest == nullptr ||
+        ucmp->Compare(file->largest_key(), *largest) > 0) {
+      largest = &file->largest_key();
+    }
+  }
+}
+
+void BlobGCJob::RequestGCBudget(uint64_t bytes, RateLimiter::OpType op_type) {
+  RateLimiter* rate_limiter = db_options_.gc_rate_limiter.get();
+  if (rate_limiter == nullptr) {
+    return;
+  }
+  while (bytes > 0) {
+    // Requests must not exceed the burst size of the rate limiter.
+    uint64_t request = std::min(
+        bytes, static_cast<uint64_t>(
+                   std::max<int64_t>(rate_limiter->GetSingleBurstBytes(), 1)));
+    rate_limiter->Request(static_cast<int64_t>(request), Env::IO_LOW,
+                          statistics(stats_), op_type);
+    bytes -= request;
+  }
+}
+
 Status BlobGCJob::BuildIterator(
     std::unique_ptr<BlobFileMergeIterator>* result) {
   Status s;
-  const auto& inputs = blob_gc_->inputs();
+  const auto& inputs = inputs_;
   assert(!inputs.empty());
   std::vector<std::unique_ptr<BlobFileIterator>> list;
   for (std::size_t i = 0; i < inputs.size(); ++i) {
     std::unique_ptr<RandomAccessFileReader> file;
-    // TODO(@DorianZheng) set read ahead size
-    s = NewBlobFileReader(inputs[i]->file_number(), 0, db_options_,
-                          env_options_, env_, &file);
+    s = NewGCBlobFileReader(inputs[i]->file_number(), db_options_,
+                            env_options_, env_, &file, readahead_budget_);
     if (!s.ok()) {
       break;
     }
     list.emplace_back(std::unique_ptr<BlobFileIterator>(new BlobFileIterator(
         std::move(file), inputs[i]->file_number(), inputs[i]->file_size(),
-        blob_gc_->titan_cf_options())));
+        blob_gc_->titan_cf_options(), blob_gc_->compression_dicts())));
+    list.back()->SetSequentialReadahead(db_options_.gc_readahead_size);
+    // Holes are not punched in files being GC, so no lock is needed.
+    list.back()->SetPunchedHoles(inputs[i]->punched_holes());
+    if (inputs[i]->gc_resume_offset() > 0) {
+      ROCKS_LOG_INFO(db_options_.info_log,
+                     "Titan GC resumes blob file %" PRIu64
+                     " from offset %" PRIu64 " slot %" PRIu32 ".",
+                     inputs[i]->file_number(), inputs[i]->gc_resume_offset(),
+                     inputs[i]->gc_resume_slot());
+      list.back()->SetStartPosition(inputs[i]->gc_resume_offset(),
+                                    inputs[i]->gc_resume_slot());
+    }
   }
 
   if (s.ok())
@@ -338,7 +730,6 @@ Status BlobGCJob::BuildIterator(
 
 Status BlobGCJob::DiscardEntry(const Slice& key, const BlobIndex& blob_index,
                                bool* discardable) {
-  TitanStopWatch sw(env_, metrics_.gc_read_lsm_micros);
   assert(discardable != nullptr);
   PinnableSlice index_entry;
   bool is_blob_index = false;
@@ -367,6 +758,235 @@ Status BlobGCJob::DiscardEntry(const Slice& key, const BlobIndex& blob_index,
   return Status::OK();
 }
 
+Status BlobGCJob::CheckEntries(std::vector<GCEntry>* entries) {
+  if (dead_records_ == nullptr) {
+    return DiscardEntries(entries);
+  }
+  // Entries which have to be checked against the LSM.
+  std::vector<size_t> unknown;
+  for (size_t i = 0; i < entries->size(); i++) {
+    GCEntry& entry = (*entries)[i];
+    auto iter = dead_records_->find(entry.blob_index.file_number);
+    if (iter == dead_records_->end()) {
+      unknown.push_back(i);
+      continue;
+    }
+    const auto& records = iter->second.records;
+    entry.discardable =
+        std::binary_search(records.begin(), records.end(),
+                           entry.blob_index.blob_handle.record_id());
+    // Without the write callback nothing stops GC from rewriting an
+    // overwritten key, so live looking records still need a check.
+    if (!entry.discardable) {
+      if (!iter->second.complete || gc_merge_rewrite_) {
+        unknown.push_back(i);
+      } else {
+        entry.validated = false;
+      }
+    }
+  }
+  if (unknown.empty()) {
+    return Status::OK();
+  }
+  if (unknown.size() == entries->size()) {
+    return DiscardEntries(entries);
+  }
+  std::vector<GCEntry> lookups;
+  lookups.reserve(unknown.size());
+  for (size_t i : unknown) {
+    lookups.emplace_back(std::move((*entries)[i]));
+  }
+  Status s = DiscardEntries(&lookups);
+  for (size_t i = 0; i < unknown.size(); i++) {
+    (*entries)[unknown[i]] = std::move(lookups[i]);
+  }
+  return s;
+}
+
+Status BlobGCJob::DiscardEntries(std::vector<GCEntry>* entries) {
+  if (merge_join_) {
+    return DiscardEntriesByIterator(entries);
+  }
+  TitanStopWatch sw(env_, metrics_.gc_read_lsm_micros);
+  if (entries->size() == 1 || gc_merge_rewrite_) {
+    // MultiGet reports whether values are blob indexes through one flag for
+    // the whole batch. An inlined value could then happen to decode into the
+    // same blob index. It is caught on rewrite by the write callback, but not
+    // by the merge operator, so in merge rewrite mode each entry is looked up
+    // on its own.
+    for (auto& entry : *entries) {
+      Status s = DiscardEntry(entry.key, entry.blob_index, &entry.discardable);
+      if (!s.ok()) {
+        return s;
+      }
+    }
+    return Status::OK();
+  }
+  // Entries come in key order, and versions of the same key from different
+  // input files are adjacent. Look up each distinct key only once.
+  std::vector<size_t> key_index(entries->size());
+  std::vector<Slice> keys;
+  for (size_t i = 0; i < entries->size(); i++) {
+    const std::string& key = (*entries)[i].key;
+    if (keys.empty() || keys.back().compare(key) != 0) {
+      keys.emplace_back(key);
+    }
+    key_index[i] = keys.size() - 1;
+  }
+
+  std::unique_ptr<PinnableSlice[]> values(new PinnableSlice[keys.size()]);
+  std::vector<Status> statuses(keys.size());
+  for (size_t start = 0; start < keys.size();
+       start += MultiGetContext::MAX_BATCH_SIZE) {
+    size_t end =
+        std::min(keys.size(), start + MultiGetContext::MAX_BATCH_SIZE);
+    autovector<KeyContext, MultiGetContext::MAX_BATCH_SIZE> key_context;
+    for (size_t i = start; i < end; i++) {
+      key_context.emplace_back(keys[i], &values[i], &statuses[i]);
+    }
+    // The flag is shared by the whole batch, values are decoded as blob index
+    // below instead.
+    bool is_blob_index = false;
+    base_db_impl_->MultiGetImpl(ReadOptions(),
+                                blob_gc_->column_family_handle(), key_context,
+                                true /*sorted_input*/,
+                                nullptr /*read_callback*/, &is_blob_index);
+  }
+
+  for (size_t i = 0; i < keys.size(); i++) {
+    if (!statuses[i].ok() && !statuses[i].IsNotFound()) {
+      return statuses[i];
+    }
+    // count read bytes for checking LSM entry
+    metrics_.gc_bytes_read += keys[i].size() + values[i].size();
+  }
+  for (size_t i = 0; i < entries->size(); i++) {
+    GCEntry& entry = (*entries)[i];
+    size_t idx = key_index[i];
+    if (statuses[idx].IsNotFound()) {
+      // Either the key is deleted or updated with a newer version which is
+      // inlined in LSM.
+      entry.discardable = true;
+      continue;
+    }
+    Slice index_entry = values[idx];
+    BlobIndex other_blob_index;
+    if (!other_blob_index.DecodeFrom(&index_entry).ok()) {
+      // Updated with a newer version which is inlined in LSM.
+      entry.discardable = true;
+      continue;
+    }
+    entry.discardable = !(entry.blob_index == other_blob_index);
+  }
+  return Status::OK();
+}
+
+Status BlobGCJob::DiscardEntriesByIterator(std::vector<GCEntry>* entries) {
+  TitanStopWatch sw(env_, metrics_.gc_read_lsm_micros);
+  const Comparator* ucmp = blob_gc_->titan_cf_options().comparator;
+  if (!lsm_iter_) {
+    // Records found valid against the iterator may be overwritten later, it
+    // is checked again on rewrite, the same as with point lookups.
+    auto* cfd = reinterpret_cast<ColumnFamilyHandleImpl*>(
+                    blob_gc_->column_family_handle())
+                    ->cfd();
+    lsm_iter_.reset(base_db_impl_->NewIteratorImpl(
+        ReadOptions(), cfd, base_db_impl_->GetLatestSequenceNumber(),
+        nullptr /*read_callback*/, true /*allow_blob*/,
+        true /*allow_refresh*/));
+  } else {
+    // Refreshed for every batch, so that the iterator doesn't pin memtables
+    // and SSTs of the version it is created at for the whole job.
+    Status s = lsm_iter_->Refresh();
+    if (!s.ok()) {
+      return s;
+    }
+  }
+  lsm_iter_->Seek(entries->front().key);
+
+  for (auto& entry : *entries) {
+    uint64_t steps = 0;
+    while (lsm_iter_->Valid() &&
+           ucmp->Compare(lsm_iter_->key(), entry.key) < 0) {
+      if (++steps > kMergeJoinStepsPerLookup) {
+        lsm_iter_->Seek(entry.key);
+        break;
+      }
+      lsm_iter_->Next();
+    }
+    if (!lsm_iter_->status().ok()) {
+      return lsm_iter_->status();
+    }
+    if (!lsm_iter_->Valid() ||
+        ucmp->Compare(lsm_iter_->key(), entry.key) != 0 ||
+        !lsm_iter_->IsBlob()) {
+      // Either the key is deleted or updated with a newer version which is
+      // inlined in LSM.
+      entry.discardable = true;
+      continue;
+    }
+    // count read bytes for checking LSM entry
+    metrics_.gc_bytes_read +=
+        lsm_iter_->key().size() + lsm_iter_->value().size();
+    Slice index_entry = lsm_iter_->value();
+    BlobIndex other_blob_index;
+    Status s = other_blob_index.DecodeFrom(&index_entry);
+    if (!s.ok()) {
+      return s;
+    }
+    entry.discardable = !(entry.blob_index == other_blob_index);
+  }
+  return Status::OK();
+}
+
+bool BlobGCJob::UseMergeJoin() {
+  const auto& cf_options = blob_gc_->titan_cf_options();
+  if (cf_options.gc_validity_check_mode != TitanGCValidityCheckMode::kAuto) {
+    return cf_options.gc_validity_check_mode ==
+           TitanGCValidityCheckMode::kMergeJoin;
+  }
+
+  // Estimate the number of LSM keys in the key range of GC inputs, and
+  // compare it with the number of blob records to check.
+  const Comparator* ucmp = cf_options.comparator;
+  std::string smallest_key;
+  std::string largest_key;
+  uint64_t gc_entries = 0;
+  for (const auto& file : inputs_) {
+    if (file->smallest_key().empty() || file->largest_key().empty() ||
+        file->file_entries() == 0) {
+      // Files of older format don't record their key range.
+      return false;
+    }
+    if (smallest_key.empty() ||
+        ucmp->Compare(file->smallest_key(), smallest_key) < 0) {
+      smallest_key = file->smallest_key();
+    }
+    if (largest_key.empty() ||
+        ucmp->Compare(file->largest_key(), largest_key) > 0) {
+      largest_key = file->largest_key();
+    }
+    gc_entries += file->file_entries();
+  }
+
+  auto* cfh = blob_gc_->column_family_handle();
+  uint64_t num_keys = 0;
+  uint64_t total_size = 0;
+  if (!base_db_->GetIntProperty(cfh, DB::Properties::kEstimateNumKeys,
+                                &num_keys) ||
+      !base_db_->GetIntProperty(cfh, DB::Properties::kTotalSstFilesSize,
+                                &total_size) ||
+      total_size == 0) {
+    return false;
+  }
+  Range range(smallest_key, largest_key);
+  uint64_t range_size = 0;
+  base_db_->GetApproximateSizes(cfh, &range, 1, &range_size);
+  uint64_t range_keys = static_cast<uint64_t>(
+      static_cast<double>(num_keys) * range_size / total_size);
+  return range_keys <= gc_entries * kMergeJoinStepsPerLookup;
+}
+
 // We have to make sure crash consistency, but LSM db MANIFEST and BLOB db
 // MANIFEST are separate, so we need to make sure all new blob file have
 // added to db before we rewrite any key to LSM
@@ -424,6 +1044,7 @@ Status BlobGCJob::InstallOutputBlobFiles() {
         builder.first->GetNumber(), builder.first->GetFile()->GetFileSize(), 0,
         0, builder.second->GetSmallestKey(), builder.second->GetLargestKey());
     file->set_live_data_size(builder.second->live_data_size());
+    file->set_creation_time(inputs_creation_time_);
     file->FileStateTransit(BlobFileMeta::FileEvent::kGCOutput);
     RecordInHistogram(statistics(stats_), TITAN_GC_OUTPUT_FILE_SIZE,
                       file->file_size());
@@ -440,6 +1061,8 @@ Status BlobGCJob::InstallOutputBlobFiles() {
     s = blob_file_manager_->BatchFinishFiles(
         blob_gc_->column_family_handle()->GetID(), files);
     if (s.ok()) {
+      // Sub jobs may install their outputs concurrently.
+      MutexLock l(mutex_);
       for (auto& file : files) {
         blob_gc_->AddOutputFile(file.first.get());
       }
@@ -482,9 +1105,12 @@ Status BlobGCJob::RewriteValidKeyToLSM() {
   wo.low_pri = true;
   wo.ignore_missing_column_families = true;
 
-  std::unordered_map<uint64_t, uint64_t>
-      dropped;  // blob_file_number -> dropped_size
-  if (!gc_merge_rewrite_) {
+  DroppedRecordsMap dropped;  // blob_file_number -> dropped records
+  const size_t batch_keys = static_cast<size_t>(std::max<uint64_t>(
+      blob_gc_->titan_cf_options().gc_rewrite_batch_keys, 1));
+  if (!gc_merge_rewrite_ && batch_keys > 1) {
+    s = RewriteValidKeyToLSMInBatches(batch_keys, &dropped);
+  } else if (!gc_merge_rewrite_) {
     for (auto& write_batch : rewrite_batches_) {
       if (blob_gc_->GetColumnFamilyData()->IsDropped()) {
         s = Status::Aborted("Column family drop");
@@ -512,7 +1138,9 @@ Status BlobGCJob::RewriteValidKeyToLSM() {
         BlobIndex blob_index;
         Slice str(write_batch.second.value);
         blob_index.DecodeFrom(&str);
-        dropped[blob_index.file_number] += blob_index.blob_handle.size;
+        auto& file_dropped = dropped[blob_index.file_number];
+        file_dropped.size += blob_index.blob_handle.size;
+        file_dropped.records.push_back(blob_index.blob_handle);
       } else {
         // We hit an error.
         break;
@@ -521,7 +1149,10 @@ Status BlobGCJob::RewriteValidKeyToLSM() {
       metrics_.gc_bytes_read += write_batch.second.read_bytes();
     }
   } else {
-    for (auto& write_batch : rewrite_batches_without_callback_) {
+    // Merge operands need no validation, rewrite up to `batch_keys` of them
+    // in one write.
+    auto& batches = rewrite_batches_without_callback_;
+    for (size_t start = 0; start < batches.size(); start += batch_keys) {
       if (blob_gc_->GetColumnFamilyData()->IsDropped()) {
         s = Status::Aborted("Column family drop");
         break;
@@ -530,13 +1161,27 @@ Status BlobGCJob::RewriteValidKeyToLSM() {
         s = Status::ShutdownInProgress();
         break;
       }
-      s = db_impl->Write(wo, &write_batch.first);
+      size_t end = std::min(batches.size(), start + batch_keys);
+      WriteBatch merged;
+      WriteBatch* wb = &batches[start].first;
+      if (end - start > 1) {
+        for (size_t i = start; i < end && s.ok(); i++) {
+          s = WriteBatchInternal::Append(&merged, &batches[i].first);
+        }
+        if (!s.ok()) {
+          break;
+        }
+        wb = &merged;
+      }
+      s = db_impl->Write(wo, wb);
       if (s.ok()) {
         // count written bytes for new blob index.
-        metrics_.gc_bytes_written += write_batch.first.GetDataSize();
-        metrics_.gc_num_keys_relocated++;
-        metrics_.gc_bytes_relocated += write_batch.second;
-        // Key is successfully written to LSM.
+        metrics_.gc_bytes_written += wb->GetDataSize();
+        metrics_.gc_num_keys_relocated += end - start;
+        for (size_t i = start; i < end; i++) {
+          metrics_.gc_bytes_relocated += batches[i].second;
+        }
+        // Keys are successfully written to LSM.
       } else {
         // We hit an error.
         break;
@@ -550,7 +1195,10 @@ Status BlobGCJob::RewriteValidKeyToLSM() {
 
   mutex_->Lock();
   auto cf_id = blob_gc_->column_family_handle()->GetID();
-  for (auto blob_file : dropped) {
+  VersionEdit edit;
+  edit.SetColumnFamilyID(cf_id);
+  bool has_dead_records = false;
+  for (auto& blob_file : dropped) {
     auto blob_storage = blob_file_set_->GetBlobStorage(cf_id).lock();
     if (blob_storage) {
       auto file = blob_storage->FindFile(blob_file.first).lock();
@@ -561,8 +1209,16 @@ Status BlobGCJob::RewriteValidKeyToLSM() {
         continue;
       }
       SubStats(stats_, cf_id, file->GetDiscardableRatioLevel(), 1);
-      file->UpdateLiveDataSize(-blob_file.second);
+      file->UpdateLiveDataSize(-blob_file.second.size);
       AddStats(stats_, cf_id, file->GetDiscardableRatioLevel(), 1);
+      // The records are never referenced by the LSM, and would otherwise be
+      // taken as live by GC of output files tracking deletions.
+      if (!file->is_obsolete()) {
+        BlobRecordSet records;
+        records.Add(blob_file.second.records);
+        edit.AddDeadBlobRecords(file->file_number(), records);
+        has_dead_records = true;
+      }
 
       blob_storage->ComputeGCScore();
     } else {
@@ -570,6 +1226,12 @@ Status BlobGCJob::RewriteValidKeyToLSM() {
                       "Column family id:%" PRIu32 " not Found when GC.", cf_id);
     }
   }
+  if (has_dead_records) {
+    Status log_status = blob_file_set_->LogAndApply(edit);
+    if (s.ok()) {
+      s = log_status;
+    }
+  }
   mutex_->Unlock();
 
   if (s.ok()) {
@@ -580,6 +1242,141 @@ Status BlobGCJob::RewriteValidKeyToLSM() {
   return s;
 }
 
+// Rewrites keys relocated by GC in write batches of up to `batch_keys` keys,
+// instead of one write per key. Keys updated since GC read them are dropped
+// from the batch, which is then retried with the rest of the keys.
+Status BlobGCJob::RewriteValidKeyToLSMInBatches(
+    size_t batch_keys, DroppedRecordsMap* dropped) {
+  Status s;
+  auto* db_impl = reinterpret_cast<DBImpl*>(base_db_);
+  WriteOptions wo;
+  wo.low_pri = true;
+  wo.ignore_missing_column_families = true;
+
+  auto& batches = rewrite_batches_;
+  for (size_t start = 0; start < batches.size(); start += batch_keys) {
+    if (blob_gc_->GetColumnFamilyData()->IsDropped()) {
+      s = Status::Aborted("Column family drop");
+      break;
+    }
+    if (IsShutingDown()) {
+      s = Status::ShutdownInProgress();
+      break;
+    }
+    size_t end = std::min(batches.size(), start + batch_keys);
+    std::vector<bool> conflicts(end - start, false);
+    size_t num_conflicts = 0;
+    WriteBatch wb;
+    while (true) {
+      wb.Clear();
+      std::vector<GarbageCollectionWriteCallback*> callbacks;
+      for (size_t i = start; i < end && s.ok(); i++) {
+        callbacks.push_back(&batches[i].second);
+        if (!conflicts[i - start]) {
+          s = WriteBatchInternal::Append(&wb, &batches[i].first);
+        }
+      }
+      if (!s.ok() || wb.Count() == 0) {
+        break;
+      }
+      GarbageCollectionBatchWriteCallback callback(std::move(callbacks),
+                                                   &conflicts);
+      s = db_impl->WriteWithCallback(wo, &wb, &callback);
+      if (!s.IsBusy()) {
+        break;
+      }
+      size_t prev_conflicts = num_conflicts;
+      num_conflicts = std::count(conflicts.begin(), conflicts.end(), true);
+      if (num_conflicts == prev_conflicts) {
+        // Not expected. Don't let the caller take it as a dropped key.
+        s = Status::Aborted("GC rewrite busy without conflict");
+        break;
+      }
+      // Some keys are overwritten in the meanwhile, retry without them.
+      s = Status::OK();
+    }
+    if (!s.ok()) {
+      break;
+    }
+
+    for (size_t i = start; i < end; i++) {
+      auto& callback = batches[i].second;
+      // count read bytes in write callback
+      metrics_.gc_bytes_read += callback.read_bytes();
+      if (conflicts[i - start]) {
+        metrics_.gc_num_keys_overwritten++;
+        metrics_.gc_bytes_overwritten += callback.blob_record_size();
+        // The key is overwritten in the meanwhile. Drop the blob record.
+        BlobIndex blob_index;
+        Slice str(callback.value);
+        blob_index.DecodeFrom(&str);
+        auto& file_dropped = (*dropped)[blob_index.file_number];
+        file_dropped.size += blob_index.blob_handle.size;
+        file_dropped.records.push_back(blob_index.blob_handle);
+      } else {
+        // count written bytes for new blob index.
+        metrics_.gc_bytes_written += batches[i].first.GetDataSize();
+        metrics_.gc_num_keys_relocated++;
+        metrics_.gc_bytes_relocated += callback.blob_record_size();
+      }
+    }
+  }
+  return s;
+}
+
+void BlobGCJob::AdvanceResumePosition(const BlobIndex& blob_index) {
+  const BlobHandle& handle = blob_index.blob_handle;
+  auto& position = resume_positions_[blob_index.file_number];
+  if (handle.packed()) {
+    position = std::make_pair(handle.offset, handle.slot + 1);
+  } else {
+    position = std::make_pair(handle.offset + handle.size, 0u);
+  }
+}
+
+Status BlobGCJob::LogResumePositions() {
+  if (resume_positions_.empty()) {
+    return Status::OK();
+  }
+  MutexLock l(mutex_);
+  VersionEdit edit;
+  edit.SetColumnFamilyID(blob_gc_->column_family_handle()->GetID());
+  for (const auto& file : inputs_) {
+    auto position = resume_positions_.find(file->file_number());
+    if (file->is_obsolete() || position == resume_positions_.end()) {
+      continue;
+    }
+    edit.SetGCResumePosition(file->file_number(), position->second.first,
+                             position->second.second);
+  }
+  return blob_file_set_->LogAndApply(edit);
+}
+
+// Installs output files finished so far and rewrites their blob indexes to
+// the LSM in the middle of a GC job, to bound the memory held by pending
+// rewrites. Output files are installed before any index pointing to them
+// is written, and input files are kept until the job finishes, so the DB
+// stays consistent if it crashes between chunks.
+//
+// REQUIRE: mutex not held
+Status BlobGCJob::InstallAndRewriteChunk() {
+  Status s = InstallOutputBlobFiles();
+  if (s.ok()) {
+    s = RewriteValidKeyToLSM();
+  }
+  if (!s.ok()) {
+    ROCKS_LOG_ERROR(db_options_.info_log,
+                    "[%s] GC job failed to rewrite a chunk to LSM: %s",
+                    blob_gc_->column_family_handle()->GetName().c_str(),
+                    s.ToString().c_str());
+  }
+  blob_file_builders_.clear();
+  rewrite_batches_.clear();
+  rewrite_batches_without_callback_.clear();
+  rewrite_buffer_size_ = 0;
+  return s;
+}
+
 Status BlobGCJob::DeleteInputBlobFiles() {
   SequenceNumber obsolete_sequence = base_db_impl_->GetLatestSequenceNumber();
 
@@ -643,6 +1440,10 @@ void BlobGCJob::UpdateInternalOpStats() {
            metrics_.gc_read_lsm_micros);
   AddStats(internal_op_stats, InternalOpStatsType::GC_UPDATE_LSM_MICROS,
            metrics_.gc_update_lsm_micros);
+  AddStats(internal_op_stats, InternalOpStatsType::GC_NUM_KEYS_OVERWRITTEN,
+           metrics_.gc_num_keys_overwritten);
+  AddStats(internal_op_stats, InternalOpStatsType::GC_NUM_KEYS_RELOCATED,
+           metrics_.gc_num_keys_relocated);
 }
 
 }  // namespace titandb
@@ -1,13 +1,17 @@
 #pragma once
 
+#include "background_readahead_file.h"
 #include "blob_file_builder.h"
 #include "blob_file_iterator.h"
 #include "blob_file_manager.h"
 #include "blob_file_set.h"
 #include "blob_gc.h"
 #include "db/db_impl/db_impl.h"
+#include "db/db_iter.h"
+#include "rocksdb/rate_limiter.h"
 #include "rocksdb/statistics.h"
 #include "rocksdb/status.h"
+#include "rocksdb/threadpool.h"
 #include "titan/options.h"
 #include "titan_stats.h"
 #include "version_edit.h"
@@ -22,7 +26,7 @@ class BlobGCJob {
             Env *env, const EnvOptions &env_options,
             BlobFileManager *blob_file_manager, BlobFileSet *blob_file_set,
             LogBuffer *log_buffer, std::atomic_bool *shuting_down,
-            TitanStats *stats);
+            TitanStats *stats, ThreadPool *thread_pool = nullptr);
 
   // No copying allowed
   BlobGCJob(const BlobGCJob &) = delete;
@@ -39,11 +43,45 @@ class BlobGCJob {
 
  private:
   class GarbageCollectionWriteCallback;
+  class GarbageCollectionBatchWriteCallback;
   friend class BlobGCJobTest;
 
+  // A blob record read from GC input files, pending validity check.
+  struct GCEntry {
+    std::string key;
+    BlobIndex blob_index;
+    std::string value;
+    bool discardable = false;
+    // False if the entry is only known not to be dropped from the LSM, and
+    // may still be an older version of its key.
+    bool validated = true;
+  };
+
+  // Records of an input file dropped from the LSM, taken when the job is
+  // prepared. See `track_blob_record_deletions`.
+  struct InputDeadRecords {
+    // Sorted record ids.
+    std::vector<uint64_t> records;
+    // Whether records not in `records` are still referenced by the LSM, if
+    // possibly by an older version of the key.
+    bool complete = false;
+  };
+  using DeadRecordsMap = std::unordered_map<uint64_t, InputDeadRecords>;
+
+  // Records written to an output file whose rewrite to the LSM is rejected,
+  // because the key is updated in the meanwhile.
+  struct DroppedRecords {
+    uint64_t size = 0;
+    std::vector<BlobHandle> records;
+  };
+  using DroppedRecordsMap = std::unordered_map<uint64_t, DroppedRecords>;
+
   void UpdateInternalOpStats();
 
   BlobGC *blob_gc_;
+  // Input files processed by this job. A subset of `blob_gc_->inputs()` for
+  // sub jobs.
+  std::vector<std::shared_ptr<BlobFileMeta>> inputs_;
   DB *base_db_;
   DBImpl *base_db_impl_;
   port::Mutex *mutex_;
@@ -62,11 +100,17 @@ class BlobGCJob {
       rewrite_batches_;
   std::vector<std::pair<WriteBatch, uint64_t /*blob_record_size*/>>
       rewrite_batches_without_callback_;
+  // Approximate memory used by pending rewrites.
+  uint64_t rewrite_buffer_size_ = 0;
 
   std::atomic_bool *shuting_down_{nullptr};
 
   TitanStats *stats_;
 
+  // The GC thread pool sub jobs run in. Sub jobs run one by one in the
+  // current thread if null.
+  ThreadPool *thread_pool_;
+
   struct {
     uint64_t gc_bytes_read = 0;
     uint64_t gc_bytes_written = 0;
@@ -84,18 +128,59 @@ class BlobGCJob {
     uint64_t gc_update_lsm_micros = 0;
   } metrics_;
 
+  // Dead records of input files, by file number. Null unless
+  // `track_blob_record_deletions` is set.
+  std::shared_ptr<const DeadRecordsMap> dead_records_;
+
+  // Creation time of the newest input file, which output files take over, so
+  // that moving records doesn't make them look young. 0 if unknown.
+  uint64_t inputs_creation_time_ = 0;
+
+  // Limits the memory of input file readahead, shared with sub jobs. Null
+  // unless `gc_readahead_size` is set.
+  std::shared_ptr<ReadaheadBudget> readahead_budget_;
+
+  // Position after the last record moved or dropped of each input file, by
+  // file number. Logged to manifest with every committed chunk, so that GC
+  // resumes from there if the job is interrupted.
+  std::unordered_map<uint64_t, std::pair<uint64_t, uint32_t>>
+      resume_positions_;
+
+  // Whether to check validity of blob records by merge-join with an LSM
+  // iterator, instead of point lookups. The iterator is refreshed for every
+  // batch of records.
+  bool merge_join_ = false;
+  std::unique_ptr<ArenaWrappedDBIter> lsm_iter_;
+
   uint64_t prev_bytes_read_ = 0;
   uint64_t prev_bytes_written_ = 0;
   uint64_t io_bytes_read_ = 0;
   uint64_t io_bytes_written_ = 0;
 
   Status DoRunGC();
+  Status RunSubJobs(size_t num_subjobs);
+  void MergeSubJob(BlobGCJob *sub_job);
   void BatchWriteNewIndices(BlobFileBuilder::OutContexts &contexts, Status *s);
   Status BuildIterator(std::unique_ptr<BlobFileMergeIterator> *result);
   Status DiscardEntry(const Slice &key, const BlobIndex &blob_index,
                       bool *discardable);
+  // Checks validity of the entries, by their dead records if known, or
+  // against the LSM otherwise.
+  Status CheckEntries(std::vector<GCEntry> *entries);
+  Status DiscardEntries(std::vector<GCEntry> *entries);
+  Status DiscardEntriesByIterator(std::vector<GCEntry> *entries);
+  bool UseMergeJoin();
+  void GetInputKeyRangeLimits(std::vector<std::string> *limits) const;
+  // Waits for `bytes` of I/O budget from `gc_rate_limiter`, if any.
+  void RequestGCBudget(uint64_t bytes, RateLimiter::OpType op_type);
   Status InstallOutputBlobFiles();
   Status RewriteValidKeyToLSM();
+  Status RewriteValidKeyToLSMInBatches(size_t batch_keys,
+                                       DroppedRecordsMap *dropped);
+  Status InstallAndRewriteChunk();
+  // Records that the entry is moved or dropped from its input file.
+  void AdvanceResumePosition(const BlobIndex &blob_index);
+  Status LogResumePositions();
   Status DeleteInputBlobFiles();
 
   bool IsShutingDown();
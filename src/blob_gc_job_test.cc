@@ -1,9 +1,16 @@
 #include "blob_gc_job.h"
 
+#include <map>
+#include <set>
+
 #include "blob_gc_picker.h"
 #include "db_impl.h"
 #include "rocksdb/convenience.h"
+#include "rocksdb/rate_limiter.h"
+#include "test_util/sync_point.h"
 #include "test_util/testharness.h"
+#include "util/compression.h"
+#include "util/random.h"
 
 namespace rocksdb {
 namespace titandb {
@@ -31,6 +38,10 @@ class BlobGCJobTest : public testing::TestWithParam<bool /*gc_merge_mode*/> {
   BlobFileSet* blob_file_set_;
   TitanOptions options_;
   port::Mutex* mutex_;
+  TitanGCValidityCheckMode gc_validity_check_mode_{
+      TitanGCValidityCheckMode::kPointLookup};
+  uint64_t gc_rewrite_buffer_size_{0};
+  bool gc_key_range_clustering_{false};
 
   BlobGCJobTest() : dbname_(test::TmpDir()) {
     options_.dirname = dbname_ + "/titandb";
@@ -115,6 +126,17 @@ class BlobGCJobTest : public testing::TestWithParam<bool /*gc_merge_mode*/> {
     ASSERT_OK(db_->CompactRange(compact_opts, nullptr, nullptr));
   }
 
+  // Returns a copy of the blob files of the default column family.
+  std::map<uint64_t, std::shared_ptr<BlobFileMeta>> GetBlobFiles() {
+    auto b = GetBlobStorage(base_db_->DefaultColumnFamily()->GetID()).lock();
+    return std::map<uint64_t, std::shared_ptr<BlobFileMeta>>(b->files_.begin(),
+                                                             b->files_.end());
+  }
+
+  void TrainCompressionDict() {
+    tdb_->MaybeTrainCompressionDict(base_db_->DefaultColumnFamily()->GetID());
+  }
+
   void ReComputeGCScore() {
     auto b = GetBlobStorage(base_db_->DefaultColumnFamily()->GetID()).lock();
     b->ComputeGCScore();
@@ -143,6 +165,15 @@ class BlobGCJobTest : public testing::TestWithParam<bool /*gc_merge_mode*/> {
     }
     cf_options.blob_file_discardable_ratio = 0.4;
     cf_options.sample_file_size_ratio = 1;
+    cf_options.gc_validity_check_mode = gc_validity_check_mode_;
+    cf_options.gc_rewrite_buffer_size = gc_rewrite_buffer_size_;
+    cf_options.gc_key_range_clustering = gc_key_range_clustering_;
+    cf_options.blob_file_compression = options_.blob_file_compression;
+    cf_options.blob_file_compression_options =
+        options_.blob_file_compression_options;
+    cf_options.gc_blob_file_compression = options_.gc_blob_file_compression;
+    cf_options.gc_blob_file_compression_level =
+        options_.gc_blob_file_compression_level;
 
     std::unique_ptr<BlobGC> blob_gc;
     {
@@ -156,11 +187,16 @@ class BlobGCJobTest : public testing::TestWithParam<bool /*gc_merge_mode*/> {
 
     if (blob_gc) {
       blob_gc->SetColumnFamily(cfh);
+      blob_gc->SetCompressionDicts(
+          blob_file_set_->GetBlobStorage(cfh->GetID())
+              .lock()
+              ->compression_dicts());
 
       BlobGCJob blob_gc_job(blob_gc.get(), base_db_, mutex_, tdb_->db_options_,
                             GetParam(), tdb_->env_, EnvOptions(options_),
                             tdb_->blob_manager_.get(), blob_file_set_,
-                            &log_buffer, nullptr, nullptr);
+                            &log_buffer, nullptr, nullptr,
+                            tdb_->thread_pool_.get());
 
       s = blob_gc_job.Prepare();
       ASSERT_OK(s);
@@ -224,6 +260,50 @@ class BlobGCJobTest : public testing::TestWithParam<bool /*gc_merge_mode*/> {
     ASSERT_FALSE(discardable);
   }
 
+  void TestDiscardEntries() {
+    NewDB();
+    auto* cfh = base_db_->DefaultColumnFamily();
+    auto make_index = [](uint64_t file_number, uint64_t offset) {
+      BlobIndex blob_index;
+      blob_index.file_number = file_number;
+      blob_index.blob_handle.offset = offset;
+      blob_index.blob_handle.size = 0x17;
+      return blob_index;
+    };
+    WriteBatch wb;
+    for (auto& key : {"key1", "key2"}) {
+      std::string res;
+      make_index(0x81, 0x98).EncodeTo(&res);
+      ASSERT_OK(WriteBatchInternal::PutBlobIndex(&wb, cfh->GetID(), key, res));
+    }
+    ASSERT_OK(base_db_->Write(WriteOptions(), &wb));
+    ASSERT_OK(base_db_->Put(WriteOptions(), "key3", "inlined value"));
+
+    std::vector<BlobGCJob::GCEntry> entries(5);
+    entries[0].key = "key1";
+    entries[0].blob_index = make_index(0x81, 0x98);
+    entries[1].key = "key1";
+    entries[1].blob_index = make_index(0x80, 0x98);
+    entries[2].key = "key2";
+    entries[2].blob_index = make_index(0x81, 0x99);
+    entries[3].key = "key3";
+    entries[3].blob_index = make_index(0x81, 0x98);
+    entries[4].key = "key4";
+    entries[4].blob_index = make_index(0x81, 0x98);
+
+    std::vector<std::shared_ptr<BlobFileMeta>> tmp;
+    BlobGC blob_gc(std::move(tmp), TitanCFOptions(), false /*trigger_next*/);
+    blob_gc.SetColumnFamily(cfh);
+    BlobGCJob blob_gc_job(&blob_gc, base_db_, mutex_, TitanDBOptions(),
+                          GetParam(), Env::Default(), EnvOptions(), nullptr,
+                          blob_file_set_, nullptr, nullptr, nullptr);
+    ASSERT_OK(blob_gc_job.DiscardEntries(&entries));
+    ASSERT_FALSE(entries[0].discardable);
+    for (size_t i = 1; i < entries.size(); i++) {
+      ASSERT_TRUE(entries[i].discardable);
+    }
+  }
+
   void TestRunGC() {
     NewDB();
     for (int i = 0; i < MAX_KEY_NUM; i++) {
@@ -283,8 +363,291 @@ class BlobGCJobTest : public testing::TestWithParam<bool /*gc_merge_mode*/> {
 
 TEST_P(BlobGCJobTest, DiscardEntry) { TestDiscardEntry(); }
 
+TEST_P(BlobGCJobTest, DiscardEntries) { TestDiscardEntries(); }
+
 TEST_P(BlobGCJobTest, RunGC) { TestRunGC(); }
 
+TEST_P(BlobGCJobTest, RunGCMergeJoin) {
+  gc_validity_check_mode_ = TitanGCValidityCheckMode::kMergeJoin;
+  TestRunGC();
+}
+
+TEST_P(BlobGCJobTest, RunGCAutoValidityCheck) {
+  gc_validity_check_mode_ = TitanGCValidityCheckMode::kAuto;
+  TestRunGC();
+}
+
+TEST_P(BlobGCJobTest, RunGCInChunks) {
+  gc_rewrite_buffer_size_ = 4096;
+  NewDB();
+  for (int i = 0; i < MAX_KEY_NUM; i++) {
+    ASSERT_OK(db_->Put(WriteOptions(), GenKey(i), GenValue(i)));
+  }
+  Flush();
+  for (int i = 0; i < MAX_KEY_NUM; i++) {
+    if (i % 3 == 0) continue;
+    ASSERT_OK(db_->Delete(WriteOptions(), GenKey(i)));
+  }
+  Flush();
+  CompactAll();
+  auto files = GetBlobFiles();
+  ASSERT_EQ(files.size(), 1);
+  auto old = files.begin()->first;
+
+  RunGC(true);
+  files = GetBlobFiles();
+  // Each chunk is installed as separate output files.
+  ASSERT_GT(files.size(), 1);
+  ASSERT_EQ(files.count(old), 0);
+  std::string value;
+  for (int i = 0; i < MAX_KEY_NUM; i++) {
+    Status s = db_->Get(ReadOptions(), GenKey(i), &value);
+    if (i % 3 == 0) {
+      ASSERT_OK(s);
+      ASSERT_EQ(value, GenValue(i));
+    } else {
+      ASSERT_TRUE(s.IsNotFound());
+    }
+  }
+}
+
+TEST_P(BlobGCJobTest, RunGCKeyRangeClustering) {
+  gc_key_range_clustering_ = true;
+  NewDB();
+  // Two blob files with a gap in between their key ranges.
+  const int kGapBegin = MAX_KEY_NUM / 4;
+  const int kGapEnd = MAX_KEY_NUM / 2;
+  for (int i = 0; i < kGapBegin; i++) {
+    ASSERT_OK(db_->Put(WriteOptions(), GenKey(i), GenValue(i)));
+  }
+  Flush();
+  for (int i = kGapEnd; i < MAX_KEY_NUM; i++) {
+    ASSERT_OK(db_->Put(WriteOptions(), GenKey(i), GenValue(i)));
+  }
+  Flush();
+  for (int i = 0; i < MAX_KEY_NUM; i++) {
+    if (i % 3 == 0) continue;
+    ASSERT_OK(db_->Delete(WriteOptions(), GenKey(i)));
+  }
+  Flush();
+  CompactAll();
+  auto files = GetBlobFiles();
+  ASSERT_EQ(files.size(), 2);
+  std::set<uint64_t> old_files;
+  for (auto& file : files) {
+    old_files.insert(file.first);
+  }
+
+  RunGC(true);
+  files = GetBlobFiles();
+  // GC output is split at the gap.
+  ASSERT_EQ(files.size(), 2);
+  for (auto& file : files) {
+    ASSERT_EQ(old_files.count(file.first), 0);
+    ASSERT_TRUE(file.second->largest_key() < GenKey(kGapBegin) ||
+                file.second->smallest_key() >= GenKey(kGapEnd));
+  }
+  std::string value;
+  for (int i = 0; i < MAX_KEY_NUM; i++) {
+    Status s = db_->Get(ReadOptions(), GenKey(i), &value);
+    if (i % 3 == 0 && (i < kGapBegin || i >= kGapEnd)) {
+      ASSERT_OK(s);
+      ASSERT_EQ(value, GenValue(i));
+    } else {
+      ASSERT_TRUE(s.IsNotFound());
+    }
+  }
+}
+
+// GC outputs should be built with gc_blob_file_compression_level, or with
+// blob_file_compression_options.level by default.
+TEST_P(BlobGCJobTest, GCBlobFileCompressionLevel) {
+  options_.blob_file_compression_options.level = 3;
+  std::vector<int> builder_levels;
+  SyncPoint::GetInstance()->SetCallBack(
+      "BlobFileBuilder::BlobFileBuilder", [&](void* arg) {
+        auto* cf_options = reinterpret_cast<TitanCFOptions*>(arg);
+        builder_levels.push_back(
+            cf_options->blob_file_compression_options.level);
+      });
+  SyncPoint::GetInstance()->EnableProcessing();
+
+  for (int gc_level : {kInheritBlobCompressionLevel, 9}) {
+    options_.gc_blob_file_compression_level = gc_level;
+    NewDB();
+    for (int i = 0; i < MAX_KEY_NUM; i++) {
+      ASSERT_OK(db_->Put(WriteOptions(), GenKey(i), GenValue(i)));
+    }
+    Flush();
+    for (int i = 0; i < MAX_KEY_NUM; i++) {
+      if (i % 3 == 0) continue;
+      ASSERT_OK(db_->Delete(WriteOptions(), GenKey(i)));
+    }
+    Flush();
+    CompactAll();
+
+    builder_levels.clear();
+    RunGC(true);
+    ASSERT_FALSE(builder_levels.empty());
+    int expected_level =
+        gc_level == kInheritBlobCompressionLevel ? 3 : gc_level;
+    for (int level : builder_levels) {
+      ASSERT_EQ(level, expected_level);
+    }
+    std::string value;
+    for (int i = 0; i < MAX_KEY_NUM; i += 3) {
+      ASSERT_OK(db_->Get(ReadOptions(), GenKey(i), &value));
+      ASSERT_EQ(value, GenValue(i));
+    }
+    Close();
+  }
+
+  SyncPoint::GetInstance()->DisableProcessing();
+  SyncPoint::GetInstance()->ClearAllCallBacks();
+}
+
+// Per-level and GC compression levels apply to blob files compressed with the
+// shared dictionary too, while the dictionary itself is digested with the
+// CF-wide level.
+TEST_P(BlobGCJobTest, CompressionLevelsWithSharedDict) {
+#if ZSTD_VERSION_NUMBER >= 10103
+  options_.blob_file_compression = kZSTD;
+  options_.blob_file_compression_options.level = 3;
+  options_.blob_file_compression_options.max_dict_bytes = 4096;
+  options_.blob_file_compression_options.zstd_max_train_bytes = 16 << 10;
+  options_.blob_file_shared_compression_dict = true;
+  options_.level_blob_file_compression_level = {1, 5};
+  options_.gc_blob_file_compression_level = 9;
+  std::vector<int> builder_levels;
+  SyncPoint::GetInstance()->SetCallBack(
+      "BlobFileBuilder::BlobFileBuilder", [&](void* arg) {
+        auto* cf_options = reinterpret_cast<TitanCFOptions*>(arg);
+        builder_levels.push_back(
+            cf_options->blob_file_compression_options.level);
+      });
+  SyncPoint::GetInstance()->EnableProcessing();
+
+  const std::vector<std::string> words = {"titan", "rocksdb", "blob",
+                                          "value", "compression", "dict"};
+  Random rnd(301);
+  std::map<std::string, std::string> data;
+  auto put_keys = [&](int start, int end) {
+    for (int i = start; i < end; i++) {
+      std::string value;
+      while (value.size() < 200) {
+        value += words[rnd.Uniform(static_cast<int>(words.size()))];
+        value += std::to_string(rnd.Uniform(100));
+      }
+      ASSERT_OK(db_->Put(WriteOptions(), GenKey(i), value));
+      data[GenKey(i)] = value;
+    }
+  };
+
+  NewDB();
+  uint32_t cf_id = base_db_->DefaultColumnFamily()->GetID();
+  // The first flush samples values to train the dictionary.
+  put_keys(0, MAX_KEY_NUM / 2);
+  Flush();
+  TrainCompressionDict();
+  auto b = GetBlobStorage(cf_id).lock();
+  uint64_t dict_id = 0;
+  ASSERT_NE(b->compression_dicts()->GetLatest(&dict_id), nullptr);
+  ASSERT_EQ(b->compression_dicts()->compression_opts().level, 3);
+
+  builder_levels.clear();
+  put_keys(MAX_KEY_NUM / 2, MAX_KEY_NUM);
+  Flush();
+  ASSERT_EQ(builder_levels, std::vector<int>({1}));
+  for (int i = 0; i < MAX_KEY_NUM; i++) {
+    if (i % 3 == 0) continue;
+    ASSERT_OK(db_->Delete(WriteOptions(), GenKey(i)));
+    data.erase(GenKey(i));
+  }
+  Flush();
+  CompactAll();
+
+  builder_levels.clear();
+  RunGC(true);
+  ASSERT_FALSE(builder_levels.empty());
+  for (int level : builder_levels) {
+    ASSERT_EQ(level, 9);
+  }
+  std::string value;
+  for (auto& kv : data) {
+    ASSERT_OK(db_->Get(ReadOptions(), kv.first, &value));
+    ASSERT_EQ(value, kv.second);
+  }
+
+  SyncPoint::GetInstance()->DisableProcessing();
+  SyncPoint::GetInstance()->ClearAllCallBacks();
+#endif
+}
+
+TEST_P(BlobGCJobTest, RunGCWithRateLimiter) {
+  std::shared_ptr<RateLimiter> rate_limiter(NewGenericRateLimiter(
+      1 << 30, 100 * 1000 /* refill_period_us */, 10 /* fairness */,
+      RateLimiter::Mode::kAllIo));
+  options_.gc_rate_limiter = rate_limiter;
+  NewDB();
+  for (int i = 0; i < MAX_KEY_NUM; i++) {
+    ASSERT_OK(db_->Put(WriteOptions(), GenKey(i), GenValue(i)));
+  }
+  Flush();
+  for (int i = 0; i < MAX_KEY_NUM; i++) {
+    if (i % 3 == 0) continue;
+    ASSERT_OK(db_->Delete(WriteOptions(), GenKey(i)));
+  }
+  Flush();
+  CompactAll();
+  ASSERT_EQ(rate_limiter->GetTotalBytesThrough(), 0);
+
+  RunGC(true);
+  // Both reads of inputs and writes of outputs are charged.
+  ASSERT_GT(rate_limiter->GetTotalBytesThrough(),
+            static_cast<int64_t>(MAX_KEY_NUM / 3 * GenValue(0).size()));
+}
+
+TEST_P(BlobGCJobTest, RunGCSubJobs) {
+  options_.max_gc_subjobs = 3;
+  NewDB();
+  const int kNumFiles = 4;
+  for (int f = 0; f < kNumFiles; f++) {
+    for (int i = f; i < MAX_KEY_NUM; i += kNumFiles) {
+      ASSERT_OK(db_->Put(WriteOptions(), GenKey(i), GenValue(i)));
+    }
+    Flush();
+  }
+  for (int i = 0; i < MAX_KEY_NUM; i++) {
+    if (i % 3 == 0) continue;
+    ASSERT_OK(db_->Delete(WriteOptions(), GenKey(i)));
+  }
+  Flush();
+  CompactAll();
+  auto files = GetBlobFiles();
+  ASSERT_EQ(files.size(), kNumFiles);
+  std::set<uint64_t> old_files;
+  for (auto& file : files) {
+    old_files.insert(file.first);
+  }
+
+  RunGC(true);
+  files = GetBlobFiles();
+  ASSERT_GT(files.size(), 0);
+  for (auto& file : files) {
+    ASSERT_EQ(old_files.count(file.first), 0);
+  }
+  std::string value;
+  for (int i = 0; i < MAX_KEY_NUM; i++) {
+    Status s = db_->Get(ReadOptions(), GenKey(i), &value);
+    if (i % 3 == 0) {
+      ASSERT_OK(s);
+      ASSERT_EQ(value, GenValue(i));
+    } else {
+      ASSERT_TRUE(s.IsNotFound());
+    }
+  }
+}
+
 TEST_P(BlobGCJobTest, GCLimiter) {
   class TestLimiter : public RateLimiter {
    public:
@@ -6,6 +6,9 @@
 
 #include <inttypes.h>
 
+#include <algorithm>
+#include <unordered_map>
+
 namespace rocksdb {
 namespace titandb {
 
@@ -18,30 +21,69 @@ BasicBlobGCPicker::~BasicBlobGCPicker() {}
 
 std::unique_ptr<BlobGC> BasicBlobGCPicker::PickBlobGC(
     BlobStorage* blob_storage) {
-  Status s;
+  std::vector<GCCandidate> candidates = GetCandidates(blob_storage);
+  size_t start = 0;
+  std::vector<GCCandidate> batch;
+  bool maybe_continue_next_time = false;
+  if (!NextBatch(candidates, &start, &batch, &maybe_continue_next_time)) {
+    return nullptr;
+  }
   std::vector<std::shared_ptr<BlobFileMeta>> blob_files;
+  for (const auto& candidate : batch) {
+    blob_files.emplace_back(
+        blob_storage->FindFile(candidate.file_number).lock());
+  }
+  return std::unique_ptr<BlobGC>(new BlobGC(
+      std::move(blob_files), std::move(cf_options_), maybe_continue_next_time));
+}
 
-  uint64_t batch_size = 0;
-  uint64_t estimate_output_size = 0;
-  bool stop_picking = false;
-  bool maybe_continue_next_time = false;
-  uint64_t next_gc_size = 0;
-  for (auto& gc_score : blob_storage->gc_score()) {
-    if (gc_score.score < cf_options_.blob_file_discardable_ratio) {
-      break;
-    }
+std::vector<GCCandidate> BasicBlobGCPicker::GetCandidates(
+    BlobStorage* blob_storage) {
+  std::vector<GCScore> scores = CandidateFiles(blob_storage);
+  if (cf_options_.gc_key_range_clustering) {
+    ClusterByKeyRange(blob_storage, &scores);
+  }
+  std::vector<GCCandidate> candidates;
+  candidates.reserve(scores.size());
+  for (auto& gc_score : scores) {
     auto blob_file = blob_storage->FindFile(gc_score.file_number).lock();
     if (!CheckBlobFile(blob_file.get())) {
       // Skip this file id this file is being GCed
       // or this file had been GCed
       ROCKS_LOG_INFO(db_options_.info_log, "Blob file %" PRIu64 " no need gc",
-                     blob_file->file_number());
+                     gc_score.file_number);
       continue;
     }
+    GCCandidate candidate;
+    candidate.file_number = blob_file->file_number();
+    candidate.file_size = blob_file->file_size();
+    candidate.live_data_size = blob_file->live_data_size();
+    candidate.discardable_ratio = blob_file->GetDiscardableRatio();
+    candidates.push_back(candidate);
+  }
+  return candidates;
+}
+
+bool BasicBlobGCPicker::NextBatch(const std::vector<GCCandidate>& candidates,
+                                  size_t* start,
+                                  std::vector<GCCandidate>* batch,
+                                  bool* trigger_next) {
+  std::vector<GCCandidate>& blob_files = *batch;
+  blob_files.clear();
+
+  uint64_t batch_size = 0;
+  uint64_t estimate_output_size = 0;
+  bool stop_picking = false;
+  bool maybe_continue_next_time = false;
+  uint64_t next_gc_size = 0;
+  size_t end = *start;
+  for (size_t i = *start; i < candidates.size(); i++) {
+    const GCCandidate& blob_file = candidates[i];
     if (!stop_picking) {
-      blob_files.emplace_back(blob_file);
-      batch_size += blob_file->file_size();
-      estimate_output_size += blob_file->live_data_size();
+      blob_files.push_back(blob_file);
+      end = i + 1;
+      batch_size += blob_file.file_size;
+      estimate_output_size += blob_file.live_data_size;
       if (batch_size >= cf_options_.max_gc_batch_size ||
           estimate_output_size >= cf_options_.blob_file_target_size) {
         // Stop pick file for this gc, but still check file for whether need
@@ -49,7 +91,7 @@ std::unique_ptr<BlobGC> BasicBlobGCPicker::PickBlobGC(
         stop_picking = true;
       }
     } else {
-      next_gc_size += blob_file->file_size();
+      next_gc_size += blob_file.file_size;
       if (next_gc_size > cf_options_.min_gc_batch_size) {
         maybe_continue_next_time = true;
         RecordTick(statistics(stats_), TITAN_GC_REMAIN, 1);
@@ -61,25 +103,99 @@ std::unique_ptr<BlobGC> BasicBlobGCPicker::PickBlobGC(
       }
     }
   }
+  *start = end;
   ROCKS_LOG_DEBUG(db_options_.info_log,
                   "got batch size %" PRIu64 ", estimate output %" PRIu64
                   " bytes",
                   batch_size, estimate_output_size);
+  *trigger_next = maybe_continue_next_time;
   if (blob_files.empty() ||
       (batch_size < cf_options_.min_gc_batch_size &&
        estimate_output_size < cf_options_.blob_file_target_size)) {
-    return nullptr;
+    return false;
   }
   // if there is only one small file to merge, no need to perform
   if (blob_files.size() == 1 &&
-      blob_files[0]->file_size() <= cf_options_.merge_small_file_threshold &&
-      blob_files[0]->GetDiscardableRatio() <
+      blob_files[0].file_size <= cf_options_.merge_small_file_threshold &&
+      blob_files[0].discardable_ratio <
           cf_options_.blob_file_discardable_ratio) {
-    return nullptr;
+    return false;
   }
+  return true;
+}
 
-  return std::unique_ptr<BlobGC>(new BlobGC(
-      std::move(blob_files), std::move(cf_options_), maybe_continue_next_time));
+std::vector<GCScore> BasicBlobGCPicker::CandidateFiles(
+    BlobStorage* blob_storage) {
+  std::vector<GCScore> candidates = blob_storage->gc_score();
+  auto end = std::find_if(candidates.begin(), candidates.end(),
+                          [this](const GCScore& gc_score) {
+                            return gc_score.score <
+                                   cf_options_.blob_file_discardable_ratio;
+                          });
+  candidates.erase(end, candidates.end());
+  return candidates;
+}
+
+void BasicBlobGCPicker::ClusterByKeyRange(
+    BlobStorage* blob_storage, std::vector<GCScore>* candidates) const {
+  auto cmp = cf_options_.comparator;
+  // Candidates with known key ranges, sorted by smallest key.
+  std::vector<std::pair<size_t, std::shared_ptr<BlobFileMeta>>> ranged;
+  ranged.reserve(candidates->size());
+  for (size_t i = 0; i < candidates->size(); i++) {
+    auto file = blob_storage->FindFile((*candidates)[i].file_number).lock();
+    if (file == nullptr || file->smallest_key().empty() ||
+        file->largest_key().empty()) {
+      continue;
+    }
+    ranged.emplace_back(i, std::move(file));
+  }
+  std::sort(ranged.begin(), ranged.end(),
+            [cmp](const std::pair<size_t, std::shared_ptr<BlobFileMeta>>& a,
+                  const std::pair<size_t, std::shared_ptr<BlobFileMeta>>& b) {
+              return cmp->Compare(a.second->smallest_key(),
+                                  b.second->smallest_key()) < 0;
+            });
+
+  // Sweep the files by smallest key, a file joins the cluster of the files
+  // before it if it starts before the largest key seen so far. Candidates
+  // with unknown key ranges are clusters of their own.
+  std::vector<size_t> cluster_of(candidates->size());
+  for (size_t i = 0; i < candidates->size(); i++) {
+    cluster_of[i] = i;
+  }
+  Slice largest;
+  size_t cluster = 0;
+  for (size_t i = 0; i < ranged.size(); i++) {
+    const auto& file = ranged[i].second;
+    if (i == 0 || cmp->Compare(file->smallest_key(), largest) > 0) {
+      cluster = ranged[i].first;
+      largest = file->largest_key();
+    } else if (cmp->Compare(file->largest_key(), largest) > 0) {
+      largest = file->largest_key();
+    }
+    cluster_of[ranged[i].first] = cluster;
+  }
+
+  // Members of each cluster in the order of their scores.
+  std::unordered_map<size_t, std::vector<size_t>> members;
+  for (size_t i = 0; i < candidates->size(); i++) {
+    members[cluster_of[i]].push_back(i);
+  }
+  std::vector<GCScore> clustered;
+  clustered.reserve(candidates->size());
+  for (size_t i = 0; i < candidates->size(); i++) {
+    auto it = members.find(cluster_of[i]);
+    if (it == members.end()) {
+      // Cluster taken by a file with better score.
+      continue;
+    }
+    for (size_t member : it->second) {
+      clustered.push_back((*candidates)[member]);
+    }
+    members.erase(it);
+  }
+  candidates->swap(clustered);
 }
 
 bool BasicBlobGCPicker::CheckBlobFile(BlobFileMeta* blob_file) const {
@@ -92,5 +208,73 @@ bool BasicBlobGCPicker::CheckBlobFile(BlobFileMeta* blob_file) const {
   return true;
 }
 
+CostBenefitBlobGCPicker::CostBenefitBlobGCPicker(TitanDBOptions db_options,
+                                                 TitanCFOptions cf_options,
+                                                 TitanStats* stats)
+    : BasicBlobGCPicker(db_options, cf_options, stats) {}
+
+std::vector<GCScore> CostBenefitBlobGCPicker::CandidateFiles(
+    BlobStorage* blob_storage) {
+  std::vector<GCScore> candidates =
+      BasicBlobGCPicker::CandidateFiles(blob_storage);
+  int64_t now = 0;
+  Status s = db_options_.env->GetCurrentTime(&now);
+  if (!s.ok()) {
+    ROCKS_LOG_WARN(db_options_.info_log,
+                   "Failed to get current time for GC picking: %s",
+                   s.ToString().c_str());
+    return candidates;
+  }
+  for (auto& gc_score : candidates) {
+    auto blob_file = blob_storage->FindFile(gc_score.file_number).lock();
+    if (blob_file == nullptr) {
+      continue;
+    }
+    // Small files are candidates with the score of the discardable ratio
+    // threshold, so take the score instead of their real discardable ratio.
+    gc_score.score = Score(blob_file.get(), gc_score.score,
+                           static_cast<uint64_t>(now));
+  }
+  std::stable_sort(candidates.begin(), candidates.end(),
+                   [](const GCScore& first, const GCScore& second) {
+                     return first.score > second.score;
+                   });
+  return candidates;
+}
+
+double CostBenefitBlobGCPicker::Score(BlobFileMeta* blob_file,
+                                      double discardable_ratio,
+                                      uint64_t now) const {
+  // Creation time is 0 if the clock failed when the file was added.
+  uint64_t creation_time = blob_file->creation_time();
+  double age = static_cast<double>(
+      creation_time > 0 && now > creation_time ? now - creation_time : 0);
+  // Age of at least one second, so that young files still compete by free
+  // space.
+  age = std::max(age, 1.0);
+  if (blob_file->live_data_size() > 0) {
+    // Fraction of the live data discarded per second.
+    double decay = blob_file->DiscardRate(now) /
+                   static_cast<double>(blob_file->live_data_size());
+    age = age / (1 + decay * age);
+  }
+  double u = 1 - std::min(std::max(discardable_ratio, 0.0), 1.0);
+  return (1 - u) * age / (1 + u);
+}
+
+std::unique_ptr<BlobGCPicker> NewBlobGCPicker(const TitanDBOptions& db_options,
+                                              const TitanCFOptions& cf_options,
+                                              TitanStats* stats) {
+  switch (cf_options.gc_picker) {
+    case TitanBlobGCPickerType::kCostBenefit:
+      return std::unique_ptr<BlobGCPicker>(
+          new CostBenefitBlobGCPicker(db_options, cf_options, stats));
+    case TitanBlobGCPickerType::kBasic:
+    default:
+      return std::unique_ptr<BlobGCPicker>(
+          new BasicBlobGCPicker(db_options, cf_options, stats));
+  }
+}
+
 }  // namespace titandb
 }  // namespace rocksdb
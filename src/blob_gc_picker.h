@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 
 #include "db/column_family.h"
 #include "db/write_callback.h"
@@ -25,24 +26,83 @@ class BlobGCPicker {
   // Otherwise returns a pointer to a heap-allocated object that
   // describes the gc.  Caller should delete the result.
   virtual std::unique_ptr<BlobGC> PickBlobGC(BlobStorage* blob_storage) = 0;
+
+  // Returns the files which may be picked by GC, in the order they would be
+  // picked, with their sizes as they are now.
+  //
+  // REQUIRE: DB mutex held
+  virtual std::vector<GCCandidate> GetCandidates(
+      BlobStorage* blob_storage) = 0;
+
+  // Takes the next batch of files GC would pick from `candidates`, starting
+  // at `*start`, and moves `*start` past it. Returns false if there is no gc
+  // to be done. `trigger_next` tells if more files are left to gc. Needs no
+  // lock, so that batches after the first one can be estimated by calling
+  // it repeatedly on the same candidates.
+  virtual bool NextBatch(const std::vector<GCCandidate>& candidates,
+                         size_t* start, std::vector<GCCandidate>* batch,
+                         bool* trigger_next) = 0;
 };
 
-class BasicBlobGCPicker final : public BlobGCPicker {
+class BasicBlobGCPicker : public BlobGCPicker {
  public:
   BasicBlobGCPicker(TitanDBOptions, TitanCFOptions, TitanStats*);
   ~BasicBlobGCPicker();
 
   std::unique_ptr<BlobGC> PickBlobGC(BlobStorage* blob_storage) override;
 
- private:
+  std::vector<GCCandidate> GetCandidates(BlobStorage* blob_storage) override;
+
+  bool NextBatch(const std::vector<GCCandidate>& candidates, size_t* start,
+                 std::vector<GCCandidate>* batch, bool* trigger_next) override;
+
+ protected:
+  // Returns the files which are worth GC, in the order they should be
+  // picked.
+  virtual std::vector<GCScore> CandidateFiles(BlobStorage* blob_storage);
+
+  // Reorders candidates so that files with overlapping key ranges follow
+  // each other, while clusters still come in the order of their best file.
+  void ClusterByKeyRange(BlobStorage* blob_storage,
+                         std::vector<GCScore>* candidates) const;
+
   TitanDBOptions db_options_;
   TitanCFOptions cf_options_;
   TitanStats* stats_;
 
+ private:
   // Check if blob_file needs to gc, return true means we need pick this
   // file for gc
   bool CheckBlobFile(BlobFileMeta* blob_file) const;
 };
 
+// Picks blob files by the cost-benefit policy of log-structured file systems,
+// among the same candidates as the basic picker:
+//
+//   benefit / cost = (1 - u) * age / (1 + u)
+//
+// where u is the fraction of live data of the file, the cost is reading the
+// whole file and rewriting its live data, and the age tells how likely the
+// live data stays live. The age is the time since the file was created, but
+// no more than the expected time before its live data gets discarded at the
+// rate recently observed on compactions, so that files still decaying
+// quickly are left to free more space by themselves.
+class CostBenefitBlobGCPicker final : public BasicBlobGCPicker {
+ public:
+  CostBenefitBlobGCPicker(TitanDBOptions, TitanCFOptions, TitanStats*);
+
+ protected:
+  std::vector<GCScore> CandidateFiles(BlobStorage* blob_storage) override;
+
+ private:
+  double Score(BlobFileMeta* blob_file, double discardable_ratio,
+               uint64_t now) const;
+};
+
+// Creates the blob GC picker specified by `cf_options.gc_picker`.
+std::unique_ptr<BlobGCPicker> NewBlobGCPicker(const TitanDBOptions& db_options,
+                                              const TitanCFOptions& cf_options,
+                                              TitanStats* stats);
+
 }  // namespace titandb
 }  // namespace rocksdb
@@ -42,6 +42,18 @@ class BlobGCPickerTest : public testing::Test {
     blob_storage_->files_[file_number] = f;
   }
 
+  void AddBlobFileWithRange(uint64_t file_number, uint64_t data_size,
+                            uint64_t discardable_size,
+                            const std::string& smallest_key,
+                            const std::string& largest_key) {
+    auto f = std::make_shared<BlobFileMeta>(
+        file_number, data_size + kBlobMaxHeaderSize + kBlobFooterSize, 0, 0,
+        smallest_key, largest_key);
+    f->set_live_data_size(data_size - discardable_size);
+    f->FileStateTransit(BlobFileMeta::FileEvent::kDbRestart);
+    blob_storage_->AddBlobFile(f);
+  }
+
   void RemoveBlobFile(uint64_t file_number) {
     ASSERT_TRUE(blob_storage_->files_[file_number] != nullptr);
     blob_storage_->files_.erase(file_number);
@@ -160,6 +172,95 @@ TEST_F(BlobGCPickerTest, ParallelPickGC) {
   UpdateBlobStorage();
 }
 
+TEST_F(BlobGCPickerTest, KeyRangeClustering) {
+  TitanDBOptions titan_db_options;
+  TitanCFOptions titan_cf_options;
+  titan_cf_options.min_gc_batch_size = 0;
+  titan_cf_options.merge_small_file_threshold = 0;
+  // Pick two files at a time.
+  titan_cf_options.max_gc_batch_size = 2 << 20;
+  NewBlobStorageAndPicker(titan_db_options, titan_cf_options);
+  AddBlobFileWithRange(1U, 1U << 20, 900U << 10, "a", "c");
+  AddBlobFileWithRange(2U, 1U << 20, 800U << 10, "x", "z");
+  AddBlobFileWithRange(3U, 1U << 20, 600U << 10, "b", "d");
+  AddBlobFileWithRange(4U, 1U << 20, 550U << 10, "y", "y");
+  UpdateBlobStorage();
+  auto blob_gc = basic_blob_gc_picker_->PickBlobGC(blob_storage_.get());
+  ASSERT_TRUE(blob_gc != nullptr);
+  ASSERT_EQ(blob_gc->inputs().size(), 2);
+  ASSERT_EQ(blob_gc->inputs()[0]->file_number(), 1U);
+  ASSERT_EQ(blob_gc->inputs()[1]->file_number(), 2U);
+
+  titan_cf_options.gc_key_range_clustering = true;
+  NewBlobStorageAndPicker(titan_db_options, titan_cf_options);
+  AddBlobFileWithRange(1U, 1U << 20, 900U << 10, "a", "c");
+  AddBlobFileWithRange(2U, 1U << 20, 800U << 10, "x", "z");
+  AddBlobFileWithRange(3U, 1U << 20, 600U << 10, "b", "d");
+  AddBlobFileWithRange(4U, 1U << 20, 550U << 10, "y", "y");
+  UpdateBlobStorage();
+  blob_gc = basic_blob_gc_picker_->PickBlobGC(blob_storage_.get());
+  ASSERT_TRUE(blob_gc != nullptr);
+  ASSERT_EQ(blob_gc->inputs().size(), 2);
+  ASSERT_EQ(blob_gc->inputs()[0]->file_number(), 1U);
+  ASSERT_EQ(blob_gc->inputs()[1]->file_number(), 3U);
+  blob_gc = basic_blob_gc_picker_->PickBlobGC(blob_storage_.get());
+  ASSERT_TRUE(blob_gc != nullptr);
+  ASSERT_EQ(blob_gc->inputs().size(), 2);
+  ASSERT_EQ(blob_gc->inputs()[0]->file_number(), 2U);
+  ASSERT_EQ(blob_gc->inputs()[1]->file_number(), 4U);
+}
+
+TEST_F(BlobGCPickerTest, CostBenefit) {
+  TitanDBOptions titan_db_options;
+  TitanCFOptions titan_cf_options;
+  titan_cf_options.min_gc_batch_size = 0;
+  // Pick one file at a time.
+  titan_cf_options.max_gc_batch_size = 1;
+  titan_cf_options.merge_small_file_threshold = 0;
+  titan_cf_options.gc_picker = TitanBlobGCPickerType::kCostBenefit;
+  NewBlobStorageAndPicker(titan_db_options, titan_cf_options);
+  auto picker = NewBlobGCPicker(titan_db_options, titan_cf_options, nullptr);
+  int64_t now = 0;
+  ASSERT_OK(titan_db_options.env->GetCurrentTime(&now));
+
+  // A young file with more discardable data loses to an old file.
+  AddBlobFile(1U, 1U << 20, 800U << 10);
+  blob_storage_->FindFile(1U).lock()->set_creation_time(now - 10);
+  AddBlobFile(2U, 1U << 20, 600U << 10);
+  blob_storage_->FindFile(2U).lock()->set_creation_time(now - 100000);
+  UpdateBlobStorage();
+  auto blob_gc = picker->PickBlobGC(blob_storage_.get());
+  ASSERT_TRUE(blob_gc != nullptr);
+  ASSERT_EQ(blob_gc->inputs().size(), 1);
+  ASSERT_EQ(blob_gc->inputs()[0]->file_number(), 2U);
+  // The basic picker goes for the most discardable file.
+  blob_gc = basic_blob_gc_picker_->PickBlobGC(blob_storage_.get());
+  ASSERT_TRUE(blob_gc != nullptr);
+  ASSERT_EQ(blob_gc->inputs()[0]->file_number(), 1U);
+
+  // An old file whose live data is still being discarded quickly is left to
+  // decay further.
+  NewBlobStorageAndPicker(titan_db_options, titan_cf_options);
+  AddBlobFile(1U, 1U << 20, 600U << 10);
+  blob_storage_->FindFile(1U).lock()->set_creation_time(now - 100000);
+  blob_storage_->FindFile(1U).lock()->RecordDiscard(100U << 10, now);
+  AddBlobFile(2U, 1U << 20, 600U << 10);
+  blob_storage_->FindFile(2U).lock()->set_creation_time(now - 50000);
+  UpdateBlobStorage();
+  blob_gc = picker->PickBlobGC(blob_storage_.get());
+  ASSERT_TRUE(blob_gc != nullptr);
+  ASSERT_EQ(blob_gc->inputs().size(), 1);
+  ASSERT_EQ(blob_gc->inputs()[0]->file_number(), 2U);
+
+  // Files below the discardable ratio threshold are not picked regardless of
+  // their age.
+  NewBlobStorageAndPicker(titan_db_options, titan_cf_options);
+  AddBlobFile(1U, 16U << 20, 1U << 20);
+  blob_storage_->FindFile(1U).lock()->set_creation_time(now - 1000000);
+  UpdateBlobStorage();
+  ASSERT_TRUE(picker->PickBlobGC(blob_storage_.get()) == nullptr);
+}
+
 }  // namespace titandb
 }  // namespace rocksdb
 
@@ -60,12 +60,14 @@ class BlobIndexMergeOperator : public MergeOperator {
       }
       if (existing_index_valid) {
         if (index.source_file_number == existing_index.file_number &&
-            index.source_file_offset == existing_index.blob_handle.offset) {
+            index.source_file_offset == existing_index.blob_handle.offset &&
+            index.source_slot == existing_index.blob_handle.slot) {
           existing_index_valid = false;
           merge_index = index;
         }
       } else if (index.source_file_number == merge_index.file_number &&
-                 index.source_file_offset == merge_index.blob_handle.offset) {
+                 index.source_file_offset == merge_index.blob_handle.offset &&
+                 index.source_slot == merge_index.blob_handle.slot) {
         merge_index = index;
       }
     }
@@ -67,6 +67,42 @@ Status BlobStorage::GetBlobFilesInRanges(const RangePtr* ranges, size_t n,
   return Status::OK();
 }
 
+uint64_t BlobStorage::ReclaimableSize() {
+  MutexLock l(&mutex_);
+  uint64_t size = 0;
+  for (auto& file : files_) {
+    const auto& meta = file.second;
+    if (meta->file_state() != BlobFileMeta::FileState::kNormal ||
+        meta->GetDiscardableRatio() < cf_options_.blob_file_discardable_ratio) {
+      continue;
+    }
+    if (meta->allocated_size() > meta->live_data_size()) {
+      size += meta->allocated_size() - meta->live_data_size();
+    }
+  }
+  return size;
+}
+
+double BlobStorage::SpaceAmplification() {
+  MutexLock l(&mutex_);
+  uint64_t file_size = 0;
+  uint64_t live_data_size = 0;
+  for (auto& file : files_) {
+    const auto& meta = file.second;
+    if (meta->file_state() != BlobFileMeta::FileState::kNormal &&
+        meta->file_state() != BlobFileMeta::FileState::kBeingGC &&
+        meta->file_state() != BlobFileMeta::FileState::kToMerge) {
+      continue;
+    }
+    file_size += meta->allocated_size();
+    live_data_size += meta->live_data_size();
+  }
+  if (live_data_size == 0) {
+    return 0;
+  }
+  return static_cast<double>(file_size) / live_data_size;
+}
+
 std::weak_ptr<BlobFileMeta> BlobStorage::FindFile(uint64_t file_number) const {
   MutexLock l(&mutex_);
   auto it = files_.find(file_number);
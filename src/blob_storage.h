@@ -47,6 +47,11 @@ class BlobStorage {
 
   const TitanCFOptions& cf_options() { return cf_options_; }
 
+  // Shared compression dictionaries of blob files.
+  const std::shared_ptr<BlobCompressionDicts>& compression_dicts() const {
+    return file_cache_->compression_dicts();
+  }
+
   const std::vector<GCScore> gc_score() {
     MutexLock l(&mutex_);
     return gc_score_;
@@ -62,6 +67,15 @@ class BlobStorage {
   Status NewPrefetcher(uint64_t file_number,
                        std::unique_ptr<BlobFilePrefetcher>* result);
 
+  // Returns the bytes GC can reclaim from files which are not being GC and
+  // have reached the discardable ratio threshold.
+  uint64_t ReclaimableSize();
+
+  // Returns size of blob files, excluding punched holes, over size of live
+  // data in them, or 0 if there is no live data. Files whose live data size
+  // is not known yet, i.e. pending flush or GC, are not counted.
+  double SpaceAmplification();
+
   // Get all the blob files within the ranges.
   Status GetBlobFilesInRanges(const RangePtr* ranges, size_t n,
                               bool include_end, std::vector<uint64_t>* files);
@@ -132,6 +146,30 @@ class BlobStorage {
     return obsolete_files_.size();
   }
 
+  // Sets the live size checkpoint recovered from or written to the manifest,
+  // see `LiveSizeCheckpoint`.
+  void SetLiveSizeCheckpoint(std::unique_ptr<LiveSizeCheckpoint>&& checkpoint) {
+    MutexLock l(&mutex_);
+    live_size_checkpoint_ = std::move(checkpoint);
+  }
+
+  // Takes the live size checkpoint away, nullptr if there is none. It is
+  // taken when live data sizes are initialized on DB open and replaced by
+  // one of the SSTs of the opened DB.
+  std::unique_ptr<LiveSizeCheckpoint> TakeLiveSizeCheckpoint() {
+    MutexLock l(&mutex_);
+    return std::move(live_size_checkpoint_);
+  }
+
+  // Applies the delta of a flush or compaction to the live size checkpoint.
+  // Ignored if there is no checkpoint.
+  void ApplyLiveSizeDelta(const LiveSizeDelta& delta) {
+    MutexLock l(&mutex_);
+    if (live_size_checkpoint_ != nullptr) {
+      live_size_checkpoint_->Apply(delta);
+    }
+  }
+
   // Exports all blob files' meta. Only for tests.
   void ExportBlobFiles(
       std::map<uint64_t, std::weak_ptr<BlobFileMeta>>& ret) const;
@@ -182,6 +220,9 @@ class BlobStorage {
   std::vector<GCScore> gc_score_;
 
   std::list<std::pair<uint64_t, SequenceNumber>> obsolete_files_;
+
+  // Kept until taken so that it survives rewriting the manifest on DB open.
+  std::unique_ptr<LiveSizeCheckpoint> live_size_checkpoint_;
   // It is marked when the column family handle is destroyed, indicating the
   // in-memory data structure can be destroyed. Physical files may still be
   // kept.
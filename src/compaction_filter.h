@@ -10,6 +10,8 @@
 namespace rocksdb {
 namespace titandb {
 
+// Drops deletion markers left by GC, and applies the compaction filter of
+// the user, if any, to values of blob indexes.
 class TitanCompactionFilter final : public CompactionFilter {
  public:
   TitanCompactionFilter(TitanDBImpl *db, const std::string &cf_name,
@@ -23,10 +25,11 @@ class TitanCompactionFilter final : public CompactionFilter {
         original_filter_(original),
         owned_filter_(std::move(owned_filter)),
         skip_value_(skip_value),
-        filter_name_(std::string("TitanCompactionfilter.")
-                         .append(original_filter_->Name())) {
+        filter_name_("TitanCompactionfilter") {
     assert(blob_storage_ != nullptr);
-    assert(original_filter_ != nullptr);
+    if (original_filter_ != nullptr) {
+      filter_name_.append(".").append(original_filter_->Name());
+    }
   }
 
   const char *Name() const override { return filter_name_.c_str(); }
@@ -35,17 +38,17 @@ class TitanCompactionFilter final : public CompactionFilter {
                     ValueType value_type, const Slice &value,
                     std::string *new_value,
                     std::string *skip_until) const override {
-    if (skip_value_) {
-      return original_filter_->FilterV3(level, key, seqno, value_type, Slice(),
-                                        new_value, skip_until);
-    }
     if (value_type != kBlobIndex) {
-      return original_filter_->FilterV3(level, key, seqno, value_type, value,
+      if (original_filter_ == nullptr) {
+        return Decision::kKeep;
+      }
+      return original_filter_->FilterV3(level, key, seqno, value_type,
+                                        skip_value_ ? Slice() : value,
                                         new_value, skip_until);
     }
 
     BlobIndex blob_index;
-    Slice original_value(value.data());
+    Slice original_value(value);
     Status s = blob_index.DecodeFrom(&original_value);
     if (!s.ok()) {
       ROCKS_LOG_ERROR(db_->db_options_.info_log,
@@ -60,9 +63,18 @@ class TitanCompactionFilter final : public CompactionFilter {
       return Decision::kKeep;
     }
     if (BlobIndex::IsDeletionMarker(blob_index)) {
-      // TODO(yiwu): handle deletion marker at bottom level.
+      // A deletion marker reads as a deletion, which it is turned into. The
+      // deletion hides older versions the same way, and is dropped right away
+      // at the bottom level.
+      return Decision::kRemove;
+    }
+    if (original_filter_ == nullptr) {
       return Decision::kKeep;
     }
+    if (skip_value_) {
+      return original_filter_->FilterV3(level, key, seqno, value_type, Slice(),
+                                        new_value, skip_until);
+    }
 
     BlobRecord record;
     PinnableSlice buffer;
@@ -121,14 +133,12 @@ class TitanCompactionFilterFactory final : public CompactionFilterFactory {
         original_filter_factory_(original_filter_factory),
         titan_db_impl_(db),
         skip_value_(skip_value),
-        cf_name_(cf_name) {
-    assert(original_filter != nullptr || original_filter_factory != nullptr);
+        cf_name_(cf_name),
+        factory_name_("TitanCompactionFilterFactory") {
     if (original_filter_ != nullptr) {
-      factory_name_ = std::string("TitanCompactionFilterFactory.")
-                          .append(original_filter_->Name());
-    } else {
-      factory_name_ = std::string("TitanCompactionFilterFactory.")
-                          .append(original_filter_factory_->Name());
+      factory_name_.append(".").append(original_filter_->Name());
+    } else if (original_filter_factory_ != nullptr) {
+      factory_name_.append(".").append(original_filter_factory_->Name());
     }
   }
 
@@ -136,8 +146,6 @@ class TitanCompactionFilterFactory final : public CompactionFilterFactory {
 
   std::unique_ptr<CompactionFilter> CreateCompactionFilter(
       const CompactionFilter::Context &context) override {
-    assert(original_filter_ != nullptr || original_filter_factory_ != nullptr);
-
     std::shared_ptr<BlobStorage> blob_storage;
     {
       MutexLock l(&titan_db_impl_->mutex_);
@@ -153,16 +161,12 @@ class TitanCompactionFilterFactory final : public CompactionFilterFactory {
 
     const CompactionFilter *original_filter = original_filter_;
     std::unique_ptr<CompactionFilter> original_filter_from_factory;
-    if (original_filter == nullptr) {
+    if (original_filter == nullptr && original_filter_factory_ != nullptr) {
       original_filter_from_factory =
           original_filter_factory_->CreateCompactionFilter(context);
       original_filter = original_filter_from_factory.get();
     }
 
-    if (original_filter == nullptr) {
-      return nullptr;
-    }
-
     return std::unique_ptr<CompactionFilter>(new TitanCompactionFilter(
         titan_db_impl_, cf_name_, original_filter,
         std::move(original_filter_from_factory), blob_storage, skip_value_));
@@ -177,6 +177,60 @@ TEST_F(TitanCompactionFilterTest, CompactSkipValue) {
   ASSERT_TRUE(db_->Get(ReadOptions(), "skip-key", &value).IsNotFound());
 }
 
+TEST_F(TitanCompactionFilterTest, NoFilterInstalledByDefault) {
+  // Without a compaction filter of the user or GC leaving deletion markers,
+  // the base DB gets no compaction filter, so CompactRange() doesn't rewrite
+  // the bottommost level by default.
+  delete options_.compaction_filter;
+  options_.compaction_filter = nullptr;
+  Open();
+  Options base_options = db_->GetBaseDB()->GetOptions();
+  ASSERT_TRUE(base_options.compaction_filter == nullptr);
+  ASSERT_TRUE(base_options.compaction_filter_factory == nullptr);
+  Close();
+
+  options_.gc_merge_rewrite = true;
+  Open();
+  base_options = db_->GetBaseDB()->GetOptions();
+  ASSERT_TRUE(base_options.compaction_filter_factory != nullptr);
+}
+
+TEST_F(TitanCompactionFilterTest, DropDeletionMarker) {
+  // Deletion markers are dropped without a compaction filter of the user.
+  delete options_.compaction_filter;
+  options_.compaction_filter = nullptr;
+  options_.gc_merge_rewrite = true;
+  Open();
+
+  // A GC rewrite on top of a deletion merges into a deletion marker.
+  MergeBlobIndex index;
+  index.file_number = 2;
+  index.blob_handle.offset = 10;
+  index.blob_handle.size = 10;
+  index.source_file_number = 1;
+  index.source_file_offset = 10;
+  std::string operand;
+  index.EncodeTo(&operand);
+  ASSERT_OK(db_->Delete(WriteOptions(), "deleted-key"));
+  ASSERT_OK(db_->Flush(FlushOptions()));
+  ASSERT_OK(db_->GetBaseDB()->Merge(WriteOptions(), "deleted-key", operand));
+  ASSERT_OK(db_->Flush(FlushOptions()));
+  CompactRangeOptions copts;
+  copts.bottommost_level_compaction = BottommostLevelCompaction::kForce;
+  ASSERT_OK(db_->CompactRange(copts, nullptr, nullptr));
+  ASSERT_OK(db_->CompactRange(copts, nullptr, nullptr));
+
+  std::string value;
+  ASSERT_TRUE(Get("deleted-key", &value).IsNotFound());
+  TablePropertiesCollection props;
+  ASSERT_OK(db_->GetPropertiesOfAllTables(&props));
+  uint64_t num_entries = 0;
+  for (auto &prop : props) {
+    num_entries += prop.second->num_entries;
+  }
+  ASSERT_EQ(0U, num_entries);
+}
+
 }  // namespace titandb
 }  // namespace rocksdb
 
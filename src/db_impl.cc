@@ -14,8 +14,10 @@
 #include "compaction_filter.h"
 #include "db_iter.h"
 #include "logging/log_buffer.h"
+#include "min_blob_size_tuner.h"
 #include "monitoring/statistics_impl.h"
 #include "port/port.h"
+#include "rocksdb/rate_limiter.h"
 #include "table_factory.h"
 #include "titan_build_version.h"
 #include "titan_stats.h"
@@ -26,6 +28,44 @@
 namespace rocksdb {
 namespace titandb {
 
+namespace {
+
+// Sums up sizes of puts and merges of a write batch by column family.
+// Deletions are left out, as they are never delayed.
+class WriteSizeCollector : public WriteBatch::Handler {
+ public:
+  Status PutCF(uint32_t column_family_id, const Slice& key,
+               const Slice& value) override {
+    sizes_[column_family_id] += key.size() + value.size();
+    return Status::OK();
+  }
+  Status MergeCF(uint32_t column_family_id, const Slice& key,
+                 const Slice& value) override {
+    sizes_[column_family_id] += key.size() + value.size();
+    return Status::OK();
+  }
+  Status DeleteCF(uint32_t /*column_family_id*/,
+                  const Slice& /*key*/) override {
+    return Status::OK();
+  }
+  Status SingleDeleteCF(uint32_t /*column_family_id*/,
+                        const Slice& /*key*/) override {
+    return Status::OK();
+  }
+  Status DeleteRangeCF(uint32_t /*column_family_id*/,
+                       const Slice& /*begin_key*/,
+                       const Slice& /*end_key*/) override {
+    return Status::OK();
+  }
+
+  const std::map<uint32_t, uint64_t>& sizes() const { return sizes_; }
+
+ private:
+  std::map<uint32_t, uint64_t> sizes_;
+};
+
+}  // namespace
+
 class TitanDBImpl::FileManager : public BlobFileManager {
  public:
   FileManager(TitanDBImpl* db) : db_(db) {}
@@ -62,6 +102,10 @@ class TitanDBImpl::FileManager : public BlobFileManager {
     Status s;
     VersionEdit edit;
     edit.SetColumnFamilyID(cf_id);
+    int64_t now = 0;
+    if (!db_->env_->GetCurrentTime(&now).ok()) {
+      now = 0;
+    }
     for (auto& file : files) {
       RecordTick(statistics(db_->stats_.get()), TITAN_BLOB_FILE_SYNCED);
       {
@@ -79,7 +123,16 @@ class TitanDBImpl::FileManager : public BlobFileManager {
                      file.first->file_number(),
                      Slice(file.first->smallest_key()).ToString(true).c_str(),
                      Slice(file.first->largest_key()).ToString(true).c_str());
+      // The file is not visible to GC yet, no need to hold the mutex. GC
+      // outputs come with the creation time of their inputs.
+      if (file.first->creation_time() == 0) {
+        file.first->set_creation_time(static_cast<uint64_t>(now));
+      }
       edit.AddBlobFile(file.first);
+      if (file.first->creation_time() > 0) {
+        edit.SetBlobFileCreationTime(file.first->file_number(),
+                                     file.first->creation_time());
+      }
     }
     s = db_->directory_->Fsync();
     if (!s.ok()) {
@@ -88,6 +141,15 @@ class TitanDBImpl::FileManager : public BlobFileManager {
 
     {
       MutexLock l(&db_->mutex_);
+      // None of the records is referenced by SSTs yet, so all records which
+      // will be dropped are caught from here on.
+      auto blob_storage = db_->blob_file_set_->GetBlobStorage(cf_id).lock();
+      if (blob_storage != nullptr &&
+          blob_storage->cf_options().track_blob_record_deletions) {
+        for (const auto& file : files) {
+          edit.SetBlobDeletionTracked(file.first->file_number(), true);
+        }
+      }
       s = db_->blob_file_set_->LogAndApply(edit);
       if (!s.ok()) {
         db_->SetBGError(s);
@@ -170,6 +232,16 @@ void TitanDBImpl::StartBackgroundTasks() {
         [this]() { TitanDBImpl::DumpStats(); }, "titanst", env_,
         db_options_.titan_stats_dump_period_sec * 1000 * 1000));
   }
+  if (thread_adjust_gc_rate_ == nullptr && db_options_.adaptive_gc_rate &&
+      db_options_.gc_rate_limiter != nullptr) {
+    gc_rate_controller_.reset(new GCRateController(
+        static_cast<uint64_t>(db_options_.gc_rate_limiter->GetBytesPerSecond()),
+        db_options_.adaptive_gc_rate_target_latency_micros,
+        db_options_.adaptive_gc_rate_max_space_amp));
+    thread_adjust_gc_rate_.reset(new rocksdb::RepeatableThread(
+        [this]() { TitanDBImpl::AdjustGCRate(); }, "titangcrt", env_,
+        1000 * 1000));
+  }
 }
 
 Status TitanDBImpl::ValidateOptions(
@@ -182,6 +254,15 @@ Status TitanDBImpl::ValidateOptions(
           "Require enabling level_compaction_dynamic_level_bytes for "
           "level_merge");
     }
+    // Files are not picked by GC until they reach the discardable ratio, so
+    // the space amplification can stay at 1 / (1 - ratio) for good.
+    double target = cf.options.max_blob_space_amplification;
+    if (target > 0 &&
+        target * (1 - cf.options.blob_file_discardable_ratio) < 1) {
+      return Status::InvalidArgument(
+          "max_blob_space_amplification must be at least "
+          "1 / (1 - blob_file_discardable_ratio)");
+    }
   }
   return Status::OK();
 }
@@ -269,19 +350,26 @@ Status TitanDBImpl::OpenImpl(const std::vector<TitanCFDescriptor>& descs,
     cf_opts.disable_auto_compactions = true;
     cf_opts.table_properties_collector_factories.emplace_back(
         std::make_shared<BlobFileSizeCollectorFactory>());
+    if (desc.options.track_blob_record_deletions) {
+      cf_opts.table_properties_collector_factories.emplace_back(
+          std::make_shared<BlobRecordCollectorFactory>());
+    }
     titan_table_factories.push_back(std::make_shared<TitanTableFactory>(
         db_options_, desc.options, this, blob_manager_, &mutex_,
         blob_file_set_.get(), stats_.get()));
     cf_opts.table_factory = titan_table_factories.back();
     cf_opts.merge_operator = shared_merge_operator_;
+    // Also installed without a compaction filter of the user if GC leaves
+    // deletion markers, see `gc_merge_rewrite`. Any compaction filter makes
+    // the base DB compact the bottommost level in CompactRange by default.
     if (cf_opts.compaction_filter != nullptr ||
-        cf_opts.compaction_filter_factory != nullptr) {
-      std::shared_ptr<TitanCompactionFilterFactory> titan_cf_factory =
+        cf_opts.compaction_filter_factory != nullptr ||
+        desc.options.gc_merge_rewrite) {
+      cf_opts.compaction_filter_factory =
           std::make_shared<TitanCompactionFilterFactory>(
               cf_opts.compaction_filter, cf_opts.compaction_filter_factory,
               this, desc.options.skip_value_in_compaction_filter, desc.name);
       cf_opts.compaction_filter = nullptr;
-      cf_opts.compaction_filter_factory = titan_cf_factory;
     }
   }
   // Initialize GC thread pool.
@@ -312,7 +400,9 @@ Status TitanDBImpl::OpenImpl(const std::vector<TitanCFDescriptor>& descs,
                           ImmutableTitanCFOptions(descs[i].options),
                           MutableTitanCFOptions(descs[i].options),
                           descs[i].options.table_factory /*base_table_factory*/,
-                          titan_table_factories[i]}));
+                          titan_table_factories[i],
+                          descs[i].options.compaction_filter,
+                          descs[i].options.compaction_filter_factory}));
     column_families[(*handles)[i]->GetID()] = descs[i].options;
     if (!descs[i].options.disable_auto_compactions) {
       cf_with_compaction.push_back((*handles)[i]);
@@ -374,6 +464,10 @@ Status TitanDBImpl::CloseImpl() {
     shuting_down_.store(true, std::memory_order_release);
   }
 
+  if (thread_adjust_gc_rate_ != nullptr) {
+    thread_adjust_gc_rate_->cancel();
+  }
+
   if (thread_pool_ != nullptr) {
     thread_pool_->JoinAllThreads();
   }
@@ -399,6 +493,10 @@ Status TitanDBImpl::CloseImpl() {
 Status TitanDBImpl::CreateColumnFamilies(
     const std::vector<TitanCFDescriptor>& descs,
     std::vector<ColumnFamilyHandle*>* handles) {
+  Status s = ValidateOptions(db_options_, descs);
+  if (!s.ok()) {
+    return s;
+  }
   std::vector<ColumnFamilyDescriptor> base_descs;
   std::vector<std::shared_ptr<TableFactory>> base_table_factory;
   std::vector<std::shared_ptr<TitanTableFactory>> titan_table_factory;
@@ -412,21 +510,24 @@ Status TitanDBImpl::CreateColumnFamilies(
     options.table_factory = titan_table_factory.back();
     options.table_properties_collector_factories.emplace_back(
         std::make_shared<BlobFileSizeCollectorFactory>());
+    if (desc.options.track_blob_record_deletions) {
+      options.table_properties_collector_factories.emplace_back(
+          std::make_shared<BlobRecordCollectorFactory>());
+    }
     options.merge_operator = shared_merge_operator_;
-    base_descs.emplace_back(desc.name, options);
-
     if (options.compaction_filter != nullptr ||
-        options.compaction_filter_factory != nullptr) {
-      std::shared_ptr<TitanCompactionFilterFactory> titan_cf_factory =
+        options.compaction_filter_factory != nullptr ||
+        desc.options.gc_merge_rewrite) {
+      options.compaction_filter_factory =
           std::make_shared<TitanCompactionFilterFactory>(
               options.compaction_filter, options.compaction_filter_factory,
               this, desc.options.skip_value_in_compaction_filter, desc.name);
       options.compaction_filter = nullptr;
-      options.compaction_filter_factory = titan_cf_factory;
     }
+    base_descs.emplace_back(desc.name, options);
   }
 
-  Status s = db_impl_->CreateColumnFamilies(base_descs, handles);
+  s = db_impl_->CreateColumnFamilies(base_descs, handles);
   assert(handles->size() == descs.size());
 
   if (s.ok()) {
@@ -442,9 +543,24 @@ Status TitanDBImpl::CreateColumnFamilies(
             TitanColumnFamilyInfo(
                 {handle->GetName(), ImmutableTitanCFOptions(descs[i].options),
                  MutableTitanCFOptions(descs[i].options), base_table_factory[i],
-                 titan_table_factory[i]}));
+                 titan_table_factory[i], descs[i].options.compaction_filter,
+                 descs[i].options.compaction_filter_factory}));
       }
       blob_file_set_->AddColumnFamilies(column_families);
+      // New column families have no SSTs, so the live size checkpoints
+      // start empty and follow flushes and compactions.
+      for (auto& cf : column_families) {
+        VersionEdit edit;
+        edit.SetColumnFamilyID(cf.first);
+        edit.SetLiveSizeCheckpoint(LiveSizeCheckpoint());
+        Status checkpoint_status = blob_file_set_->LogAndApply(edit);
+        if (!checkpoint_status.ok()) {
+          ROCKS_LOG_WARN(db_options_.info_log,
+                         "Titan failed to log live size checkpoint for CF "
+                         "%" PRIu32 ": %s",
+                         cf.first, checkpoint_status.ToString().c_str());
+        }
+      }
     }
   }
   if (s.ok()) {
@@ -563,25 +679,157 @@ Status TitanDBImpl::Put(const rocksdb::WriteOptions& options,
                         rocksdb::ColumnFamilyHandle* column_family,
                         const rocksdb::Slice& key,
                         const rocksdb::Slice& value) {
-  return HasBGError() ? GetBGError()
-                      : db_->Put(options, column_family, key, value);
+  if (HasBGError()) return GetBGError();
+  Status s = MaybeDelayWrite(options, column_family->GetID(),
+                             key.size() + value.size());
+  return s.ok() ? db_->Put(options, column_family, key, value) : s;
 }
 
 Status TitanDBImpl::Write(const rocksdb::WriteOptions& options,
                           rocksdb::WriteBatch* updates) {
-  return HasBGError() ? GetBGError() : db_->Write(options, updates);
+  if (HasBGError()) return GetBGError();
+  Status s = MaybeDelayWrite(options, {updates});
+  return s.ok() ? db_->Write(options, updates) : s;
 }
 
 Status TitanDBImpl::MultiBatchWrite(const WriteOptions& options,
                                     std::vector<WriteBatch*>&& updates) {
-  return HasBGError() ? GetBGError()
-                      : db_->MultiBatchWrite(options, std::move(updates));
+  if (HasBGError()) return GetBGError();
+  Status s = MaybeDelayWrite(options, updates);
+  return s.ok() ? db_->MultiBatchWrite(options, std::move(updates)) : s;
 }
 
 Status TitanDBImpl::Delete(const rocksdb::WriteOptions& options,
                            rocksdb::ColumnFamilyHandle* column_family,
                            const rocksdb::Slice& key) {
-  return HasBGError() ? GetBGError() : db_->Delete(options, column_family, key);
+  if (HasBGError()) return GetBGError();
+  return db_->Delete(options, column_family, key);
+}
+
+Status TitanDBImpl::DeleteRange(const WriteOptions& options,
+                                ColumnFamilyHandle* column_family,
+                                const Slice& begin_key, const Slice& end_key) {
+  if (HasBGError()) return GetBGError();
+  uint32_t cf_id = column_family->GetID();
+  // Blob files which are live before the deletion is written only hold
+  // records older than it, so the ones within the range are fully covered.
+  // Files still being flushed may take newer records.
+  std::vector<uint64_t> covered_files;
+  if (!options.disableWAL) {
+    MutexLock l(&mutex_);
+    auto bs = blob_file_set_->GetBlobStorage(cf_id).lock();
+    if (bs != nullptr) {
+      RangePtr range(&begin_key, &end_key);
+      std::vector<uint64_t> files;
+      bs->GetBlobFilesInRanges(&range, 1, false /*include_end*/, &files);
+      for (uint64_t file_number : files) {
+        auto file = bs->FindFile(file_number).lock();
+        if (file != nullptr &&
+            file->file_state() == BlobFileMeta::FileState::kNormal) {
+          covered_files.push_back(file_number);
+        }
+      }
+    }
+  }
+  Status s = db_->DeleteRange(options, column_family, begin_key, end_key);
+  if (!s.ok() || covered_files.empty()) {
+    return s;
+  }
+  // The deletion must survive a crash once the files are gone.
+  if (!options.sync) {
+    s = db_->FlushWAL(true /*sync*/);
+    if (!s.ok()) {
+      return s;
+    }
+  }
+
+  MutexLock l(&mutex_);
+  auto bs = blob_file_set_->GetBlobStorage(cf_id).lock();
+  if (bs == nullptr) {
+    return s;
+  }
+  // Snapshots older than the deletion still see the files, which are purged
+  // only after them.
+  SequenceNumber obsolete_sequence = db_impl_->GetLatestSequenceNumber();
+  VersionEdit edit;
+  edit.SetColumnFamilyID(cf_id);
+  bool deleted = false;
+  for (uint64_t file_number : covered_files) {
+    auto file = bs->FindFile(file_number).lock();
+    // Files picked by GC meanwhile are left to it.
+    if (file != nullptr &&
+        file->file_state() == BlobFileMeta::FileState::kNormal) {
+      edit.DeleteBlobFile(file_number, obsolete_sequence);
+      deleted = true;
+    }
+  }
+  if (!deleted) {
+    return s;
+  }
+  s = blob_file_set_->LogAndApply(edit);
+  if (!s.ok()) {
+    SetBGError(s);
+    return s;
+  }
+  ROCKS_LOG_INFO(db_options_.info_log,
+                 "Titan deleted blob files covered by range deletion in "
+                 "column family [%s].",
+                 column_family->GetName().c_str());
+  UpdateBlobSpaceAmplification();
+  return s;
+}
+
+Status TitanDBImpl::MaybeDelayWrite(const WriteOptions& options,
+                                    uint32_t cf_id, uint64_t num_bytes) {
+  if (!blob_space_write_controller_.NeedsDelay()) {
+    return Status::OK();
+  }
+  return MaybeDelayWrite(options, {{cf_id, num_bytes}});
+}
+
+Status TitanDBImpl::MaybeDelayWrite(const WriteOptions& options,
+                                    const std::vector<WriteBatch*>& batches) {
+  if (!blob_space_write_controller_.NeedsDelay()) {
+    return Status::OK();
+  }
+  WriteSizeCollector collector;
+  for (auto* batch : batches) {
+    if (!batch->Iterate(&collector).ok()) {
+      // Records the handler doesn't know of, take the whole batch as written
+      // to the default column family.
+      return MaybeDelayWrite(
+          options, {{db_->DefaultColumnFamily()->GetID(),
+                     static_cast<uint64_t>(batch->GetDataSize())}});
+    }
+  }
+  return MaybeDelayWrite(options, collector.sizes());
+}
+
+Status TitanDBImpl::MaybeDelayWrite(
+    const WriteOptions& options, const std::map<uint32_t, uint64_t>& sizes) {
+  uint64_t delay = 0;
+  {
+    MutexLock l(&mutex_);
+    uint64_t num_bytes = 0;
+    for (const auto& cf_size : sizes) {
+      if (blob_space_delayed_cfs_.count(cf_size.first) > 0) {
+        num_bytes += cf_size.second;
+      }
+    }
+    if (num_bytes == 0) {
+      return Status::OK();
+    }
+    if (options.no_slowdown) {
+      return Status::Incomplete("Write stall");
+    }
+    delay = blob_space_write_controller_.GetDelay(env_, num_bytes);
+  }
+  if (delay > 0) {
+    RecordTick(statistics(stats_.get()), TITAN_BLOB_SPACE_WRITE_DELAY_MICROS,
+               delay);
+    env_->SleepForMicroseconds(static_cast<int>(delay));
+  }
+  return Status::OK();
 }
 
 Status TitanDBImpl::IngestExternalFile(
@@ -645,9 +893,16 @@ Status TitanDBImpl::GetImpl(const ReadOptions& options,
   mutex_.Unlock();
 
   if (storage) {
-    StopWatch read_sw(env_, statistics(stats_.get()),
-                      TITAN_BLOB_FILE_READ_MICROS);
-    s = storage->Get(options, index, &record, &buffer);
+    uint64_t read_micros = 0;
+    {
+      StopWatch read_sw(
+          env_, statistics(stats_.get()), TITAN_BLOB_FILE_READ_MICROS,
+          gc_rate_controller_ != nullptr ? &read_micros : nullptr);
+      s = storage->Get(options, index, &record, &buffer);
+    }
+    if (gc_rate_controller_ != nullptr) {
+      blob_read_latency_.Add(read_micros);
+    }
     RecordTick(statistics(stats_.get()), TITAN_BLOB_FILE_NUM_KEYS_READ);
     RecordTick(statistics(stats_.get()), TITAN_BLOB_FILE_BYTES_READ,
                index.blob_handle.size);
@@ -970,12 +1225,36 @@ Status TitanDBImpl::DeleteFilesInRanges(ColumnFamilyHandle* column_family,
     }
     SubStats(stats_.get(), cf_id, TitanInternalStats::LIVE_BLOB_SIZE, -delta);
   }
+  if (cf_options.track_blob_record_deletions) {
+    // The properties may be inaccurate as noted above, so the dropped
+    // records are not taken as dead. GC checks them against the LSM instead.
+    VersionEdit tracking_edit;
+    tracking_edit.SetColumnFamilyID(cf_id);
+    bool untracked = false;
+    for (const auto& file_size : blob_file_size_diff) {
+      auto file = bs->FindFile(file_size.first).lock();
+      if (file && !file->is_obsolete() && file->deletion_tracked()) {
+        tracking_edit.SetBlobDeletionTracked(file->file_number(), false);
+        untracked = true;
+      }
+    }
+    if (untracked) {
+      Status log_status = blob_file_set_->LogAndApply(tracking_edit);
+      if (!log_status.ok()) {
+        // Dead records would be trusted after reopen otherwise.
+        SetBGError(log_status);
+        return log_status;
+      }
+    }
+  }
   if (cf_options.level_merge) {
     blob_file_set_->LogAndApply(edit);
+    UpdateBlobSpaceAmplification();
   } else {
     bs->ComputeGCScore();
 
     AddToGCQueue(cf_id);
+    UpdateBlobSpaceAmplification();
     MaybeScheduleGC();
   }
 
@@ -1038,7 +1317,10 @@ Options TitanDBImpl::GetOptions(ColumnFamilyHandle* column_family) const {
 
   MutexLock l(&mutex_);
   if (cf_info_.count(cf_id) > 0) {
-    options.table_factory = cf_info_.at(cf_id).base_table_factory;
+    const TitanColumnFamilyInfo& cf_info = cf_info_.at(cf_id);
+    options.table_factory = cf_info.base_table_factory;
+    options.compaction_filter = cf_info.base_compaction_filter;
+    options.compaction_filter_factory = cf_info.base_compaction_filter_factory;
   } else {
     ROCKS_LOG_ERROR(
         db_options_.info_log,
@@ -1058,6 +1340,8 @@ Status TitanDBImpl::SetOptions(
   TitanBlobRunMode blob_run_mode = TitanBlobRunMode::kNormal;
   bool set_gc_merge_rewrite = false;
   bool gc_merge_rewrite = false;
+  bool set_min_blob_size = false;
+  uint64_t min_blob_size = 0;
   {
     auto p = opts.find("blob_run_mode");
     set_blob_run_mode = (p != opts.end());
@@ -1089,6 +1373,22 @@ Status TitanDBImpl::SetOptions(
       opts.erase(p);
     }
   }
+  {
+    auto p = opts.find("min_blob_size");
+    set_min_blob_size = (p != opts.end());
+    if (set_min_blob_size) {
+      try {
+        min_blob_size = ParseUint64(p->second);
+      } catch (std::exception& e) {
+        return Status::InvalidArgument("Error parsing " + p->second + ":" +
+                                       std::string(e.what()));
+      }
+      ROCKS_LOG_INFO(db_options_.info_log,
+                     "[%s] Set min_blob_size: %" PRIu64,
+                     column_family->GetName().c_str(), min_blob_size);
+      opts.erase(p);
+    }
+  }
   if (opts.size() > 0) {
     s = db_->SetOptions(column_family, opts);
     if (!s.ok()) {
@@ -1096,7 +1396,7 @@ Status TitanDBImpl::SetOptions(
     }
   }
   // Make sure base db's SetOptions success before setting blob_run_mode.
-  if (set_blob_run_mode || set_gc_merge_rewrite) {
+  if (set_blob_run_mode || set_gc_merge_rewrite || set_min_blob_size) {
     uint32_t cf_id = column_family->GetID();
     {
       MutexLock l(&mutex_);
@@ -1109,6 +1409,10 @@ Status TitanDBImpl::SetOptions(
       if (set_gc_merge_rewrite) {
         cf_info.mutable_cf_options.gc_merge_rewrite = gc_merge_rewrite;
       }
+      if (set_min_blob_size) {
+        cf_info.titan_table_factory->SetMinBlobSize(min_blob_size);
+        cf_info.mutable_cf_options.min_blob_size = min_blob_size;
+      }
     }
   }
   return Status::OK();
@@ -1144,6 +1448,11 @@ TitanDBOptions TitanDBImpl::GetTitanDBOptions() const {
 bool TitanDBImpl::GetProperty(ColumnFamilyHandle* column_family,
                               const Slice& property, std::string* value) {
   assert(column_family != nullptr);
+  uint64_t int_value;
+  if (GetGCIntProperty(column_family, property, &int_value)) {
+    *value = std::to_string(int_value);
+    return true;
+  }
   bool s = false;
   if (stats_.get() != nullptr) {
     auto stats = stats_->internal_stats(column_family->GetID());
@@ -1161,6 +1470,9 @@ bool TitanDBImpl::GetProperty(ColumnFamilyHandle* column_family,
 bool TitanDBImpl::GetIntProperty(ColumnFamilyHandle* column_family,
                                  const Slice& property, uint64_t* value) {
   assert(column_family != nullptr);
+  if (GetGCIntProperty(column_family, property, value)) {
+    return true;
+  }
   bool s = false;
   if (stats_.get() != nullptr) {
     auto stats = stats_->internal_stats(column_family->GetID());
@@ -1175,6 +1487,35 @@ bool TitanDBImpl::GetIntProperty(ColumnFamilyHandle* column_family,
   }
 }
 
+bool TitanDBImpl::GetGCIntProperty(ColumnFamilyHandle* column_family,
+                                   const Slice& property, uint64_t* value) {
+  if (property == TitanDB::Properties::kNumPendingGC) {
+    MutexLock l(&mutex_);
+    *value = gc_queue_.size();
+    return true;
+  } else if (property == TitanDB::Properties::kNumRunningGC) {
+    MutexLock l(&mutex_);
+    *value = static_cast<uint64_t>(bg_gc_running_);
+    return true;
+  } else if (property == TitanDB::Properties::kGCReclaimableSize) {
+    std::shared_ptr<BlobStorage> blob_storage;
+    {
+      MutexLock l(&mutex_);
+      blob_storage =
+          blob_file_set_->GetBlobStorage(column_family->GetID()).lock();
+    }
+    *value = blob_storage != nullptr ? blob_storage->ReclaimableSize() : 0;
+    return true;
+  } else if (property == TitanDB::Properties::kGCBytesPerSec) {
+    *value = db_options_.gc_rate_limiter != nullptr
+                 ? static_cast<uint64_t>(
+                       db_options_.gc_rate_limiter->GetBytesPerSecond())
+                 : 0;
+    return true;
+  }
+  return false;
+}
+
 void TitanDBImpl::OnFlushCompleted(const FlushJobInfo& flush_job_info) {
   TEST_SYNC_POINT("TitanDBImpl::OnFlushCompleted:Begin1");
   TEST_SYNC_POINT("TitanDBImpl::OnFlushCompleted:Begin");
@@ -1206,6 +1547,10 @@ void TitanDBImpl::OnFlushCompleted(const FlushJobInfo& flush_job_info) {
       assert(false);
       return;
     }
+    if (s.ok()) {
+      LogLiveSizeDelta(flush_job_info.cf_id, {flush_job_info.file_path},
+                       {} /*deleted_ssts*/, blob_file_size_diff);
+    }
     for (const auto& file_diff : blob_file_size_diff) {
       uint64_t file_number = file_diff.first;
       int64_t delta = file_diff.second;
@@ -1255,10 +1600,48 @@ void TitanDBImpl::OnFlushCompleted(const FlushJobInfo& flush_job_info) {
                      flush_job_info.job_id, file->file_number(),
                      file->live_data_size());
     }
+    UpdateBlobSpaceAmplification();
   }
+  MaybeTrainCompressionDict(flush_job_info.cf_id);
   TEST_SYNC_POINT("TitanDBImpl::OnFlushCompleted:Finished");
 }
 
+void TitanDBImpl::MaybeTrainCompressionDict(uint32_t cf_id) {
+  std::shared_ptr<BlobCompressionDicts> compression_dicts;
+  {
+    MutexLock l(&mutex_);
+    auto blob_storage = blob_file_set_->GetBlobStorage(cf_id).lock();
+    if (blob_storage) {
+      compression_dicts = blob_storage->compression_dicts();
+    }
+  }
+  std::string raw_dict;
+  // Training takes a while, do it without holding the mutex.
+  if (!compression_dicts || !compression_dicts->enabled() ||
+      !compression_dicts->MaybeTrain(&raw_dict)) {
+    return;
+  }
+
+  MutexLock l(&mutex_);
+  VersionEdit edit;
+  edit.SetColumnFamilyID(cf_id);
+  uint64_t dict_id = blob_file_set_->NewFileNumber();
+  edit.AddCompressionDict(dict_id, raw_dict);
+  Status s = blob_file_set_->LogAndApply(edit);
+  if (s.ok()) {
+    ROCKS_LOG_INFO(db_options_.info_log,
+                   "Titan added shared compression dict %" PRIu64
+                   " of %" PRIu64 " bytes for CF %" PRIu32 ".",
+                   dict_id, static_cast<uint64_t>(raw_dict.size()), cf_id);
+  } else {
+    ROCKS_LOG_ERROR(db_options_.info_log,
+                    "Titan failed to add shared compression dict for CF "
+                    "%" PRIu32 ": %s",
+                    cf_id, s.ToString().c_str());
+    SetBGError(s);
+  }
+}
+
 void TitanDBImpl::OnCompactionCompleted(
     const CompactionJobInfo& compaction_job_info) {
   TEST_SYNC_POINT("TitanDBImpl::OnCompactionCompleted:Begin");
@@ -1271,6 +1654,10 @@ void TitanDBImpl::OnCompactionCompleted(
     return;
   }
   std::map<uint64_t, int64_t> blob_file_size_diff;
+  // Whether the diff covers all input and output files.
+  bool size_diff_complete = true;
+  std::map<uint64_t, std::vector<BlobHandle>> input_records;
+  std::map<uint64_t, std::vector<BlobHandle>> output_records;
   const TablePropertiesCollection& prop_collection =
       compaction_job_info.table_properties;
   auto update_diff = [&](const std::vector<std::string>& files, bool to_add) {
@@ -1281,6 +1668,7 @@ void TitanDBImpl::OnCompactionCompleted(
             db_options_.info_log,
             "OnCompactionCompleted[%d]: No table properties for file %s.",
             compaction_job_info.job_id, file_name.c_str());
+        size_diff_complete = false;
         continue;
       }
       Status gc_stats_status = ExtractGCStatsFromTableProperty(
@@ -1294,12 +1682,30 @@ void TitanDBImpl::OnCompactionCompleted(
             compaction_job_info.job_id, file_name.c_str(),
             gc_stats_status.ToString().c_str());
         assert(false);
+        size_diff_complete = false;
+      }
+      if (prop_iter->second == nullptr) {
+        continue;
+      }
+      gc_stats_status = ExtractBlobRecordsFromTableProperty(
+          *prop_iter->second, to_add ? &output_records : &input_records);
+      if (!gc_stats_status.ok()) {
+        ROCKS_LOG_ERROR(
+            db_options_.info_log,
+            "OnCompactionCompleted[%d]: failed to extract blob records from "
+            "table property: compaction file: %s, error: %s",
+            compaction_job_info.job_id, file_name.c_str(),
+            gc_stats_status.ToString().c_str());
+        assert(false);
       }
     }
   };
   update_diff(compaction_job_info.input_files, false /*to_add*/);
   update_diff(compaction_job_info.output_files, true /*to_add*/);
 
+  // Blob files whose remaining references are worth compacting away.
+  // blob_file_number -> [smallest_key, largest_key]
+  std::map<uint64_t, std::pair<std::string, std::string>> hint_files;
   {
     MutexLock l(&mutex_);
     auto bs = blob_file_set_->GetBlobStorage(compaction_job_info.cf_id).lock();
@@ -1311,12 +1717,21 @@ void TitanDBImpl::OnCompactionCompleted(
                       compaction_job_info.job_id, compaction_job_info.cf_id);
       return;
     }
+    if (size_diff_complete) {
+      LogLiveSizeDelta(compaction_job_info.cf_id,
+                       compaction_job_info.output_files,
+                       compaction_job_info.input_files, blob_file_size_diff);
+    }
     VersionEdit edit;
     auto cf_options = bs->cf_options();
     std::vector<std::shared_ptr<BlobFileMeta>> to_merge_candidates;
     bool count_sorted_run =
         cf_options.level_merge && cf_options.range_merge &&
         cf_options.num_levels - 1 == compaction_job_info.output_level;
+    int64_t now = 0;
+    db_options_.env->GetCurrentTime(&now);
+    AddDeadRecords(compaction_job_info.cf_id, bs.get(), &input_records,
+                   &output_records);
     for (const auto& file_diff : blob_file_size_diff) {
       uint64_t file_number = file_diff.first;
       int64_t delta = file_diff.second;
@@ -1394,6 +1809,10 @@ void TitanDBImpl::OnCompactionCompleted(
                          compaction_job_info.job_id, file_number);
           assert(false);
         }
+        if (delta < 0) {
+          file->RecordDiscard(static_cast<uint64_t>(-delta),
+                              static_cast<uint64_t>(now));
+        }
         SubStats(stats_.get(), compaction_job_info.cf_id,
                  TitanInternalStats::LIVE_BLOB_SIZE, delta);
         if (cf_options.level_merge) {
@@ -1421,18 +1840,38 @@ void TitanDBImpl::OnCompactionCompleted(
         auto after = file->GetDiscardableRatioLevel();
         AddStats(stats_.get(), compaction_job_info.cf_id, after, 1);
       }
+      if (!cf_options.level_merge &&
+          cf_options.compaction_hint_discardable_ratio > 0 &&
+          file->file_state() == BlobFileMeta::FileState::kNormal &&
+          !file->compaction_hinted() && !file->smallest_key().empty() &&
+          !file->largest_key().empty()) {
+        double ratio = file->GetDiscardableRatio();
+        // Files reaching blob_file_discardable_ratio are left to GC.
+        if (ratio >= cf_options.compaction_hint_discardable_ratio &&
+            ratio < cf_options.blob_file_discardable_ratio) {
+          file->set_compaction_hinted(true);
+          hint_files.emplace(file_number,
+                             std::make_pair(file->smallest_key(),
+                                            file->largest_key()));
+        }
+      }
     }
     // If level merge is enabled, blob files will be deleted by live
     // data based GC, so we don't need to trigger regular GC anymore
     if (cf_options.level_merge) {
       blob_file_set_->LogAndApply(edit);
       MarkFileIfNeedMerge(to_merge_candidates, cf_options.max_sorted_runs);
+      UpdateBlobSpaceAmplification();
     } else {
       bs->ComputeGCScore();
       AddToGCQueue(compaction_job_info.cf_id);
+      UpdateBlobSpaceAmplification();
       MaybeScheduleGC();
     }
   }
+  if (!hint_files.empty()) {
+    MarkSSTsForBlobGC(compaction_job_info.cf_id, hint_files);
+  }
 }
 
 Status TitanDBImpl::SetBGError(const Status& s) {
@@ -1471,11 +1910,53 @@ void TitanDBImpl::DumpStats() {
       }
       LogToBuffer(&log_buffer, "Titan internal stats for column family [%s]:",
                   cf.second.name.c_str());
+      if (cf.second.immutable_cf_options.min_blob_size_auto_tune) {
+        TuneMinBlobSize(&cf.second, internal_stats, &log_buffer);
+      }
       internal_stats->DumpAndResetInternalOpStats(&log_buffer);
     }
   }
   log_buffer.FlushBufferToLog();
 }
 
+void TitanDBImpl::TuneMinBlobSize(TitanColumnFamilyInfo* cf_info,
+                                  TitanInternalStats* internal_stats,
+                                  LogBuffer* log_buffer) {
+  mutex_.AssertHeld();
+  InternalOpStats* gc_stats =
+      internal_stats->GetInternalOpStatsForType(InternalOpType::GC);
+  uint64_t keys_overwritten =
+      GetStats(gc_stats, InternalOpStatsType::GC_NUM_KEYS_OVERWRITTEN);
+  uint64_t keys_relocated =
+      GetStats(gc_stats, InternalOpStatsType::GC_NUM_KEYS_RELOCATED);
+  HistogramImpl* value_sizes = internal_stats->value_size_histogram();
+
+  uint64_t current = cf_info->mutable_cf_options.min_blob_size;
+  const ImmutableTitanCFOptions& cf_options = cf_info->immutable_cf_options;
+  MinBlobSizeTuner tuner(cf_options.min_blob_size_lower_bound,
+                         cf_options.min_blob_size_upper_bound);
+  uint64_t next = tuner.Tune(current, *value_sizes, keys_overwritten,
+                             keys_relocated);
+  if (next != current) {
+    cf_info->titan_table_factory->SetMinBlobSize(next);
+    cf_info->mutable_cf_options.min_blob_size = next;
+    LogToBuffer(log_buffer,
+                "Auto tuned min_blob_size from %" PRIu64 " to %" PRIu64
+                " (values sampled: %" PRIu64 ", GC keys overwritten: %" PRIu64
+                ", GC keys relocated: %" PRIu64 ")",
+                current, next, value_sizes->num(), keys_overwritten,
+                keys_relocated);
+  } else {
+    LogToBuffer(log_buffer, "Auto tuned min_blob_size: %" PRIu64, current);
+  }
+  // Only consider statistics since last tune.
+  if (value_sizes->num() >= MinBlobSizeTuner::kMinValueSamples &&
+      keys_overwritten + keys_relocated >= MinBlobSizeTuner::kMinGCKeys) {
+    value_sizes->Clear();
+    GetAndResetStats(gc_stats, InternalOpStatsType::GC_NUM_KEYS_OVERWRITTEN);
+    GetAndResetStats(gc_stats, InternalOpStatsType::GC_NUM_KEYS_RELOCATED);
+  }
+}
+
 }  // namespace titandb
 }  // namespace rocksdb
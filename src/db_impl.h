@@ -1,6 +1,7 @@
 #pragma once
 
 #include "db/db_impl/db_impl.h"
+#include "db/write_controller.h"
 #include "rocksdb/statistics.h"
 #include "rocksdb/threadpool.h"
 #include "util/repeatable_thread.h"
@@ -8,6 +9,7 @@
 #include "blob_file_manager.h"
 #include "blob_file_set.h"
 #include "blob_index_merge_operator.h"
+#include "gc_rate_controller.h"
 #include "table_factory.h"
 #include "titan/db.h"
 #include "titan_stats.h"
@@ -21,8 +23,13 @@ struct TitanColumnFamilyInfo {
   MutableTitanCFOptions mutable_cf_options;
   std::shared_ptr<TableFactory> base_table_factory;
   std::shared_ptr<TitanTableFactory> titan_table_factory;
+  // Compaction filter given by the user, which the base DB sees wrapped by
+  // TitanCompactionFilterFactory.
+  const CompactionFilter* base_compaction_filter;
+  std::shared_ptr<CompactionFilterFactory> base_compaction_filter_factory;
 };
 
+class BlobGC;
 class TitanCompactionFilterFactory;
 class TitanCompactionFilter;
 
@@ -73,6 +80,13 @@ class TitanDBImpl : public TitanDB {
   Status Delete(const WriteOptions& options, ColumnFamilyHandle* column_family,
                 const Slice& key) override;
 
+  // Blob files whose key ranges are covered by the deleted range are marked
+  // obsolete right away, instead of waiting for compaction and GC.
+  using TitanDB::DeleteRange;
+  Status DeleteRange(const WriteOptions& options,
+                     ColumnFamilyHandle* column_family, const Slice& begin_key,
+                     const Slice& end_key) override;
+
   using TitanDB::IngestExternalFile;
   Status IngestExternalFile(ColumnFamilyHandle* column_family,
                             const std::vector<std::string>& external_files,
@@ -128,6 +142,14 @@ class TitanDBImpl : public TitanDB {
                                  const RangePtr* ranges, size_t n,
                                  bool include_end = true) override;
 
+  Status CompactBlobFiles(ColumnFamilyHandle* column_family, const Slice* begin,
+                          const Slice* end,
+                          const CompactBlobFilesOptions& options) override;
+
+  Status EstimateGC(ColumnFamilyHandle* column_family,
+                    const TitanCFOptions* options,
+                    GCEstimate* estimate) override;
+
   using TitanDB::GetOptions;
   Options GetOptions(ColumnFamilyHandle* column_family) const override;
 
@@ -208,6 +230,33 @@ class TitanDBImpl : public TitanDB {
 
   Status InitializeGC(const std::vector<ColumnFamilyHandle*>& cf_handles);
 
+  // An SST whose table properties are read for live data sizes of the blob
+  // files it references.
+  struct SSTToRead {
+    // Index of the sizes summed into.
+    size_t group;
+    Version* version;
+    const FileMetaData* file;
+  };
+
+  // Sums live data sizes of blob files referenced by the SSTs into
+  // `live_sizes`, reading table properties with up to
+  // max_file_opening_threads threads.
+  // REQUIRE: versions of the SSTs referenced
+  Status ReadLiveSizesFromSSTs(
+      const std::vector<SSTToRead>& ssts,
+      std::vector<std::map<uint64_t, int64_t>>* live_sizes);
+
+  // Logs the SSTs added and deleted by a flush or compaction, with the live
+  // data size changes summed from their table properties, to the live size
+  // checkpoint of the column family. So the next DB open needn't read table
+  // properties of the SSTs, even if the DB isn't closed cleanly.
+  // REQUIRE: mutex_ held
+  void LogLiveSizeDelta(uint32_t cf_id,
+                        const std::vector<std::string>& added_ssts,
+                        const std::vector<std::string>& deleted_ssts,
+                        const std::map<uint64_t, int64_t>& live_size_diff);
+
   Status ExtractGCStatsFromTableProperty(
       const std::shared_ptr<const TableProperties>& table_properties,
       bool to_add, std::map<uint64_t, int64_t>* blob_file_size_diff);
@@ -216,6 +265,20 @@ class TitanDBImpl : public TitanDB {
       const TableProperties& table_properties, bool to_add,
       std::map<uint64_t, int64_t>* blob_file_size_diff);
 
+  // Appends handles of blob records referenced by the table to
+  // `blob_records`, if it is collected by BlobRecordCollector.
+  Status ExtractBlobRecordsFromTableProperty(
+      const TableProperties& table_properties,
+      std::map<uint64_t, std::vector<BlobHandle>>* blob_records);
+
+  // Logs blob records referenced by compaction inputs but not outputs as
+  // dead records of their blob files.
+  // REQUIRE: mutex_ held
+  void AddDeadRecords(
+      uint32_t cf_id, BlobStorage* blob_storage,
+      std::map<uint64_t, std::vector<BlobHandle>>* input_records,
+      std::map<uint64_t, std::vector<BlobHandle>>* output_records);
+
   // REQUIRE: mutex_ held
   void AddToGCQueue(uint32_t column_family_id) {
     mutex_.AssertHeld();
@@ -223,18 +286,68 @@ class TitanDBImpl : public TitanDB {
     gc_queue_.push_back(column_family_id);
   }
 
+  // Pops the queued column family with the most reclaimable bytes, so that
+  // column families with lots of garbage don't wait behind ones with little.
+  // Ties are broken in FIFO order.
   // REQUIRE: gc_queue_ not empty
   // REQUIRE: mutex_ held
-  uint32_t PopFirstFromGCQueue() {
-    assert(!gc_queue_.empty());
-    auto column_family_id = *gc_queue_.begin();
-    gc_queue_.pop_front();
-    return column_family_id;
-  }
+  uint32_t PopFromGCQueue();
+
+  // Handles GC scheduler properties, which are not kept in internal stats.
+  bool GetGCIntProperty(ColumnFamilyHandle* column_family,
+                        const Slice& property, uint64_t* value);
 
   // REQUIRE: mutex_ held
   void MaybeScheduleGC();
 
+  // Max number of GC jobs to schedule, raised while some column family is
+  // close to its max_blob_space_amplification.
+  // REQUIRE: mutex_ held
+  int MaxBackgroundGC() const;
+
+  // Refreshes blob space amplification of column families with
+  // max_blob_space_amplification set, and the GC priority and write delay
+  // that follow from it.
+  // REQUIRE: mutex_ held
+  void UpdateBlobSpaceAmplification();
+
+  // Delays a write of `num_bytes` to the column family if its blob space
+  // amplification exceeds its target. Deletions are never delayed, as they
+  // don't add to blob files and let GC reclaim space.
+  // REQUIRE: mutex_ not held
+  Status MaybeDelayWrite(const WriteOptions& options, uint32_t cf_id,
+                         uint64_t num_bytes);
+  // Same as above, for the puts and merges of the batches.
+  // REQUIRE: mutex_ not held
+  Status MaybeDelayWrite(const WriteOptions& options,
+                         const std::vector<WriteBatch*>& batches);
+  // Same as above, for the number of bytes written to each column family.
+  // REQUIRE: mutex_ not held
+  Status MaybeDelayWrite(const WriteOptions& options,
+                         const std::map<uint32_t, uint64_t>& sizes);
+
+  // Punches holes over runs of dead records of at least punch_hole_min_size
+  // in a few blob files GC would not pick, so that clustered garbage is
+  // reclaimed without rewriting the files. Runs are found from the dead
+  // records kept in memory, without reading the files.
+  // REQUIRE: mutex_ held, and it is released while punching holes
+  void PunchBlobFileHoles(uint32_t column_family_id, BlobStorage* blob_storage,
+                          LogBuffer* log_buffer);
+
+  // Marks SSTs of the column family which reference any of the blob files
+  // for compaction, see `compaction_hint_discardable_ratio`. Blob files are
+  // given with their key ranges, only SSTs overlapping them are checked.
+  // REQUIRE: mutex_ not held
+  void MarkSSTsForBlobGC(
+      uint32_t column_family_id,
+      const std::map<uint64_t, std::pair<std::string, std::string>>&
+          blob_files);
+
+  // Runs a GC job on the files picked by `blob_gc` and releases them.
+  // REQUIRE: mutex_ held, and it is released while the job runs
+  Status RunBlobGCJob(BlobGC* blob_gc, bool gc_merge_rewrite,
+                      LogBuffer* log_buffer);
+
   static void BGWorkGC(void* db);
   void BackgroundCallGC();
   Status BackgroundGC(LogBuffer* log_buffer, uint32_t column_family_id);
@@ -242,6 +355,12 @@ class TitanDBImpl : public TitanDB {
   void PurgeObsoleteFiles();
   Status PurgeObsoleteFilesImpl();
 
+  // Adjusts the rate of gc_rate_limiter by foreground load, and pauses or
+  // resumes GC scheduling accordingly. Runs periodically when
+  // adaptive_gc_rate is enabled.
+  // REQUIRE: mutex_ not held
+  void AdjustGCRate();
+
   SequenceNumber GetOldestSnapshotSequence() {
     SequenceNumber oldest_snapshot = kMaxSequenceNumber;
     {
@@ -274,6 +393,16 @@ class TitanDBImpl : public TitanDB {
 
   void DumpStats();
 
+  // Trains the shared compression dictionary of the column family if enough
+  // values are sampled, and logs it to manifest.
+  // REQUIRE: mutex_ not held
+  void MaybeTrainCompressionDict(uint32_t cf_id);
+
+  // REQUIRE: mutex_ held
+  void TuneMinBlobSize(TitanColumnFamilyInfo* cf_info,
+                       TitanInternalStats* internal_stats,
+                       LogBuffer* log_buffer);
+
   FileLock* lock_{nullptr};
   // The lock sequence must be Titan.mutex_.Lock() -> Base DB mutex_.Lock()
   // while the unlock sequence must be Base DB mutex.Unlock() ->
@@ -317,6 +446,14 @@ class TitanDBImpl : public TitanDB {
   // handle for dump internal stats at fixed intervals.
   std::unique_ptr<RepeatableThread> thread_dump_stats_;
 
+  // handle for adjusting GC rate at fixed intervals, if adaptive_gc_rate is
+  // enabled.
+  std::unique_ptr<RepeatableThread> thread_adjust_gc_rate_;
+  std::unique_ptr<GCRateController> gc_rate_controller_;
+  // Latency of blob file reads by Gets since last GC rate adjustment. Only
+  // recorded if adaptive_gc_rate is enabled.
+  HistogramImpl blob_read_latency_;
+
   std::unique_ptr<BlobFileSet> blob_file_set_;
   std::set<uint64_t> pending_outputs_;
   std::shared_ptr<BlobFileManager> blob_manager_;
@@ -333,6 +470,27 @@ class TitanDBImpl : public TitanDB {
   int unscheduled_gc_ = 0;
   // REQUIRE: mutex_ held.
   int drop_cf_requests_ = 0;
+  // Set by AdjustGCRate when GC is hurting foreground even at the lowest
+  // rate, to stop scheduling new GC jobs.
+  // REQUIRE: mutex_ held.
+  bool gc_paused_ = false;
+  // Column families whose blob space amplification is close to their
+  // max_blob_space_amplification.
+  // REQUIRE: mutex_ held.
+  std::set<uint32_t> blob_space_pressured_cfs_;
+  // Column families whose blob space amplification exceeds their
+  // max_blob_space_amplification, writes to which are delayed.
+  // REQUIRE: mutex_ held.
+  std::set<uint32_t> blob_space_delayed_cfs_;
+  // Set once punching holes fails as not supported.
+  // REQUIRE: mutex_ held.
+  bool punch_hole_unsupported_ = false;
+
+  // Delays writes when GC can't keep blob space amplification under target.
+  // GetDelay() requires mutex_ held.
+  WriteController blob_space_write_controller_;
+  // REQUIRE: mutex_ held.
+  std::unique_ptr<WriteControllerToken> blob_space_write_token_;
 
   // PurgeObsoleteFiles, DisableFileDeletions and EnableFileDeletions block
   // on the mutex to avoid contention.
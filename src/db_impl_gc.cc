@@ -1,8 +1,20 @@
 #include "db_impl.h"
 
+#ifndef __STDC_FORMAT_MACROS
+#define __STDC_FORMAT_MACROS
+#endif
+
+#include <inttypes.h>
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+
+#include "file/filename.h"
+#include "rocksdb/rate_limiter.h"
 #include "test_util/sync_point.h"
 
 #include "blob_file_iterator.h"
+#include "blob_file_reader.h"
 #include "blob_file_size_collector.h"
 #include "blob_gc_job.h"
 #include "blob_gc_picker.h"
@@ -11,6 +23,108 @@
 namespace rocksdb {
 namespace titandb {
 
+namespace {
+
+// GC of a column family is prioritized once its blob space amplification
+// reaches this ratio of max_blob_space_amplification.
+const double kBlobSpacePressureRatio = 0.8;
+// The write delay rate is halved for every this ratio of
+// max_blob_space_amplification exceeded, at most kMaxWriteDelayHalvings
+// times.
+const double kWriteDelayStepRatio = 0.1;
+const int kMaxWriteDelayHalvings = 10;
+
+// Sorts key ranges by start and merges the overlapping ones. Ends are
+// inclusive.
+void MergeKeyRanges(const Comparator* ucmp,
+                    std::vector<std::pair<Slice, Slice>>* ranges) {
+  std::sort(ranges->begin(), ranges->end(),
+            [ucmp](const std::pair<Slice, Slice>& a,
+                   const std::pair<Slice, Slice>& b) {
+              return ucmp->Compare(a.first, b.first) < 0;
+            });
+  std::vector<std::pair<Slice, Slice>> merged;
+  for (const auto& range : *ranges) {
+    if (!merged.empty() &&
+        ucmp->Compare(range.first, merged.back().second) <= 0) {
+      if (ucmp->Compare(range.second, merged.back().second) > 0) {
+        merged.back().second = range.second;
+      }
+    } else {
+      merged.push_back(range);
+    }
+  }
+  ranges->swap(merged);
+}
+
+// At most this many blob files are checked for holes to punch after each
+// GC job, the ones with most newly dropped records first.
+const size_t kMaxFilesToPunchHoles = 4;
+
+// Appends runs of adjacent dead records of at least `min_size` to `runs`.
+// `dead_records` are sorted by record id. A record, or a block of packed
+// records, is dead if all records in it are dead, which is told from the
+// sizes alone: shares of the records packed in a block add up to the size
+// of the block.
+void FindDeadRanges(const std::vector<BlobHandle>& dead_records,
+                    uint64_t min_size, BlobFileRanges* runs) {
+  uint64_t run_offset = 0;
+  uint64_t run_size = 0;
+  auto end_run = [&]() {
+    if (run_size >= min_size) {
+      runs->emplace_back(run_offset, run_size);
+    }
+    run_size = 0;
+  };
+  size_t i = 0;
+  while (i < dead_records.size()) {
+    uint64_t unit_offset = dead_records[i].offset;
+    uint64_t unit_size = dead_records[i].read_size();
+    uint64_t dead_size = 0;
+    for (; i < dead_records.size() && dead_records[i].offset == unit_offset;
+         i++) {
+      dead_size += dead_records[i].size;
+    }
+    if (dead_size < unit_size) {
+      end_run();
+    } else if (run_size > 0 && run_offset + run_size == unit_offset) {
+      run_size += unit_size;
+    } else {
+      end_run();
+      run_offset = unit_offset;
+      run_size = unit_size;
+    }
+  }
+  end_run();
+}
+
+// Returns the parts of `ranges` not covered by `holes`. Both are sorted by
+// offset and don't overlap themselves.
+BlobFileRanges SubtractRanges(const BlobFileRanges& ranges,
+                              const BlobFileRanges& holes) {
+  BlobFileRanges result;
+  auto hole = holes.begin();
+  for (const auto& range : ranges) {
+    uint64_t begin = range.first;
+    uint64_t end = range.first + range.second;
+    while (hole != holes.end() && hole->first + hole->second <= begin) {
+      hole++;
+    }
+    for (auto iter = hole; iter != holes.end() && iter->first < end; iter++) {
+      if (iter->first > begin) {
+        result.emplace_back(begin, iter->first - begin);
+      }
+      begin = std::max(begin, iter->first + iter->second);
+    }
+    if (begin < end) {
+      result.emplace_back(begin, end - begin);
+    }
+  }
+  return result;
+}
+
+}  // namespace
+
 Status TitanDBImpl::ExtractGCStatsFromTableProperty(
     const std::shared_ptr<const TableProperties>& table_properties, bool to_add,
     std::map<uint64_t, int64_t>* blob_file_size_diff) {
@@ -49,6 +163,210 @@ Status TitanDBImpl::ExtractGCStatsFromTableProperty(
   return Status::OK();
 }
 
+Status TitanDBImpl::ExtractBlobRecordsFromTableProperty(
+    const TableProperties& table_properties,
+    std::map<uint64_t, std::vector<BlobHandle>>* blob_records) {
+  assert(blob_records != nullptr);
+  auto& prop = table_properties.user_collected_properties;
+  auto prop_iter = prop.find(BlobRecordCollector::kPropertiesName);
+  if (prop_iter == prop.end()) {
+    return Status::OK();
+  }
+  Slice prop_slice(prop_iter->second);
+  if (!BlobRecordCollector::Decode(&prop_slice, blob_records)) {
+    return Status::Corruption("Failed to decode blob records property.");
+  }
+  return Status::OK();
+}
+
+void TitanDBImpl::AddDeadRecords(
+    uint32_t cf_id, BlobStorage* blob_storage,
+    std::map<uint64_t, std::vector<BlobHandle>>* input_records,
+    std::map<uint64_t, std::vector<BlobHandle>>* output_records) {
+  mutex_.AssertHeld();
+  auto by_id = [](const BlobHandle& a, const BlobHandle& b) {
+    return a.record_id() < b.record_id();
+  };
+  VersionEdit edit;
+  edit.SetColumnFamilyID(cf_id);
+  bool has_dropped = false;
+  for (auto& input : *input_records) {
+    auto file = blob_storage->FindFile(input.first).lock();
+    if (!file || file->is_obsolete() || !file->deletion_tracked()) {
+      continue;
+    }
+    std::vector<BlobHandle>& inputs = input.second;
+    std::vector<BlobHandle>& outputs = (*output_records)[input.first];
+    std::sort(inputs.begin(), inputs.end(), by_id);
+    std::sort(outputs.begin(), outputs.end(), by_id);
+    std::vector<BlobHandle> dropped;
+    std::set_difference(inputs.begin(), inputs.end(), outputs.begin(),
+                        outputs.end(), std::back_inserter(dropped), by_id);
+    if (dropped.empty()) {
+      continue;
+    }
+    BlobRecordSet records;
+    records.Add(dropped);
+    edit.AddDeadBlobRecords(input.first, records);
+    has_dropped = true;
+  }
+  if (!has_dropped) {
+    return;
+  }
+  Status s = blob_file_set_->LogAndApply(edit);
+  if (!s.ok()) {
+    ROCKS_LOG_ERROR(db_options_.info_log,
+                    "Titan failed to log dead blob records for CF %" PRIu32
+                    ": %s",
+                    cf_id, s.ToString().c_str());
+    SetBGError(s);
+  }
+}
+
+void TitanDBImpl::MarkSSTsForBlobGC(
+    uint32_t column_family_id,
+    const std::map<uint64_t, std::pair<std::string, std::string>>&
+        blob_files) {
+  std::unique_ptr<ColumnFamilyHandle> cfh =
+      db_impl_->GetColumnFamilyHandleUnlocked(column_family_id);
+  if (cfh == nullptr) {
+    // Column family has been dropped.
+    return;
+  }
+  const Comparator* ucmp = cfh->GetComparator();
+  // Only SSTs overlapping the key ranges of the blob files may reference
+  // them, so only their properties are read.
+  std::vector<std::pair<Slice, Slice>> key_ranges;
+  for (const auto& blob_file : blob_files) {
+    key_ranges.emplace_back(blob_file.second.first, blob_file.second.second);
+  }
+  MergeKeyRanges(ucmp, &key_ranges);
+  std::vector<Range> ranges;
+  for (const auto& key_range : key_ranges) {
+    ranges.emplace_back(key_range.first, key_range.second);
+  }
+  // Blob files whose SSTs are all left unmarked are hinted again later.
+  std::set<uint64_t> unmarked_blob_files;
+  for (const auto& blob_file : blob_files) {
+    unmarked_blob_files.insert(blob_file.first);
+  }
+  auto unhint = [&]() {
+    MutexLock l(&mutex_);
+    auto blob_storage = blob_file_set_->GetBlobStorage(column_family_id).lock();
+    if (blob_storage == nullptr) {
+      return;
+    }
+    for (uint64_t file_number : unmarked_blob_files) {
+      auto file = blob_storage->FindFile(file_number).lock();
+      if (file != nullptr) {
+        file->set_compaction_hinted(false);
+      }
+    }
+  };
+
+  TablePropertiesCollection collection;
+  Status s = GetPropertiesOfTablesInRange(cfh.get(), ranges.data(),
+                                          ranges.size(), &collection);
+  // SST file path -> blob files to hint referenced by the SST
+  std::map<std::string, std::vector<uint64_t>> sst_files;
+  for (auto& table : collection) {
+    if (!s.ok()) {
+      break;
+    }
+    std::map<uint64_t, int64_t> blob_file_sizes;
+    s = ExtractGCStatsFromTableProperty(table.second, true /*to_add*/,
+                                        &blob_file_sizes);
+    for (auto& blob_file : blob_file_sizes) {
+      if (blob_files.count(blob_file.first) > 0) {
+        sst_files[table.first].push_back(blob_file.first);
+      }
+    }
+  }
+  if (!s.ok()) {
+    ROCKS_LOG_WARN(db_options_.info_log,
+                   "Titan failed to find SSTs referencing blob files to hint "
+                   "compaction of: %s",
+                   s.ToString().c_str());
+    unhint();
+    return;
+  }
+
+  // The base DB marks SSTs by key range, including the ones overlapping them
+  // in other levels, which compaction would pick along anyway. So SSTs next
+  // to each other in a level, and overlapping ranges of a level, are marked
+  // at once. Ranges of different levels are kept apart, as merging them
+  // would mark SSTs in between which reference none of the blob files. SSTs
+  // in the last non-empty level are skipped, since the base DB doesn't mark
+  // them.
+  ColumnFamilyMetaData cf_meta;
+  GetColumnFamilyMetaData(cfh.get(), &cf_meta);
+  int last_level = -1;
+  for (const auto& level : cf_meta.levels) {
+    if (!level.files.empty()) {
+      last_level = level.level;
+    }
+  }
+  uint64_t marked = 0;
+  std::vector<std::pair<Slice, Slice>> compact_ranges;
+  for (const auto& level : cf_meta.levels) {
+    if (level.level == last_level) {
+      continue;
+    }
+    std::vector<std::pair<Slice, Slice>> level_ranges;
+    bool follows_marked = false;
+    for (const auto& sst : level.files) {
+      auto sst_iter = sst_files.find(sst.db_path + sst.name);
+      if (sst.being_compacted || sst_iter == sst_files.end()) {
+        follows_marked = false;
+        continue;
+      }
+      // Files of level 0 are not sorted by key.
+      if (follows_marked && level.level > 0) {
+        level_ranges.back().second = sst.largestkey;
+      } else {
+        level_ranges.emplace_back(sst.smallestkey, sst.largestkey);
+      }
+      follows_marked = true;
+      marked++;
+      for (uint64_t file_number : sst_iter->second) {
+        unmarked_blob_files.erase(file_number);
+      }
+    }
+    MergeKeyRanges(ucmp, &level_ranges);
+    compact_ranges.insert(compact_ranges.end(), level_ranges.begin(),
+                          level_ranges.end());
+  }
+  for (const auto& range : compact_ranges) {
+    s = db_impl_->SuggestCompactRange(cfh.get(), &range.first, &range.second);
+    if (!s.ok()) {
+      ROCKS_LOG_WARN(db_options_.info_log,
+                     "Titan failed to mark SSTs in range [%s, %s] for "
+                     "compaction: %s",
+                     range.first.ToString(true).c_str(),
+                     range.second.ToString(true).c_str(),
+                     s.ToString().c_str());
+      for (const auto& blob_file : blob_files) {
+        unmarked_blob_files.insert(blob_file.first);
+      }
+      break;
+    }
+  }
+  if (!unmarked_blob_files.empty()) {
+    unhint();
+  }
+  if (!s.ok()) {
+    return;
+  }
+  ROCKS_LOG_INFO(db_options_.info_log,
+                 "Titan marked %" PRIu64 " SSTs in %" PRIuPTR
+                 " ranges referencing %" PRIuPTR
+                 " blob files for compaction in column family [%s].",
+                 marked, compact_ranges.size(),
+                 blob_files.size() - unmarked_blob_files.size(),
+                 cf_meta.name.c_str());
+  TEST_SYNC_POINT_CALLBACK("TitanDBImpl::MarkSSTsForBlobGC:Marked", &marked);
+}
+
 Status TitanDBImpl::InitializeGC(
     const std::vector<ColumnFamilyHandle*>& cf_handles) {
   assert(!initialized());
@@ -61,37 +379,125 @@ Status TitanDBImpl::InitializeGC(
     if (!s.ok()) {
       return s;
     }
-    TablePropertiesCollection collection;
-    s = GetPropertiesOfAllTables(cf_handle, &collection);
-    if (!s.ok()) {
-      return s;
+  }
+
+  std::vector<Version*> versions;
+  {
+    InstrumentedMutexLock l(db_impl_->mutex());
+    for (ColumnFamilyHandle* cf_handle : cf_handles) {
+      auto cfd = reinterpret_cast<ColumnFamilyHandleImpl*>(cf_handle)->cfd();
+      versions.push_back(cfd->current());
+      versions.back()->Ref();
+    }
+  }
+
+  // Live data sizes are summed from the live size checkpoint of the column
+  // family and table properties of SSTs created after it, or all SSTs if the
+  // checkpoint doesn't match them.
+  std::vector<std::map<uint64_t, int64_t>> live_sizes(cf_handles.size());
+  std::vector<SSTToRead> ssts;
+  // New checkpoints of all SSTs, replacing the ones not used as is.
+  std::vector<LiveSizeCheckpoint> checkpoints(cf_handles.size());
+  std::vector<bool> checkpoints_to_log(cf_handles.size(), false);
+  for (size_t i = 0; i < cf_handles.size(); i++) {
+    std::shared_ptr<BlobStorage> blob_storage =
+        blob_file_set_->GetBlobStorage(cf_handles[i]->GetID()).lock();
+    assert(blob_storage != nullptr);
+    std::unique_ptr<LiveSizeCheckpoint> checkpoint =
+        blob_storage->TakeLiveSizeCheckpoint();
+    std::vector<const FileMetaData*> files;
+    LiveSizeCheckpoint covered;
+    auto* vstorage = versions[i]->storage_info();
+    for (int level = 0; level < vstorage->num_levels(); level++) {
+      for (const FileMetaData* file : vstorage->LevelFiles(level)) {
+        files.push_back(file);
+        checkpoints[i].AddSST(file->fd.GetNumber());
+        if (checkpoint != nullptr &&
+            file->fd.GetNumber() <= checkpoint->max_sst_number) {
+          covered.AddSST(file->fd.GetNumber());
+        }
+      }
     }
-    std::map<uint64_t, int64_t> blob_file_size_diff;
-    for (auto& file : collection) {
-      s = ExtractGCStatsFromTableProperty(file.second, true /*to_add*/,
-                                          &blob_file_size_diff);
-      if (!s.ok()) {
-        return s;
+    bool use_checkpoint =
+        checkpoint != nullptr && covered.num_ssts == checkpoint->num_ssts &&
+        covered.max_sst_number == checkpoint->max_sst_number &&
+        covered.sst_digest == checkpoint->sst_digest;
+    uint64_t num_to_read = 0;
+    for (const FileMetaData* file : files) {
+      if (!use_checkpoint ||
+          file->fd.GetNumber() > checkpoint->max_sst_number) {
+        ssts.push_back({i, versions[i], file});
+        num_to_read++;
       }
     }
+    if (use_checkpoint) {
+      for (auto& file : checkpoint->live_sizes) {
+        live_sizes[i][file.first] = static_cast<int64_t>(file.second);
+      }
+    }
+    checkpoints_to_log[i] = !use_checkpoint || num_to_read > 0;
+    ROCKS_LOG_INFO(db_options_.info_log,
+                   "Titan reading %" PRIu64 " of %" PRIuPTR
+                   " SSTs for live data sizes of column family [%s], live "
+                   "size checkpoint %s.",
+                   num_to_read, files.size(), cf_handles[i]->GetName().c_str(),
+                   use_checkpoint
+                       ? "used"
+                       : (checkpoint != nullptr ? "outdated" : "not found"));
+    TEST_SYNC_POINT_CALLBACK("TitanDBImpl::InitializeGC:SSTsToRead",
+                             &num_to_read);
+  }
+  s = ReadLiveSizesFromSSTs(ssts, &live_sizes);
+  {
+    InstrumentedMutexLock l(db_impl_->mutex());
+    for (Version* version : versions) {
+      version->Unref();
+    }
+  }
+  if (!s.ok()) {
+    return s;
+  }
+
+  for (size_t i = 0; i < cf_handles.size(); i++) {
     std::shared_ptr<BlobStorage> blob_storage =
-        blob_file_set_->GetBlobStorage(cf_handle->GetID()).lock();
+        blob_file_set_->GetBlobStorage(cf_handles[i]->GetID()).lock();
     assert(blob_storage != nullptr);
-    for (auto& file_size : blob_file_size_diff) {
+    for (auto& file_size : live_sizes[i]) {
       assert(file_size.second >= 0);
       std::shared_ptr<BlobFileMeta> file =
           blob_storage->FindFile(file_size.first).lock();
       if (file != nullptr) {
         assert(file->live_data_size() == 0);
         file->set_live_data_size(static_cast<uint64_t>(file_size.second));
-        AddStats(stats_.get(), cf_handle->GetID(),
+        AddStats(stats_.get(), cf_handles[i]->GetID(),
                  file->GetDiscardableRatioLevel(), 1);
       }
+      if (file_size.second > 0) {
+        checkpoints[i].live_sizes[file_size.first] =
+            static_cast<uint64_t>(file_size.second);
+      }
     }
     blob_storage->InitializeAllFiles();
   }
   {
     MutexLock l(&mutex_);
+    // From here on the checkpoints follow flushes and compactions by deltas.
+    for (size_t i = 0; i < cf_handles.size(); i++) {
+      if (checkpoints_to_log[i]) {
+        VersionEdit edit;
+        edit.SetColumnFamilyID(cf_handles[i]->GetID());
+        edit.SetLiveSizeCheckpoint(checkpoints[i]);
+        s = blob_file_set_->LogAndApply(edit);
+        if (!s.ok()) {
+          return s;
+        }
+      } else {
+        blob_file_set_->GetBlobStorage(cf_handles[i]->GetID())
+            .lock()
+            ->SetLiveSizeCheckpoint(std::unique_ptr<LiveSizeCheckpoint>(
+                new LiveSizeCheckpoint(checkpoints[i])));
+      }
+    }
     for (ColumnFamilyHandle* cf_handle : cf_handles) {
       AddToGCQueue(cf_handle->GetID());
     }
@@ -100,6 +506,85 @@ Status TitanDBImpl::InitializeGC(
   return s;
 }
 
+Status TitanDBImpl::ReadLiveSizesFromSSTs(
+    const std::vector<SSTToRead>& ssts,
+    std::vector<std::map<uint64_t, int64_t>>* live_sizes) {
+  std::atomic<size_t> next_sst{0};
+  port::Mutex result_mutex;
+  Status result;
+  auto read_ssts = [&]() {
+    std::vector<std::map<uint64_t, int64_t>> sizes(live_sizes->size());
+    Status s;
+    for (size_t i = next_sst.fetch_add(1); s.ok() && i < ssts.size();
+         i = next_sst.fetch_add(1)) {
+      std::shared_ptr<const TableProperties> table_properties;
+      s = ssts[i].version->GetTableProperties(&table_properties,
+                                               ssts[i].file);
+      if (s.ok()) {
+        s = ExtractGCStatsFromTableProperty(table_properties, true /*to_add*/,
+                                            &sizes[ssts[i].group]);
+      }
+    }
+    MutexLock l(&result_mutex);
+    if (!s.ok()) {
+      // Stops the other threads early.
+      next_sst.store(ssts.size());
+      if (result.ok()) {
+        result = s;
+      }
+    }
+    for (size_t group = 0; group < sizes.size(); group++) {
+      for (auto& file_size : sizes[group]) {
+        (*live_sizes)[group][file_size.first] += file_size.second;
+      }
+    }
+  };
+
+  // Reading the properties mostly waits for I/O of opening the SSTs, so the
+  // caller reads along with at most max_file_opening_threads - 1 threads.
+  size_t num_threads = std::min<size_t>(
+      std::max(db_options_.max_file_opening_threads, 1), ssts.size());
+  std::vector<port::Thread> threads;
+  for (size_t i = 1; i < num_threads; i++) {
+    threads.emplace_back(read_ssts);
+  }
+  read_ssts();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  return result;
+}
+
+void TitanDBImpl::LogLiveSizeDelta(
+    uint32_t cf_id, const std::vector<std::string>& added_ssts,
+    const std::vector<std::string>& deleted_ssts,
+    const std::map<uint64_t, int64_t>& live_size_diff) {
+  mutex_.AssertHeld();
+  LiveSizeDelta delta;
+  for (const auto& sst : added_ssts) {
+    delta.added_ssts.push_back(TableFileNameToNumber(sst));
+  }
+  for (const auto& sst : deleted_ssts) {
+    delta.deleted_ssts.push_back(TableFileNameToNumber(sst));
+  }
+  for (const auto& file_diff : live_size_diff) {
+    if (file_diff.second != 0) {
+      delta.live_sizes.insert(file_diff);
+    }
+  }
+  VersionEdit edit;
+  edit.SetColumnFamilyID(cf_id);
+  edit.SetLiveSizeDelta(delta);
+  Status s = blob_file_set_->LogAndApply(edit);
+  if (!s.ok()) {
+    ROCKS_LOG_ERROR(db_options_.info_log,
+                    "Titan failed to log live size delta for CF %" PRIu32
+                    ": %s",
+                    cf_id, s.ToString().c_str());
+    SetBGError(s);
+  }
+}
+
 void TitanDBImpl::MaybeScheduleGC() {
   mutex_.AssertHeld();
 
@@ -107,14 +592,196 @@ void TitanDBImpl::MaybeScheduleGC() {
 
   if (shuting_down_.load(std::memory_order_acquire)) return;
 
-  while (unscheduled_gc_ > 0 &&
-         bg_gc_scheduled_ < db_options_.max_background_gc) {
+  if (gc_paused_) return;
+
+  while (unscheduled_gc_ > 0 && bg_gc_scheduled_ < MaxBackgroundGC()) {
     unscheduled_gc_--;
     bg_gc_scheduled_++;
     thread_pool_->SubmitJob(std::bind(&TitanDBImpl::BGWorkGC, this));
   }
 }
 
+int TitanDBImpl::MaxBackgroundGC() const {
+  mutex_.AssertHeld();
+  return blob_space_pressured_cfs_.empty() ? db_options_.max_background_gc
+                                           : 2 * db_options_.max_background_gc;
+}
+
+void TitanDBImpl::UpdateBlobSpaceAmplification() {
+  mutex_.AssertHeld();
+
+  std::set<uint32_t> pressured_cfs;
+  std::set<uint32_t> delayed_cfs;
+  double max_ratio = 0;
+  for (auto& cf : cf_info_) {
+    double target = cf.second.immutable_cf_options.max_blob_space_amplification;
+    if (target <= 0 || blob_file_set_->IsColumnFamilyObsolete(cf.first)) {
+      continue;
+    }
+    auto blob_storage = blob_file_set_->GetBlobStorage(cf.first).lock();
+    if (blob_storage == nullptr) continue;
+    double ratio = blob_storage->SpaceAmplification() / target;
+    if (ratio >= kBlobSpacePressureRatio) {
+      pressured_cfs.insert(cf.first);
+    }
+    if (ratio > 1) {
+      delayed_cfs.insert(cf.first);
+    }
+    max_ratio = std::max(max_ratio, ratio);
+  }
+
+  bool pressure_changed =
+      pressured_cfs.empty() != blob_space_pressured_cfs_.empty();
+  if (pressure_changed) {
+    ROCKS_LOG_INFO(db_options_.info_log,
+                   "Titan blob space amplification %s target, %.2f of max",
+                   pressured_cfs.empty() ? "back under" : "approaching",
+                   max_ratio);
+  }
+  blob_space_pressured_cfs_ = std::move(pressured_cfs);
+  blob_space_delayed_cfs_ = std::move(delayed_cfs);
+  if (pressure_changed && thread_pool_ != nullptr) {
+    // Grows the pool under pressure, and shrinks it back once it clears.
+    thread_pool_->SetBackgroundThreads(MaxBackgroundGC());
+  }
+
+  if (max_ratio > 1) {
+    // GC can't keep up, slow down writes to the column families behind, more
+    // the further they fall behind. The rate is shared by them.
+    int halvings = std::min(
+        static_cast<int>((max_ratio - 1) / kWriteDelayStepRatio),
+        kMaxWriteDelayHalvings);
+    uint64_t max_rate = db_impl_->GetDBOptions().delayed_write_rate;
+    uint64_t rate = std::max<uint64_t>(max_rate >> halvings, 1);
+    if (blob_space_write_token_ == nullptr ||
+        blob_space_write_controller_.delayed_write_rate() != rate) {
+      ROCKS_LOG_WARN(db_options_.info_log,
+                     "Titan delaying writes at %" PRIu64
+                     " bytes/s, blob space amplification %.2f of max",
+                     rate, max_ratio);
+      blob_space_write_controller_.set_max_delayed_write_rate(max_rate);
+      blob_space_write_token_ =
+          blob_space_write_controller_.GetDelayToken(rate);
+    }
+  } else if (blob_space_write_token_ != nullptr) {
+    ROCKS_LOG_INFO(db_options_.info_log,
+                   "Titan stopped delaying writes, blob space amplification "
+                   "%.2f of max",
+                   max_ratio);
+    blob_space_write_token_.reset();
+  }
+}
+
+void TitanDBImpl::AdjustGCRate() {
+  assert(gc_rate_controller_ != nullptr);
+  GCRateController::Signals signals;
+  if (!blob_read_latency_.Empty()) {
+    signals.read_latency_micros =
+        static_cast<uint64_t>(blob_read_latency_.Percentile(99));
+  }
+  blob_read_latency_.Clear();
+
+  uint64_t delayed_write_rate = 0;
+  uint64_t write_stopped = 0;
+  db_impl_->GetIntProperty(DB::Properties::kActualDelayedWriteRate,
+                           &delayed_write_rate);
+  db_impl_->GetIntProperty(DB::Properties::kIsWriteStopped, &write_stopped);
+  signals.write_stalled = delayed_write_rate > 0 || write_stopped > 0;
+
+  uint64_t live_blob_size = 0;
+  uint64_t live_blob_file_size = 0;
+  {
+    MutexLock l(&mutex_);
+    signals.over_space_budget = !blob_space_pressured_cfs_.empty();
+    if (stats_ != nullptr) {
+      for (auto& cf : cf_info_) {
+        TitanInternalStats* internal_stats = stats_->internal_stats(cf.first);
+        if (internal_stats == nullptr) continue;
+        live_blob_size +=
+            internal_stats->GetStats(TitanInternalStats::LIVE_BLOB_SIZE);
+        live_blob_file_size +=
+            internal_stats->GetStats(TitanInternalStats::LIVE_BLOB_FILE_SIZE);
+      }
+    }
+  }
+  if (live_blob_size > 0) {
+    signals.space_amplification =
+        static_cast<double>(live_blob_file_size) / live_blob_size;
+  }
+
+  RateLimiter* rate_limiter = db_options_.gc_rate_limiter.get();
+  uint64_t current = static_cast<uint64_t>(rate_limiter->GetBytesPerSecond());
+  GCRateController::Decision decision =
+      gc_rate_controller_->Adjust(current, signals);
+  if (decision.rate != current) {
+    rate_limiter->SetBytesPerSecond(static_cast<int64_t>(decision.rate));
+    ROCKS_LOG_INFO(db_options_.info_log,
+                   "Titan GC rate %" PRIu64 " -> %" PRIu64
+                   " bytes/s, blob read P99 %" PRIu64
+                   " us, write stalled %d, space amp %.2f",
+                   current, decision.rate, signals.read_latency_micros,
+                   static_cast<int>(signals.write_stalled),
+                   signals.space_amplification);
+  }
+  switch (decision.action) {
+    case GCRateController::Action::kSlowDown:
+      RecordTick(statistics(stats_.get()), TITAN_GC_RATE_SLOWDOWN);
+      break;
+    case GCRateController::Action::kSpeedUp:
+      RecordTick(statistics(stats_.get()), TITAN_GC_RATE_SPEEDUP);
+      break;
+    case GCRateController::Action::kPause:
+      RecordTick(statistics(stats_.get()), TITAN_GC_RATE_PAUSE);
+      break;
+    case GCRateController::Action::kHold:
+      break;
+  }
+
+  MutexLock l(&mutex_);
+  if (gc_paused_ != decision.pause) {
+    gc_paused_ = decision.pause;
+    ROCKS_LOG_INFO(db_options_.info_log, "Titan GC %s by foreground load",
+                   gc_paused_ ? "paused" : "resumed");
+    if (!gc_paused_) {
+      MaybeScheduleGC();
+    }
+  }
+}
+
+uint32_t TitanDBImpl::PopFromGCQueue() {
+  mutex_.AssertHeld();
+  assert(!gc_queue_.empty());
+  // The same column family can be queued more than once.
+  std::unordered_map<uint32_t, uint64_t> reclaimable;
+  auto best = gc_queue_.begin();
+  uint64_t best_size = 0;
+  bool best_pressured = false;
+  for (auto it = gc_queue_.begin(); it != gc_queue_.end(); it++) {
+    // Column families close to their space budget go first.
+    bool pressured = blob_space_pressured_cfs_.count(*it) > 0;
+    if (best_pressured && !pressured) continue;
+    auto p = reclaimable.find(*it);
+    if (p == reclaimable.end()) {
+      uint64_t size = 0;
+      if (!blob_file_set_->IsColumnFamilyObsolete(*it)) {
+        auto blob_storage = blob_file_set_->GetBlobStorage(*it).lock();
+        if (blob_storage != nullptr) {
+          size = blob_storage->ReclaimableSize();
+        }
+      }
+      p = reclaimable.emplace(*it, size).first;
+    }
+    if (p->second > best_size || (pressured && !best_pressured)) {
+      best = it;
+      best_size = p->second;
+      best_pressured = pressured;
+    }
+  }
+  uint32_t column_family_id = *best;
+  gc_queue_.erase(best);
+  return column_family_id;
+}
+
 void TitanDBImpl::BGWorkGC(void* db) {
   reinterpret_cast<TitanDBImpl*>(db)->BackgroundCallGC();
 }
@@ -131,7 +798,7 @@ void TitanDBImpl::BackgroundCallGC() {
 
     TEST_SYNC_POINT("TitanDBImpl::BackgroundCallGC:BeforeBackgroundGC");
     if (!gc_queue_.empty()) {
-      uint32_t column_family_id = PopFirstFromGCQueue();
+      uint32_t column_family_id = PopFromGCQueue();
       LogBuffer log_buffer(InfoLogLevel::INFO_LEVEL,
                            db_options_.info_log.get());
       BackgroundGC(&log_buffer, column_family_id);
@@ -180,17 +847,33 @@ Status TitanDBImpl::BackgroundGC(LogBuffer* log_buffer,
   }
   if (blob_storage != nullptr) {
     const auto& cf_options = blob_storage->cf_options();
-    std::shared_ptr<BlobGCPicker> blob_gc_picker =
-        std::make_shared<BasicBlobGCPicker>(db_options_, cf_options,
-                                            stats_.get());
+    TitanCFOptions picker_cf_options = cf_options;
+    if (blob_space_pressured_cfs_.count(column_family_id) > 0) {
+      // Reclaim whatever there is instead of waiting for a full batch.
+      picker_cf_options.min_gc_batch_size = 0;
+    }
+    std::unique_ptr<BlobGCPicker> blob_gc_picker =
+        NewBlobGCPicker(db_options_, picker_cf_options, stats_.get());
     blob_gc = blob_gc_picker->PickBlobGC(blob_storage.get());
 
     if (blob_gc) {
       cfh = db_impl_->GetColumnFamilyHandleUnlocked(column_family_id);
       assert(column_family_id == cfh->GetID());
       blob_gc->SetColumnFamily(cfh.get());
+      blob_gc->SetCompressionDicts(blob_storage->compression_dicts());
       gc_merge_rewrite =
           cf_info_[column_family_id].mutable_cf_options.gc_merge_rewrite;
+
+      if (blob_gc->trigger_next() &&
+          (bg_gc_scheduled_ - 1 + gc_queue_.size() <
+           2 * static_cast<uint32_t>(db_options_.max_background_gc))) {
+        RecordTick(statistics(stats_.get()), TITAN_GC_TRIGGER_NEXT, 1);
+        // There is still data remained to be GCed and the queue is not
+        // overwhelmed, then put this cf to GC queue right away, so that
+        // another job can GC the rest files in parallel with this one.
+        AddToGCQueue(column_family_id);
+        MaybeScheduleGC();
+      }
     }
   }
 
@@ -201,33 +884,11 @@ Status TitanDBImpl::BackgroundGC(LogBuffer* log_buffer,
     // Nothing to do
     ROCKS_LOG_BUFFER(log_buffer, "Titan GC nothing to do");
   } else {
-    StopWatch gc_sw(env_, statistics(stats_.get()), TITAN_GC_MICROS);
-    BlobGCJob blob_gc_job(blob_gc.get(), db_, &mutex_, db_options_,
-                          gc_merge_rewrite, env_, env_options_,
-                          blob_manager_.get(), blob_file_set_.get(), log_buffer,
-                          &shuting_down_, stats_.get());
-    s = blob_gc_job.Prepare();
-    if (s.ok()) {
-      mutex_.Unlock();
-      TEST_SYNC_POINT("TitanDBImpl::BackgroundGC::BeforeRunGCJob");
-      s = blob_gc_job.Run();
-      TEST_SYNC_POINT("TitanDBImpl::BackgroundGC::AfterRunGCJob");
-      mutex_.Lock();
-    }
-    if (s.ok()) {
-      s = blob_gc_job.Finish();
-    }
-    blob_gc->ReleaseGcFiles();
-
-    if (blob_gc->trigger_next() &&
-        (bg_gc_scheduled_ - 1 + gc_queue_.size() <
-         2 * static_cast<uint32_t>(db_options_.max_background_gc))) {
-      RecordTick(statistics(stats_.get()), TITAN_GC_TRIGGER_NEXT, 1);
-      // There is still data remained to be GCed
-      // and the queue is not overwhelmed
-      // then put this cf to GC queue for next GC
-      AddToGCQueue(blob_gc->column_family_handle()->GetID());
-    }
+    s = RunBlobGCJob(blob_gc.get(), gc_merge_rewrite, log_buffer);
+  }
+  if (s.ok() && blob_storage != nullptr &&
+      !blob_file_set_->IsColumnFamilyObsolete(column_family_id)) {
+    PunchBlobFileHoles(column_family_id, blob_storage.get(), log_buffer);
   }
 
   if (s.ok()) {
@@ -240,10 +901,390 @@ Status TitanDBImpl::BackgroundGC(LogBuffer* log_buffer,
                    s.ToString().c_str());
   }
 
+  UpdateBlobSpaceAmplification();
   TEST_SYNC_POINT("TitanDBImpl::BackgroundGC:Finish");
   return s;
 }
 
+Status TitanDBImpl::RunBlobGCJob(BlobGC* blob_gc, bool gc_merge_rewrite,
+                                 LogBuffer* log_buffer) {
+  mutex_.AssertHeld();
+  StopWatch gc_sw(env_, statistics(stats_.get()), TITAN_GC_MICROS);
+  BlobGCJob blob_gc_job(blob_gc, db_, &mutex_, db_options_, gc_merge_rewrite,
+                        env_, env_options_, blob_manager_.get(),
+                        blob_file_set_.get(), log_buffer, &shuting_down_,
+                        stats_.get(), thread_pool_.get());
+  Status s = blob_gc_job.Prepare();
+  if (s.ok()) {
+    mutex_.Unlock();
+    TEST_SYNC_POINT("TitanDBImpl::BackgroundGC::BeforeRunGCJob");
+    s = blob_gc_job.Run();
+    TEST_SYNC_POINT("TitanDBImpl::BackgroundGC::AfterRunGCJob");
+    mutex_.Lock();
+  }
+  if (s.ok()) {
+    s = blob_gc_job.Finish();
+  }
+  blob_gc->ReleaseGcFiles();
+  return s;
+}
+
+Status TitanDBImpl::CompactBlobFiles(ColumnFamilyHandle* column_family,
+                                     const Slice* begin, const Slice* end,
+                                     const CompactBlobFilesOptions& options) {
+  assert(column_family != nullptr);
+  uint32_t column_family_id = column_family->GetID();
+  std::vector<std::unique_ptr<BlobGC>> blob_gcs;
+  uint64_t files_total = 0;
+  bool gc_merge_rewrite = false;
+  {
+    MutexLock l(&mutex_);
+    // Prevent CF being dropped while GC is running.
+    while (drop_cf_requests_ > 0) {
+      bg_cv_.Wait();
+    }
+    if (blob_file_set_->IsColumnFamilyObsolete(column_family_id)) {
+      return Status::InvalidArgument("Column family has been dropped.");
+    }
+    std::shared_ptr<BlobStorage> blob_storage =
+        blob_file_set_->GetBlobStorage(column_family_id).lock();
+    if (blob_storage == nullptr) {
+      return Status::InvalidArgument("Column family not found.");
+    }
+    const TitanCFOptions& cf_options = blob_storage->cf_options();
+    double min_discardable_ratio =
+        options.min_discardable_ratio >= 0
+            ? options.min_discardable_ratio
+            : cf_options.blob_file_discardable_ratio;
+    gc_merge_rewrite =
+        cf_info_[column_family_id].mutable_cf_options.gc_merge_rewrite;
+
+    RangePtr range(begin, end);
+    std::vector<uint64_t> file_numbers;
+    Status s = blob_storage->GetBlobFilesInRanges(&range, 1,
+                                                  true /*include_end*/,
+                                                  &file_numbers);
+    if (!s.ok()) {
+      return s;
+    }
+
+    // Files come in order of their smallest keys, batch them up the same way
+    // as the GC picker does.
+    std::vector<std::shared_ptr<BlobFileMeta>> batch;
+    uint64_t batch_size = 0;
+    uint64_t estimate_output_size = 0;
+    auto add_blob_gc = [&]() {
+      if (batch.empty()) {
+        return;
+      }
+      files_total += batch.size();
+      TitanCFOptions gc_cf_options = cf_options;
+      blob_gcs.emplace_back(new BlobGC(std::move(batch),
+                                       std::move(gc_cf_options),
+                                       false /*need_trigger_next*/));
+      blob_gcs.back()->SetColumnFamily(column_family);
+      blob_gcs.back()->SetCompressionDicts(blob_storage->compression_dicts());
+      batch.clear();
+      batch_size = 0;
+      estimate_output_size = 0;
+    };
+    for (uint64_t file_number : file_numbers) {
+      auto file = blob_storage->FindFile(file_number).lock();
+      if (!file || file->file_state() != BlobFileMeta::FileState::kNormal ||
+          file->GetDiscardableRatio() < min_discardable_ratio) {
+        continue;
+      }
+      batch_size += file->file_size();
+      estimate_output_size += file->live_data_size();
+      batch.push_back(std::move(file));
+      if (batch_size >= cf_options.max_gc_batch_size ||
+          estimate_output_size >= cf_options.blob_file_target_size) {
+        add_blob_gc();
+      }
+    }
+    add_blob_gc();
+    if (blob_gcs.empty()) {
+      return Status::OK();
+    }
+    ROCKS_LOG_INFO(db_options_.info_log,
+                   "[%s] Titan compacting %" PRIu64 " blob files in %" PRIuPTR
+                   " GC jobs",
+                   column_family->GetName().c_str(), files_total,
+                   blob_gcs.size());
+    // The call is accounted as a single GC run, so that CF dropping and DB
+    // closing wait for it.
+    bg_gc_running_++;
+    bg_gc_scheduled_++;
+  }
+
+  std::atomic<size_t> next_job{0};
+  std::atomic<bool> failed{false};
+  std::atomic<bool> aborted{false};
+  port::Mutex progress_mutex;
+  uint64_t files_done = 0;
+  std::vector<Status> statuses(
+      std::min<size_t>(std::max<uint32_t>(options.max_parallelism, 1),
+                       blob_gcs.size()));
+  auto run_jobs = [&](size_t worker) {
+    LogBuffer log_buffer(InfoLogLevel::INFO_LEVEL, db_options_.info_log.get());
+    MutexLock l(&mutex_);
+    for (size_t i = next_job++; i < blob_gcs.size(); i = next_job++) {
+      BlobGC* blob_gc = blob_gcs[i].get();
+      if (!failed.load(std::memory_order_relaxed) &&
+          shuting_down_.load(std::memory_order_acquire)) {
+        aborted.store(true, std::memory_order_relaxed);
+      }
+      if (failed.load(std::memory_order_relaxed) ||
+          aborted.load(std::memory_order_relaxed)) {
+        // Give the rest of the files back to background GC.
+        blob_gc->ReleaseGcFiles();
+        continue;
+      }
+      Status s = RunBlobGCJob(blob_gc, gc_merge_rewrite, &log_buffer);
+      if (s.ok()) {
+        RecordTick(statistics(stats_.get()), TITAN_GC_SUCCESS, 1);
+      } else {
+        SetBGError(s);
+        RecordTick(statistics(stats_.get()), TITAN_GC_FAILURE, 1);
+        ROCKS_LOG_WARN(db_options_.info_log, "Titan GC error: %s",
+                       s.ToString().c_str());
+        statuses[worker] = s;
+        failed.store(true, std::memory_order_relaxed);
+      }
+      mutex_.Unlock();
+      log_buffer.FlushBufferToLog();
+      if (s.ok() && options.progress_callback) {
+        MutexLock progress_lock(&progress_mutex);
+        files_done += blob_gc->inputs().size();
+        options.progress_callback(files_done, files_total);
+      }
+      mutex_.Lock();
+    }
+  };
+  // Other workers than the calling thread run in the GC thread pool, so
+  // that they are bounded by `max_background_gc` along with background GC.
+  // The calling thread takes the jobs left if the pool is busy.
+  port::Mutex workers_mutex;
+  port::CondVar workers_cv(&workers_mutex);
+  size_t num_workers = 0;
+  if (thread_pool_ != nullptr) {
+    num_workers = statuses.size() - 1;
+    for (size_t i = 1; i < statuses.size(); i++) {
+      thread_pool_->SubmitJob([&, i]() {
+        run_jobs(i);
+        MutexLock l(&workers_mutex);
+        if (--num_workers == 0) {
+          workers_cv.Signal();
+        }
+      });
+    }
+  }
+  run_jobs(0);
+  {
+    MutexLock l(&workers_mutex);
+    while (num_workers > 0) {
+      workers_cv.Wait();
+    }
+  }
+  LogFlush(db_options_.info_log.get());
+
+  Status s;
+  for (auto& status : statuses) {
+    if (!status.ok()) {
+      s = status;
+      break;
+    }
+  }
+  if (s.ok() && aborted.load(std::memory_order_relaxed)) {
+    s = Status::ShutdownInProgress();
+  }
+  {
+    MutexLock l(&mutex_);
+    UpdateBlobSpaceAmplification();
+    bg_gc_running_--;
+    bg_gc_scheduled_--;
+    if (bg_gc_scheduled_ == 0 || bg_gc_running_ == 0) {
+      bg_cv_.SignalAll();
+    }
+  }
+  return s;
+}
+
+Status TitanDBImpl::EstimateGC(ColumnFamilyHandle* column_family,
+                               const TitanCFOptions* options,
+                               GCEstimate* estimate) {
+  assert(column_family != nullptr);
+  assert(estimate != nullptr);
+  *estimate = GCEstimate();
+  uint32_t column_family_id = column_family->GetID();
+  std::unique_ptr<BlobGCPicker> blob_gc_picker;
+  std::vector<GCCandidate> candidates;
+  {
+    MutexLock l(&mutex_);
+    if (blob_file_set_->IsColumnFamilyObsolete(column_family_id)) {
+      return Status::InvalidArgument("Column family has been dropped.");
+    }
+    std::shared_ptr<BlobStorage> blob_storage =
+        blob_file_set_->GetBlobStorage(column_family_id).lock();
+    if (blob_storage == nullptr) {
+      return Status::InvalidArgument("Column family not found.");
+    }
+
+    TitanCFOptions picker_cf_options = blob_storage->cf_options();
+    if (options != nullptr) {
+      picker_cf_options = *options;
+    } else if (blob_space_pressured_cfs_.count(column_family_id) > 0) {
+      // Same as BackgroundGC().
+      picker_cf_options.min_gc_batch_size = 0;
+    }
+    // Stats are left out, as nothing is actually picked.
+    blob_gc_picker =
+        NewBlobGCPicker(db_options_, picker_cf_options, nullptr /*stats*/);
+    candidates = blob_gc_picker->GetCandidates(blob_storage.get());
+
+    std::map<uint64_t, std::weak_ptr<BlobFileMeta>> blob_files;
+    blob_storage->ExportBlobFiles(blob_files);
+    for (const auto& blob_file : blob_files) {
+      auto file = blob_file.second.lock();
+      if (file != nullptr && !file->is_obsolete()) {
+        estimate->num_blob_files++;
+        estimate->blob_file_size += file->file_size();
+      }
+    }
+  }
+
+  // Files are picked by one GC after another in the order of the
+  // candidates, which stays the same as nothing is actually GCed. So the
+  // batches are taken from the candidates taken once, without the mutex.
+  size_t start = 0;
+  std::vector<GCCandidate> files;
+  bool trigger_next = false;
+  while (blob_gc_picker->NextBatch(candidates, &start, &files,
+                                   &trigger_next)) {
+    GCEstimate::Batch batch;
+    for (const auto& file : files) {
+      batch.file_numbers.push_back(file.file_number);
+      batch.bytes_read += file.file_size;
+      batch.bytes_written += file.live_data_size;
+    }
+    estimate->bytes_read += batch.bytes_read;
+    estimate->bytes_written += batch.bytes_written;
+    estimate->batches.push_back(std::move(batch));
+  }
+  if (estimate->bytes_read > estimate->bytes_written) {
+    estimate->reclaimable_size = estimate->bytes_read - estimate->bytes_written;
+  }
+  return Status::OK();
+}
+
+void TitanDBImpl::PunchBlobFileHoles(uint32_t column_family_id,
+                                     BlobStorage* blob_storage,
+                                     LogBuffer* log_buffer) {
+  mutex_.AssertHeld();
+  const auto& cf_options = blob_storage->cf_options();
+  if (cf_options.punch_hole_min_size == 0 ||
+      !cf_options.track_blob_record_deletions || punch_hole_unsupported_) {
+    return;
+  }
+
+  // Files GC would not pick, with enough records dropped since they were
+  // last checked to possibly make a new hole, most such records first.
+  std::vector<std::pair<uint64_t, std::shared_ptr<BlobFileMeta>>> candidates;
+  for (const auto& score : blob_storage->gc_score()) {
+    auto file = blob_storage->FindFile(score.file_number).lock();
+    if (!file || file->file_state() != BlobFileMeta::FileState::kNormal ||
+        file->GetDiscardableRatio() >= cf_options.blob_file_discardable_ratio) {
+      continue;
+    }
+    uint64_t checked_size = file->punch_checked_size();
+    uint64_t dead_size = file->dead_records().total_size();
+    if (dead_size < checked_size + cf_options.punch_hole_min_size) {
+      continue;
+    }
+    candidates.emplace_back(dead_size - checked_size, std::move(file));
+  }
+  if (candidates.size() > kMaxFilesToPunchHoles) {
+    std::partial_sort(
+        candidates.begin(), candidates.begin() + kMaxFilesToPunchHoles,
+        candidates.end(),
+        [](const std::pair<uint64_t, std::shared_ptr<BlobFileMeta>>& a,
+           const std::pair<uint64_t, std::shared_ptr<BlobFileMeta>>& b) {
+          return a.first > b.first;
+        });
+    candidates.resize(kMaxFilesToPunchHoles);
+  }
+
+  for (auto& candidate : candidates) {
+    auto& file = candidate.second;
+    uint64_t file_number = file->file_number();
+    file->FileStateTransit(BlobFileMeta::FileEvent::kGCBegin);
+    BlobRecordSet dead_records = file->dead_records();
+    BlobFileRanges punched = file->punched_holes();
+    file->set_punch_checked_size(dead_records.total_size());
+
+    BlobFileRanges holes;
+    mutex_.Unlock();
+    FindDeadRanges(dead_records.Records(), cf_options.punch_hole_min_size,
+                   &holes);
+    holes = SubtractRanges(holes, punched);
+    mutex_.Lock();
+
+    Status s;
+    if (!holes.empty() && !shuting_down_.load(std::memory_order_acquire)) {
+      // Holes are logged before being punched, so that iterating the file
+      // never runs into an unknown hole, even after a crash in between.
+      VersionEdit edit;
+      edit.SetColumnFamilyID(column_family_id);
+      edit.AddPunchedHoles(file_number, holes);
+      s = blob_file_set_->LogAndApply(edit);
+      if (s.ok()) {
+        mutex_.Unlock();
+        std::string file_name = BlobFileName(db_options_.dirname, file_number);
+        uint64_t punched_bytes = 0;
+        size_t num_punched = 0;
+        for (const auto& hole : holes) {
+          s = PunchHole(file_name, hole.first, hole.second);
+          if (!s.ok()) {
+            break;
+          }
+          punched_bytes += hole.second;
+          num_punched++;
+        }
+        mutex_.Lock();
+        RecordTick(statistics(stats_.get()), TITAN_GC_NUM_HOLES_PUNCHED,
+                   num_punched);
+        RecordTick(statistics(stats_.get()), TITAN_GC_BYTES_PUNCHED,
+                   punched_bytes);
+        ROCKS_LOG_BUFFER(log_buffer,
+                         "Titan punched %" PRIu64 " bytes in %" PRIuPTR
+                         " of %" PRIuPTR " holes of blob file %" PRIu64,
+                         punched_bytes, num_punched, holes.size(),
+                         file_number);
+      }
+    }
+    if (s.IsNotSupported()) {
+      // The holes stay logged, which only means the dead records are skipped
+      // by GC.
+      punch_hole_unsupported_ = true;
+      ROCKS_LOG_WARN(db_options_.info_log,
+                     "Titan disabled punching holes in blob files: %s",
+                     s.ToString().c_str());
+    } else if (!s.ok()) {
+      ROCKS_LOG_WARN(db_options_.info_log,
+                     "Titan failed to punch holes in blob file %" PRIu64
+                     ": %s",
+                     file_number, s.ToString().c_str());
+    }
+    file->FileStateTransit(BlobFileMeta::FileEvent::kGCCompleted);
+    if (punch_hole_unsupported_) {
+      break;
+    }
+  }
+  if (!candidates.empty()) {
+    blob_storage->ComputeGCScore();
+  }
+}
+
 Status TitanDBImpl::TEST_StartGC(uint32_t column_family_id) {
   // BackgroundCallGC
   Status s;
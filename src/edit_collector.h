@@ -3,7 +3,10 @@
 #include <inttypes.h>
 
 #include <algorithm>
+#include <map>
+#include <memory>
 #include <unordered_map>
+#include <vector>
 
 #include "blob_file_set.h"
 #include "util/string_util.h"
@@ -34,6 +37,31 @@ class EditCollector {
       status_ = collector.DeleteFile(file.first, file.second);
       if (!status_.ok()) return status_;
     }
+    for (auto& dict : edit.added_dicts_) {
+      status_ = collector.AddCompressionDict(dict.first, dict.second);
+      if (!status_.ok()) return status_;
+    }
+    for (auto& file : edit.punched_holes_) {
+      collector.AddPunchedHoles(file.first, file.second);
+    }
+    for (auto& file : edit.gc_resume_positions_) {
+      collector.SetGCResumePosition(file.first, file.second);
+    }
+    for (auto& file : edit.dead_records_) {
+      collector.AddDeadRecords(file.first, file.second);
+    }
+    for (auto& file : edit.deletion_tracked_) {
+      collector.SetDeletionTracked(file.first, file.second);
+    }
+    for (auto& file : edit.creation_times_) {
+      collector.SetCreationTime(file.first, file.second);
+    }
+    if (edit.has_live_size_checkpoint_) {
+      collector.SetLiveSizeCheckpoint(edit.live_size_checkpoint_);
+    }
+    if (edit.has_live_size_delta_) {
+      collector.AddLiveSizeDelta(edit.live_size_delta_);
+    }
 
     if (edit.has_next_file_number_) {
       if (edit.next_file_number_ < next_file_number_) {
@@ -138,7 +166,58 @@ class EditCollector {
       return Status::OK();
     }
 
+    Status AddCompressionDict(uint64_t id, const std::string& raw_dict) {
+      if (!added_dicts_.emplace(id, raw_dict).second) {
+        return Status::Corruption("Compression dict " + ToString(id) +
+                                  " has been added twice");
+      }
+      return Status::OK();
+    }
+
+    void AddPunchedHoles(uint64_t number, const BlobFileRanges& holes) {
+      auto& file_holes = punched_holes_[number];
+      file_holes.insert(file_holes.end(), holes.begin(), holes.end());
+    }
+
+    void SetGCResumePosition(uint64_t number,
+                             const std::pair<uint64_t, uint32_t>& position) {
+      gc_resume_positions_[number] = position;
+    }
+
+    void AddDeadRecords(uint64_t number, const BlobRecordSet& records) {
+      std::vector<BlobHandle> handles = records.Records();
+      auto& file_records = dead_records_[number];
+      file_records.insert(file_records.end(), handles.begin(), handles.end());
+    }
+
+    void SetDeletionTracked(uint64_t number, bool tracked) {
+      deletion_tracked_[number] = tracked;
+    }
+
+    void SetCreationTime(uint64_t number, uint64_t time) {
+      creation_times_[number] = time;
+    }
+
+    void SetLiveSizeCheckpoint(const LiveSizeCheckpoint& checkpoint) {
+      live_size_checkpoint_.reset(new LiveSizeCheckpoint(checkpoint));
+      // Deltas before it are already included.
+      live_size_deltas_.clear();
+    }
+
+    void AddLiveSizeDelta(const LiveSizeDelta& delta) {
+      live_size_deltas_.push_back(delta);
+    }
+
     Status Seal(BlobStorage* storage) {
+      for (auto& dict : added_dicts_) {
+        if (storage->compression_dicts()->GetUncompressionDict(dict.first) !=
+            nullptr) {
+          return Status::Corruption("Compression dict " +
+                                    ToString(dict.first) +
+                                    " has been added before");
+        }
+      }
+
       for (auto& file : added_files_) {
         auto number = file.first;
         auto blob = storage->FindFile(number).lock();
@@ -180,10 +259,35 @@ class EditCollector {
         }
       }
 
+      for (auto& file : punched_holes_) {
+        Status s = CheckFileToUpdate(storage, file.first);
+        if (!s.ok()) return s;
+      }
+      for (auto& file : gc_resume_positions_) {
+        Status s = CheckFileToUpdate(storage, file.first);
+        if (!s.ok()) return s;
+      }
+      for (auto& file : dead_records_) {
+        Status s = CheckFileToUpdate(storage, file.first);
+        if (!s.ok()) return s;
+      }
+      for (auto& file : deletion_tracked_) {
+        Status s = CheckFileToUpdate(storage, file.first);
+        if (!s.ok()) return s;
+      }
+      for (auto& file : creation_times_) {
+        Status s = CheckFileToUpdate(storage, file.first);
+        if (!s.ok()) return s;
+      }
+
       return Status::OK();
     }
 
     Status Apply(BlobStorage* storage) {
+      for (auto& dict : added_dicts_) {
+        storage->compression_dicts()->Add(dict.first, dict.second);
+      }
+
       for (auto& file : added_files_) {
         // just skip paired added and deleted files
         if (deleted_files_.count(file.first) > 0) {
@@ -204,6 +308,65 @@ class EditCollector {
         }
       }
 
+      for (auto& file : punched_holes_) {
+        if (deleted_files_.count(file.first) > 0) {
+          continue;
+        }
+        auto blob = storage->FindFile(file.first).lock();
+        if (blob) {
+          blob->AddPunchedHoles(file.second);
+        }
+      }
+
+      for (auto& file : gc_resume_positions_) {
+        if (deleted_files_.count(file.first) > 0) {
+          continue;
+        }
+        auto blob = storage->FindFile(file.first).lock();
+        if (blob) {
+          blob->SetGCResumePosition(file.second.first, file.second.second);
+        }
+      }
+
+      for (auto& file : dead_records_) {
+        if (deleted_files_.count(file.first) > 0) {
+          continue;
+        }
+        auto blob = storage->FindFile(file.first).lock();
+        if (blob) {
+          blob->AddDeadRecords(file.second);
+        }
+      }
+
+      for (auto& file : deletion_tracked_) {
+        if (deleted_files_.count(file.first) > 0) {
+          continue;
+        }
+        auto blob = storage->FindFile(file.first).lock();
+        if (blob) {
+          blob->set_deletion_tracked(file.second);
+        }
+      }
+
+      for (auto& file : creation_times_) {
+        if (deleted_files_.count(file.first) > 0) {
+          continue;
+        }
+        auto blob = storage->FindFile(file.first).lock();
+        if (blob) {
+          blob->set_creation_time(file.second);
+        }
+      }
+
+      // Sizes of files not found are ignored when the checkpoint is used, so
+      // it isn't checked here.
+      if (live_size_checkpoint_ != nullptr) {
+        storage->SetLiveSizeCheckpoint(std::move(live_size_checkpoint_));
+      }
+      for (auto& delta : live_size_deltas_) {
+        storage->ApplyLiveSizeDelta(delta);
+      }
+
       storage->ComputeGCScore();
       return Status::OK();
     }
@@ -220,6 +383,10 @@ class EditCollector {
           added_files_.at(file)->Dump(with_keys);
         }
       }
+      for (auto& dict : added_dicts_) {
+        fprintf(stdout, "compression dict %" PRIu64 ", size %" PRIu64 "\n",
+                dict.first, static_cast<uint64_t>(dict.second.size()));
+      }
       bool has_additional_deletion = false;
       for (auto& file : deleted_files_) {
         if (added_files_.count(file.first) == 0) {
@@ -234,8 +401,35 @@ class EditCollector {
     }
 
    private:
+    // Checks the existing file whose meta is updated by the batch.
+    Status CheckFileToUpdate(BlobStorage* storage, uint64_t number) const {
+      if (added_files_.count(number) > 0 || deleted_files_.count(number) > 0) {
+        return Status::OK();
+      }
+      auto blob = storage->FindFile(number).lock();
+      if (!blob || blob->is_obsolete()) {
+        ROCKS_LOG_ERROR(storage->db_options().info_log,
+                        "blob file %" PRIu64 " to update doesn't exist\n",
+                        number);
+        return Status::Corruption("Blob file " + ToString(number) +
+                                  " to update doesn't exist");
+      }
+      return Status::OK();
+    }
+
     std::unordered_map<uint64_t, std::shared_ptr<BlobFileMeta>> added_files_;
     std::unordered_map<uint64_t, SequenceNumber> deleted_files_;
+    std::map<uint64_t, std::string> added_dicts_;
+    std::unordered_map<uint64_t, BlobFileRanges> punched_holes_;
+    std::unordered_map<uint64_t, std::pair<uint64_t, uint32_t>>
+        gc_resume_positions_;
+    std::unordered_map<uint64_t, std::vector<BlobHandle>> dead_records_;
+    std::unordered_map<uint64_t, bool> deletion_tracked_;
+    std::unordered_map<uint64_t, uint64_t> creation_times_;
+    // The last one of the batch.
+    std::unique_ptr<LiveSizeCheckpoint> live_size_checkpoint_;
+    // Deltas after the last checkpoint, in order.
+    std::vector<LiveSizeDelta> live_size_deltas_;
   };
 
   Status status_{Status::OK()};
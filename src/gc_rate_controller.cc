@@ -0,0 +1,45 @@
+#include "gc_rate_controller.h"
+
+#include <algorithm>
+
+namespace rocksdb {
+namespace titandb {
+
+const uint64_t GCRateController::kMinRateDivisor;
+const uint64_t GCRateController::kSpeedUpSteps;
+constexpr double GCRateController::kUrgentSpaceAmpRatio;
+
+uint64_t GCRateController::min_rate() const {
+  return std::max<uint64_t>(max_rate_ / kMinRateDivisor, 1);
+}
+
+GCRateController::Decision GCRateController::Adjust(
+    uint64_t current, const Signals& signals) const {
+  current = std::min(std::max(current, min_rate()), max_rate_);
+  if (signals.over_space_budget ||
+      (max_space_amplification_ > 0 &&
+       signals.space_amplification >=
+           max_space_amplification_ * kUrgentSpaceAmpRatio)) {
+    bool over_limit = max_space_amplification_ > 0 &&
+                      signals.space_amplification >= max_space_amplification_;
+    uint64_t next = over_limit ? max_rate_ : std::min(max_rate_, current * 2);
+    return {next, false, next > current ? Action::kSpeedUp : Action::kHold};
+  }
+  bool overloaded = signals.write_stalled ||
+                    (target_latency_micros_ > 0 &&
+                     signals.read_latency_micros > target_latency_micros_);
+  if (overloaded) {
+    if (current <= min_rate()) {
+      return {min_rate(), true, Action::kPause};
+    }
+    return {std::max(min_rate(), current / 2), false, Action::kSlowDown};
+  }
+  if (current < max_rate_) {
+    uint64_t step = std::max<uint64_t>(max_rate_ / kSpeedUpSteps, 1);
+    return {std::min(max_rate_, current + step), false, Action::kSpeedUp};
+  }
+  return {max_rate_, false, Action::kHold};
+}
+
+}  // namespace titandb
+}  // namespace rocksdb
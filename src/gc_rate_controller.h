@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+
+namespace rocksdb {
+namespace titandb {
+
+// Picks the rate of GC I/O from foreground load, when adaptive_gc_rate is
+// enabled.
+//
+// The rate is cut by half whenever foreground is hurt, either by slow reads
+// of blob files or by write stalls of the base DB, and GC stops taking new
+// jobs if foreground is still hurt at the lowest rate. Otherwise the rate is
+// raised by a fixed step back to the max rate. Space amplification close to
+// its limit overrides foreground load, since running out of space is worse
+// than slow requests.
+class GCRateController {
+ public:
+  // The lowest rate is max rate divided by this.
+  static const uint64_t kMinRateDivisor = 64;
+  // The max rate is reached in this many steps from zero.
+  static const uint64_t kSpeedUpSteps = 16;
+  // GC is not held back once space amplification reaches this ratio of its
+  // limit.
+  static constexpr double kUrgentSpaceAmpRatio = 0.9;
+
+  enum class Action {
+    kHold,
+    kSlowDown,
+    kSpeedUp,
+    kPause,
+  };
+
+  struct Signals {
+    // P99 latency of blob file reads by Gets since last adjustment, 0 if
+    // there was none.
+    uint64_t read_latency_micros = 0;
+    // Whether the base DB is delaying or stopping writes.
+    bool write_stalled = false;
+    // Total size of live blob files over size of live blob data, 0 if
+    // unknown.
+    double space_amplification = 0;
+    // Whether some column family is close to its
+    // max_blob_space_amplification.
+    bool over_space_budget = false;
+  };
+
+  struct Decision {
+    uint64_t rate;
+    // Whether GC should stop starting new jobs.
+    bool pause;
+    Action action;
+  };
+
+  GCRateController(uint64_t max_rate, uint64_t target_latency_micros,
+                   double max_space_amplification)
+      : max_rate_(max_rate),
+        target_latency_micros_(target_latency_micros),
+        max_space_amplification_(max_space_amplification) {}
+
+  uint64_t min_rate() const;
+
+  // Returns the rate to use next, given the rate currently used.
+  Decision Adjust(uint64_t current, const Signals& signals) const;
+
+ private:
+  uint64_t max_rate_;
+  uint64_t target_latency_micros_;
+  double max_space_amplification_;
+};
+
+}  // namespace titandb
+}  // namespace rocksdb
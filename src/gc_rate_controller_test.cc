@@ -0,0 +1,98 @@
+#include "gc_rate_controller.h"
+
+#include "test_util/testharness.h"
+
+namespace rocksdb {
+namespace titandb {
+
+class GCRateControllerTest : public testing::Test {
+ public:
+  static const uint64_t kMaxRate = 64 << 20;
+
+  GCRateControllerTest() : controller_(kMaxRate, 1000, 2.0) {}
+
+  GCRateController controller_;
+};
+
+const uint64_t GCRateControllerTest::kMaxRate;
+
+TEST_F(GCRateControllerTest, SlowDownAndPause) {
+  GCRateController::Signals signals;
+  signals.read_latency_micros = 2000;
+  uint64_t rate = kMaxRate;
+  int slow_downs = 0;
+  while (true) {
+    auto decision = controller_.Adjust(rate, signals);
+    if (decision.action == GCRateController::Action::kPause) {
+      ASSERT_TRUE(decision.pause);
+      ASSERT_EQ(decision.rate, controller_.min_rate());
+      break;
+    }
+    ASSERT_EQ(decision.action, GCRateController::Action::kSlowDown);
+    ASSERT_FALSE(decision.pause);
+    ASSERT_EQ(decision.rate, rate / 2);
+    rate = decision.rate;
+    slow_downs++;
+  }
+  ASSERT_EQ(slow_downs, 6);
+
+  // Write stalls of the base DB count as overload too.
+  signals.read_latency_micros = 0;
+  signals.write_stalled = true;
+  auto decision = controller_.Adjust(kMaxRate, signals);
+  ASSERT_EQ(decision.action, GCRateController::Action::kSlowDown);
+  ASSERT_EQ(decision.rate, kMaxRate / 2);
+}
+
+TEST_F(GCRateControllerTest, SpeedUp) {
+  GCRateController::Signals signals;
+  signals.read_latency_micros = 500;
+  uint64_t rate = controller_.min_rate();
+  int speed_ups = 0;
+  while (rate < kMaxRate) {
+    auto decision = controller_.Adjust(rate, signals);
+    ASSERT_EQ(decision.action, GCRateController::Action::kSpeedUp);
+    ASSERT_FALSE(decision.pause);
+    ASSERT_GT(decision.rate, rate);
+    rate = decision.rate;
+    speed_ups++;
+  }
+  ASSERT_LE(speed_ups, static_cast<int>(GCRateController::kSpeedUpSteps));
+  auto decision = controller_.Adjust(rate, signals);
+  ASSERT_EQ(decision.action, GCRateController::Action::kHold);
+  ASSERT_EQ(decision.rate, kMaxRate);
+}
+
+TEST_F(GCRateControllerTest, SpaceAmplificationOverridesLoad) {
+  GCRateController::Signals signals;
+  signals.read_latency_micros = 2000;
+  signals.write_stalled = true;
+  // Approaching the limit, GC speeds up despite the load.
+  signals.space_amplification = 1.9;
+  auto decision = controller_.Adjust(kMaxRate / 8, signals);
+  ASSERT_EQ(decision.action, GCRateController::Action::kSpeedUp);
+  ASSERT_FALSE(decision.pause);
+  ASSERT_EQ(decision.rate, kMaxRate / 4);
+  // Beyond the limit, GC runs at full rate.
+  signals.space_amplification = 2.5;
+  decision = controller_.Adjust(controller_.min_rate(), signals);
+  ASSERT_FALSE(decision.pause);
+  ASSERT_EQ(decision.rate, kMaxRate);
+  // Far from the limit, load wins.
+  signals.space_amplification = 1.2;
+  decision = controller_.Adjust(kMaxRate, signals);
+  ASSERT_EQ(decision.action, GCRateController::Action::kSlowDown);
+  // Unless some column family is close to its own budget.
+  signals.over_space_budget = true;
+  decision = controller_.Adjust(kMaxRate / 8, signals);
+  ASSERT_EQ(decision.action, GCRateController::Action::kSpeedUp);
+  ASSERT_EQ(decision.rate, kMaxRate / 4);
+}
+
+}  // namespace titandb
+}  // namespace rocksdb
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
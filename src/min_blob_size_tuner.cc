@@ -0,0 +1,36 @@
+#include "min_blob_size_tuner.h"
+
+#include <algorithm>
+
+namespace rocksdb {
+namespace titandb {
+
+uint64_t MinBlobSizeTuner::Bound(uint64_t size) const {
+  return std::min(std::max(size, lower_bound_),
+                  std::max(lower_bound_, upper_bound_));
+}
+
+uint64_t MinBlobSizeTuner::Tune(uint64_t current,
+                                const HistogramImpl& value_sizes,
+                                uint64_t keys_overwritten,
+                                uint64_t keys_relocated) const {
+  uint64_t gc_keys = keys_overwritten + keys_relocated;
+  if (value_sizes.num() < kMinValueSamples || gc_keys < kMinGCKeys) {
+    // Not enough evidence, only make sure it is within bounds.
+    return Bound(current);
+  }
+  double overwrite_ratio = static_cast<double>(keys_overwritten) / gc_keys;
+  uint64_t target = Bound(
+      static_cast<uint64_t>(value_sizes.Percentile(overwrite_ratio * 100)));
+  // Move halfway to the target to smooth out bursts of the workload, and skip
+  // changes less than 1/8 to avoid flapping.
+  uint64_t next = Bound((current + target) / 2);
+  uint64_t diff = next > current ? next - current : current - next;
+  if (diff < current / 8) {
+    return Bound(current);
+  }
+  return next;
+}
+
+}  // namespace titandb
+}  // namespace rocksdb
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "monitoring/histogram.h"
+
+namespace rocksdb {
+namespace titandb {
+
+// Picks min_blob_size of a column family from recent statistics, when
+// min_blob_size_auto_tune is enabled.
+//
+// A separated value costs a blob write at flush and a rewrite by every GC it
+// survives, while an inlined value costs a rewrite by every compaction it
+// survives. Values overwritten shortly are cheaper to keep inline, since they
+// are likely dropped by compaction in upper levels. The ratio of separated
+// values found overwritten by GC approximates the share of short-lived
+// values, and the tuner keeps that share of smallest values inline, where
+// keeping a value inline costs the least.
+class MinBlobSizeTuner {
+ public:
+  // Least number of value samples and GC'ed keys to make a decision.
+  static const uint64_t kMinValueSamples = 1000;
+  static const uint64_t kMinGCKeys = 100;
+
+  MinBlobSizeTuner(uint64_t lower_bound, uint64_t upper_bound)
+      : lower_bound_(lower_bound), upper_bound_(upper_bound) {}
+
+  // Returns the min_blob_size to use next. `value_sizes` are sizes of
+  // values written by flush, `keys_overwritten` and `keys_relocated` are
+  // counts of keys discarded and rewritten by GC, since last tune.
+  uint64_t Tune(uint64_t current, const HistogramImpl& value_sizes,
+                uint64_t keys_overwritten, uint64_t keys_relocated) const;
+
+ private:
+  uint64_t Bound(uint64_t size) const;
+
+  uint64_t lower_bound_;
+  uint64_t upper_bound_;
+};
+
+}  // namespace titandb
+}  // namespace rocksdb
@@ -0,0 +1,71 @@
+#include "min_blob_size_tuner.h"
+
+#include "test_util/testharness.h"
+
+namespace rocksdb {
+namespace titandb {
+
+class MinBlobSizeTunerTest : public testing::Test {
+ public:
+  MinBlobSizeTunerTest() : tuner_(512, 64 << 10) {}
+
+  // Records value sizes uniformly distributed in [0, max_size).
+  void AddValueSizes(uint64_t num, uint64_t max_size) {
+    for (uint64_t i = 0; i < num; i++) {
+      value_sizes_.Add(i * max_size / num);
+    }
+  }
+
+  MinBlobSizeTuner tuner_;
+  HistogramImpl value_sizes_;
+};
+
+TEST_F(MinBlobSizeTunerTest, NotEnoughSamples) {
+  AddValueSizes(MinBlobSizeTuner::kMinValueSamples - 1, 16 << 10);
+  ASSERT_EQ(4096, tuner_.Tune(4096, value_sizes_, 1000, 1000));
+  // Out of bounds value should still be corrected.
+  ASSERT_EQ(512, tuner_.Tune(100, value_sizes_, 1000, 1000));
+  ASSERT_EQ(64 << 10, tuner_.Tune(1 << 20, value_sizes_, 1000, 1000));
+
+  value_sizes_.Clear();
+  AddValueSizes(10000, 16 << 10);
+  ASSERT_EQ(4096, tuner_.Tune(4096, value_sizes_, 10, 10));
+}
+
+TEST_F(MinBlobSizeTunerTest, FollowOverwriteRatio) {
+  AddValueSizes(10000, 16 << 10);
+
+  // Most separated values are overwritten before GC, keep more values inline.
+  uint64_t size = 4096;
+  for (int i = 0; i < 10; i++) {
+    uint64_t next = tuner_.Tune(size, value_sizes_, 9000, 1000);
+    ASSERT_GE(next, size);
+    size = next;
+  }
+  ASSERT_GT(size, 8192);
+  ASSERT_LE(size, 16 << 10);
+
+  // Most separated values live long, separate more values.
+  size = 4096;
+  for (int i = 0; i < 10; i++) {
+    uint64_t next = tuner_.Tune(size, value_sizes_, 100, 9900);
+    ASSERT_LE(next, size);
+    size = next;
+  }
+  ASSERT_LT(size, 1024);
+  ASSERT_GE(size, 512);
+}
+
+TEST_F(MinBlobSizeTunerTest, Stable) {
+  AddValueSizes(10000, 16 << 10);
+  // Close to the target, should not change.
+  ASSERT_EQ(8192, tuner_.Tune(8192, value_sizes_, 5200, 4800));
+}
+
+}  // namespace titandb
+}  // namespace rocksdb
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -6,13 +6,29 @@
 
 #include <inttypes.h>
 
+#include <algorithm>
+
 #include "logging/logging.h"
 #include "options/options_helper.h"
 #include "rocksdb/convenience.h"
+#include "util/string_util.h"
 
 namespace rocksdb {
 namespace titandb {
 
+namespace {
+
+std::string CompressionTypeName(CompressionType type) {
+  for (auto& compression_type : compression_type_string_map) {
+    if (compression_type.second == type) {
+      return compression_type.first;
+    }
+  }
+  return "unknown";
+}
+
+}  // namespace
+
 void TitanDBOptions::Dump(Logger* logger) const {
   ROCKS_LOG_HEADER(logger, "TitanDBOptions.dirname                    : %s",
                    dirname.c_str());
@@ -21,6 +37,24 @@ void TitanDBOptions::Dump(Logger* logger) const {
   ROCKS_LOG_HEADER(logger,
                    "TitanDBOptions.max_background_gc          : %" PRIi32,
                    max_background_gc);
+  ROCKS_LOG_HEADER(logger,
+                   "TitanDBOptions.max_gc_subjobs             : %" PRIu32,
+                   max_gc_subjobs);
+  ROCKS_LOG_HEADER(logger, "TitanDBOptions.gc_rate_limiter            : %p",
+                   gc_rate_limiter.get());
+  ROCKS_LOG_HEADER(logger,
+                   "TitanDBOptions.gc_readahead_size          : %" PRIu64,
+                   gc_readahead_size);
+  ROCKS_LOG_HEADER(logger, "TitanDBOptions.use_direct_reads_for_gc    : %d",
+                   static_cast<int>(use_direct_reads_for_gc));
+  ROCKS_LOG_HEADER(logger, "TitanDBOptions.adaptive_gc_rate           : %d",
+                   static_cast<int>(adaptive_gc_rate));
+  ROCKS_LOG_HEADER(
+      logger, "TitanDBOptions.adaptive_gc_rate_target_latency_micros: %" PRIu64,
+      adaptive_gc_rate_target_latency_micros);
+  ROCKS_LOG_HEADER(logger,
+                   "TitanDBOptions.adaptive_gc_rate_max_space_amp: %lf",
+                   adaptive_gc_rate_max_space_amp);
   ROCKS_LOG_HEADER(logger,
                    "TitanDBOptions.purge_obsolete_files_period_sec: %" PRIu32,
                    purge_obsolete_files_period_sec);
@@ -33,8 +67,21 @@ TitanCFOptions::TitanCFOptions(const ColumnFamilyOptions& cf_opts,
                                const ImmutableTitanCFOptions& immutable_opts,
                                const MutableTitanCFOptions& mutable_opts)
     : ColumnFamilyOptions(cf_opts),
-      min_blob_size(immutable_opts.min_blob_size),
+      min_blob_size(mutable_opts.min_blob_size),
+      level_min_blob_size(immutable_opts.level_min_blob_size),
+      min_blob_size_auto_tune(immutable_opts.min_blob_size_auto_tune),
+      min_blob_size_lower_bound(immutable_opts.min_blob_size_lower_bound),
+      min_blob_size_upper_bound(immutable_opts.min_blob_size_upper_bound),
       blob_file_compression(immutable_opts.blob_file_compression),
+      level_blob_file_compression(immutable_opts.level_blob_file_compression),
+      gc_blob_file_compression(immutable_opts.gc_blob_file_compression),
+      level_blob_file_compression_level(
+          immutable_opts.level_blob_file_compression_level),
+      gc_blob_file_compression_level(
+          immutable_opts.gc_blob_file_compression_level),
+      blob_file_shared_compression_dict(
+          immutable_opts.blob_file_shared_compression_dict),
+      blob_file_block_size(immutable_opts.blob_file_block_size),
       blob_file_target_size(immutable_opts.blob_file_target_size),
       blob_cache(immutable_opts.blob_cache),
       max_gc_batch_size(immutable_opts.max_gc_batch_size),
@@ -42,24 +89,99 @@ TitanCFOptions::TitanCFOptions(const ColumnFamilyOptions& cf_opts,
       blob_file_discardable_ratio(immutable_opts.blob_file_discardable_ratio),
       sample_file_size_ratio(immutable_opts.sample_file_size_ratio),
       merge_small_file_threshold(immutable_opts.merge_small_file_threshold),
+      gc_picker(immutable_opts.gc_picker),
+      gc_key_range_clustering(immutable_opts.gc_key_range_clustering),
+      max_blob_space_amplification(
+          immutable_opts.max_blob_space_amplification),
+      gc_lookup_batch_size(immutable_opts.gc_lookup_batch_size),
+      gc_validity_check_mode(immutable_opts.gc_validity_check_mode),
+      track_blob_record_deletions(immutable_opts.track_blob_record_deletions),
+      punch_hole_min_size(immutable_opts.punch_hole_min_size),
+      compaction_hint_discardable_ratio(
+          immutable_opts.compaction_hint_discardable_ratio),
+      gc_rewrite_buffer_size(immutable_opts.gc_rewrite_buffer_size),
+      gc_rewrite_batch_keys(immutable_opts.gc_rewrite_batch_keys),
       blob_run_mode(mutable_opts.blob_run_mode),
       gc_merge_rewrite(mutable_opts.gc_merge_rewrite),
       skip_value_in_compaction_filter(
           immutable_opts.skip_value_in_compaction_filter) {}
 
+uint64_t TitanCFOptions::MinBlobSizeForLevel(int level) const {
+  if (level_min_blob_size.empty()) {
+    return min_blob_size;
+  }
+  size_t idx = std::min(static_cast<size_t>(std::max(level, 0)),
+                        level_min_blob_size.size() - 1);
+  return level_min_blob_size[idx];
+}
+
+CompressionType TitanCFOptions::BlobFileCompressionForLevel(int level) const {
+  if (level_blob_file_compression.empty()) {
+    return blob_file_compression;
+  }
+  size_t idx = std::min(static_cast<size_t>(std::max(level, 0)),
+                        level_blob_file_compression.size() - 1);
+  return level_blob_file_compression[idx];
+}
+
+int TitanCFOptions::BlobFileCompressionLevelForLevel(int level) const {
+  if (level_blob_file_compression_level.empty()) {
+    return blob_file_compression_options.level;
+  }
+  size_t idx = std::min(static_cast<size_t>(std::max(level, 0)),
+                        level_blob_file_compression_level.size() - 1);
+  return level_blob_file_compression_level[idx];
+}
+
 void TitanCFOptions::Dump(Logger* logger) const {
   ROCKS_LOG_HEADER(logger,
                    "TitanCFOptions.min_blob_size                : %" PRIu64,
                    min_blob_size);
-  std::string compression_str = "unknown";
-  for (auto& compression_type : compression_type_string_map) {
-    if (compression_type.second == blob_file_compression) {
-      compression_str = compression_type.first;
-      break;
+  std::string level_min_blob_size_str;
+  for (size_t i = 0; i < level_min_blob_size.size(); i++) {
+    if (i > 0) {
+      level_min_blob_size_str += ",";
     }
+    level_min_blob_size_str += ToString(level_min_blob_size[i]);
   }
+  ROCKS_LOG_HEADER(logger, "TitanCFOptions.level_min_blob_size          : %s",
+                   level_min_blob_size_str.c_str());
+  ROCKS_LOG_HEADER(logger, "TitanCFOptions.min_blob_size_auto_tune      : %d",
+                   static_cast<int>(min_blob_size_auto_tune));
+  ROCKS_LOG_HEADER(logger,
+                   "TitanCFOptions.min_blob_size_lower_bound    : %" PRIu64,
+                   min_blob_size_lower_bound);
+  ROCKS_LOG_HEADER(logger,
+                   "TitanCFOptions.min_blob_size_upper_bound    : %" PRIu64,
+                   min_blob_size_upper_bound);
   ROCKS_LOG_HEADER(logger, "TitanCFOptions.blob_file_compression        : %s",
-                   compression_str.c_str());
+                   CompressionTypeName(blob_file_compression).c_str());
+  std::string level_compression_str;
+  for (size_t i = 0; i < level_blob_file_compression.size(); i++) {
+    if (i > 0) {
+      level_compression_str += ",";
+    }
+    level_compression_str +=
+        CompressionTypeName(level_blob_file_compression[i]);
+  }
+  ROCKS_LOG_HEADER(logger, "TitanCFOptions.level_blob_file_compression  : %s",
+                   level_compression_str.c_str());
+  ROCKS_LOG_HEADER(logger, "TitanCFOptions.gc_blob_file_compression     : %s",
+                   CompressionTypeName(gc_blob_file_compression).c_str());
+  std::string level_compression_level_str;
+  for (size_t i = 0; i < level_blob_file_compression_level.size(); i++) {
+    if (i > 0) {
+      level_compression_level_str += ",";
+    }
+    level_compression_level_str +=
+        ToString(level_blob_file_compression_level[i]);
+  }
+  ROCKS_LOG_HEADER(logger,
+                   "TitanCFOptions.level_blob_file_compression_level: %s",
+                   level_compression_level_str.c_str());
+  ROCKS_LOG_HEADER(logger,
+                   "TitanCFOptions.gc_blob_file_compression_level: %d",
+                   GCBlobFileCompressionLevel());
   ROCKS_LOG_HEADER(logger, "TItanCFOptions.blob_file_compression_options: ");
   ROCKS_LOG_HEADER(logger, "    window_bits : %d",
                    blob_file_compression_options.window_bits);
@@ -71,6 +193,12 @@ void TitanCFOptions::Dump(Logger* logger) const {
                    blob_file_compression_options.max_dict_bytes);
   ROCKS_LOG_HEADER(logger, "    zstd_max_train_bytes : %" PRIu32,
                    blob_file_compression_options.zstd_max_train_bytes);
+  ROCKS_LOG_HEADER(logger,
+                   "TitanCFOptions.blob_file_shared_compression_dict: %d",
+                   blob_file_shared_compression_dict);
+  ROCKS_LOG_HEADER(logger,
+                   "TitanCFOptions.blob_file_block_size         : %" PRIu64,
+                   blob_file_block_size);
   ROCKS_LOG_HEADER(logger,
                    "TitanCFOptions.blob_file_target_size        : %" PRIu64,
                    blob_file_target_size);
@@ -92,6 +220,31 @@ void TitanCFOptions::Dump(Logger* logger) const {
   ROCKS_LOG_HEADER(logger,
                    "TitanCFOptions.merge_small_file_threshold   : %" PRIu64,
                    merge_small_file_threshold);
+  ROCKS_LOG_HEADER(logger, "TitanCFOptions.gc_picker                    : %d",
+                   static_cast<int>(gc_picker));
+  ROCKS_LOG_HEADER(logger, "TitanCFOptions.gc_key_range_clustering      : %d",
+                   gc_key_range_clustering);
+  ROCKS_LOG_HEADER(logger, "TitanCFOptions.max_blob_space_amplification : %lf",
+                   max_blob_space_amplification);
+  ROCKS_LOG_HEADER(logger,
+                   "TitanCFOptions.gc_lookup_batch_size         : %" PRIu64,
+                   gc_lookup_batch_size);
+  ROCKS_LOG_HEADER(logger, "TitanCFOptions.gc_validity_check_mode       : %d",
+                   static_cast<int>(gc_validity_check_mode));
+  ROCKS_LOG_HEADER(logger, "TitanCFOptions.track_blob_record_deletions  : %d",
+                   track_blob_record_deletions);
+  ROCKS_LOG_HEADER(logger,
+                   "TitanCFOptions.punch_hole_min_size          : %" PRIu64,
+                   punch_hole_min_size);
+  ROCKS_LOG_HEADER(logger,
+                   "TitanCFOptions.compaction_hint_discardable_ratio: %lf",
+                   compaction_hint_discardable_ratio);
+  ROCKS_LOG_HEADER(logger,
+                   "TitanCFOptions.gc_rewrite_buffer_size       : %" PRIu64,
+                   gc_rewrite_buffer_size);
+  ROCKS_LOG_HEADER(logger,
+                   "TitanCFOptions.gc_rewrite_batch_keys        : %" PRIu64,
+                   gc_rewrite_batch_keys);
   std::string blob_run_mode_str = "unknown";
   if (blob_run_mode_to_string.count(blob_run_mode) > 0) {
     blob_run_mode_str = blob_run_mode_to_string.at(blob_run_mode);
@@ -67,18 +67,12 @@ void TitanTableBuilder::Add(const Slice& key, const Slice& value) {
     }
   } else if (ikey.type == kTypeValue &&
              cf_options_.blob_run_mode == TitanBlobRunMode::kNormal) {
-    bool is_small_kv = value.size() < cf_options_.min_blob_size;
+    if (target_level_ == 0 && cf_options_.min_blob_size_auto_tune) {
+      RecordValueSize(stats_, cf_id_, value.size());
+    }
+    bool is_small_kv = value.size() < min_blob_size_;
     if (is_small_kv) {
-      if (builder_unbuffered()) {
-        // We can append this into SST safely, without disorder issue.
-        base_builder_->Add(key, value);
-      } else {
-        // We have to let builder to cache this KV pair, and it will be returned
-        // when state changed
-        std::unique_ptr<BlobFileBuilder::BlobRecordContext> ctx =
-            NewCachedRecordContext(ikey, value);
-        blob_builder_->AddSmall(std::move(ctx));
-      }
+      AddToBaseOrCache(ikey, key, value);
       return;
     } else {
       // We write to blob file and insert index
@@ -114,16 +108,24 @@ void TitanTableBuilder::Add(const Slice& key, const Slice& value) {
                         index.file_number, get_status.ToString().c_str());
       }
     }
-    if (builder_unbuffered()) {
-      base_builder_->Add(key, value);
-    } else {
-      std::unique_ptr<BlobFileBuilder::BlobRecordContext> ctx =
-          NewCachedRecordContext(ikey, value);
-      blob_builder_->AddSmall(std::move(ctx));
-    }
+    AddToBaseOrCache(ikey, key, value);
   } else {
-    assert(builder_unbuffered());
+    AddToBaseOrCache(ikey, key, value);
+  }
+}
+
+void TitanTableBuilder::AddToBaseOrCache(const ParsedInternalKey& ikey,
+                                         const Slice& key,
+                                         const Slice& value) {
+  if (can_add_to_base()) {
+    // We can append this into SST safely, without disorder issue.
     base_builder_->Add(key, value);
+  } else {
+    // We have to let builder to cache this KV pair, and it will be returned
+    // along with the blob records before it
+    std::unique_ptr<BlobFileBuilder::BlobRecordContext> ctx =
+        NewCachedRecordContext(ikey, value);
+    blob_builder_->AddSmall(std::move(ctx));
   }
 }
 
@@ -155,8 +157,21 @@ void TitanTableBuilder::AddBlob(const ParsedInternalKey& ikey,
     ROCKS_LOG_INFO(db_options_.info_log,
                    "Titan table builder created new blob file %" PRIu64 ".",
                    blob_handle_->GetNumber());
-    blob_builder_.reset(
-        new BlobFileBuilder(db_options_, cf_options_, blob_handle_->GetFile()));
+    auto storage = blob_storage_.lock();
+    const BlobCompressionDicts* compression_dicts =
+        storage ? storage->compression_dicts().get() : nullptr;
+    if (compression_dicts != nullptr) {
+      dict_sample_bytes_wanted_ = compression_dicts->SampleBytesWanted();
+    }
+    blob_builder_.reset(new BlobFileBuilder(db_options_, cf_options_,
+                                            blob_handle_->GetFile(),
+                                            compression_dicts));
+  }
+
+  if (dict_samples_.size() < dict_sample_bytes_wanted_) {
+    // Sample values to train the shared compression dictionary.
+    dict_samples_.append(value.data(), value.size());
+    dict_sample_lens_.push_back(value.size());
   }
 
   RecordTick(statistics(stats_), TITAN_BLOB_FILE_NUM_KEYS_WRITTEN);
@@ -175,15 +190,14 @@ void TitanTableBuilder::AddBlob(const ParsedInternalKey& ikey,
   UpdateIOBytes(prev_bytes_read, prev_bytes_written, &io_bytes_read_,
                 &io_bytes_written_);
 
+  // contexts output by `Add` go before the ones output by `Finish`
+  AddToBaseTable(contexts);
+
   if (blob_handle_->GetFile()->GetFileSize() >=
       cf_options_.blob_file_target_size) {
     // if blob file hit the size limit, we have to finish it
-    // in this case, when calling `BlobFileBuilder::Finish`, builder will be in
-    // unbuffered state, so it will not trigger another `AddToBaseTable` call
     FinishBlobFile();
   }
-
-  AddToBaseTable(contexts);
 }
 
 void TitanTableBuilder::AddToBaseTable(
@@ -273,6 +287,13 @@ Status TitanTableBuilder::Finish() {
                     status_.ToString().c_str());
   }
   UpdateInternalOpStats();
+  if (!dict_samples_.empty()) {
+    auto storage = blob_storage_.lock();
+    if (storage) {
+      storage->compression_dicts()->AddSamples(dict_samples_,
+                                               dict_sample_lens_);
+    }
+  }
   if (error_read_cnt_ > 0) {
     ROCKS_LOG_ERROR(db_options_.info_log,
                     "Read file error %" PRIu64 " times during level merge",
@@ -295,7 +316,8 @@ void TitanTableBuilder::Abandon() {
 
 uint64_t TitanTableBuilder::NumEntries() const {
   if (builder_unbuffered()) {
-    return base_builder_->NumEntries();
+    return base_builder_->NumEntries() +
+           (blob_builder_ ? blob_builder_->NumPendingContexts() : 0);
   } else {
     return blob_builder_->NumEntries() + blob_builder_->NumSampleEntries();
   }
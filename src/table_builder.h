@@ -27,7 +27,8 @@ class TitanTableBuilder : public TableBuilder {
         blob_storage_(blob_storage),
         stats_(stats),
         target_level_(target_level),
-        merge_level_(merge_level) {}
+        merge_level_(merge_level),
+        min_blob_size_(cf_options.MinBlobSizeForLevel(target_level)) {}
 
   void Add(const Slice& key, const Slice& value) override;
 
@@ -55,6 +56,15 @@ class TitanTableBuilder : public TableBuilder {
                                  BlobFileBuilder::BuilderState::kUnbuffered;
   }
 
+  // Whether KV pairs can be appended into base table directly, i.e. blob
+  // builder holds no context to be output before them.
+  bool can_add_to_base() const {
+    return !blob_builder_ || !blob_builder_->HasPendingContexts();
+  }
+
+  void AddToBaseOrCache(const ParsedInternalKey& ikey, const Slice& key,
+                        const Slice& value);
+
   std::unique_ptr<BlobFileBuilder::BlobRecordContext> NewCachedRecordContext(
       const ParsedInternalKey& ikey, const Slice& value);
 
@@ -93,6 +103,8 @@ class TitanTableBuilder : public TableBuilder {
   // equals to merge_level_, values belong to blob files which have lower level
   // than target_level_ will be merged to new blob file
   int merge_level_;
+  // values smaller than it are kept inline in SSTs of target_level_
+  uint64_t min_blob_size_;
 
   // counters
   uint64_t bytes_read_ = 0;
@@ -100,6 +112,11 @@ class TitanTableBuilder : public TableBuilder {
   uint64_t io_bytes_read_ = 0;
   uint64_t io_bytes_written_ = 0;
   uint64_t error_read_cnt_ = 0;
+
+  // values sampled for the shared compression dictionary
+  uint64_t dict_sample_bytes_wanted_ = 0;
+  std::string dict_samples_;
+  std::vector<size_t> dict_sample_lens_;
 };
 
 }  // namespace titandb
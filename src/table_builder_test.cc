@@ -8,7 +8,9 @@
 #include "table/table_reader.h"
 #include "table_builder.h"
 #include "table_factory.h"
+#include "test_util/sync_point.h"
 #include "test_util/testharness.h"
+#include "util/compression.h"
 
 namespace rocksdb {
 namespace titandb {
@@ -657,6 +659,174 @@ TEST_F(TableBuilderTest, TargetSize) {
   }
 }
 
+// With level_min_blob_size set, values should be kept inline in upper levels
+// and only be separated once they reach the configured lower levels.
+TEST_F(TableBuilderTest, LevelMinBlobSize) {
+  cf_options_.level_min_blob_size = {port::kMaxUint64, port::kMaxUint64,
+                                     kMinBlobSize};
+  table_factory_.reset(new TitanTableFactory(
+      db_options_, cf_options_, db_impl_.get(), blob_manager_, &mutex_,
+      blob_file_set_.get(), nullptr));
+
+  for (int level : {0, 1, 2, 6}) {
+    std::unique_ptr<WritableFileWriter> base_file;
+    NewBaseFileWriter(&base_file);
+    std::unique_ptr<TableBuilder> table_builder;
+    NewTableBuilder(base_file.get(), &table_builder, level);
+
+    const int n = 100;
+    for (char i = 0; i < n; i++) {
+      std::string key(1, i);
+      InternalKey ikey(key, 1, kTypeValue);
+      std::string value(kMinBlobSize, i);
+      table_builder->Add(ikey.Encode(), value);
+    }
+    ASSERT_OK(table_builder->Finish());
+    ASSERT_OK(base_file->Sync(true));
+    ASSERT_OK(base_file->Close());
+
+    std::unique_ptr<TableReader> base_reader;
+    NewTableReader(base_name_, &base_reader);
+    ReadOptions ro;
+    std::unique_ptr<InternalIterator> iter;
+    iter.reset(base_reader->NewIterator(
+        ro, nullptr /*prefix_extractor*/, nullptr /*arena*/,
+        false /*skip_filters*/, TableReaderCaller::kUncategorized));
+    iter->SeekToFirst();
+    for (char i = 0; i < n; i++) {
+      ASSERT_TRUE(iter->Valid());
+      ParsedInternalKey ikey;
+      ASSERT_TRUE(ParseInternalKey(iter->key(), &ikey));
+      ASSERT_EQ(ikey.user_key, std::string(1, i));
+      if (level < 2) {
+        ASSERT_EQ(ikey.type, kTypeValue);
+        ASSERT_EQ(iter->value(), std::string(kMinBlobSize, i));
+      } else {
+        ASSERT_EQ(ikey.type, kTypeBlobIndex);
+      }
+      iter->Next();
+    }
+    ASSERT_FALSE(iter->Valid());
+  }
+}
+
+// With level_blob_file_compression set, blob files should be compressed with
+// the algorithm configured for the output level.
+TEST_F(TableBuilderTest, LevelBlobFileCompression) {
+  if (!ZSTD_Supported()) {
+    return;
+  }
+  cf_options_.blob_file_compression = kZSTD;
+  cf_options_.level_blob_file_compression = {kNoCompression, kZSTD};
+  table_factory_.reset(new TitanTableFactory(
+      db_options_, cf_options_, db_impl_.get(), blob_manager_, &mutex_,
+      blob_file_set_.get(), nullptr));
+
+  const int n = 100;
+  std::map<int, uint64_t> blob_file_sizes;
+  for (int level : {0, 1, 6}) {
+    std::unique_ptr<WritableFileWriter> base_file;
+    NewBaseFileWriter(&base_file);
+    std::unique_ptr<TableBuilder> table_builder;
+    NewTableBuilder(base_file.get(), &table_builder, level);
+    for (char i = 0; i < n; i++) {
+      std::string key(1, i);
+      InternalKey ikey(key, 1, kTypeValue);
+      std::string value(kMinBlobSize, i);
+      table_builder->Add(ikey.Encode(), value);
+    }
+    ASSERT_OK(table_builder->Finish());
+    ASSERT_OK(base_file->Sync(true));
+    ASSERT_OK(base_file->Close());
+
+    uint64_t blob_number =
+        reinterpret_cast<FileManager*>(blob_manager_.get())->LastBlobNumber();
+    std::string blob_name = BlobFileName(tmpdir_, blob_number);
+    ASSERT_OK(env_->GetFileSize(blob_name, &blob_file_sizes[level]));
+
+    std::unique_ptr<RandomAccessFileReader> file;
+    NewFileReader(blob_name, &file);
+    std::unique_ptr<BlobFileReader> blob_reader;
+    ASSERT_OK(BlobFileReader::Open(cf_options_, std::move(file),
+                                   blob_file_sizes[level], &blob_reader,
+                                   nullptr));
+
+    std::unique_ptr<TableReader> base_reader;
+    NewTableReader(base_name_, &base_reader);
+    ReadOptions ro;
+    std::unique_ptr<InternalIterator> iter;
+    iter.reset(base_reader->NewIterator(
+        ro, nullptr /*prefix_extractor*/, nullptr /*arena*/,
+        false /*skip_filters*/, TableReaderCaller::kUncategorized));
+    iter->SeekToFirst();
+    for (char i = 0; i < n; i++) {
+      ASSERT_TRUE(iter->Valid());
+      BlobIndex index;
+      ASSERT_OK(DecodeInto(iter->value(), &index));
+      ASSERT_EQ(index.file_number, blob_number);
+      BlobRecord record;
+      PinnableSlice buffer;
+      ASSERT_OK(blob_reader->Get(ro, index.blob_handle, &record, &buffer));
+      ASSERT_EQ(record.value, std::string(kMinBlobSize, i));
+      iter->Next();
+    }
+    ASSERT_FALSE(iter->Valid());
+  }
+  ASSERT_GT(blob_file_sizes[0], n * kMinBlobSize);
+  ASSERT_LT(blob_file_sizes[1], blob_file_sizes[0] / 2);
+  ASSERT_EQ(blob_file_sizes[6], blob_file_sizes[1]);
+}
+
+// Blob files should be built with the compression level configured for the
+// output level in level_blob_file_compression_level, and with
+// blob_file_compression_options.level if it is empty.
+TEST_F(TableBuilderTest, LevelBlobFileCompressionLevel) {
+  cf_options_.blob_file_compression_options.level = 3;
+  std::vector<int> builder_levels;
+  SyncPoint::GetInstance()->SetCallBack(
+      "BlobFileBuilder::BlobFileBuilder", [&](void* arg) {
+        auto* cf_options = reinterpret_cast<TitanCFOptions*>(arg);
+        builder_levels.push_back(
+            cf_options->blob_file_compression_options.level);
+      });
+  SyncPoint::GetInstance()->EnableProcessing();
+
+  auto build_table = [&](int level) {
+    table_factory_.reset(new TitanTableFactory(
+        db_options_, cf_options_, db_impl_.get(), blob_manager_, &mutex_,
+        blob_file_set_.get(), nullptr));
+    std::unique_ptr<WritableFileWriter> base_file;
+    NewBaseFileWriter(&base_file);
+    std::unique_ptr<TableBuilder> table_builder;
+    NewTableBuilder(base_file.get(), &table_builder, level);
+    // Small enough to fit in one blob file.
+    for (char i = 0; i < 10; i++) {
+      std::string key(1, i);
+      InternalKey ikey(key, 1, kTypeValue);
+      std::string value(kMinBlobSize, i);
+      table_builder->Add(ikey.Encode(), value);
+    }
+    ASSERT_OK(table_builder->Finish());
+    ASSERT_OK(base_file->Sync(true));
+    ASSERT_OK(base_file->Close());
+  };
+
+  for (int level : {0, 6}) {
+    build_table(level);
+  }
+  ASSERT_EQ(builder_levels, std::vector<int>({3, 3}));
+
+  builder_levels.clear();
+  cf_options_.level_blob_file_compression_level = {1, 5};
+  for (int level : {0, 1, 6}) {
+    build_table(level);
+  }
+  ASSERT_EQ(builder_levels, std::vector<int>({1, 5, 5}));
+
+  SyncPoint::GetInstance()->DisableProcessing();
+  SyncPoint::GetInstance()->ClearAllCallBacks();
+}
+
 // Compact a level 0 file to last level, to test level merge is functional and
 // correct
 TEST_F(TableBuilderTest, LevelMerge) {
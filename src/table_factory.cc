@@ -26,6 +26,11 @@ TableBuilder* TitanTableFactory::NewTableBuilder(
   }
   TitanCFOptions cf_options = cf_options_;
   cf_options.blob_run_mode = blob_run_mode_.load();
+  cf_options.min_blob_size = min_blob_size_.load();
+  cf_options.blob_file_compression =
+      cf_options.BlobFileCompressionForLevel(options.level);
+  cf_options.blob_file_compression_options.level =
+      cf_options.BlobFileCompressionLevelForLevel(options.level);
   std::weak_ptr<BlobStorage> blob_storage;
 
   // since we force use dynamic_level_bytes=true when level_merge=true, the last
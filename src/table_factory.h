@@ -23,6 +23,7 @@ class TitanTableFactory : public TableFactory {
       : db_options_(db_options),
         cf_options_(cf_options),
         blob_run_mode_(cf_options.blob_run_mode),
+        min_blob_size_(cf_options.min_blob_size),
         base_factory_(cf_options.table_factory),
         db_impl_(db_impl),
         blob_manager_(blob_manager),
@@ -60,6 +61,8 @@ class TitanTableFactory : public TableFactory {
 
   void SetBlobRunMode(TitanBlobRunMode mode) { blob_run_mode_.store(mode); }
 
+  void SetMinBlobSize(uint64_t size) { min_blob_size_.store(size); }
+
   bool IsDeleteRangeSupported() const override {
     return base_factory_->IsDeleteRangeSupported();
   }
@@ -68,6 +71,7 @@ class TitanTableFactory : public TableFactory {
   const TitanDBOptions db_options_;
   const TitanCFOptions cf_options_;
   std::atomic<TitanBlobRunMode> blob_run_mode_;
+  std::atomic<uint64_t> min_blob_size_;
   std::shared_ptr<TableFactory> base_factory_;
   TitanDBImpl* db_impl_;
   std::shared_ptr<BlobFileManager> blob_manager_;
@@ -1,4 +1,6 @@
 #include <inttypes.h>
+#include <sys/stat.h>
+#include <algorithm>
 #include <options/cf_options.h>
 #include <unordered_map>
 
@@ -158,6 +160,15 @@ class TitanDBTest : public testing::Test {
     return db_impl_->blob_file_set_->GetBlobStorage(cf_handle->GetID());
   }
 
+  // Blob file metadata is guarded by the mutex of TitanDBImpl, which test
+  // bodies can't access directly.
+  port::Mutex* GetTitanMutex() { return &db_impl_->mutex_; }
+
+  bool PunchHoleUnsupported() {
+    MutexLock l(&db_impl_->mutex_);
+    return db_impl_->punch_hole_unsupported_;
+  }
+
   void CheckBlobFileCount(int count, ColumnFamilyHandle* cf_handle = nullptr) {
     db_impl_->TEST_WaitForBackgroundGC();
     ASSERT_OK(db_impl_->TEST_PurgeObsoleteFiles());
@@ -399,6 +410,60 @@ TEST_F(TitanDBTest, DictCompressOptions) {
   VerifyDB(data);
 }
 
+TEST_F(TitanDBTest, SharedCompressionDict) {
+#if ZSTD_VERSION_NUMBER >= 10103
+  options_.min_blob_size = 1;
+  options_.blob_file_compression = CompressionType::kZSTD;
+  options_.blob_file_compression_options.max_dict_bytes = 4096;
+  options_.blob_file_compression_options.zstd_max_train_bytes = 64 << 10;
+  options_.blob_file_shared_compression_dict = true;
+
+  const std::vector<std::string> words = {"titan", "rocksdb", "blob",
+                                          "value", "compression", "dict"};
+  Random rnd(301);
+  auto put_keys = [&](uint64_t start, uint64_t end,
+                      std::map<std::string, std::string>* data) {
+    for (uint64_t k = start; k < end; k++) {
+      std::string value;
+      while (value.size() < 200) {
+        value += words[rnd.Uniform(static_cast<int>(words.size()))];
+        value += std::to_string(rnd.Uniform(100));
+      }
+      std::string key = GenKey(k);
+      ASSERT_OK(db_->Put(WriteOptions(), key, value));
+      (*data)[key] = value;
+    }
+  };
+
+  std::map<std::string, std::string> data;
+  Open();
+  uint64_t dict_id = 0;
+  ASSERT_EQ(GetBlobStorage().lock()->compression_dicts()->GetLatest(&dict_id),
+            nullptr);
+  // Blob files are compressed without dictionary before it is trained.
+  put_keys(0, 1000, &data);
+  Flush();
+  VerifyDB(data);
+
+  // Wait for the background training.
+  Reopen();
+  ASSERT_NE(GetBlobStorage().lock()->compression_dicts()->GetLatest(&dict_id),
+            nullptr);
+  put_keys(1000, 2000, &data);
+  Flush();
+  VerifyDB(data);
+
+  // The dictionary is recovered from manifest.
+  Reopen();
+  uint64_t recovered_dict_id = 0;
+  ASSERT_NE(GetBlobStorage().lock()->compression_dicts()->GetLatest(
+                &recovered_dict_id),
+            nullptr);
+  ASSERT_EQ(dict_id, recovered_dict_id);
+  VerifyDB(data);
+#endif
+}
+
 TEST_F(TitanDBTest, TableFactory) { TestTableFactory(); }
 
 TEST_F(TitanDBTest, DbIter) {
@@ -531,6 +596,442 @@ TEST_F(TitanDBTest, GetProperty) {
   ASSERT_EQ(value, 0);
 }
 
+TEST_F(TitanDBTest, GCSchedulerProperties) {
+  Open();
+  for (uint64_t k = 1; k <= 100; k++) {
+    Put(k);
+  }
+  Flush();
+  uint64_t value;
+  ASSERT_TRUE(GetIntProperty(TitanDB::Properties::kGCReclaimableSize, &value));
+  ASSERT_EQ(value, 0);
+
+  for (uint64_t k = 1; k <= 100; k++) {
+    if (k % 3 != 0) Delete(k);
+  }
+  Flush();
+  CompactAll();
+  // Background GC is disabled, so the GC triggered by compaction stays in
+  // the queue.
+  ASSERT_TRUE(GetIntProperty(TitanDB::Properties::kNumPendingGC, &value));
+  ASSERT_GT(value, 0);
+  ASSERT_TRUE(GetIntProperty(TitanDB::Properties::kNumRunningGC, &value));
+  ASSERT_EQ(value, 0);
+  ASSERT_TRUE(GetIntProperty(TitanDB::Properties::kGCReclaimableSize, &value));
+  ASSERT_GT(value, 0);
+  std::string str_value;
+  ASSERT_TRUE(
+      db_->GetProperty(TitanDB::Properties::kGCReclaimableSize, &str_value));
+  ASSERT_EQ(str_value, std::to_string(value));
+
+  uint32_t default_cf_id = db_->DefaultColumnFamily()->GetID();
+  ASSERT_OK(db_impl_->TEST_StartGC(default_cf_id));
+  ASSERT_TRUE(GetIntProperty(TitanDB::Properties::kGCReclaimableSize, &value));
+  ASSERT_EQ(value, 0);
+}
+
+TEST_F(TitanDBTest, BlobSpaceAmplificationWriteDelay) {
+  options_.blob_file_compression = CompressionType::kNoCompression;
+  // Unreachable with the default discardable ratio of 0.5.
+  options_.max_blob_space_amplification = 1.5;
+  ASSERT_TRUE(TitanDB::Open(options_, dbname_, &db_).IsInvalidArgument());
+  options_.max_blob_space_amplification = 2.0;
+  Open();
+  AddCF("other");
+  ColumnFamilyHandle* other_cf = cf_handles_.back();
+  WriteOptions no_slowdown;
+  no_slowdown.no_slowdown = true;
+  for (uint64_t k = 1; k <= 100; k++) {
+    Put(k);
+  }
+  Flush();
+  ASSERT_OK(db_->Put(no_slowdown, "foo", "bar"));
+
+  for (uint64_t k = 1; k <= 100; k++) {
+    if (k % 3 != 0) Delete(k);
+  }
+  Flush();
+  CompactAll();
+  // Two thirds of blob data are garbage and background GC is disabled, so
+  // writes are delayed.
+  ASSERT_TRUE(db_->Put(no_slowdown, "foo", "bar").IsIncomplete());
+  WriteBatch batch;
+  ASSERT_OK(batch.Put(other_cf, "foo", "bar"));
+  ASSERT_OK(batch.Put("foo", "bar"));
+  ASSERT_TRUE(db_->Write(no_slowdown, &batch).IsIncomplete());
+  ASSERT_OK(db_->Put(WriteOptions(), "foo", "bar"));
+  ASSERT_GT(db_->GetDBOptions().statistics->getTickerCount(
+                TITAN_BLOB_SPACE_WRITE_DELAY_MICROS),
+            0);
+  // Deletions, and writes to other column families, are not delayed.
+  ASSERT_OK(db_->Delete(no_slowdown, "foo"));
+  ASSERT_OK(db_->DeleteRange(no_slowdown, db_->DefaultColumnFamily(), "a",
+                             "b"));
+  ASSERT_OK(db_->Put(no_slowdown, other_cf, "foo", "bar"));
+  batch.Clear();
+  ASSERT_OK(batch.Put(other_cf, "foo", "bar"));
+  ASSERT_OK(batch.Delete("foo"));
+  ASSERT_OK(db_->Write(no_slowdown, &batch));
+
+  uint32_t default_cf_id = db_->DefaultColumnFamily()->GetID();
+  ASSERT_OK(db_impl_->TEST_StartGC(default_cf_id));
+  ASSERT_OK(db_->Put(no_slowdown, "foo", "bar"));
+}
+
+TEST_F(TitanDBTest, TrackBlobRecordDeletions) {
+  options_.track_blob_record_deletions = true;
+  options_.blob_file_discardable_ratio = 0;
+  Open();
+  std::map<std::string, std::string> data;
+  for (uint64_t k = 1; k <= 100; k++) {
+    Put(k, &data);
+  }
+  Flush();
+  for (uint64_t k = 1; k <= 100; k++) {
+    if (k % 3 != 0) {
+      Delete(k);
+      data.erase(GenKey(k));
+    }
+  }
+  Flush();
+  CompactAll();
+
+  // Only odd keys are stored in blob files, 33 of them are deleted.
+  auto blob_storage = GetBlobStorage().lock();
+  ASSERT_TRUE(blob_storage != nullptr);
+  std::map<uint64_t, std::weak_ptr<BlobFileMeta>> blob_files;
+  blob_storage->ExportBlobFiles(blob_files);
+  ASSERT_EQ(1, blob_files.size());
+  {
+    MutexLock l(GetTitanMutex());
+    auto file = blob_files.begin()->second.lock();
+    ASSERT_TRUE(file != nullptr);
+    ASSERT_TRUE(file->deletion_tracked());
+    ASSERT_EQ(33, file->dead_records().size());
+  }
+
+  // Tracking and dead records are recovered from the manifest.
+  Reopen();
+  blob_storage = GetBlobStorage().lock();
+  ASSERT_TRUE(blob_storage != nullptr);
+  blob_storage->ExportBlobFiles(blob_files);
+  ASSERT_EQ(1, blob_files.size());
+  {
+    MutexLock l(GetTitanMutex());
+    auto file = blob_files.begin()->second.lock();
+    ASSERT_TRUE(file != nullptr);
+    ASSERT_TRUE(file->deletion_tracked());
+    ASSERT_EQ(33, file->dead_records().size());
+  }
+
+  uint32_t default_cf_id = db_->DefaultColumnFamily()->GetID();
+  ASSERT_OK(db_impl_->TEST_StartGC(default_cf_id));
+  VerifyDB(data);
+
+  // An overwrite that has not been compacted yet must not be resurrected by
+  // GC rewriting the old version.
+  std::string key = GenKey(3);
+  std::string value(100, 'x');
+  ASSERT_OK(db_->Put(WriteOptions(), key, value));
+  data[key] = value;
+  Flush();
+  ASSERT_OK(db_impl_->TEST_StartGC(default_cf_id));
+  VerifyDB(data);
+}
+
+TEST_F(TitanDBTest, BlobFileCreationTime) {
+  options_.blob_file_discardable_ratio = 0.1;
+  Open();
+  std::map<std::string, std::string> data;
+  for (uint64_t k = 1; k <= 100; k++) {
+    Put(k, &data);
+  }
+  Flush();
+  // Returns the live blob file, with its creation time.
+  auto live_file = [&]() {
+    std::map<uint64_t, std::weak_ptr<BlobFileMeta>> blob_files;
+    GetBlobStorage().lock()->ExportBlobFiles(blob_files);
+    std::shared_ptr<BlobFileMeta> live;
+    for (auto& file : blob_files) {
+      auto meta = file.second.lock();
+      if (meta != nullptr && !meta->is_obsolete()) {
+        EXPECT_TRUE(live == nullptr);
+        live = meta;
+      }
+    }
+    EXPECT_TRUE(live != nullptr);
+    return live;
+  };
+  auto creation_time = [&](const std::shared_ptr<BlobFileMeta>& file) {
+    MutexLock l(GetTitanMutex());
+    return file->creation_time();
+  };
+  uint64_t flushed_time = creation_time(live_file());
+  ASSERT_GT(flushed_time, 1000);
+
+  // Recovered from the manifest instead of taken as created at reopen.
+  Reopen();
+  auto input = live_file();
+  ASSERT_EQ(flushed_time, creation_time(input));
+
+  // GC output takes over the creation time of its input.
+  {
+    MutexLock l(GetTitanMutex());
+    input->set_creation_time(flushed_time - 1000);
+  }
+  for (uint64_t k = 1; k <= 50; k++) {
+    Delete(k);
+    data.erase(GenKey(k));
+  }
+  Flush();
+  CompactAll();
+  ASSERT_OK(db_impl_->TEST_StartGC(db_->DefaultColumnFamily()->GetID()));
+  auto output = live_file();
+  ASSERT_NE(input->file_number(), output->file_number());
+  ASSERT_EQ(flushed_time - 1000, creation_time(output));
+  input.reset();
+  output.reset();
+  Reopen();
+  ASSERT_EQ(flushed_time - 1000, creation_time(live_file()));
+  VerifyDB(data);
+}
+
+TEST_F(TitanDBTest, PunchHoles) {
+  options_.track_blob_record_deletions = true;
+  options_.punch_hole_min_size = 1;
+  options_.blob_file_discardable_ratio = 0.7;
+  Open();
+  std::map<std::string, std::string> data;
+  for (uint64_t k = 1; k <= 100; k++) {
+    Put(k, &data);
+  }
+  Flush();
+  // Deleted blob records are adjacent in the blob file.
+  for (uint64_t k = 1; k <= 60; k++) {
+    Delete(k);
+    data.erase(GenKey(k));
+  }
+  Flush();
+  CompactAll();
+  std::map<uint64_t, std::weak_ptr<BlobFileMeta>> blob_files;
+  GetBlobStorage().lock()->ExportBlobFiles(blob_files);
+  ASSERT_EQ(1, blob_files.size());
+  std::string file_name =
+      BlobFileName(options_.dirname, blob_files.begin()->first);
+  struct stat file_stat;
+  ASSERT_EQ(0, stat(file_name.c_str(), &file_stat));
+  auto allocated_blocks = file_stat.st_blocks;
+
+  uint32_t default_cf_id = db_->DefaultColumnFamily()->GetID();
+  ASSERT_OK(db_impl_->TEST_StartGC(default_cf_id));
+  VerifyDB(data);
+  if (PunchHoleUnsupported()) {
+    fprintf(stderr, "Skipped as the file system can't punch holes\n");
+    return;
+  }
+  auto stats = db_->GetDBOptions().statistics;
+  ASSERT_EQ(1, stats->getTickerCount(TITAN_GC_NUM_HOLES_PUNCHED));
+  // The garbage is under the discardable ratio, so the file is punched
+  // instead of being GCed.
+  ASSERT_EQ(0, stats->getTickerCount(TITAN_GC_NUM_FILES));
+  // Without new dead records the file is not checked again.
+  ASSERT_OK(db_impl_->TEST_StartGC(default_cf_id));
+  ASSERT_EQ(1, stats->getTickerCount(TITAN_GC_NUM_HOLES_PUNCHED));
+  ASSERT_EQ(0, stat(file_name.c_str(), &file_stat));
+  ASSERT_LT(file_stat.st_blocks, allocated_blocks);
+  blob_files.clear();
+  GetBlobStorage().lock()->ExportBlobFiles(blob_files);
+  ASSERT_EQ(1, blob_files.size());
+  uint64_t punched_size = blob_files.begin()->second.lock()->punched_size();
+  ASSERT_GT(punched_size, 0);
+
+  // Holes are recovered from manifest, and skipped by GC.
+  options_.blob_file_discardable_ratio = 0;
+  Reopen();
+  blob_files.clear();
+  GetBlobStorage().lock()->ExportBlobFiles(blob_files);
+  ASSERT_EQ(1, blob_files.size());
+  ASSERT_EQ(punched_size, blob_files.begin()->second.lock()->punched_size());
+  ASSERT_OK(db_impl_->TEST_StartGC(default_cf_id));
+  VerifyDB(data);
+  blob_files.clear();
+  GetBlobStorage().lock()->ExportBlobFiles(blob_files);
+  for (auto& file : blob_files) {
+    auto meta = file.second.lock();
+    if (!meta->is_obsolete()) {
+      ASSERT_EQ(0, meta->punched_size());
+    }
+  }
+}
+
+TEST_F(TitanDBTest, ResumeInterruptedGC) {
+  // Commit a chunk for every rewritten key.
+  options_.gc_rewrite_buffer_size = 1;
+  options_.blob_file_discardable_ratio = 0.3;
+  Open();
+  std::map<std::string, std::string> data;
+  for (uint64_t k = 1; k <= 100; k++) {
+    Put(k, &data);
+  }
+  Flush();
+  // 25 of the 50 keys in blob file are deleted.
+  for (uint64_t k = 1; k <= 100; k += 4) {
+    Delete(k);
+    data.erase(GenKey(k));
+  }
+  Flush();
+  CompactAll();
+  std::map<uint64_t, std::weak_ptr<BlobFileMeta>> blob_files;
+  GetBlobStorage().lock()->ExportBlobFiles(blob_files);
+  ASSERT_EQ(1, blob_files.size());
+  uint64_t file_number = blob_files.begin()->first;
+
+  // Fail the GC job after 10 keys are rewritten.
+  int num_chunks = 0;
+  SyncPoint::GetInstance()->SetCallBack(
+      "BlobGCJob::DoRunGC:AfterChunk", [&](void* arg) {
+        if (++num_chunks == 10) {
+          *reinterpret_cast<Status*>(arg) = Status::IOError("Injected");
+        }
+      });
+  SyncPoint::GetInstance()->EnableProcessing();
+  uint32_t default_cf_id = db_->DefaultColumnFamily()->GetID();
+  ASSERT_TRUE(db_impl_->TEST_StartGC(default_cf_id).IsIOError());
+  SyncPoint::GetInstance()->DisableProcessing();
+  SyncPoint::GetInstance()->ClearAllCallBacks();
+
+  Reopen();
+  // Flush rewritten keys, so that GC outputs have their live data counted.
+  Flush();
+  auto file = GetBlobStorage().lock()->FindFile(file_number).lock();
+  ASSERT_TRUE(file != nullptr);
+  ASSERT_GT(file->gc_resume_offset(), 0);
+  ASSERT_OK(db_impl_->TEST_StartGC(default_cf_id));
+  VerifyDB(data);
+  // Only the keys after the last committed chunk are rewritten.
+  ASSERT_EQ(15, db_->GetDBOptions().statistics->getTickerCount(
+                    TITAN_GC_NUM_KEYS_RELOCATED));
+}
+
+TEST_F(TitanDBTest, CompactBlobFiles) {
+  // One GC job for each blob file.
+  options_.max_gc_batch_size = 1;
+  Open();
+  std::map<std::string, std::string> data;
+  // Four blob files of disjoint key ranges.
+  for (uint64_t k = 1; k <= 100; k++) {
+    Put(k, &data);
+    if (k % 25 == 0) {
+      Flush();
+    }
+  }
+  for (uint64_t k = 1; k <= 100; k += 4) {
+    Delete(k);
+    data.erase(GenKey(k));
+  }
+  Flush();
+  CompactAll();
+  std::map<uint64_t, std::weak_ptr<BlobFileMeta>> blob_files;
+  GetBlobStorage().lock()->ExportBlobFiles(blob_files);
+  ASSERT_EQ(4, blob_files.size());
+
+  CompactBlobFilesOptions compact_options;
+  compact_options.min_discardable_ratio = 0.3;
+  compact_options.max_parallelism = 2;
+  std::vector<std::pair<uint64_t, uint64_t>> progress;
+  compact_options.progress_callback = [&](uint64_t done, uint64_t total) {
+    progress.emplace_back(done, total);
+  };
+  std::string begin = GenKey(1);
+  std::string end = GenKey(50);
+  Slice begin_slice(begin);
+  Slice end_slice(end);
+  ASSERT_OK(db_->CompactBlobFiles(db_->DefaultColumnFamily(), &begin_slice,
+                                  &end_slice, compact_options));
+  ASSERT_EQ(2, progress.size());
+  ASSERT_EQ(2, progress.back().first);
+  ASSERT_EQ(2, progress.back().second);
+  VerifyDB(data);
+
+  // Only the two files in the range are GCed.
+  auto file = blob_files.begin();
+  for (int i = 0; i < 4; i++, file++) {
+    auto meta = file->second.lock();
+    ASSERT_EQ(i < 2, meta == nullptr || meta->is_obsolete());
+  }
+
+  // Nothing is left to GC in the range, once live data of GC outputs is
+  // counted.
+  Flush();
+  progress.clear();
+  ASSERT_OK(db_->CompactBlobFiles(db_->DefaultColumnFamily(), &begin_slice,
+                                  &end_slice, compact_options));
+  ASSERT_TRUE(progress.empty());
+}
+
+TEST_F(TitanDBTest, EstimateGC) {
+  options_.blob_file_discardable_ratio = 0.3;
+  Open();
+  std::map<std::string, std::string> data;
+  // Four blob files, half of the blob records of the first two are deleted.
+  for (uint64_t k = 1; k <= 100; k++) {
+    Put(k, &data);
+    if (k % 25 == 0) {
+      Flush();
+    }
+  }
+  for (uint64_t k = 1; k <= 50; k += 4) {
+    Delete(k);
+    data.erase(GenKey(k));
+  }
+  Flush();
+  CompactAll();
+  std::map<uint64_t, std::weak_ptr<BlobFileMeta>> blob_files;
+  GetBlobStorage().lock()->ExportBlobFiles(blob_files);
+  ASSERT_EQ(4, blob_files.size());
+  std::vector<std::shared_ptr<BlobFileMeta>> files;
+  for (auto& file : blob_files) {
+    files.push_back(file.second.lock());
+  }
+
+  GCEstimate estimate;
+  ASSERT_OK(db_->EstimateGC(db_->DefaultColumnFamily(), nullptr, &estimate));
+  ASSERT_EQ(4, estimate.num_blob_files);
+  ASSERT_EQ(1, estimate.batches.size());
+  std::vector<uint64_t> file_numbers = estimate.batches[0].file_numbers;
+  std::sort(file_numbers.begin(), file_numbers.end());
+  ASSERT_EQ(std::vector<uint64_t>({files[0]->file_number(),
+                                   files[1]->file_number()}),
+            file_numbers);
+  ASSERT_EQ(files[0]->file_size() + files[1]->file_size(),
+            estimate.bytes_read);
+  ASSERT_EQ(files[0]->live_data_size() + files[1]->live_data_size(),
+            estimate.bytes_written);
+  ASSERT_EQ(estimate.bytes_read - estimate.bytes_written,
+            estimate.reclaimable_size);
+
+  TitanCFOptions cf_options = db_->GetTitanOptions();
+  cf_options.max_gc_batch_size = 1;
+  ASSERT_OK(
+      db_->EstimateGC(db_->DefaultColumnFamily(), &cf_options, &estimate));
+  ASSERT_EQ(2, estimate.batches.size());
+  cf_options.blob_file_discardable_ratio = 0.9;
+  ASSERT_OK(
+      db_->EstimateGC(db_->DefaultColumnFamily(), &cf_options, &estimate));
+  ASSERT_TRUE(estimate.batches.empty());
+  ASSERT_EQ(0, estimate.reclaimable_size);
+
+  // Nothing is changed by estimating, GC picks the files estimated.
+  for (auto& file : files) {
+    ASSERT_EQ(BlobFileMeta::FileState::kNormal, file->file_state());
+  }
+  ASSERT_OK(db_impl_->TEST_StartGC(db_->DefaultColumnFamily()->GetID()));
+  for (size_t i = 0; i < files.size(); i++) {
+    ASSERT_EQ(i < 2, files[i]->is_obsolete());
+  }
+  VerifyDB(data);
+}
+
 TEST_F(TitanDBTest, Snapshot) {
   Open();
   std::map<std::string, std::string> data;
@@ -1017,6 +1518,15 @@ TEST_F(TitanDBTest, SetOptions) {
   ASSERT_EQ(false, titan_options.gc_merge_rewrite);
   opts.clear();
 
+  // Set titan min_blob_size.
+  opts["min_blob_size"] = "456";
+  ASSERT_OK(db_->SetOptions(opts));
+  titan_options = db_->GetTitanOptions();
+  ASSERT_EQ(456, titan_options.min_blob_size);
+  opts["min_blob_size"] = "abc";
+  ASSERT_TRUE(db_->SetOptions(opts).IsInvalidArgument());
+  opts.clear();
+
   // Set column family options.
   opts["disable_auto_compactions"] = "true";
   ASSERT_OK(db_->SetOptions(opts));
@@ -1718,6 +2228,229 @@ TEST_F(TitanDBTest, LowDiscardableRatio) {
   ASSERT_TRUE(blob_files.begin()->second.lock()->file_size() < prev_file_size);
 }
 
+TEST_F(TitanDBTest, CompactionHint) {
+  options_.disable_auto_compactions = true;
+  options_.blob_file_discardable_ratio = 0.8;
+  options_.compaction_hint_discardable_ratio = 0.3;
+  Open();
+  std::map<std::string, std::string> data;
+  auto sst_files = [&](int level) {
+    ColumnFamilyMetaData cf_meta;
+    db_->GetColumnFamilyMetaData(&cf_meta);
+    std::vector<std::string> files;
+    for (auto& file : cf_meta.levels[level].files) {
+      files.push_back(file.name);
+    }
+    return files;
+  };
+
+  // Keys in the last level, so that the ones compacted into level 5 below
+  // are not in the last non-empty level.
+  for (uint64_t k = 1000; k < 1100; k++) {
+    Put(k, &data);
+  }
+  Flush();
+  CompactAll();
+  for (uint64_t k = 0; k < 100; k++) {
+    Put(k, &data);
+  }
+  Flush();
+  ASSERT_OK(db_->CompactFiles(CompactionOptions(), sst_files(0), 5));
+  ASSERT_EQ(1U, sst_files(5).size());
+
+  std::vector<uint64_t> marked;
+  SyncPoint::GetInstance()->SetCallBack(
+      "TitanDBImpl::MarkSSTsForBlobGC:Marked",
+      [&](void* arg) { marked.push_back(*static_cast<uint64_t*>(arg)); });
+  SyncPoint::GetInstance()->EnableProcessing();
+
+  // Drops half of the blob file written by the second flush, leaving its
+  // remaining references in level 5.
+  for (uint64_t k = 0; k < 50; k++) {
+    Delete(k);
+    data.erase(GenKey(k));
+  }
+  Flush();
+  ASSERT_OK(db_->CompactFiles(CompactionOptions(), sst_files(0), 5));
+  ASSERT_EQ(1U, sst_files(5).size());
+  ASSERT_EQ(std::vector<uint64_t>{1}, marked);
+
+  // The marked SST is compacted down once compaction is enabled, and the
+  // blob file is not hinted again.
+  std::unordered_map<std::string, std::string> opts;
+  opts["disable_auto_compactions"] = "false";
+  ASSERT_OK(db_->SetOptions(opts));
+  ASSERT_OK(
+      reinterpret_cast<DBImpl*>(db_->GetRootDB())->TEST_WaitForCompact());
+  ASSERT_EQ(0U, sst_files(5).size());
+  ASSERT_EQ(std::vector<uint64_t>{1}, marked);
+  VerifyDB(data);
+}
+
+TEST_F(TitanDBTest, CompactionHintLastLevel) {
+  options_.disable_auto_compactions = true;
+  options_.blob_file_discardable_ratio = 0.8;
+  options_.compaction_hint_discardable_ratio = 0.3;
+  Open();
+  std::map<std::string, std::string> data;
+  for (uint64_t k = 0; k < 100; k++) {
+    Put(k, &data);
+  }
+  Flush();
+  CompactAll();
+
+  std::vector<uint64_t> marked;
+  SyncPoint::GetInstance()->SetCallBack(
+      "TitanDBImpl::MarkSSTsForBlobGC:Marked",
+      [&](void* arg) { marked.push_back(*static_cast<uint64_t*>(arg)); });
+  SyncPoint::GetInstance()->EnableProcessing();
+
+  // The remaining references are all in the last level, which is not
+  // marked, so the blob file is left to be hinted again.
+  for (uint64_t k = 0; k < 50; k++) {
+    Delete(k);
+    data.erase(GenKey(k));
+  }
+  Flush();
+  CompactAll();
+  ASSERT_EQ(std::vector<uint64_t>{0}, marked);
+  std::map<uint64_t, std::weak_ptr<BlobFileMeta>> blob_files;
+  GetBlobStorage().lock()->ExportBlobFiles(blob_files);
+  ASSERT_EQ(1, blob_files.size());
+  {
+    MutexLock l(GetTitanMutex());
+    ASSERT_FALSE(blob_files.begin()->second.lock()->compaction_hinted());
+  }
+
+  for (uint64_t k = 50; k < 60; k++) {
+    Delete(k);
+    data.erase(GenKey(k));
+  }
+  Flush();
+  CompactAll();
+  ASSERT_EQ((std::vector<uint64_t>{0, 0}), marked);
+  SyncPoint::GetInstance()->DisableProcessing();
+  SyncPoint::GetInstance()->ClearAllCallBacks();
+  VerifyDB(data);
+}
+
+TEST_F(TitanDBTest, DeleteRangeCoveringBlobFiles) {
+  Open();
+  std::map<std::string, std::string> data;
+  for (uint64_t k = 0; k < 100; k++) {
+    Put(k, &data);
+  }
+  Flush();
+  for (uint64_t k = 100; k < 200; k++) {
+    Put(k, &data);
+  }
+  Flush();
+  std::shared_ptr<BlobStorage> blob_storage = GetBlobStorage().lock();
+  ASSERT_TRUE(blob_storage != nullptr);
+  std::map<uint64_t, std::weak_ptr<BlobFileMeta>> blob_files;
+  blob_storage->ExportBlobFiles(blob_files);
+  ASSERT_EQ(2, blob_files.size());
+  auto first = blob_files.begin()->second.lock();
+  auto second = blob_files.rbegin()->second.lock();
+
+  // Only covers part of the second file.
+  const Snapshot* snapshot = db_->GetSnapshot();
+  std::string begin = GenKey(0);
+  std::string end = GenKey(150);
+  ASSERT_OK(db_->DeleteRange(WriteOptions(), db_->DefaultColumnFamily(),
+                             begin, end));
+  for (uint64_t k = 0; k < 150; k++) {
+    data.erase(GenKey(k));
+  }
+  ASSERT_TRUE(first->is_obsolete());
+  ASSERT_FALSE(second->is_obsolete());
+  VerifyDB(data);
+
+  // Kept for the snapshot taken before the deletion.
+  ASSERT_OK(db_impl_->TEST_PurgeObsoleteFiles());
+  ReadOptions ropts;
+  ropts.snapshot = snapshot;
+  std::string value;
+  ASSERT_OK(db_->Get(ropts, GenKey(1), &value));
+  ASSERT_EQ(GenValue(1), value);
+  db_->ReleaseSnapshot(snapshot);
+  CheckBlobFileCount(1);
+  VerifyDB(data);
+}
+
+TEST_F(TitanDBTest, LiveSizeCheckpoint) {
+  options_.disable_background_gc = true;
+  options_.disable_auto_compactions = true;
+  Open();
+  std::map<std::string, std::string> data;
+  for (uint64_t k = 0; k < 100; k++) {
+    Put(k, &data);
+  }
+  Flush();
+  for (uint64_t k = 100; k < 200; k++) {
+    Put(k, &data);
+  }
+  Flush();
+  for (uint64_t k = 0; k < 50; k++) {
+    Delete(k);
+    data.erase(GenKey(k));
+  }
+  Flush();
+  CompactAll();
+  auto live_sizes = [&]() {
+    std::map<uint64_t, uint64_t> ret;
+    std::map<uint64_t, std::weak_ptr<BlobFileMeta>> blob_files;
+    GetBlobStorage().lock()->ExportBlobFiles(blob_files);
+    for (auto& file : blob_files) {
+      auto meta = file.second.lock();
+      if (meta != nullptr && !meta->is_obsolete()) {
+        ret[file.first] = meta->live_data_size();
+      }
+    }
+    return ret;
+  };
+  auto expected = live_sizes();
+  ASSERT_EQ(2U, expected.size());
+
+  std::vector<uint64_t> ssts_to_read;
+  SyncPoint::GetInstance()->SetCallBack(
+      "TitanDBImpl::InitializeGC:SSTsToRead", [&](void* arg) {
+        ssts_to_read.push_back(*static_cast<uint64_t*>(arg));
+      });
+  SyncPoint::GetInstance()->EnableProcessing();
+
+  // Nothing is read as the checkpoint follows flushes and compactions.
+  Reopen();
+  ASSERT_EQ(std::vector<uint64_t>{0}, ssts_to_read);
+  ASSERT_EQ(expected, live_sizes());
+  VerifyDB(data);
+
+  // Only the SST flushed on recovery is read on top of the checkpoint.
+  options_.avoid_flush_during_shutdown = true;
+  Reopen();
+  for (uint64_t k = 200; k < 300; k++) {
+    Put(k, &data);
+  }
+  ssts_to_read.clear();
+  Reopen();
+  ASSERT_EQ(std::vector<uint64_t>{1}, ssts_to_read);
+  auto actual = live_sizes();
+  ASSERT_EQ(3U, actual.size());
+  for (auto& file : expected) {
+    ASSERT_EQ(file.second, actual[file.first]);
+  }
+  VerifyDB(data);
+
+  // The checkpoint logged on open follows the compaction after it.
+  CompactAll();
+  expected = live_sizes();
+  ssts_to_read.clear();
+  Reopen();
+  ASSERT_EQ(std::vector<uint64_t>{0}, ssts_to_read);
+  ASSERT_EQ(expected, live_sizes());
+  VerifyDB(data);
+}
+
 TEST_F(TitanDBTest, PutDeletedDuringGC) {
   options_.max_background_gc = 2;
   options_.disable_background_gc = false;
@@ -1759,6 +2492,90 @@ TEST_F(TitanDBTest, PutDeletedDuringGC) {
   ASSERT_EQ(value, std::string(100 * 1024, 'v'));
 }
 
+TEST_F(TitanDBTest, BatchedGCRewriteWithConflicts) {
+  options_.max_background_gc = 2;
+  options_.disable_background_gc = false;
+  options_.blob_file_discardable_ratio = 0.01;
+  options_.gc_rewrite_batch_keys = 4;
+  options_.track_blob_record_deletions = true;
+  Open();
+
+  const int kNumKeys = 10;
+  for (int i = 0; i < kNumKeys; i++) {
+    ASSERT_OK(db_->Put(WriteOptions(), "k" + std::to_string(i),
+                       std::string(10 * 1024, 'v')));
+  }
+  auto snap = db_->GetSnapshot();
+  ASSERT_OK(db_->Delete(WriteOptions(), "k0"));
+  Flush();
+
+  db_->ReleaseSnapshot(snap);
+  CheckBlobFileCount(1);
+  CompactAll();
+
+  CheckBlobFileCount(1);
+  std::map<uint64_t, std::weak_ptr<BlobFileMeta>> blob_files;
+  GetBlobStorage().lock()->ExportBlobFiles(blob_files);
+  ASSERT_EQ(blob_files.size(), 1);
+  uint64_t input_file_number = blob_files.begin()->first;
+  SyncPoint::GetInstance()->LoadDependency(
+      {{"TitanDBTest::BatchedGCRewriteWithConflicts::ContinueGC",
+        "BlobGCJob::Finish::BeforeRewriteValidKeyToLSM"},
+       {"BlobGCJob::Finish::AfterRewriteValidKeyToLSM",
+        "TitanDBTest::BatchedGCRewriteWithConflicts::WaitGC"}});
+  SyncPoint::GetInstance()->EnableProcessing();
+
+  CompactAll();
+  // Overwrite some of the keys relocated by GC, which should be dropped from
+  // the batched rewrite, while the others are still rewritten.
+  ASSERT_OK(db_->Put(WriteOptions(), "k2", std::string(100, 'w')));
+  ASSERT_OK(db_->Put(WriteOptions(), "k5", std::string(100, 'w')));
+
+  TEST_SYNC_POINT("TitanDBTest::BatchedGCRewriteWithConflicts::ContinueGC");
+  TEST_SYNC_POINT("TitanDBTest::BatchedGCRewriteWithConflicts::WaitGC");
+
+  std::string value;
+  ASSERT_TRUE(db_->Get(ReadOptions(), "k0", &value).IsNotFound());
+  for (int i = 1; i < kNumKeys; i++) {
+    ASSERT_OK(db_->Get(ReadOptions(), "k" + std::to_string(i), &value));
+    if (i == 2 || i == 5) {
+      ASSERT_EQ(value, std::string(100, 'w'));
+    } else {
+      ASSERT_EQ(value, std::string(10 * 1024, 'v'));
+    }
+  }
+  // Keys not overwritten point to the GC output file now.
+  for (int i = 1; i < kNumKeys; i++) {
+    PinnableSlice index_entry;
+    bool is_blob_index = false;
+    ASSERT_OK(reinterpret_cast<DBImpl*>(db_->GetRootDB())
+                  ->GetImpl(ReadOptions(), db_->DefaultColumnFamily(),
+                            "k" + std::to_string(i), &index_entry,
+                            nullptr /*value_found*/,
+                            nullptr /*read_callback*/, &is_blob_index));
+    if (i == 2 || i == 5) {
+      ASSERT_FALSE(is_blob_index);
+      continue;
+    }
+    ASSERT_TRUE(is_blob_index);
+    BlobIndex blob_index;
+    Slice src(index_entry);
+    ASSERT_OK(blob_index.DecodeFrom(&src));
+    ASSERT_GT(blob_index.file_number, input_file_number);
+  }
+  // Records of the overwritten keys in the output file are known dead.
+  GetBlobStorage().lock()->ExportBlobFiles(blob_files);
+  size_t num_dead_records = 0;
+  for (auto& file : blob_files) {
+    auto meta = file.second.lock();
+    if (meta != nullptr && file.first > input_file_number) {
+      MutexLock l(GetTitanMutex());
+      num_dead_records += meta->dead_records().size();
+    }
+  }
+  ASSERT_EQ(num_dead_records, 2);
+}
+
 TEST_F(TitanDBTest, IngestDuringGC) {
   options_.max_background_gc = 2;
   options_.disable_background_gc = false;
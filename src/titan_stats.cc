@@ -36,6 +36,10 @@ static const std::string num_discardable_ratio_le80_file =
     "num-discardable-ratio-le80-file";
 static const std::string num_discardable_ratio_le100_file =
     "num-discardable-ratio-le100-file";
+static const std::string num_pending_gc = "num-pending-gc";
+static const std::string num_running_gc = "num-running-gc";
+static const std::string gc_reclaimable_size = "gc-reclaimable-size";
+static const std::string gc_bytes_per_sec = "gc-bytes-per-sec";
 
 const std::string TitanDB::Properties::kNumBlobFilesAtLevelPrefix =
     titandb_prefix + num_blob_files_at_level_prefix;
@@ -59,6 +63,14 @@ const std::string TitanDB::Properties::kNumDiscardableRatioLE80File =
     titandb_prefix + num_discardable_ratio_le80_file;
 const std::string TitanDB::Properties::kNumDiscardableRatioLE100File =
     titandb_prefix + num_discardable_ratio_le100_file;
+const std::string TitanDB::Properties::kNumPendingGC =
+    titandb_prefix + num_pending_gc;
+const std::string TitanDB::Properties::kNumRunningGC =
+    titandb_prefix + num_running_gc;
+const std::string TitanDB::Properties::kGCReclaimableSize =
+    titandb_prefix + gc_reclaimable_size;
+const std::string TitanDB::Properties::kGCBytesPerSec =
+    titandb_prefix + gc_bytes_per_sec;
 
 const std::unordered_map<
     std::string, std::function<uint64_t(const TitanInternalStats*, Slice)>>
@@ -32,6 +32,8 @@ enum class InternalOpStatsType : int {
   GC_READ_LSM_MICROS,
   // Update lsm and write callback
   GC_UPDATE_LSM_MICROS,
+  GC_NUM_KEYS_OVERWRITTEN,
+  GC_NUM_KEYS_RELOCATED,
   INTERNAL_OP_STATS_ENUM_MAX,
 };
 
@@ -91,6 +93,11 @@ class TitanInternalStats {
         internal_op_stats_[op][stat].store(0, std::memory_order_relaxed);
       }
     }
+    value_size_hist_.Clear();
+  }
+
+  uint64_t GetStats(StatsType type) const {
+    return stats_[type].load(std::memory_order_relaxed);
   }
 
   void ResetStats(StatsType type) {
@@ -111,6 +118,12 @@ class TitanInternalStats {
     return &internal_op_stats_[static_cast<int>(type)];
   }
 
+  // Sizes of values written by flush, no matter they are separated or not.
+  // Used to auto tune min_blob_size.
+  void RecordValueSize(uint64_t size) { value_size_hist_.Add(size); }
+
+  HistogramImpl* value_size_histogram() { return &value_size_hist_; }
+
   void DumpAndResetInternalOpStats(LogBuffer* log_buffer);
 
   bool GetIntProperty(const Slice& property, uint64_t* value) const;
@@ -130,6 +143,7 @@ class TitanInternalStats {
   std::array<InternalOpStats,
              static_cast<size_t>(InternalOpType::INTERNAL_OP_ENUM_MAX)>
       internal_op_stats_;
+  HistogramImpl value_size_hist_;
   std::shared_ptr<BlobStorage> blob_storage_;
 };
 
@@ -203,7 +217,24 @@ inline void SubStats(TitanStats* stats, uint32_t cf_id,
   }
 }
 
+inline void RecordValueSize(TitanStats* stats, uint32_t cf_id,
+                            uint64_t size) {
+  if (stats) {
+    auto p = stats->internal_stats(cf_id);
+    if (p) {
+      p->RecordValueSize(size);
+    }
+  }
+}
+
 // Utility functions for Titan internal operation stats type
+inline uint64_t GetStats(InternalOpStats* stats, InternalOpStatsType type) {
+  if (stats != nullptr) {
+    return (*stats)[static_cast<int>(type)].load(std::memory_order_relaxed);
+  }
+  return 0;
+}
+
 inline uint64_t GetAndResetStats(InternalOpStats* stats,
                                  InternalOpStatsType type) {
   if (stats != nullptr) {
@@ -1,5 +1,12 @@
 #include "util.h"
 
+#ifdef ROCKSDB_FALLOCATE_PRESENT
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/falloc.h>
+#include <unistd.h>
+#endif
+
 #include "util/stop_watch.h"
 
 namespace rocksdb {
@@ -166,5 +173,29 @@ Status SyncTitanManifest(Env* env, TitanStats* stats,
   return file->Sync(db_options->use_fsync);
 }
 
+Status PunchHole(const std::string& fname, uint64_t offset, uint64_t size) {
+#ifdef ROCKSDB_FALLOCATE_PRESENT
+  int fd = open(fname.c_str(), O_WRONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return Status::IOError("While open file to punch hole", fname);
+  }
+  Status s;
+  if (fallocate(fd, FALLOC_FL_KEEP_SIZE | FALLOC_FL_PUNCH_HOLE,
+                static_cast<off_t>(offset), static_cast<off_t>(size)) != 0) {
+    if (errno == EOPNOTSUPP) {
+      s = Status::NotSupported("Punch hole not supported", fname);
+    } else {
+      s = Status::IOError("While punch hole", fname);
+    }
+  }
+  close(fd);
+  return s;
+#else
+  (void)offset;
+  (void)size;
+  return Status::NotSupported("Punch hole not supported", fname);
+#endif
+}
+
 }  // namespace titandb
 }  // namespace rocksdb
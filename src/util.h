@@ -79,5 +79,10 @@ Status SyncTitanManifest(Env* env, TitanStats* stats,
                          const ImmutableDBOptions* db_options,
                          WritableFileWriter* file);
 
+// Deallocates the range of the file without changing its size, so that the
+// range reads as zeros afterwards. Returns NotSupported if the platform or
+// file system can't punch holes.
+Status PunchHole(const std::string& fname, uint64_t offset, uint64_t size);
+
 }  // namespace titandb
 }  // namespace rocksdb
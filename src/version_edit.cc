@@ -20,11 +20,56 @@ void VersionEdit::EncodeTo(std::string* dst) const {
     // obsolete sequence is a inpersistent field, so no need to encode it.
     PutVarint32Varint64(dst, kDeletedBlobFile, file.first);
   }
+  for (auto& dict : added_dicts_) {
+    PutVarint32Varint64(dst, kAddedCompressionDict, dict.first);
+    PutLengthPrefixedSlice(dst, dict.second);
+  }
+  for (auto& file : punched_holes_) {
+    PutVarint32Varint64(dst, kPunchedBlobFileHoles, file.first);
+    PutVarint32(dst, static_cast<uint32_t>(file.second.size()));
+    for (auto& hole : file.second) {
+      PutVarint64Varint64(dst, hole.first, hole.second);
+    }
+  }
+  for (auto& file : gc_resume_positions_) {
+    PutVarint32Varint64(dst, kGCResumePosition, file.first);
+    PutVarint64(dst, file.second.first);
+    PutVarint32(dst, file.second.second);
+  }
+  for (auto& file : dead_records_) {
+    PutVarint32Varint64(dst, kDeadBlobRecords, file.first);
+    file.second.EncodeTo(dst);
+  }
+  for (auto& file : deletion_tracked_) {
+    PutVarint32Varint64(dst, kBlobDeletionTracked, file.first);
+    PutVarint32(dst, file.second ? 1 : 0);
+  }
+  for (auto& file : creation_times_) {
+    PutVarint32Varint64(dst, kBlobFileCreationTime, file.first);
+    PutVarint64(dst, file.second);
+  }
+  if (has_live_size_checkpoint_) {
+    PutVarint32(dst, kLiveSizeCheckpoint);
+    live_size_checkpoint_.EncodeTo(dst);
+  }
+  if (has_live_size_delta_) {
+    PutVarint32(dst, kLiveSizeDelta);
+    live_size_delta_.EncodeTo(dst);
+  }
 }
 
 Status VersionEdit::DecodeFrom(Slice* src) {
   uint32_t tag;
   uint64_t file_number;
+  uint64_t dict_id;
+  Slice raw_dict;
+  uint32_t num_holes;
+  BlobFileRanges holes;
+  uint64_t offset;
+  uint32_t slot;
+  BlobRecordSet records;
+  uint32_t tracked;
+  uint64_t creation_time;
   std::shared_ptr<BlobFileMeta> blob_file;
   Status s;
 
@@ -74,6 +119,79 @@ Status VersionEdit::DecodeFrom(Slice* src) {
           error = "deleted blob file";
         }
         break;
+      case kAddedCompressionDict:
+        if (GetVarint64(src, &dict_id) &&
+            GetLengthPrefixedSlice(src, &raw_dict)) {
+          AddCompressionDict(dict_id, raw_dict.ToString());
+        } else {
+          error = "added compression dict";
+        }
+        break;
+      case kPunchedBlobFileHoles:
+        if (GetVarint64(src, &file_number) && GetVarint32(src, &num_holes)) {
+          holes.clear();
+          for (uint32_t i = 0; i < num_holes; i++) {
+            uint64_t hole_offset, hole_size;
+            if (!GetVarint64(src, &hole_offset) ||
+                !GetVarint64(src, &hole_size)) {
+              error = "punched blob file holes";
+              break;
+            }
+            holes.emplace_back(hole_offset, hole_size);
+          }
+          if (!error) {
+            AddPunchedHoles(file_number, holes);
+          }
+        } else {
+          error = "punched blob file holes";
+        }
+        break;
+      case kGCResumePosition:
+        if (GetVarint64(src, &file_number) && GetVarint64(src, &offset) &&
+            GetVarint32(src, &slot)) {
+          SetGCResumePosition(file_number, offset, slot);
+        } else {
+          error = "gc resume position";
+        }
+        break;
+      case kDeadBlobRecords:
+        if (GetVarint64(src, &file_number) && records.DecodeFrom(src).ok()) {
+          AddDeadBlobRecords(file_number, records);
+        } else {
+          error = "dead blob records";
+        }
+        break;
+      case kBlobDeletionTracked:
+        if (GetVarint64(src, &file_number) && GetVarint32(src, &tracked)) {
+          SetBlobDeletionTracked(file_number, tracked != 0);
+        } else {
+          error = "blob deletion tracked";
+        }
+        break;
+      case kBlobFileCreationTime:
+        if (GetVarint64(src, &file_number) &&
+            GetVarint64(src, &creation_time)) {
+          SetBlobFileCreationTime(file_number, creation_time);
+        } else {
+          error = "blob file creation time";
+        }
+        break;
+      case kLiveSizeCheckpoint:
+        s = live_size_checkpoint_.DecodeFrom(src);
+        if (s.ok()) {
+          has_live_size_checkpoint_ = true;
+        } else {
+          error = "live size checkpoint";
+        }
+        break;
+      case kLiveSizeDelta:
+        s = live_size_delta_.DecodeFrom(src);
+        if (s.ok()) {
+          has_live_size_delta_ = true;
+        } else {
+          error = "live size delta";
+        }
+        break;
       default:
         error = "unknown tag";
         break;
@@ -104,7 +222,17 @@ bool operator==(const VersionEdit& lhs, const VersionEdit& rhs) {
   return (lhs.has_next_file_number_ == rhs.has_next_file_number_ &&
           lhs.next_file_number_ == rhs.next_file_number_ &&
           lhs.column_family_id_ == rhs.column_family_id_ &&
-          lhs.deleted_files_ == rhs.deleted_files_);
+          lhs.deleted_files_ == rhs.deleted_files_ &&
+          lhs.added_dicts_ == rhs.added_dicts_ &&
+          lhs.punched_holes_ == rhs.punched_holes_ &&
+          lhs.gc_resume_positions_ == rhs.gc_resume_positions_ &&
+          lhs.dead_records_ == rhs.dead_records_ &&
+          lhs.deletion_tracked_ == rhs.deletion_tracked_ &&
+          lhs.creation_times_ == rhs.creation_times_ &&
+          lhs.has_live_size_checkpoint_ == rhs.has_live_size_checkpoint_ &&
+          lhs.live_size_checkpoint_ == rhs.live_size_checkpoint_ &&
+          lhs.has_live_size_delta_ == rhs.has_live_size_delta_ &&
+          lhs.live_size_delta_ == rhs.live_size_delta_);
 }
 
 void VersionEdit::Dump(bool with_keys) const {
@@ -125,6 +253,65 @@ void VersionEdit::Dump(bool with_keys) const {
               file.second);
     }
   }
+  if (!added_dicts_.empty()) {
+    fprintf(stdout, "add compression dicts:\n");
+    for (auto& dict : added_dicts_) {
+      fprintf(stdout, "dict %" PRIu64 ", size %" PRIu64 "\n", dict.first,
+              static_cast<uint64_t>(dict.second.size()));
+    }
+  }
+  if (!punched_holes_.empty()) {
+    fprintf(stdout, "punch holes:\n");
+    for (auto& file : punched_holes_) {
+      fprintf(stdout, "file %" PRIu64 ", %" PRIuPTR " holes\n", file.first,
+              file.second.size());
+    }
+  }
+  if (!gc_resume_positions_.empty()) {
+    fprintf(stdout, "gc resume positions:\n");
+    for (auto& file : gc_resume_positions_) {
+      fprintf(stdout,
+              "file %" PRIu64 ", offset %" PRIu64 ", slot %" PRIu32 "\n",
+              file.first, file.second.first, file.second.second);
+    }
+  }
+  if (!dead_records_.empty()) {
+    fprintf(stdout, "dead records:\n");
+    for (auto& file : dead_records_) {
+      fprintf(stdout, "file %" PRIu64 ", %" PRIu64 " records\n", file.first,
+              file.second.size());
+    }
+  }
+  if (!deletion_tracked_.empty()) {
+    fprintf(stdout, "deletion tracked:\n");
+    for (auto& file : deletion_tracked_) {
+      fprintf(stdout, "file %" PRIu64 ", %s\n", file.first,
+              file.second ? "tracked" : "not tracked");
+    }
+  }
+  if (!creation_times_.empty()) {
+    fprintf(stdout, "creation times:\n");
+    for (auto& file : creation_times_) {
+      fprintf(stdout, "file %" PRIu64 ", %" PRIu64 "\n", file.first,
+              file.second);
+    }
+  }
+  if (has_live_size_checkpoint_) {
+    fprintf(stdout,
+            "live size checkpoint: %" PRIu64 " SSTs up to %" PRIu64
+            ", %" PRIuPTR " files\n",
+            live_size_checkpoint_.num_ssts,
+            live_size_checkpoint_.max_sst_number,
+            live_size_checkpoint_.live_sizes.size());
+  }
+  if (has_live_size_delta_) {
+    fprintf(stdout,
+            "live size delta: %" PRIuPTR " SSTs added, %" PRIuPTR
+            " deleted, %" PRIuPTR " files\n",
+            live_size_delta_.added_ssts.size(),
+            live_size_delta_.deleted_ssts.size(),
+            live_size_delta_.live_sizes.size());
+  }
 }
 
 }  // namespace titandb
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <map>
 #include <set>
 
 #include "blob_format.h"
@@ -17,6 +18,14 @@ enum Tag {
   kDeletedBlobFile = 12,  // Deprecated, leave here for backward compatibility
   kAddedBlobFileV2 = 13,  // Comparing to kAddedBlobFile, it newly includes
                           // smallest_key and largest_key of blob file
+  kAddedCompressionDict = 14,  // Shared compression dictionary of blob files
+  kPunchedBlobFileHoles = 15,  // Dead ranges punched out of a blob file
+  kGCResumePosition = 16,      // Where GC of a blob file was interrupted
+  kLiveSizeCheckpoint = 17,    // Live data sizes of blob files at some SSTs
+  kLiveSizeDelta = 18,         // Change of the checkpoint by an SST event
+  kDeadBlobRecords = 19,       // Records of a blob file dropped from the LSM
+  kBlobDeletionTracked = 20,   // Whether all dropped records are known
+  kBlobFileCreationTime = 21,  // Creation time of a blob file
 };
 
 class VersionEdit {
@@ -36,6 +45,41 @@ class VersionEdit {
     deleted_files_.emplace_back(std::make_pair(file_number, obsolete_sequence));
   }
 
+  void AddCompressionDict(uint64_t dict_id, const std::string& raw_dict) {
+    added_dicts_.emplace_back(dict_id, raw_dict);
+  }
+
+  void AddPunchedHoles(uint64_t file_number, const BlobFileRanges& holes) {
+    punched_holes_.emplace_back(file_number, holes);
+  }
+
+  void SetGCResumePosition(uint64_t file_number, uint64_t offset,
+                           uint32_t slot) {
+    gc_resume_positions_[file_number] = std::make_pair(offset, slot);
+  }
+
+  void AddDeadBlobRecords(uint64_t file_number, const BlobRecordSet& records) {
+    dead_records_.emplace_back(file_number, records);
+  }
+
+  void SetBlobDeletionTracked(uint64_t file_number, bool tracked) {
+    deletion_tracked_[file_number] = tracked;
+  }
+
+  void SetBlobFileCreationTime(uint64_t file_number, uint64_t time) {
+    creation_times_[file_number] = time;
+  }
+
+  void SetLiveSizeCheckpoint(const LiveSizeCheckpoint& checkpoint) {
+    has_live_size_checkpoint_ = true;
+    live_size_checkpoint_ = checkpoint;
+  }
+
+  void SetLiveSizeDelta(const LiveSizeDelta& delta) {
+    has_live_size_delta_ = true;
+    live_size_delta_ = delta;
+  }
+
   void EncodeTo(std::string* dst) const;
   Status DecodeFrom(Slice* src);
 
@@ -54,6 +98,23 @@ class VersionEdit {
 
   std::vector<std::shared_ptr<BlobFileMeta>> added_files_;
   std::vector<std::pair<uint64_t, SequenceNumber>> deleted_files_;
+  // dict id -> raw dictionary
+  std::vector<std::pair<uint64_t, std::string>> added_dicts_;
+  // file number -> holes punched
+  std::vector<std::pair<uint64_t, BlobFileRanges>> punched_holes_;
+  // file number -> offset and slot to resume GC from
+  std::map<uint64_t, std::pair<uint64_t, uint32_t>> gc_resume_positions_;
+  // file number -> records dropped from the LSM
+  std::vector<std::pair<uint64_t, BlobRecordSet>> dead_records_;
+  // file number -> whether deletions of the file are tracked
+  std::map<uint64_t, bool> deletion_tracked_;
+  // file number -> creation time in seconds since epoch
+  std::map<uint64_t, uint64_t> creation_times_;
+  bool has_live_size_checkpoint_{false};
+  LiveSizeCheckpoint live_size_checkpoint_;
+  // Applied after the checkpoint if the edit has both.
+  bool has_live_size_delta_{false};
+  LiveSizeDelta live_size_delta_;
 };
 
 }  // namespace titandb
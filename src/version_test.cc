@@ -137,6 +137,65 @@ TEST_F(VersionTest, VersionEdit) {
   input.DeleteBlobFile(7, 0);
   input.DeleteBlobFile(8, 0);
   CheckCodec(input);
+  input.AddCompressionDict(9, "dict");
+  CheckCodec(input);
+  input.AddPunchedHoles(3, {{10, 20}, {40, 5}});
+  CheckCodec(input);
+  input.SetGCResumePosition(5, 100, 2);
+  CheckCodec(input);
+  BlobHandle record;
+  record.offset = 10;
+  record.size = 20;
+  BlobRecordSet records;
+  records.Add({record});
+  input.AddDeadBlobRecords(3, records);
+  CheckCodec(input);
+  input.SetBlobDeletionTracked(3, true);
+  input.SetBlobDeletionTracked(5, false);
+  CheckCodec(input);
+  input.SetBlobFileCreationTime(3, 1600000000);
+  CheckCodec(input);
+  LiveSizeCheckpoint checkpoint;
+  checkpoint.AddSST(11);
+  checkpoint.AddSST(12);
+  checkpoint.live_sizes[3] = 2;
+  checkpoint.live_sizes[5] = 6;
+  input.SetLiveSizeCheckpoint(checkpoint);
+  CheckCodec(input);
+  LiveSizeDelta delta;
+  delta.added_ssts = {13};
+  delta.deleted_ssts = {11, 12};
+  delta.live_sizes[3] = -2;
+  delta.live_sizes[7] = 4;
+  input.SetLiveSizeDelta(delta);
+  CheckCodec(input);
+}
+
+TEST_F(VersionTest, LiveSizeDelta) {
+  LiveSizeCheckpoint expected;
+  expected.AddSST(12);
+  expected.AddSST(13);
+  expected.live_sizes[3] = 5;
+
+  LiveSizeCheckpoint checkpoint;
+  checkpoint.AddSST(10);
+  checkpoint.live_sizes[3] = 4;
+  // SST 11 flushed, referencing blob files 3 and 5.
+  LiveSizeDelta flush;
+  flush.added_ssts = {11};
+  flush.live_sizes[3] = 2;
+  flush.live_sizes[5] = 2;
+  // SSTs 10 and 11 compacted into 12 and 13, dropping blob file 5.
+  LiveSizeDelta compaction;
+  compaction.added_ssts = {12, 13};
+  compaction.deleted_ssts = {10, 11};
+  compaction.live_sizes[3] = -1;
+  compaction.live_sizes[5] = -2;
+  // The compaction is applied before the flush, so the size of blob file 5
+  // wraps below zero in between.
+  checkpoint.Apply(compaction);
+  checkpoint.Apply(flush);
+  ASSERT_TRUE(expected == checkpoint);
 }
 
 VersionEdit AddBlobFilesEdit(uint32_t cf_id, uint64_t start, uint64_t end) {
@@ -4,7 +4,7 @@
 if [ $# -ne 1 ]; then
   echo -n "./benchmark.sh [bulkload/fillseq/overwrite/filluniquerandom/"
   echo    "readrandom/readwhilewriting/readwhilemerging/updaterandom/"
-  echo    "mergerandom/randomtransaction/compact]"
+  echo    "mergerandom/randomtransaction/compact/lazy_separation]"
   exit 0
 fi
 
@@ -52,6 +52,8 @@ duration=${DURATION:-0}
 num_keys=${NUM_KEYS:-$((1 * G))}
 key_size=${KEY_SIZE:-20}
 value_size=${VALUE_SIZE:-100}
+# Only for lazy_separation, per-level min blob size thresholds of Titan
+level_min_blob_size=${LEVEL_MIN_BLOB_SIZE:-"18446744073709551615,18446744073709551615,18446744073709551615,0"}
 
 const_params="
   --db=$DB_DIR \
@@ -391,6 +393,33 @@ function run_range {
   summarize_result $output_dir/${out_name} ${full_name}.t${num_threads} seekrandom
 }
 
+function run_lazy_separation {
+  # Compare write amplification of separating values at flush with separating
+  # them only when they are compacted into lower levels. Values are overwritten
+  # randomly, so that many of them die in upper levels. Note that W-Amp in the
+  # report only covers SSTs, bytes written to blob files by flush, compaction
+  # and GC are dumped in Titan internal stats of the info log.
+  for mode in eager lazy; do
+    if [ $mode = lazy ]; then
+      separation_params="--titan_min_blob_size=0 --titan_level_min_blob_size=$level_min_blob_size"
+    else
+      separation_params="--titan_min_blob_size=0"
+    fi
+    out_name="benchmark_lazy_separation.${mode}.v${value_size}.log"
+    echo "Overwrite $num_keys random keys with $mode separation"
+    cmd="./titandb_bench --benchmarks=fillrandom,overwrite,stats \
+         --use_existing_db=0 \
+         $const_params \
+         $separation_params \
+         --threads=$num_threads \
+         --seed=$( date +%s ) \
+         2>&1 | tee -a $output_dir/${out_name}"
+    echo $cmd | tee $output_dir/${out_name}
+    eval $cmd
+    summarize_result $output_dir/${out_name} lazy_separation.${mode}.v${value_size} overwrite
+  done
+}
+
 function run_randomtransaction {
   echo "..."
   cmd="./titandb_bench $params_r --benchmarks=randomtransaction \
@@ -454,6 +483,8 @@ for job in ${jobs[@]}; do
     run_rangewhile merging $job false
   elif [ $job = revrangewhilemerging ]; then
     run_rangewhile merging $job true
+  elif [ $job = lazy_separation ]; then
+    run_lazy_separation
   elif [ $job = randomtransaction ]; then
     run_randomtransaction
   elif [ $job = universal_compaction ]; then
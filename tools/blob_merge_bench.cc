@@ -0,0 +1,220 @@
+// Copyright 2021-present TiKV Project Authors. Licensed under Apache-2.0.
+
+#ifndef GFLAGS
+#include <cstdio>
+int main() {
+  fprintf(stderr, "Please install gflags to run Titan tools.\n");
+  return 1;
+}
+#else
+
+#ifndef __STDC_FORMAT_MACROS
+#define __STDC_FORMAT_MACROS
+#endif
+
+#include <inttypes.h>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "db/dbformat.h"
+#include "file/filename.h"
+#include "rocksdb/env.h"
+#include "util/gflags_compat.h"
+#include "util/string_util.h"
+
+#include "blob_file_builder.h"
+#include "blob_file_iterator.h"
+#include "blob_file_reader.h"
+
+using GFLAGS_NAMESPACE::ParseCommandLineFlags;
+using GFLAGS_NAMESPACE::SetUsageMessage;
+
+DEFINE_string(fan_in, "2,8,32,128,512",
+              "Comma separated numbers of blob files to merge.");
+DEFINE_uint64(num_records, 1000000, "Number of records merged in each run.");
+DEFINE_uint64(value_size, 16, "Size of blob record values.");
+DEFINE_string(dir, "", "Directory for blob files, a temp dir if empty.");
+
+#define handle_error(s, location)                                           \
+  if (!s.ok()) {                                                            \
+    fprintf(stderr, "error when %s: %s\n", location, s.ToString().c_str()); \
+    return 1;                                                               \
+  }
+
+namespace rocksdb {
+namespace titandb {
+
+// Merges blob files whose keys are interleaved with each other, the worst
+// case for the merge, and reports the time spent by the merge on top of
+// scanning the files one by one.
+class BlobMergeBench {
+ public:
+  BlobMergeBench(Env* env, const std::string& dir) : env_(env) {
+    options_.dirname = dir;
+  }
+
+  Status Run(size_t fan_in) {
+    Status s = BuildFiles(fan_in);
+    if (s.ok()) {
+      s = Measure(fan_in);
+    }
+    for (uint64_t file_number = 1; file_number <= fan_in; file_number++) {
+      env_->DeleteFile(BlobFileName(options_.dirname, file_number));
+    }
+    return s;
+  }
+
+ private:
+  Status BuildFiles(size_t fan_in) {
+    TitanDBOptions db_options(options_);
+    TitanCFOptions cf_options(options_);
+    std::string value(FLAGS_value_size, 'v');
+    char key[32];
+    for (uint64_t file_number = 1; file_number <= fan_in; file_number++) {
+      std::string file_name = BlobFileName(options_.dirname, file_number);
+      std::unique_ptr<WritableFile> f;
+      Status s = env_->NewWritableFile(file_name, &f, env_options_);
+      if (!s.ok()) {
+        return s;
+      }
+      WritableFileWriter file(std::move(f), file_name, env_options_);
+      BlobFileBuilder builder(db_options, cf_options, &file);
+      BlobFileBuilder::OutContexts contexts;
+      for (uint64_t i = file_number - 1; i < FLAGS_num_records; i += fan_in) {
+        snprintf(key, sizeof(key), "%016" PRIu64, i);
+        BlobRecord record;
+        record.key = key;
+        record.value = value;
+        std::unique_ptr<BlobFileBuilder::BlobRecordContext> ctx(
+            new BlobFileBuilder::BlobRecordContext);
+        ctx->key = InternalKey(key, 1, kTypeValue).Encode().ToString();
+        builder.Add(record, std::move(ctx), &contexts);
+        contexts.clear();
+      }
+      s = builder.status();
+      if (s.ok()) {
+        s = builder.Finish(&contexts);
+      }
+      if (s.ok()) {
+        s = file.Sync(false /*use_fsync*/);
+      }
+      if (s.ok()) {
+        s = file.Close();
+      }
+      if (!s.ok()) {
+        return s;
+      }
+    }
+    return Status::OK();
+  }
+
+  Status NewIterators(size_t fan_in,
+                      std::vector<std::unique_ptr<BlobFileIterator>>* iters) {
+    for (uint64_t file_number = 1; file_number <= fan_in; file_number++) {
+      uint64_t file_size = 0;
+      Status s = env_->GetFileSize(
+          BlobFileName(options_.dirname, file_number), &file_size);
+      std::unique_ptr<RandomAccessFileReader> file;
+      if (s.ok()) {
+        s = NewBlobFileReader(file_number, 0, options_, env_options_, env_,
+                              &file);
+      }
+      if (!s.ok()) {
+        return s;
+      }
+      iters->emplace_back(new BlobFileIterator(std::move(file), file_number,
+                                               file_size,
+                                               TitanCFOptions(options_)));
+    }
+    return Status::OK();
+  }
+
+  Status Measure(size_t fan_in) {
+    // Scan files one by one first, which also warms up page cache.
+    std::vector<std::unique_ptr<BlobFileIterator>> iters;
+    Status s = NewIterators(fan_in, &iters);
+    if (!s.ok()) {
+      return s;
+    }
+    uint64_t scanned = 0;
+    uint64_t start = env_->NowNanos();
+    for (auto& iter : iters) {
+      for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+        scanned++;
+      }
+      if (!iter->status().ok()) {
+        return iter->status();
+      }
+    }
+    uint64_t scan_nanos = env_->NowNanos() - start;
+
+    iters.clear();
+    s = NewIterators(fan_in, &iters);
+    if (!s.ok()) {
+      return s;
+    }
+    BlobFileMergeIterator merge_iter(std::move(iters), options_.comparator);
+    uint64_t merged = 0;
+    start = env_->NowNanos();
+    for (merge_iter.SeekToFirst(); merge_iter.Valid(); merge_iter.Next()) {
+      merged++;
+    }
+    uint64_t merge_nanos = env_->NowNanos() - start;
+    if (!merge_iter.status().ok()) {
+      return merge_iter.status();
+    }
+    if (merged != scanned || merged == 0) {
+      return Status::Corruption("Merged " + ToString(merged) + " of " +
+                                ToString(scanned) + " records");
+    }
+
+    double overhead = merge_nanos > scan_nanos
+                          ? static_cast<double>(merge_nanos - scan_nanos)
+                          : 0;
+    fprintf(stdout,
+            "fan-in %5" PRIuPTR ": %10.0f records/s, %7.1f ns/record, "
+            "merge overhead %7.1f ns/record\n",
+            fan_in, merged * 1e9 / std::max<uint64_t>(merge_nanos, 1),
+            static_cast<double>(merge_nanos) / merged, overhead / merged);
+    return Status::OK();
+  }
+
+  Env* env_;
+  TitanOptions options_;
+  EnvOptions env_options_;
+};
+
+int blob_merge_bench() {
+  Env* env = Env::Default();
+  std::string dir = FLAGS_dir;
+  Status s;
+  if (dir.empty()) {
+    s = env->GetTestDirectory(&dir);
+    handle_error(s, "get temp dir");
+    dir += "/titan_blob_merge_bench";
+  }
+  s = env->CreateDirIfMissing(dir);
+  handle_error(s, "create dir");
+
+  BlobMergeBench bench(env, dir);
+  for (const auto& fan_in : StringSplit(FLAGS_fan_in, ',')) {
+    s = bench.Run(static_cast<size_t>(std::stoull(fan_in)));
+    handle_error(s, "run benchmark");
+  }
+  env->DeleteDir(dir);
+  return 0;
+}
+
+}  // namespace titandb
+}  // namespace rocksdb
+
+int main(int argc, char** argv) {
+  SetUsageMessage(std::string("\nUSAGE\n") + std::string(argv[0]) +
+                  " [OPTIONS]...");
+  ParseCommandLineFlags(&argc, &argv, true);
+  return rocksdb::titandb::blob_merge_bench();
+}
+
+#endif  // GFLAGS
@@ -74,6 +74,7 @@
 #include "utilities/persistent_cache/block_cache_tier.h"
 
 #include "titan/db.h"
+#include "titan/statistics.h"
 
 #ifdef OS_WIN
 #include <io.h>  // open/close
@@ -136,6 +137,8 @@ DEFINE_string(
     " key order and keep the shape of the LSM tree\n"
     "\toverwrite     -- overwrite N values in random key order in"
     " async mode\n"
+    "\toverwritehotcold -- overwrite N values with most writes going to a"
+    " small hot set of keys, and report Titan GC write amplification\n"
     "\tfillsync      -- write N/100 values in random key order in "
     "sync mode\n"
     "\tfill100K      -- write N/1000 100K values in random order in"
@@ -290,6 +293,14 @@ DEFINE_double(read_random_exp_range, 0.0,
               "The larger the number is, the more skewed the reads are. "
               "Only used in readrandom and multireadrandom benchmarks.");
 
+DEFINE_double(hot_key_fraction, 0.1,
+              "Fraction of keys which are hot in the overwritehotcold "
+              "benchmark.");
+
+DEFINE_double(hot_write_ratio, 0.9,
+              "Fraction of writes going to hot keys in the overwritehotcold "
+              "benchmark.");
+
 DEFINE_bool(histogram, false, "Print histogram of operation timings");
 
 DEFINE_bool(enable_numa, false,
@@ -768,14 +779,136 @@ DEFINE_uint64(titan_min_blob_size, 0,
               "Smallest blob to store in a file. Blobs smaller than this "
               "will be inlined with the key in the LSM tree.");
 
+DEFINE_string(titan_level_min_blob_size, "",
+              "Comma-separated per-level min blob size of Titan, indexed by "
+              "output level. Levels beyond the list use the last entry. "
+              "Overrides titan_min_blob_size if non-empty.");
+
+DEFINE_bool(titan_min_blob_size_auto_tune, false,
+            "Let Titan adjust min blob size based on value sizes and GC "
+            "statistics.");
+
+DEFINE_uint64(titan_blob_file_block_size,
+              rocksdb::titandb::TitanOptions().blob_file_block_size,
+              "Pack Titan blob records into compressed blocks of this size. "
+              "0 disables packing.");
+
+DEFINE_bool(titan_blob_file_shared_compression_dict, false,
+            "Compress Titan blob files with a shared dictionary per column "
+            "family, configured by compression_max_dict_bytes and "
+            "compression_zstd_max_train_bytes.");
+
+DEFINE_string(titan_level_blob_file_compression, "",
+              "Comma-separated per-level compression type of Titan blob "
+              "files, indexed by output level. Levels beyond the list use the "
+              "last entry. Overrides compression_type if non-empty.");
+
+DEFINE_string(titan_gc_blob_file_compression, "",
+              "Compression type of Titan blob files rewritten by GC. Uses the "
+              "blob file compression if empty.");
+
+DEFINE_string(titan_level_blob_file_compression_level, "",
+              "Comma-separated per-level compression level of Titan blob "
+              "files, indexed by output level. Levels beyond the list use the "
+              "last entry. Overrides the blob file compression level if "
+              "non-empty.");
+
+DEFINE_int32(titan_gc_blob_file_compression_level,
+             rocksdb::titandb::kInheritBlobCompressionLevel,
+             "Compression level of Titan blob files rewritten by GC. Uses the "
+             "blob file compression level if unset.");
+
 DEFINE_bool(titan_disable_background_gc,
             rocksdb::titandb::TitanOptions().disable_background_gc,
             "Disable Titan background GC");
 
+DEFINE_uint64(titan_gc_lookup_batch_size,
+              rocksdb::titandb::TitanOptions().gc_lookup_batch_size,
+              "Number of blob records Titan GC checks against the LSM with "
+              "one MultiGet.");
+
+DEFINE_uint64(titan_gc_rewrite_buffer_size,
+              rocksdb::titandb::TitanOptions().gc_rewrite_buffer_size,
+              "If non-zero, Titan GC installs outputs and rewrites the LSM "
+              "whenever pending rewrites exceed this size.");
+
+DEFINE_uint64(titan_gc_rewrite_batch_keys,
+              rocksdb::titandb::TitanOptions().gc_rewrite_batch_keys,
+              "Max number of keys Titan GC rewrites to the LSM in one write.");
+
+DEFINE_int32(titan_gc_picker,
+             static_cast<int32_t>(rocksdb::titandb::TitanOptions().gc_picker),
+             "How Titan GC picks blob files. 0: by discardable ratio, "
+             "1: by cost-benefit.");
+
+DEFINE_bool(titan_gc_key_range_clustering,
+            rocksdb::titandb::TitanOptions().gc_key_range_clustering,
+            "Let Titan GC batch blob files with overlapping key ranges and "
+            "split its outputs at key range gaps.");
+
+DEFINE_double(titan_max_blob_space_amplification,
+              rocksdb::titandb::TitanOptions().max_blob_space_amplification,
+              "If non-zero, prioritize Titan GC and eventually delay writes "
+              "to keep blob space amplification under this target.");
+
+DEFINE_int32(titan_gc_validity_check_mode,
+             static_cast<int32_t>(
+                 rocksdb::titandb::TitanOptions().gc_validity_check_mode),
+             "How Titan GC checks validity of blob records. 0: point lookups, "
+             "1: merge-join with an LSM iterator, 2: pick by key density.");
+
+DEFINE_bool(titan_track_blob_record_deletions,
+            rocksdb::titandb::TitanOptions().track_blob_record_deletions,
+            "Track blob records dropped by compaction so that Titan GC can "
+            "skip validity lookups for them.");
+
+DEFINE_uint64(titan_punch_hole_min_size,
+              rocksdb::titandb::TitanOptions().punch_hole_min_size,
+              "If non-zero, Titan GC punches holes over runs of dead blob "
+              "records of at least this size instead of rewriting files.");
+
+DEFINE_double(titan_compaction_hint_discardable_ratio,
+              rocksdb::titandb::TitanOptions()
+                  .compaction_hint_discardable_ratio,
+              "If non-zero, mark SSTs referencing blob files with at least "
+              "this discardable ratio for compaction.");
+
 DEFINE_int32(titan_max_background_gc,
              rocksdb::titandb::TitanOptions().max_background_gc,
              "Titan max background GC threads.");
 
+DEFINE_int32(titan_max_gc_subjobs,
+             rocksdb::titandb::TitanOptions().max_gc_subjobs,
+             "Titan max threads used by a single GC job.");
+
+DEFINE_uint64(titan_gc_readahead_size,
+              rocksdb::titandb::TitanOptions().gc_readahead_size,
+              "If non-zero, Titan GC reads input blob files in chunks of this "
+              "size in the background.");
+
+DEFINE_bool(titan_use_direct_reads_for_gc,
+            rocksdb::titandb::TitanOptions().use_direct_reads_for_gc,
+            "Titan GC reads input blob files with direct I/O.");
+
+DEFINE_uint64(titan_gc_bytes_per_sec, 0,
+              "If non-zero, limit bytes read and written by all Titan GC "
+              "jobs to this rate.");
+
+DEFINE_bool(titan_adaptive_gc_rate,
+            rocksdb::titandb::TitanOptions().adaptive_gc_rate,
+            "Adjust --titan_gc_bytes_per_sec by foreground load.");
+
+DEFINE_uint64(titan_adaptive_gc_rate_target_latency_micros,
+              rocksdb::titandb::TitanOptions()
+                  .adaptive_gc_rate_target_latency_micros,
+              "Target P99 latency of Titan blob file reads for "
+              "--titan_adaptive_gc_rate.");
+
+DEFINE_double(titan_adaptive_gc_rate_max_space_amp,
+              rocksdb::titandb::TitanOptions().adaptive_gc_rate_max_space_amp,
+              "Blob space amplification at which --titan_adaptive_gc_rate "
+              "stops holding GC back.");
+
 DEFINE_int64(titan_blob_cache_size, 0,
              "Size of Titan blob cache. Disabled by default.");
 
@@ -2773,6 +2906,8 @@ class Benchmark {
         method = &Benchmark::WriteUniqueRandom;
       } else if (name == "overwrite") {
         method = &Benchmark::WriteRandom;
+      } else if (name == "overwritehotcold") {
+        method = &Benchmark::OverwriteHotCold;
       } else if (name == "fillsync") {
         fresh_db = true;
         num_ /= 1000;
@@ -3829,12 +3964,65 @@ class Benchmark {
 
     options.listeners.emplace_back(listener_);
     opts->min_blob_size = FLAGS_titan_min_blob_size;
+    for (auto& size : StringSplit(FLAGS_titan_level_min_blob_size, ',')) {
+      opts->level_min_blob_size.push_back(std::stoull(size));
+    }
+    opts->min_blob_size_auto_tune = FLAGS_titan_min_blob_size_auto_tune;
     opts->level_merge = FLAGS_titan_level_merge;
     opts->range_merge = FLAGS_titan_range_merge;
     opts->disable_background_gc = FLAGS_titan_disable_background_gc;
     opts->max_background_gc = FLAGS_titan_max_background_gc;
+    opts->max_gc_subjobs = static_cast<uint32_t>(FLAGS_titan_max_gc_subjobs);
+    opts->gc_readahead_size = FLAGS_titan_gc_readahead_size;
+    opts->use_direct_reads_for_gc = FLAGS_titan_use_direct_reads_for_gc;
+    if (FLAGS_titan_gc_bytes_per_sec > 0) {
+      opts->gc_rate_limiter.reset(NewGenericRateLimiter(
+          FLAGS_titan_gc_bytes_per_sec, 100 * 1000 /* refill_period_us */,
+          10 /* fairness */, RateLimiter::Mode::kAllIo));
+    }
+    opts->adaptive_gc_rate = FLAGS_titan_adaptive_gc_rate;
+    opts->adaptive_gc_rate_target_latency_micros =
+        FLAGS_titan_adaptive_gc_rate_target_latency_micros;
+    opts->adaptive_gc_rate_max_space_amp =
+        FLAGS_titan_adaptive_gc_rate_max_space_amp;
+    opts->gc_picker = static_cast<rocksdb::titandb::TitanBlobGCPickerType>(
+        FLAGS_titan_gc_picker);
+    opts->gc_key_range_clustering = FLAGS_titan_gc_key_range_clustering;
+    opts->max_blob_space_amplification =
+        FLAGS_titan_max_blob_space_amplification;
+    opts->gc_lookup_batch_size = FLAGS_titan_gc_lookup_batch_size;
+    opts->gc_rewrite_buffer_size = FLAGS_titan_gc_rewrite_buffer_size;
+    opts->gc_rewrite_batch_keys = FLAGS_titan_gc_rewrite_batch_keys;
+    opts->gc_validity_check_mode =
+        static_cast<rocksdb::titandb::TitanGCValidityCheckMode>(
+            FLAGS_titan_gc_validity_check_mode);
+    opts->track_blob_record_deletions =
+        FLAGS_titan_track_blob_record_deletions;
+    opts->punch_hole_min_size = FLAGS_titan_punch_hole_min_size;
+    opts->compaction_hint_discardable_ratio =
+        FLAGS_titan_compaction_hint_discardable_ratio;
     opts->min_gc_batch_size = 128 << 20;
     opts->blob_file_compression = FLAGS_compression_type_e;
+    opts->blob_file_block_size = FLAGS_titan_blob_file_block_size;
+    for (auto& ctype :
+         StringSplit(FLAGS_titan_level_blob_file_compression, ',')) {
+      opts->level_blob_file_compression.push_back(
+          StringToCompressionType(ctype.c_str()));
+    }
+    if (!FLAGS_titan_gc_blob_file_compression.empty()) {
+      opts->gc_blob_file_compression = StringToCompressionType(
+          FLAGS_titan_gc_blob_file_compression.c_str());
+    }
+    for (auto& level :
+         StringSplit(FLAGS_titan_level_blob_file_compression_level, ',')) {
+      opts->level_blob_file_compression_level.push_back(std::stoi(level));
+    }
+    opts->gc_blob_file_compression_level =
+        FLAGS_titan_gc_blob_file_compression_level;
+    if (FLAGS_titan_blob_file_shared_compression_dict) {
+      opts->blob_file_compression_options = options.compression_opts;
+      opts->blob_file_shared_compression_dict = true;
+    }
     if (FLAGS_titan_blob_cache_size > 0) {
       opts->blob_cache = NewLRUCache(FLAGS_titan_blob_cache_size);
     }
@@ -4044,7 +4232,7 @@ class Benchmark {
     }
   }
 
-  enum WriteMode { RANDOM, SEQUENTIAL, UNIQUE_RANDOM };
+  enum WriteMode { RANDOM, SEQUENTIAL, UNIQUE_RANDOM, HOT_COLD_RANDOM };
 
   void WriteSeqDeterministic(ThreadState* thread) {
     DoDeterministicCompact(thread, open_options_.compaction_style, SEQUENTIAL);
@@ -4063,6 +4251,46 @@ class Benchmark {
     DoWrite(thread, UNIQUE_RANDOM);
   }
 
+  // Overwrites with a hot and cold key set, to see how well Titan GC avoids
+  // rewriting cold data while hot data is still being overwritten. Run it
+  // with --statistics to get the GC write amplification.
+  void OverwriteHotCold(ThreadState* thread) {
+    DoWrite(thread, HOT_COLD_RANDOM);
+    if (thread->tid != 0 || !FLAGS_use_titan) {
+      return;
+    }
+    uint64_t blob_bytes_written = 0;
+    uint64_t gc_bytes_written = 0;
+    uint64_t gc_bytes_read = 0;
+    auto add_tickers = [&](DB* db) {
+      auto stats = db->GetDBOptions().statistics;
+      if (stats == nullptr) {
+        return;
+      }
+      blob_bytes_written +=
+          stats->getTickerCount(titandb::TITAN_BLOB_FILE_BYTES_WRITTEN);
+      gc_bytes_written +=
+          stats->getTickerCount(titandb::TITAN_GC_BYTES_WRITTEN);
+      gc_bytes_read += stats->getTickerCount(titandb::TITAN_GC_BYTES_READ);
+    };
+    if (db_.db != nullptr) {
+      add_tickers(db_.db);
+    }
+    for (const auto& db_with_cfh : multi_dbs_) {
+      add_tickers(db_with_cfh.db);
+    }
+    if (blob_bytes_written == 0) {
+      return;
+    }
+    char msg[200];
+    snprintf(msg, sizeof(msg),
+             "(GC read %.1f MB, wrote %.1f MB, blob write amp %.3f)",
+             gc_bytes_read / 1048576.0, gc_bytes_written / 1048576.0,
+             static_cast<double>(blob_bytes_written + gc_bytes_written) /
+                 blob_bytes_written);
+    thread->stats.AddMessage(msg);
+  }
+
   class KeyGenerator {
    public:
     KeyGenerator(Random64* rand, WriteMode mode, uint64_t num,
@@ -4092,6 +4320,16 @@ class Benchmark {
         case UNIQUE_RANDOM:
           assert(next_ < num_);
           return values_[next_++];
+        case HOT_COLD_RANDOM: {
+          uint64_t num_hot =
+              static_cast<uint64_t>(num_ * FLAGS_hot_key_fraction);
+          num_hot = std::min(num_, std::max<uint64_t>(num_hot, 1));
+          if (num_hot == num_ ||
+              rand_->Next() % 10000 < FLAGS_hot_write_ratio * 10000) {
+            return rand_->Next() % num_hot;
+          }
+          return num_hot + rand_->Next() % (num_ - num_hot);
+        }
       }
       assert(false);
       return std::numeric_limits<uint64_t>::max();
@@ -4124,7 +4362,9 @@ class Benchmark {
   }
 
   void DoWrite(ThreadState* thread, WriteMode write_mode) {
-    const int test_duration = write_mode == RANDOM ? FLAGS_duration : 0;
+    const int test_duration =
+        (write_mode == RANDOM || write_mode == HOT_COLD_RANDOM) ? FLAGS_duration
+                                                                 : 0;
     const int64_t num_ops = writes_ == 0 ? num_ : writes_;
 
     size_t num_key_gens = 1;
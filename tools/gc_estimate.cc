@@ -0,0 +1,176 @@
+// Copyright 2021-present TiKV Project Authors. Licensed under Apache-2.0.
+
+#ifndef GFLAGS
+#include <cstdio>
+int main() {
+  fprintf(stderr, "Please install gflags to run Titan tools.\n");
+  return 1;
+}
+#else
+
+#ifndef __STDC_FORMAT_MACROS
+#define __STDC_FORMAT_MACROS
+#endif
+
+#include <inttypes.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "titan/db.h"
+#include "util/gflags_compat.h"
+#include "util/string_util.h"
+
+using GFLAGS_NAMESPACE::ParseCommandLineFlags;
+using GFLAGS_NAMESPACE::SetUsageMessage;
+
+DEFINE_string(db, "", "Path of the Titan DB.");
+DEFINE_string(cf, "default", "Column family to estimate GC of.");
+DEFINE_string(blob_file_discardable_ratio, "",
+              "Comma separated values of blob_file_discardable_ratio, the "
+              "default if empty.");
+DEFINE_string(min_gc_batch_size, "",
+              "Comma separated values of min_gc_batch_size, the default if "
+              "empty.");
+DEFINE_string(max_gc_batch_size, "",
+              "Comma separated values of max_gc_batch_size, the default if "
+              "empty.");
+DEFINE_uint64(merge_small_file_threshold,
+              rocksdb::titandb::TitanOptions().merge_small_file_threshold,
+              "merge_small_file_threshold of the column family.");
+DEFINE_bool(verbose, false, "Output blob files of each batch.");
+
+#define handle_error(s, location)                                           \
+  if (!s.ok()) {                                                            \
+    fprintf(stderr, "error when %s: %s\n", location, s.ToString().c_str()); \
+    return 1;                                                               \
+  }
+
+namespace rocksdb {
+namespace titandb {
+
+void PrintEstimate(const TitanCFOptions& options,
+                   const GCEstimate& estimate) {
+  const double kMB = 1 << 20;
+  fprintf(stdout,
+          "discardable ratio %.2f, min batch %" PRIu64 ", max batch %" PRIu64
+          ": %" PRIuPTR " batches, read %.1f MB, write %.1f MB, "
+          "reclaim %.1f MB of %.1f MB in %" PRIu64 " files\n",
+          options.blob_file_discardable_ratio, options.min_gc_batch_size,
+          options.max_gc_batch_size, estimate.batches.size(),
+          estimate.bytes_read / kMB, estimate.bytes_written / kMB,
+          estimate.reclaimable_size / kMB, estimate.blob_file_size / kMB,
+          estimate.num_blob_files);
+  if (!FLAGS_verbose) {
+    return;
+  }
+  for (size_t i = 0; i < estimate.batches.size(); i++) {
+    const auto& batch = estimate.batches[i];
+    std::string files;
+    for (uint64_t file_number : batch.file_numbers) {
+      files += " " + ToString(file_number);
+    }
+    fprintf(stdout,
+            "  batch %" PRIuPTR ": read %" PRIu64 ", write %" PRIu64
+            ", files%s\n",
+            i, batch.bytes_read, batch.bytes_written, files.c_str());
+  }
+}
+
+int gc_estimate() {
+  if (FLAGS_db.empty()) {
+    fprintf(stderr, "DB path not given.\n");
+    return 1;
+  }
+  TitanCFOptions cf_options;
+  std::vector<double> ratios;
+  for (const auto& ratio :
+       StringSplit(FLAGS_blob_file_discardable_ratio, ',')) {
+    ratios.push_back(std::stod(ratio));
+  }
+  if (ratios.empty()) {
+    ratios.push_back(cf_options.blob_file_discardable_ratio);
+  }
+  std::vector<uint64_t> min_batch_sizes;
+  for (const auto& size : StringSplit(FLAGS_min_gc_batch_size, ',')) {
+    min_batch_sizes.push_back(std::stoull(size));
+  }
+  if (min_batch_sizes.empty()) {
+    min_batch_sizes.push_back(cf_options.min_gc_batch_size);
+  }
+  std::vector<uint64_t> max_batch_sizes;
+  for (const auto& size : StringSplit(FLAGS_max_gc_batch_size, ',')) {
+    max_batch_sizes.push_back(std::stoull(size));
+  }
+  if (max_batch_sizes.empty()) {
+    max_batch_sizes.push_back(cf_options.max_gc_batch_size);
+  }
+
+  // Nothing is supposed to be changed by the tool, other than the flush on
+  // opening the DB.
+  TitanDBOptions db_options;
+  db_options.disable_background_gc = true;
+  db_options.purge_obsolete_files_period_sec = 0;
+  cf_options.disable_auto_compactions = true;
+  cf_options.merge_small_file_threshold = FLAGS_merge_small_file_threshold;
+  cf_options.blob_file_discardable_ratio = ratios[0];
+
+  std::vector<std::string> cf_names;
+  Status s = DB::ListColumnFamilies(db_options, FLAGS_db, &cf_names);
+  handle_error(s, "list column families");
+  std::vector<TitanCFDescriptor> descs;
+  size_t cf_index = cf_names.size();
+  for (size_t i = 0; i < cf_names.size(); i++) {
+    descs.emplace_back(cf_names[i], cf_options);
+    if (cf_names[i] == FLAGS_cf) {
+      cf_index = i;
+    }
+  }
+  if (cf_index == cf_names.size()) {
+    fprintf(stderr, "Column family %s not found.\n", FLAGS_cf.c_str());
+    return 1;
+  }
+
+  TitanDB* db = nullptr;
+  std::vector<ColumnFamilyHandle*> handles;
+  s = TitanDB::Open(db_options, FLAGS_db, descs, &handles, &db);
+  handle_error(s, "open db");
+  std::unique_ptr<TitanDB> db_guard(db);
+
+  for (double ratio : ratios) {
+    for (uint64_t min_batch_size : min_batch_sizes) {
+      for (uint64_t max_batch_size : max_batch_sizes) {
+        cf_options.blob_file_discardable_ratio = ratio;
+        cf_options.min_gc_batch_size = min_batch_size;
+        cf_options.max_gc_batch_size = max_batch_size;
+        GCEstimate estimate;
+        s = db->EstimateGC(handles[cf_index], &cf_options, &estimate);
+        handle_error(s, "estimate gc");
+        PrintEstimate(cf_options, estimate);
+      }
+    }
+  }
+
+  for (auto* handle : handles) {
+    db->DestroyColumnFamilyHandle(handle);
+  }
+  s = db->Close();
+  handle_error(s, "close db");
+  return 0;
+}
+
+}  // namespace titandb
+}  // namespace rocksdb
+
+int main(int argc, char** argv) {
+  SetUsageMessage(
+      std::string("\nUSAGE\n") + std::string(argv[0]) +
+      " --db=<path> [OPTIONS]...\n\n"
+      "Estimates GC of a Titan column family with given GC options, for\n"
+      "each combination of them. The DB is opened with default options\n"
+      "otherwise, and must not be opened by others.");
+  ParseCommandLineFlags(&argc, &argv, true);
+  return rocksdb::titandb::gc_estimate();
+}
+
+#endif  // GFLAGS